@@ -22,9 +22,28 @@
 #include "mirac-glib-logging.hpp"
 #include <cassert>
 
-DesktopMediaManager::DesktopMediaManager(const std::string& hostname)
+DesktopMediaManager::DesktopMediaManager(const std::string& hostname,
+                                         const std::string& interface)
   : hostname_(hostname),
-    format_() {
+    interface_(interface),
+    sink_port1_(0),
+    sink_port2_(0),
+    format_(),
+    audio_codec_(),
+    audio_enabled_(true),
+    format_change_at_(GST_CLOCK_TIME_NONE),
+    pause_source_(nullptr) {
+  // Built while the RTSP negotiation is in flight, for the default format
+  // and LPCM (which all sinks support); SETUP only patches the caps and
+  // the destination, so that connecting does not wait for the pipeline.
+  CreatePipeline();
+}
+
+DesktopMediaManager::~DesktopMediaManager() {
+  if (pause_source_) {
+    g_source_destroy(pause_source_);
+    g_source_unref(pause_source_);
+  }
 }
 
 void DesktopMediaManager::Play() {
@@ -37,6 +56,16 @@ void DesktopMediaManager::Pause() {
   gst_pipeline_->SetState(GST_STATE_PAUSED);
 }
 
+void DesktopMediaManager::PlayAsync(const StateChangeCallback& completed) {
+  assert(gst_pipeline_);
+  gst_pipeline_->SetState(GST_STATE_PLAYING, completed);
+}
+
+void DesktopMediaManager::PauseAsync(const StateChangeCallback& completed) {
+  assert(gst_pipeline_);
+  gst_pipeline_->SetState(GST_STATE_PAUSED, completed);
+}
+
 void DesktopMediaManager::Teardown() {
   if (gst_pipeline_)
     gst_pipeline_->SetState(GST_STATE_READY);
@@ -51,16 +80,61 @@ std::string DesktopMediaManager::GetSessionId() const {
 }
 
 wds::SessionType DesktopMediaManager::GetSessionType() const {
+  // Without PulseAudio, or for a sink that takes none of the codecs, the
+  // pipeline is built for the video only
+  if (gst_pipeline_ && gst_pipeline_->HasAudio())
+    return wds::AudioVideoSession;
   return wds::VideoSession;
 }
 
 void DesktopMediaManager::SetSinkRtpPorts(int port1, int port2) {
   sink_port1_ = port1;
   sink_port2_ = port2;
-  gst_pipeline_.reset(new MiracGstTestSource(WFD_DESKTOP, hostname_, port1));
+  gst_pipeline_->SetDestination(hostname_, sink_port1_);
+  SchedulePause();
+}
+
+void DesktopMediaManager::CreatePipeline() {
+  gst_pipeline_.reset(new MiracGstTestSource(WFD_DESKTOP, format_,
+                                             audio_enabled_ ? &audio_codec_ : nullptr,
+                                             hostname_, sink_port1_, interface_));
+  // Slides and documents are static most of the time
+  if (!gst_pipeline_->EnableIdleFrameSkipping())
+    WDS_WARNING("Static screens are sent at the full frame rate");
   gst_pipeline_->SetState(GST_STATE_READY);
 }
 
+void DesktopMediaManager::UpdateVideoFormat() {
+  // The encoder takes a new format in READY only; going back there from
+  // PAUSED is still much cheaper than building a new pipeline
+  if (gst_pipeline_->GetState() == GST_STATE_PAUSED)
+    gst_pipeline_->SetState(GST_STATE_READY);
+  if (!gst_pipeline_->SetVideoFormat(format_)) {
+    WDS_WARNING("Cannot change the format of the pipeline, building a new one");
+    CreatePipeline();
+  }
+  SchedulePause();
+}
+
+void DesktopMediaManager::SchedulePause() {
+  if (pause_source_)
+    return;
+  // Once the M3 reply is done: the capture starts up in PAUSED, leaving
+  // only the encoder to start on PLAY
+  pause_source_ = g_idle_source_new();
+  g_source_set_callback(pause_source_, pause_cb, this, nullptr);
+  g_source_attach(pause_source_, g_main_context_get_thread_default());
+}
+
+gboolean DesktopMediaManager::pause_cb(gpointer data_ptr) {
+  DesktopMediaManager* self = static_cast<DesktopMediaManager*>(data_ptr);
+  g_source_unref(self->pause_source_);
+  self->pause_source_ = nullptr;
+  if (self->gst_pipeline_->GetState() == GST_STATE_READY)
+    self->gst_pipeline_->SetState(GST_STATE_PAUSED);
+  return G_SOURCE_REMOVE;
+}
+
 std::pair<int, int> DesktopMediaManager::GetSinkRtpPorts() const {
   return std::pair<int, int>(sink_port1_, sink_port2_);
 }
@@ -71,6 +145,10 @@ int DesktopMediaManager::GetLocalRtpPort() const {
 
 namespace {
 
+// Covers the M4 round trip: the stream switches at this running time
+// after the format change is requested, see ChangeVideoFormat()
+const GstClockTime kFormatChangeDelay = 200 * GST_MSECOND;
+
 std::vector<wds::H264VideoCodec> GetH264VideoCodecs() {
   static std::vector<wds::H264VideoCodec> codecs;
   if (codecs.empty()) {
@@ -88,6 +166,8 @@ std::vector<wds::H264VideoCodec> GetH264VideoCodecs() {
       hh_rr.set(i);
 
     wds::H264VideoCodec codec(wds::CHP, wds::k4_2, cea_rr, vesa_rr, hh_rr);
+    // x264enc slices pictures as the sink allows, see MiracVideoEncodingFor()
+    codec.min_slice_size = 1;
     codecs.push_back(codec);
   }
 
@@ -99,10 +179,20 @@ std::vector<wds::H264VideoCodec> GetH264VideoCodecs() {
 bool DesktopMediaManager::InitOptimalVideoFormat(
     const wds::NativeVideoFormat& sink_native_format,
     const std::vector<wds::H264VideoCodec>& sink_supported_codecs) {
+  sink_native_format_ = sink_native_format;
+  sink_codecs_ = sink_supported_codecs;
 
-  format_ = wds::FindOptimalVideoFormat(sink_native_format,
-                                        GetH264VideoCodecs(),
-                                        sink_supported_codecs);
+  if (video_format_policy_) {
+    format_ = wds::FindOptimalVideoFormat(*video_format_policy_,
+                                          sink_native_format,
+                                          GetH264VideoCodecs(),
+                                          sink_supported_codecs);
+  } else {
+    format_ = wds::FindOptimalVideoFormat(sink_native_format,
+                                          GetH264VideoCodecs(),
+                                          sink_supported_codecs);
+  }
+  UpdateVideoFormat();
   return true;
 }
 
@@ -110,21 +200,124 @@ wds::H264VideoFormat DesktopMediaManager::GetOptimalVideoFormat() const {
   return format_;
 }
 
+bool DesktopMediaManager::FindVideoFormat(const wds::VideoFormatPolicy& policy,
+                                          wds::H264VideoFormat* format) const {
+  if (sink_codecs_.empty())
+    return false;
+  bool success = false;
+  *format = wds::FindOptimalVideoFormat(policy, sink_native_format_,
+                                        GetH264VideoCodecs(), sink_codecs_,
+                                        &success);
+  return success;
+}
+
+bool DesktopMediaManager::GetVideoFormatChangeTiming(
+    const wds::H264VideoFormat& format,
+    unsigned long long* pts, unsigned long long* dts) {
+  GstClockTime now = gst_pipeline_ ? gst_pipeline_->RunningTime()
+                                   : GST_CLOCK_TIME_NONE;
+  if (!GST_CLOCK_TIME_IS_VALID(now) || !gst_pipeline_->CanSwitchVideoFormat(format))
+    return false;
+  format_change_at_ = now + kFormatChangeDelay;
+  // mpegtsmux stamps the frames with their running time, 33 bits of
+  // 90 kHz; x264enc with zerolatency does not reorder, so DTS is PTS
+  const guint64 kPtsMask = (1ull << 33) - 1;
+  *pts = gst_util_uint64_scale(format_change_at_, 90000, GST_SECOND) & kPtsMask;
+  *dts = *pts;
+  return true;
+}
+
+bool DesktopMediaManager::ChangeVideoFormat(const wds::H264VideoFormat& format) {
+  // A late M4 reply switches with the next frame
+  if (!gst_pipeline_ || !gst_pipeline_->SwitchVideoFormat(format, format_change_at_))
+    return false;
+  format_ = format;
+  return true;
+}
+
 bool DesktopMediaManager::InitOptimalAudioFormat(const std::vector<wds::AudioCodec>& sink_codecs) {
-  for (const auto& codec : sink_codecs) {
-     if (codec.format == wds::AAC && codec.modes.test(wds::AAC_48K_16B_2CH))
-       return true;
+  // Stereo is enough for a desktop. LPCM is what the pipeline is built
+  // with, and sent as is.
+  static const std::vector<wds::AudioCodec> codecs = {
+    wds::AudioCodec(wds::LPCM, wds::AudioModes().set(wds::LPCM_48K_16B_2CH), 0),
+    wds::AudioCodec(wds::AAC, wds::AudioModes().set(wds::AAC_48K_16B_2CH), 0),
+    wds::AudioCodec(wds::AC3, wds::AudioModes().set(wds::AC3_48K_16B_2CH), 0)
+  };
+
+  bool success = false;
+  wds::AudioCodec codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), codecs, sink_codecs, &success);
+  if (!success)
+    WDS_WARNING("The sink takes none of the audio codecs, streaming video only");
+
+  // The audio encoder can not be swapped in place
+  bool rebuild = success != audio_enabled_ ||
+                 (success && (codec.format != audio_codec_.format ||
+                              codec.modes != audio_codec_.modes));
+  audio_enabled_ = success;
+  if (success)
+    audio_codec_ = codec;
+  if (rebuild) {
+    CreatePipeline();
+    SchedulePause();
   }
-  return false;
+  return true;
 }
 
 wds::AudioCodec DesktopMediaManager::GetOptimalAudioFormat() const {
-  wds::AudioModes audio_modes;
-  audio_modes.set(wds::AAC_48K_16B_2CH);
-
-  return wds::AudioCodec(wds::AAC, audio_modes, 0);
+  return audio_codec_;
 }
 
 void DesktopMediaManager::SendIDRPicture() {
-  WDS_WARNING("Unimplemented IDR picture request");
+  if (gst_pipeline_)
+    gst_pipeline_->RequestKeyFrame();
+}
+
+bool DesktopMediaManager::SetSinkRtcpPort(int port) {
+  return gst_pipeline_ && gst_pipeline_->EnableRtcp(hostname_, port);
+}
+
+bool DesktopMediaManager::GetCachedSinkCapabilities(
+    wds::SinkCapabilities* capabilities) const {
+  return capability_cache_ && capability_cache_->Find(hostname_, capabilities);
+}
+
+void DesktopMediaManager::SinkCapabilitiesReceived(
+    const wds::SinkCapabilities& capabilities) {
+  if (capability_cache_)
+    capability_cache_->Store(hostname_, capabilities);
+}
+
+std::string DesktopMediaManager::GetFrameTimingStats() const {
+  if (!gst_pipeline_)
+    return std::string();
+  return gst_pipeline_->FrameTiming().Format();
+}
+
+void DesktopMediaManager::SetVideoFormatPolicy(
+    std::shared_ptr<const wds::VideoFormatPolicy> policy) {
+  video_format_policy_ = policy;
+}
+
+void DesktopMediaManager::SetCapabilityCache(
+    std::shared_ptr<wds::CapabilityCache> cache) {
+  capability_cache_ = cache;
+}
+
+MiracGstTestSource::KeyFrameStats DesktopMediaManager::GetKeyFrameStats() const {
+  if (!gst_pipeline_)
+    return MiracGstTestSource::KeyFrameStats();
+  return gst_pipeline_->GetKeyFrameStats();
+}
+
+gint64 DesktopMediaManager::GetFirstPacketLatency() const {
+  if (!gst_pipeline_)
+    return 0;
+  return gst_pipeline_->FirstPacketLatency();
+}
+
+MiracGstTestSource::IdleStats DesktopMediaManager::GetIdleStats() const {
+  if (!gst_pipeline_)
+    return MiracGstTestSource::IdleStats();
+  return gst_pipeline_->GetIdleStats();
 }
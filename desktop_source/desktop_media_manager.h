@@ -23,14 +23,20 @@
 
 #include <memory>
 
+#include "libwds/public/capability_cache.h"
 #include "libwds/public/media_manager.h"
+#include "libwds/public/video_format_policy.h"
 #include "mirac-gst-test-source.hpp"
 
 class DesktopMediaManager : public wds::SourceMediaManager {
  public:
-  explicit DesktopMediaManager(const std::string& hostname);
+  explicit DesktopMediaManager(const std::string& hostname,
+                               const std::string& interface = std::string());
+  ~DesktopMediaManager() override;
   void Play() override;
   void Pause() override;
+  void PlayAsync(const StateChangeCallback& completed) override;
+  void PauseAsync(const StateChangeCallback& completed) override;
   void Teardown() override;
   bool IsPaused() const override;
   std::string GetSessionId() const override;
@@ -45,13 +51,51 @@ class DesktopMediaManager : public wds::SourceMediaManager {
   bool InitOptimalAudioFormat(const std::vector<wds::AudioCodec>& sink_supported_codecs) override;
   wds::AudioCodec GetOptimalAudioFormat() const override;
   void SendIDRPicture() override;
+  bool SetSinkRtcpPort(int port) override;
+  bool GetCachedSinkCapabilities(wds::SinkCapabilities* capabilities) const override;
+  void SinkCapabilitiesReceived(const wds::SinkCapabilities& capabilities) override;
+  bool GetVideoFormatChangeTiming(const wds::H264VideoFormat& format,
+                                  unsigned long long* pts,
+                                  unsigned long long* dts) override;
+  bool ChangeVideoFormat(const wds::H264VideoFormat& format) override;
+
+  MiracGstTestSource::KeyFrameStats GetKeyFrameStats() const;
+  MiracGstTestSource::IdleStats GetIdleStats() const;
+  // M7 PLAY to the first RTP packet, in microseconds
+  gint64 GetFirstPacketLatency() const;
+  // Empty until the pipeline exists
+  std::string GetFrameTimingStats() const;
+  // Used by the next video format negotiation, the libwds default one
+  // if null
+  void SetVideoFormatPolicy(std::shared_ptr<const wds::VideoFormatPolicy> policy);
+  // Sinks are known there by their host name, none are cached if null
+  void SetCapabilityCache(std::shared_ptr<wds::CapabilityCache> cache);
+  // The format the policy prefers of the ones the sink supports, for
+  // wds::Source::ChangeVideoFormat(); false before the sink's are known
+  bool FindVideoFormat(const wds::VideoFormatPolicy& policy,
+                       wds::H264VideoFormat* format) const;
 
  private:
+  void CreatePipeline();
+  void UpdateVideoFormat();
+  void SchedulePause();
+  static gboolean pause_cb(gpointer data_ptr);
+
   std::string hostname_;
+  std::string interface_;
   std::unique_ptr<MiracGstTestSource> gst_pipeline_;
   int sink_port1_;
   int sink_port2_;
   wds::H264VideoFormat format_;
+  wds::NativeVideoFormat sink_native_format_;
+  std::vector<wds::H264VideoCodec> sink_codecs_;
+  wds::AudioCodec audio_codec_;
+  bool audio_enabled_;  // false once the sink takes no audio
+  // Running time of the switch announced in the last M4
+  GstClockTime format_change_at_;
+  std::shared_ptr<const wds::VideoFormatPolicy> video_format_policy_;
+  std::shared_ptr<wds::CapabilityCache> capability_cache_;
+  GSource* pause_source_;
 };
 
 #endif // DESKTOP_MEDIA_MANAGER_H_
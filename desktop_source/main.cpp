@@ -39,10 +39,46 @@ static gboolean _sig_handler (gpointer data_ptr)
     return G_SOURCE_CONTINUE;
 }
 
+static void print_send_queue_stats(const MiracBroker::SendQueueStats& stats) {
+    std::cout << "RTSP send queue: " << stats.depth << " bytes queued (max "
+              << stats.max_depth << "), " << stats.messages << " messages sent, "
+              << stats.congestion_events << " times congested, "
+              << stats.overflows << " overflows" << std::endl;
+    if (stats.messages > 0)
+        std::cout << "send latency: last " << stats.last_latency << " us, max "
+                  << stats.max_latency << " us, mean "
+                  << stats.total_latency / (gint64) stats.messages << " us" << std::endl;
+}
+
+static void print_key_frame_stats(const MiracGstTestSource::KeyFrameStats& stats) {
+    std::cout << "IDR requests: " << stats.requests << " received, "
+              << stats.coalesced << " coalesced, " << stats.sent << " sent to encoder, "
+              << stats.delivered << " delivered" << std::endl;
+    if (stats.delivered > 0)
+        std::cout << "IDR latency: last " << stats.last_latency << " us, max "
+                  << stats.max_latency << " us" << std::endl;
+}
+
+static void print_idle_stats(const MiracGstTestSource::IdleStats& stats) {
+    if (stats.frames == 0)
+        return;
+    std::cout << "Static screen: " << stats.static_frames << " of " << stats.frames
+              << " frames static, " << stats.skipped << " not encoded ("
+              << 100 * stats.skipped / stats.frames << "% encode saving)" << std::endl;
+    // Skipped frames would have cost about as much as the static frames
+    // that were encoded anyway
+    if (stats.static_encoded > 0) {
+        guint64 saved = stats.skipped * stats.static_bytes / stats.static_encoded;
+        std::cout << "network: " << stats.encoded_bytes << " bytes encoded, about "
+                  << saved << " bytes saved ("
+                  << 100 * saved / (saved + stats.encoded_bytes) << "%)" << std::endl;
+    }
+}
+
 static void parse_input_and_call_source(
     const std::string& command, SourceApp *app) {
 
-    auto source = app->source()->wfd_source();
+    auto source = app->source() ? app->source()->wfd_source() : nullptr;
     bool status = true;
 
     if (command == "scan\n") {
@@ -55,6 +91,18 @@ static void parse_input_and_call_source(
         status = source && source->Pause();
     } else if (command == "play\n") {
         status = source && source->Play();
+    } else if (command.find("format ") == 0) {
+        status = app->change_video_format(command.substr(7, command.size() - 8));
+    } else if (command == "stats\n") {
+        status = app->source() != nullptr;
+        if (status) {
+            print_send_queue_stats(app->source()->get_send_queue_stats());
+            print_key_frame_stats(app->source()->get_key_frame_stats());
+            print_idle_stats(app->source()->get_idle_stats());
+            if (gint64 latency = app->source()->get_first_packet_latency())
+                std::cout << "First RTP packet " << latency << " us after PLAY" << std::endl;
+            std::cout << "Frame timing: " << app->source()->get_frame_timing_stats() << std::endl;
+        }
     } else {
         std::cout << "Received unknown command: " << command << std::endl;
     }
@@ -93,10 +141,18 @@ int main (int argc, char *argv[])
 {
     InitGlibLogging();
     int port = 7236;
+    int rtsp_workers = 0;
+    gchar* interface = NULL;
+    gchar* video_policy = NULL;
+    int max_throughput = 0;
 
     GOptionEntry main_entries[] =
     {
         { "rtsp_port", 0, 0, G_OPTION_ARG_INT, &(port), "Specify optional RTSP port number, 7236 by default", "rtsp_port"},
+        { "rtsp_workers", 0, 0, G_OPTION_ARG_INT, &(rtsp_workers), "Accept RTSP sessions on N SO_REUSEPORT listener threads, disabled by default", "N"},
+        { "interface", 0, 0, G_OPTION_ARG_STRING, &(interface), "Bind RTSP and RTP sockets to a network interface, e.g. a P2P group", "name"},
+        { "video_policy", 0, 0, G_OPTION_ARG_STRING, &(video_policy), "Choose the video format by quality, native, bandwidth or latency, lowest common by default", "policy"},
+        { "max_throughput", 0, 0, G_OPTION_ARG_INT, &(max_throughput), "Throughput for the bandwidth policy in Mbit/s, the P2P peer's by default", "Mbps"},
         { NULL }
     };
 
@@ -112,7 +168,17 @@ int main (int argc, char *argv[])
     }
     g_option_context_free(context);
 
-    SourceApp app(port);
+    std::string policy_name = video_policy ? video_policy : "";
+    g_free(video_policy);
+    std::shared_ptr<const wds::VideoFormatPolicy> policy;
+    if (!SourceApp::create_video_policy(policy_name, max_throughput, policy)) {
+        WDS_ERROR ("unknown video policy: %s", policy_name.c_str());
+        exit (1);
+    }
+
+    SourceApp app(port, rtsp_workers, interface ? interface : "",
+                  policy_name, max_throughput);
+    g_free(interface);
 
     GMainLoop *main_loop =  g_main_loop_new(NULL, TRUE);
     g_unix_signal_add(SIGINT, _sig_handler, main_loop);
@@ -30,6 +30,15 @@ MiracBrokerSource::MiracBrokerSource(int rtsp_port)
   : MiracBroker(std::to_string(rtsp_port)) {
 }
 
+MiracBrokerSource::MiracBrokerSource(MiracNetwork* connection,
+    std::shared_ptr<const wds::VideoFormatPolicy> policy,
+    std::shared_ptr<wds::CapabilityCache> cache)
+  : MiracBroker(connection),
+    video_format_policy_(policy),
+    capability_cache_(cache) {
+  on_connected();
+}
+
 MiracBrokerSource::~MiracBrokerSource() {}
 
 void MiracBrokerSource::got_message(const std::string& message) {
@@ -37,7 +46,10 @@ void MiracBrokerSource::got_message(const std::string& message) {
 }
 
 void MiracBrokerSource::on_connected() {
-  media_manager_.reset(new DesktopMediaManager(get_peer_address()));
+  auto media_manager = new DesktopMediaManager(get_peer_address(), get_interface());
+  media_manager->SetVideoFormatPolicy(video_format_policy_);
+  media_manager->SetCapabilityCache(capability_cache_);
+  media_manager_.reset(media_manager);
   wfd_source_.reset(wds::Source::Create(this, media_manager_.get()));
   wfd_source_->Start();
 }
@@ -55,6 +67,53 @@ void MiracBrokerSource::on_connection_failure(ConnectionFailure failure) {
   }
 }
 
+MiracGstTestSource::KeyFrameStats MiracBrokerSource::get_key_frame_stats() const {
+  if (!media_manager_)
+    return MiracGstTestSource::KeyFrameStats();
+  return static_cast<DesktopMediaManager*>(media_manager_.get())->GetKeyFrameStats();
+}
+
+gint64 MiracBrokerSource::get_first_packet_latency() const {
+  if (!media_manager_)
+    return 0;
+  return static_cast<DesktopMediaManager*>(media_manager_.get())->GetFirstPacketLatency();
+}
+
+MiracGstTestSource::IdleStats MiracBrokerSource::get_idle_stats() const {
+  if (!media_manager_)
+    return MiracGstTestSource::IdleStats();
+  return static_cast<DesktopMediaManager*>(media_manager_.get())->GetIdleStats();
+}
+
+std::string MiracBrokerSource::get_frame_timing_stats() const {
+  if (!media_manager_)
+    return std::string();
+  return static_cast<DesktopMediaManager*>(media_manager_.get())->GetFrameTimingStats();
+}
+
 wds::Peer* MiracBrokerSource::Peer() const {
   return wfd_source_.get();
 }
+
+void MiracBrokerSource::set_video_format_policy(
+    std::shared_ptr<const wds::VideoFormatPolicy> policy) {
+  video_format_policy_ = policy;
+  if (media_manager_)
+    static_cast<DesktopMediaManager*>(media_manager_.get())->SetVideoFormatPolicy(policy);
+}
+
+void MiracBrokerSource::set_capability_cache(
+    std::shared_ptr<wds::CapabilityCache> cache) {
+  capability_cache_ = cache;
+  if (media_manager_)
+    static_cast<DesktopMediaManager*>(media_manager_.get())->SetCapabilityCache(cache);
+}
+
+bool MiracBrokerSource::change_video_format(const wds::VideoFormatPolicy& policy) {
+  if (!media_manager_ || !wfd_source_)
+    return false;
+  wds::H264VideoFormat format;
+  if (!static_cast<DesktopMediaManager*>(media_manager_.get())->FindVideoFormat(policy, &format))
+    return false;
+  return wfd_source_->ChangeVideoFormat(format);
+}
@@ -25,18 +25,37 @@
 #include <memory>
 
 #include "mirac-broker.hpp"
+#include "mirac-gst-test-source.hpp"
 
 namespace wds {
+class CapabilityCache;
 class SourceMediaManager;
 class Source;
+class VideoFormatPolicy;
 }
 
 class MiracBrokerSource : public MiracBroker {
  public:
   explicit MiracBrokerSource(int rtsp_port);
+  // Session for a connection accepted by MiracListenerPool, which starts
+  // right away with the given policy and cache (both may be null)
+  MiracBrokerSource(MiracNetwork* connection,
+                    std::shared_ptr<const wds::VideoFormatPolicy> policy,
+                    std::shared_ptr<wds::CapabilityCache> cache);
   ~MiracBrokerSource();
 
   wds::Source* wfd_source() { return wfd_source_.get(); }
+  MiracGstTestSource::KeyFrameStats get_key_frame_stats() const;
+  MiracGstTestSource::IdleStats get_idle_stats() const;
+  gint64 get_first_packet_latency() const;
+  std::string get_frame_timing_stats() const;
+  // For this and the following sessions, see DesktopMediaManager
+  void set_video_format_policy(std::shared_ptr<const wds::VideoFormatPolicy> policy);
+  // Shared by the sessions of one application, for this and the
+  // following sessions
+  void set_capability_cache(std::shared_ptr<wds::CapabilityCache> cache);
+  // Switches the streaming session to the format the policy prefers
+  bool change_video_format(const wds::VideoFormatPolicy& policy);
 
  private:
   virtual void got_message(const std::string& message) override;
@@ -45,6 +64,8 @@ class MiracBrokerSource : public MiracBroker {
   virtual wds::Peer* Peer() const override;
 
   std::unique_ptr<wds::SourceMediaManager> media_manager_;
+  std::shared_ptr<const wds::VideoFormatPolicy> video_format_policy_;
+  std::shared_ptr<wds::CapabilityCache> capability_cache_;
   std::unique_ptr<wds::Source> wfd_source_;
 };
 
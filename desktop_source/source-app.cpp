@@ -24,6 +24,9 @@
 
 #include "source-app.h"
 
+#include "libwds/public/capability_cache.h"
+#include "libwds/public/video_format_policy.h"
+
 void SourceApp::on_availability_changed(P2P::Client *client)
 {
     if (client->is_available())
@@ -80,11 +83,54 @@ void SourceApp::on_availability_changed(P2P::Peer *peer)
         return;
 
     std::cout << "* Connected to " << peer->remote_host()  << std::endl;
+
+    if (video_policy_ == "bandwidth" && max_throughput_ == 0 && source_) {
+        int throughput = peer->maximum_throughput();
+        if (throughput <= 0)
+            return;
+        std::cout << "* Capping video to the peer's " << throughput << " Mbit/s" << std::endl;
+        source_->set_video_format_policy(
+            std::make_shared<wds::BandwidthCappedPolicy>(throughput * 1000));
+    }
+}
+
+bool SourceApp::create_video_policy(const std::string& name, int max_throughput,
+                                    std::shared_ptr<const wds::VideoFormatPolicy>& policy)
+{
+    if (name.empty())
+        policy.reset();
+    else if (name == "quality")
+        policy = std::make_shared<wds::MaxQualityPolicy>();
+    else if (name == "native")
+        policy = std::make_shared<wds::NativeFirstPolicy>();
+    else if (name == "bandwidth")
+        policy = std::make_shared<wds::BandwidthCappedPolicy>(max_throughput * 1000);
+    else if (name == "latency")
+        policy = std::make_shared<wds::LowestLatencyPolicy>();
+    else
+        return false;
+    return true;
 }
 
-SourceApp::SourceApp(int port) :
-    peer_index_(0)
+bool SourceApp::change_video_format(const std::string& policy_name)
 {
+    std::shared_ptr<const wds::VideoFormatPolicy> policy;
+    if (!source_ || !create_video_policy(policy_name, max_throughput_, policy) || !policy)
+        return false;
+    return source_->change_video_format(*policy);
+}
+
+SourceApp::SourceApp(int port, int rtsp_workers, const std::string& interface,
+                     const std::string& video_policy, int max_throughput) :
+    peer_index_(0),
+    video_policy_(video_policy),
+    max_throughput_(max_throughput)
+{
+    std::shared_ptr<const wds::VideoFormatPolicy> policy;
+    create_video_policy(video_policy, max_throughput, policy);
+    // Sinks reconnecting over a flaky link skip waiting for M3
+    auto capability_cache = std::make_shared<wds::CapabilityCache>();
+
     // Create a information element for a simple WFD Source
     P2P::InformationElement ie;
     auto sub_element = P2P::new_subelement(P2P::DEVICE_INFORMATION);
@@ -103,7 +149,23 @@ SourceApp::SourceApp(int port) :
     auto array = ie.serialize ();
     p2p_client_.reset(new P2P::Client(array, this));
 
+    if (rtsp_workers > 0) {
+        // Sessions are owned by the pool workers, each on its own thread.
+        listener_pool_.reset(new MiracListenerPool(std::to_string(port), rtsp_workers,
+            [policy, capability_cache] (MiracNetwork* connection) {
+                return new MiracBrokerSource(connection, policy, capability_cache);
+            },
+            interface));
+        std::cout << "* Accepting RTSP connections with " << rtsp_workers
+                  << " workers" << std::endl;
+        return;
+    }
+
     source_.reset(new MiracBrokerSource(port));
+    if (!interface.empty())
+        source_->set_interface(interface);
+    source_->set_video_format_policy(policy);
+    source_->set_capability_cache(capability_cache);
 }
 
 SourceApp::~SourceApp()
@@ -27,13 +27,25 @@
 #include "source.h"
 #include "connman-client.h"
 #include "mirac_broker_source.h"
+#include "mirac-listener-pool.hpp"
 
 class SourceApp: public P2P::Client::Observer, public P2P::Peer::Observer {
   public:
-    SourceApp(int port);
+    // video_policy is one of the create_video_policy() names, a
+    // bandwidth policy without max_throughput (Mbit/s) caps by the P2P
+    // peer's throughput
+    SourceApp(int port, int rtsp_workers = 0, const std::string& interface = std::string(),
+              const std::string& video_policy = std::string(), int max_throughput = 0);
     ~SourceApp();
 
+    // "quality", "native", "bandwidth" or "latency", false for an unknown
+    // name. Empty selects the libwds default (null policy).
+    static bool create_video_policy(const std::string& name, int max_throughput,
+                                    std::shared_ptr<const wds::VideoFormatPolicy>& policy);
+
     MiracBrokerSource* source() { return source_.get(); }
+    // Switches the streaming session to the format of another policy
+    bool change_video_format(const std::string& policy_name);
 
     void on_peer_added(P2P::Client *client, std::shared_ptr<P2P::Peer> peer) override;
     void on_peer_removed(P2P::Client *client, std::shared_ptr<P2P::Peer> peer) override;
@@ -48,8 +60,11 @@ class SourceApp: public P2P::Client::Observer, public P2P::Peer::Observer {
   private:
     std::unique_ptr<P2P::Client> p2p_client_;
     std::unique_ptr<MiracBrokerSource> source_;
+    std::unique_ptr<MiracListenerPool> listener_pool_;
     std::map<uint, P2P::Peer*>peers_;
     uint peer_index_;
+    std::string video_policy_;
+    int max_throughput_;
 };
 
 #endif // SOURCE_APP_H
@@ -0,0 +1,103 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "libwds/public/audio_codec.h"
+
+#include <algorithm>
+#include <utility>
+
+#include "libwds/public/logging.h"
+
+namespace wds {
+
+namespace {
+
+// Units of the 'wfd-audio-codecs' latency field
+const unsigned kLatencyUnitMs = 5;
+
+unsigned lowest_bit(const AudioModes& modes) {
+  unsigned bit = 0;
+  while (!modes.test(bit))
+    ++bit;
+  return bit;
+}
+
+}  // namespace
+
+AudioCodecPreference LowestLatencyAudioPreference() {
+  return AudioCodecPreference({LPCM, AAC, AC3}, 20);
+}
+
+AudioCodecPreference LowestBandwidthAudioPreference() {
+  return AudioCodecPreference({AAC, AC3, LPCM}, 0);
+}
+
+AudioCodec FindOptimalAudioCodec(
+    const AudioCodecPreference& preference,
+    const std::vector<AudioCodec>& local_codecs,
+    const std::vector<AudioCodec>& remote_codecs,
+    bool* success) {
+  const AudioCodec* best_local = nullptr;
+  const AudioCodec* best_remote = nullptr;
+  AudioModes best_modes;
+  // Compared by the first, then the second
+  std::pair<unsigned, unsigned> best_cost;
+
+  for (const auto& remote : remote_codecs) {
+    auto it = std::find(preference.formats.begin(), preference.formats.end(),
+                        remote.format);
+    if (it == preference.formats.end())
+      continue;
+    unsigned rank = it - preference.formats.begin();
+    unsigned latency_ms = remote.latency * kLatencyUnitMs;
+    auto cost = preference.latency_per_rank_ms ?
+        std::make_pair(rank * preference.latency_per_rank_ms + latency_ms, rank) :
+        std::make_pair(rank, latency_ms);
+    if (best_remote && cost >= best_cost)
+      continue;
+
+    for (const auto& local : local_codecs) {
+      AudioModes modes = local.modes & remote.modes;
+      if (local.format != remote.format || modes.none())
+        continue;
+      best_local = &local;
+      best_remote = &remote;
+      best_modes = modes;
+      best_cost = cost;
+      break;
+    }
+  }
+
+  if (!best_remote) {
+    WDS_ERROR("Failed to find compatible audio codec.");
+    if (success)
+      *success = false;
+    return AudioCodec();
+  }
+
+  if (success)
+    *success = true;
+  return AudioCodec(best_remote->format,
+                    AudioModes().set(lowest_bit(best_modes)),
+                    std::max(best_local->latency, best_remote->latency));
+}
+
+}  // namespace wds
@@ -0,0 +1,75 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "libwds/public/capability_cache.h"
+
+#include <algorithm>
+
+namespace wds {
+
+CapabilityCache::CapabilityCache(size_t max_entries, int max_age_seconds)
+  : max_entries_(max_entries),
+    max_age_(max_age_seconds) {
+}
+
+bool CapabilityCache::Find(const std::string& peer_id,
+                           SinkCapabilities* capabilities) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  auto it = std::find_if(entries_.begin(), entries_.end(),
+      [&peer_id](const Entry& entry) { return entry.peer_id == peer_id; });
+  if (it == entries_.end())
+    return false;
+
+  if (std::chrono::steady_clock::now() - it->stored >= max_age_) {
+    entries_.erase(it);
+    return false;
+  }
+
+  entries_.splice(entries_.begin(), entries_, it);
+  *capabilities = it->capabilities;
+  return true;
+}
+
+void CapabilityCache::Store(const std::string& peer_id,
+                            const SinkCapabilities& capabilities) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.remove_if(
+      [&peer_id](const Entry& entry) { return entry.peer_id == peer_id; });
+  if (max_entries_ == 0)
+    return;
+
+  entries_.push_front({peer_id, capabilities, std::chrono::steady_clock::now()});
+  while (entries_.size() > max_entries_)
+    entries_.pop_back();
+}
+
+void CapabilityCache::Remove(const std::string& peer_id) {
+  std::lock_guard<std::mutex> lock(mutex_);
+  entries_.remove_if(
+      [&peer_id](const Entry& entry) { return entry.peer_id == peer_id; });
+}
+
+size_t CapabilityCache::size() const {
+  std::lock_guard<std::mutex> lock(mutex_);
+  return entries_.size();
+}
+
+}  // namespace wds
@@ -0,0 +1,302 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "libwds/public/edid.h"
+
+#include <algorithm>
+#include <cstdlib>
+
+#include "libwds/public/logging.h"
+
+namespace wds {
+
+namespace {
+
+const unsigned kBlockSize = 128;
+const unsigned char kHeader[] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+const unsigned char kCEAExtensionTag = 0x02;
+const unsigned kDescriptorSize = 18;
+
+// A timing the display supports, rates in Hz (field rate if interlaced)
+struct Timing {
+  unsigned width;
+  unsigned height;
+  double refresh_rate;
+  bool interlaced;
+};
+
+// CEA-861 video identification codes of the WFD CEA modes, 59.94 Hz
+// ones included as 60 Hz
+struct VicTiming {
+  unsigned char vic;
+  Timing timing;
+};
+
+const VicTiming kVicTimings[] = {
+  {1, {640, 480, 60, false}},
+  {2, {720, 480, 60, false}},
+  {3, {720, 480, 60, false}},
+  {4, {1280, 720, 60, false}},
+  {5, {1920, 1080, 60, true}},
+  {6, {720, 480, 60, true}},
+  {7, {720, 480, 60, true}},
+  {16, {1920, 1080, 60, false}},
+  {17, {720, 576, 50, false}},
+  {18, {720, 576, 50, false}},
+  {19, {1280, 720, 50, false}},
+  {20, {1920, 1080, 50, true}},
+  {21, {720, 576, 50, true}},
+  {22, {720, 576, 50, true}},
+  {31, {1920, 1080, 50, false}},
+  {32, {1920, 1080, 24, false}},
+  {33, {1920, 1080, 25, false}},
+  {34, {1920, 1080, 30, false}},
+  {60, {1280, 720, 24, false}},
+  {61, {1280, 720, 25, false}},
+  {62, {1280, 720, 30, false}}
+};
+
+bool IsValidBlock(const unsigned char* block) {
+  unsigned char sum = 0;
+  for (unsigned i = 0; i < kBlockSize; ++i)
+    sum += block[i];
+  return sum == 0;
+}
+
+DisplayTiming ParseDetailedTiming(const unsigned char* d) {
+  DisplayTiming timing;
+  timing.pixel_clock = d[0] | (d[1] << 8);
+  timing.h_active = d[2] | ((d[4] & 0xf0) << 4);
+  timing.h_blanking = d[3] | ((d[4] & 0x0f) << 8);
+  timing.v_active = d[5] | ((d[7] & 0xf0) << 4);
+  timing.v_blanking = d[6] | ((d[7] & 0x0f) << 8);
+  timing.h_sync_offset = d[8] | ((d[11] & 0xc0) << 2);
+  timing.h_sync_width = d[9] | ((d[11] & 0x30) << 4);
+  timing.v_sync_offset = (d[10] >> 4) | ((d[11] & 0x0c) << 2);
+  timing.v_sync_width = (d[10] & 0x0f) | ((d[11] & 0x03) << 4);
+  timing.interlaced = d[17] & 0x80;
+  // Polarities are only given for digital separate sync
+  if ((d[17] & 0x18) == 0x18) {
+    timing.v_sync_positive = d[17] & 0x04;
+    timing.h_sync_positive = d[17] & 0x02;
+  }
+  return timing;
+}
+
+Timing ToTiming(const DisplayTiming& detailed) {
+  unsigned h_total = detailed.h_active + detailed.h_blanking;
+  unsigned v_total = detailed.v_active + detailed.v_blanking;
+  // An interlaced frame has two fields and a half line more
+  double lines = detailed.interlaced ? v_total + 0.5 : v_total;
+  double rate = h_total && v_total ?
+      detailed.pixel_clock * 10000.0 / (h_total * lines) : 0;
+  return {detailed.h_active,
+          detailed.interlaced ? 2u * detailed.v_active : detailed.v_active,
+          rate, detailed.interlaced};
+}
+
+// The standard timings of the base block and of display descriptors
+void ParseStandardTiming(const unsigned char* d, std::vector<Timing>& timings) {
+  if ((d[0] == 0x01 && d[1] == 0x01) || d[0] == 0x00)
+    return;
+  unsigned width = (d[0] + 31) * 8;
+  unsigned height = 0;
+  switch (d[1] >> 6) {
+  case 0:  // 16:10
+    height = width * 10 / 16;
+    break;
+  case 1:  // 4:3
+    height = width * 3 / 4;
+    break;
+  case 2:  // 5:4
+    height = width * 4 / 5;
+    break;
+  case 3:  // 16:9
+    height = width * 9 / 16;
+    break;
+  }
+  timings.push_back({width, height, double((d[1] & 0x3f) + 60), false});
+}
+
+void ParseEstablishedTimings(const unsigned char* block,
+                             std::vector<Timing>& timings) {
+  if (block[35] & 0x20)
+    timings.push_back({640, 480, 60, false});
+  if (block[35] & 0x01)
+    timings.push_back({800, 600, 60, false});
+  if (block[36] & 0x08)
+    timings.push_back({1024, 768, 60, false});
+}
+
+// Detailed timings, or standard timings in display descriptors
+void ParseDescriptor(const unsigned char* d, std::vector<Timing>& timings,
+                     EdidDisplayInfo* info) {
+  if (d[0] || d[1]) {
+    DisplayTiming detailed = ParseDetailedTiming(d);
+    if (!info->has_preferred_timing) {
+      info->has_preferred_timing = true;
+      info->preferred_timing = detailed;
+    }
+    timings.push_back(ToTiming(detailed));
+  } else if (d[3] == 0xfa) {
+    for (unsigned i = 5; i + 1 < kDescriptorSize - 1; i += 2)
+      ParseStandardTiming(d + i, timings);
+  }
+}
+
+void ParseCEAExtension(const unsigned char* block, std::vector<Timing>& timings,
+                       std::vector<Timing>& native_timings,
+                       EdidDisplayInfo* info) {
+  unsigned dtd_offset = block[2];
+  if (dtd_offset < 4 || dtd_offset > kBlockSize - 1)
+    return;
+
+  for (unsigned i = 4; i < dtd_offset;) {
+    unsigned tag = block[i] >> 5;
+    unsigned length = block[i] & 0x1f;
+    const unsigned kVideoDataBlock = 2;
+    if (tag == kVideoDataBlock) {
+      for (unsigned j = i + 1; j <= i + length && j < dtd_offset; ++j) {
+        unsigned char svd = block[j];
+        bool native = svd >= 129 && svd <= 192;
+        unsigned char vic = native ? svd & 0x7f : svd;
+        for (const VicTiming& vic_timing : kVicTimings) {
+          if (vic_timing.vic != vic)
+            continue;
+          timings.push_back(vic_timing.timing);
+          if (native)
+            native_timings.push_back(vic_timing.timing);
+        }
+      }
+    }
+    i += length + 1;
+  }
+
+  for (unsigned i = dtd_offset; i + kDescriptorSize < kBlockSize; i += kDescriptorSize) {
+    if (!block[i] && !block[i + 1])
+      break;
+    ParseDescriptor(block + i, timings, info);
+  }
+}
+
+bool IsSameRate(double a, double b) {
+  return std::abs(a - b) <= 1;
+}
+
+// The display shows the frames of the mode without scaling: same size,
+// and each frame repeated the same number of times
+bool ShowsMode(const Timing& timing, const VideoMode& mode) {
+  if (timing.width != mode.width || timing.height != mode.height ||
+      timing.interlaced != mode.interlaced)
+    return false;
+  if (mode.interlaced)
+    return IsSameRate(timing.refresh_rate, mode.frame_rate);
+  for (unsigned repeat = 1; repeat * mode.frame_rate <= timing.refresh_rate + 1; ++repeat)
+    if (IsSameRate(timing.refresh_rate, repeat * mode.frame_rate))
+      return true;
+  return false;
+}
+
+// The first mode of kVideoModes with the exact size and rate of timing
+const VideoMode* FindMode(const Timing& timing) {
+  for (const VideoMode& mode : kVideoModes) {
+    if (timing.width == mode.width && timing.height == mode.height &&
+        timing.interlaced == mode.interlaced &&
+        IsSameRate(timing.refresh_rate, mode.frame_rate))
+      return &mode;
+  }
+  return nullptr;
+}
+
+RateAndResolutionsBitmap& ModesOf(EdidDisplayInfo* info, ResolutionType type) {
+  switch (type) {
+  case VESA:
+    return info->vesa_rr;
+  case HH:
+    return info->hh_rr;
+  default:
+    return info->cea_rr;
+  }
+}
+
+NativeVideoFormat ToNativeFormat(const VideoMode& mode) {
+  NativeVideoFormat format;
+  format.type = mode.type;
+  format.rate_resolution = mode.bit;
+  return format;
+}
+
+}  // namespace
+
+bool ParseEdid(const std::vector<unsigned char>& edid, EdidDisplayInfo* info) {
+  if (edid.size() < kBlockSize || edid.size() % kBlockSize ||
+      !std::equal(kHeader, kHeader + sizeof(kHeader), edid.begin())) {
+    WDS_WARNING("Not an EDID");
+    return false;
+  }
+  unsigned blocks = std::min<unsigned>(edid.size() / kBlockSize, edid[126] + 1);
+  for (unsigned i = 0; i < blocks; ++i) {
+    if (!IsValidBlock(&edid[i * kBlockSize])) {
+      WDS_WARNING("Wrong checksum of EDID block %u", i);
+      return false;
+    }
+  }
+
+  *info = EdidDisplayInfo();
+  std::vector<Timing> timings;
+  std::vector<Timing> native_timings;
+  const unsigned char* base = &edid[0];
+  ParseEstablishedTimings(base, timings);
+  for (unsigned i = 38; i < 54; i += 2)
+    ParseStandardTiming(base + i, timings);
+  for (unsigned i = 54; i < 126; i += kDescriptorSize)
+    ParseDescriptor(base + i, timings, info);
+  for (unsigned i = 1; i < blocks; ++i) {
+    const unsigned char* block = &edid[i * kBlockSize];
+    if (block[0] == kCEAExtensionTag)
+      ParseCEAExtension(block, timings, native_timings, info);
+  }
+
+  info->cea_rr.set(CEA640x480p60);
+  const VideoMode* largest = &GetVideoMode(CEA, CEA640x480p60);
+  for (const VideoMode& mode : kVideoModes) {
+    for (const Timing& timing : timings) {
+      if (!ShowsMode(timing, mode))
+        continue;
+      ModesOf(info, mode.type).set(mode.bit);
+      if (mode.width * mode.height > largest->width * largest->height ||
+          (mode.width * mode.height == largest->width * largest->height &&
+           mode.pixel_rate > largest->pixel_rate))
+        largest = &mode;
+      break;
+    }
+  }
+
+  const VideoMode* native = nullptr;
+  if (info->has_preferred_timing)
+    native = FindMode(ToTiming(info->preferred_timing));
+  if (!native && !native_timings.empty())
+    native = FindMode(native_timings.front());
+  info->native_format = ToNativeFormat(native ? *native : *largest);
+  return true;
+}
+
+}  // namespace wds
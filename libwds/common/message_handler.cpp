@@ -220,7 +220,8 @@ bool MessageSequenceWithOptionalSetHandler::HandleTimeoutEvent(unsigned timer_id
 // MessageReceiverBase
 MessageReceiverBase::MessageReceiverBase(const InitParams& init_params)
   : MessageHandler(init_params),
-    wait_for_message_(false) {}
+    wait_for_message_(false),
+    request_id_(0) {}
 
 MessageReceiverBase::~MessageReceiverBase() {}
 
@@ -230,7 +231,10 @@ bool MessageReceiverBase::CanHandle(Message* message) const {
 }
 
 void MessageReceiverBase::Start() { wait_for_message_ = true; }
-void MessageReceiverBase::Reset() { wait_for_message_ = false; }
+void MessageReceiverBase::Reset() {
+  wait_for_message_ = false;
+  ++request_id_;
+}
 bool MessageReceiverBase::CanSend(Message* message) const { return false; }
 void MessageReceiverBase::Send(std::unique_ptr<Message> message) {}
 void MessageReceiverBase::Handle(std::unique_ptr<Message> message) {
@@ -240,12 +244,37 @@ void MessageReceiverBase::Handle(std::unique_ptr<Message> message) {
     return;
   }
   wait_for_message_ = false;
-  std::unique_ptr<Reply> reply = HandleMessage(message.get());
+  int cseq = message->cseq();
+  unsigned request_id = ++request_id_;
+  std::weak_ptr<MessageHandler> weak_self = shared_from_this();
+  HandleMessageAsync(message.get(),
+      [weak_self, cseq, request_id](std::unique_ptr<Reply> reply) {
+        if (auto self = weak_self.lock())
+          static_cast<MessageReceiverBase*>(self.get())->SendReply(
+              cseq, request_id, std::move(reply));
+      });
+}
+
+std::unique_ptr<Reply> MessageReceiverBase::HandleMessage(Message* message) {
+  return nullptr;
+}
+
+void MessageReceiverBase::HandleMessageAsync(Message* message,
+                                             const ReplyCallback& send_reply) {
+  send_reply(HandleMessage(message));
+}
+
+void MessageReceiverBase::SendReply(int cseq, unsigned request_id,
+                                    std::unique_ptr<Reply> reply) {
+  if (request_id != request_id_) {
+    WDS_WARNING("Dropping the reply to a request that was reset");
+    return;
+  }
   if (!reply) {
     observer_->OnError(shared_from_this());
     return;
   }
-  reply->header().set_cseq(message->cseq());
+  reply->header().set_cseq(cseq);
   sender_->SendRTSPData(reply->ToString());
   observer_->OnCompleted(shared_from_this());
 }
@@ -23,6 +23,7 @@
 #define LIBWDS_COMMON_MESSAGE_HANDLER_H_
 
 #include <cassert>
+#include <functional>
 #include <list>
 #include <vector>
 #include <memory>
@@ -162,7 +163,14 @@ class MessageReceiverBase : public MessageHandler {
   ~MessageReceiverBase() override;
 
  protected:
-  virtual std::unique_ptr<wds::rtsp::Reply> HandleMessage(rtsp::Message* message) = 0;
+  using ReplyCallback = std::function<void(std::unique_ptr<rtsp::Reply>)>;
+
+  virtual std::unique_ptr<wds::rtsp::Reply> HandleMessage(rtsp::Message* message);
+  // For requests that can only be answered once something completed,
+  // e.g. PLAY: the reply is sent when send_reply is called, which may be
+  // later. Calls HandleMessage() by default.
+  virtual void HandleMessageAsync(rtsp::Message* message,
+                                  const ReplyCallback& send_reply);
   bool CanHandle(rtsp::Message* message) const override;
   void Handle(std::unique_ptr<rtsp::Message> message) override;
 
@@ -171,8 +179,12 @@ class MessageReceiverBase : public MessageHandler {
   void Reset() override;
   bool CanSend(rtsp::Message* message) const override;
   void Send(std::unique_ptr<rtsp::Message> message) override;
+  void SendReply(int cseq, unsigned request_id,
+                 std::unique_ptr<rtsp::Reply> reply);
 
   bool wait_for_message_;
+  // Tells replies to requests dropped by Reset() from the current one
+  unsigned request_id_;
 };
 
 template <rtsp::Request::ID id>
@@ -192,6 +204,9 @@ class MessageSenderBase : public MessageHandler {
   explicit MessageSenderBase(const InitParams& init_params);
   ~MessageSenderBase() override;
 
+  // Whether a sent request is still waiting for its reply.
+  bool HasPendingReplies() const { return !parcel_queue_.empty(); }
+
  protected:
   virtual bool HandleReply(rtsp::Reply* reply) = 0;
   void Send(std::unique_ptr<rtsp::Message> message) override;
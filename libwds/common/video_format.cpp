@@ -20,8 +20,10 @@
  */
 
 #include "libwds/public/media_manager.h"
+#include "libwds/public/video_format_policy.h"
 
 #include <assert.h>
+#include <stdint.h>
 
 #include <algorithm>
 
@@ -30,138 +32,231 @@
 namespace wds {
 
 namespace {
-// Quality weight is calculated using following formula:
-// width * height * fps * 2 for progressive or 1 for interlaced frames
-struct QualityInfo {
-  unsigned width;
-  unsigned height;
-  unsigned weight;
-};
 
-const QualityInfo cea_info_table[] = {
-  {640, 480, 640*480*60*2},     // CEA640x480p60
-  {720, 480, 720*480*60*2},     // CEA720x480p60
-  {720, 480, 720*480*60},       // CEA720x480i60
-  {720, 576, 720*576*50*2},     // CEA720x576p50
-  {720, 576, 720*576*50},       // CEA720x576i50
-  {1280, 720, 1280*720*30*2},   // CEA1280x720p30
-  {1280, 720, 1280*720*60*2},   // CEA1280x720p60
-  {1920, 1080, 1920*1080*30*2}, // CEA1920x1080p30
-  {1920, 1080, 1920*1080*60*2}, // CEA1920x1080p60
-  {1920, 1080, 1920*1080*60},   // CEA1920x1080i60
-  {1280, 720, 1280*720*25*2},   // CEA1280x720p25
-  {1280, 720, 1280*720*50*2},   // CEA1280x720p50
-  {1920, 1080, 1920*1080*25*2}, // CEA1920x1080p25
-  {1920, 1080, 1920*1080*50*2}, // CEA1920x1080p50
-  {1920, 1080, 1920*1080*50},   // CEA1920x1080i50
-  {1280, 720, 1280*720*24*2},   // CEA1280x720p24
-  {1920, 1080, 1920*1080*24*2}  // CEA1920x1080p24
-};
+// True if kVideoModes lists every mode at its GetVideoModeIndex()
+constexpr bool is_catalogue_ordered(unsigned index = 0) {
+  return index == kVideoModeCount ||
+      (GetVideoModeIndex(kVideoModes[index].type, kVideoModes[index].bit) ==
+           index &&
+       kVideoModes[index].bit < GetVideoModeCount(kVideoModes[index].type) &&
+       is_catalogue_ordered(index + 1));
+}
 
-#define CEA_TABLE_LENGTH  sizeof(cea_info_table) / sizeof(QualityInfo)
-
-const QualityInfo vesa_info_table[] = {
-  {800, 600, 800*600*30*2},        // VESA800x600p30
-  {800, 600, 800*600*60*2},        // VESA800x600p60
-  {1024, 768, 1024*768*30*2},      // VESA1024x768p30
-  {1024, 768, 1024*768*60*2},      // VESA1024x768p60
-  {1152, 864, 1152*864*30*2},      // VESA1152x864p30
-  {1152, 864, 1152*864*60*2},      // VESA1152x864p60
-  {1280, 768, 1280*768*30*2},      // VESA1280x768p30
-  {1280, 768, 1280*768*60*2},      // VESA1280x768p60
-  {1280, 800, 1280*800*30*2},      // VESA1280x800p30
-  {1280, 800, 1280*800*60*2},      // VESA1280x800p60
-  {1360, 768, 1360*768*30*2},      // VESA1360x768p30
-  {1360, 768, 1360*768*60*2},      // VESA1360x768p60
-  {1366, 768, 1366*768*30*2},      // VESA1366x768p30
-  {1366, 768, 1366*768*60*2},      // VESA1366x768p60
-  {1280, 1024, 1280*1024*30*2},    // VESA1280x1024p30
-  {1280, 1024, 1280*1024*60*2},    // VESA1280x1024p60
-  {1400, 1050, 1400*1050*30*2},    // VESA1400x1050p30
-  {1400, 1050, 1400*1050*60*2},    // VESA1400x1050p60
-  {1440, 900, 1440*900*30*2},      // VESA1440x900p30
-  {1440, 900, 1440*900*60*2},      // VESA1440x900p60
-  {1600, 900, 1600*900*30*2},      // VESA1600x900p30
-  {1600, 900, 1600*900*60*2},      // VESA1600x900p60
-  {1600, 1200, 1600*1200*30*2},    // VESA1600x1200p30
-  {1600, 1200, 1600*1200*60*2},    // VESA1600x1200p60
-  {1680, 1024, 1680*1024*30*2},    // VESA1680x1024p30
-  {1680, 1024, 1680*1024*60*2},    // VESA1680x1024p60
-  {1680, 1050, 1680*1050*30*2},    // VESA1680x1050p30
-  {1680, 1050, 1680*1050*60*2},    // VESA1680x1050p60
-  {1920, 1200, 1920*1200*30*2}     // VESA1920x1200p30
+static_assert(is_catalogue_ordered(), "kVideoModes is out of order");
+
+// The modes of each table by ascending pixel rate, modes of the same
+// rate in table order. FindOptimalVideoFormat() picks the first common
+// mode in this order. The pixel rate is half the quality weight the
+// negotiation used to sort by (width * height * fps * 2 for progressive
+// or 1 for interlaced frames).
+constexpr RateAndResolution cea_by_pixel_rate[] = {
+  CEA720x480i60, CEA720x576i50, CEA640x480p60, CEA720x480p60,
+  CEA720x576p50, CEA1280x720p24, CEA1280x720p25, CEA1280x720p30,
+  CEA1280x720p50, CEA1920x1080p24, CEA1920x1080p25, CEA1920x1080i50,
+  CEA1280x720p60, CEA1920x1080p30, CEA1920x1080i60, CEA1920x1080p50,
+  CEA1920x1080p60
 };
 
-#define VESA_TABLE_LENGTH  sizeof(vesa_info_table) / sizeof(QualityInfo)
-
-const QualityInfo hh_info_table[] = {
-  {800, 480, 800*480*30*2},         // HH800x480p30
-  {800, 480, 800*480*60*2},         // HH800x480p60
-  {854, 480, 854*480*30*2},         // HH854x480p30
-  {854, 480, 854*480*60*2},         // HH854x480p60
-  {864, 480, 864*480*30*2},         // HH864x480p30
-  {864, 480, 864*480*60*2},         // HH864x480p60
-  {640, 360, 640*360*30*2},         // HH640x360p30
-  {640, 360, 640*360*60*2},         // HH640x360p60
-  {960, 540, 960*540*30*2},         // HH960x540p30
-  {960, 540, 960*540*60*2},         // HH960x540p60
-  {848, 480, 848*480*30*2},         // HH848x480p30
-  {848, 480, 848*480*60*2}          // HH848x480p60
+constexpr RateAndResolution vesa_by_pixel_rate[] = {
+  VESA800x600p30, VESA1024x768p30, VESA800x600p60, VESA1280x768p30,
+  VESA1152x864p30, VESA1280x800p30, VESA1360x768p30, VESA1366x768p30,
+  VESA1440x900p30, VESA1280x1024p30, VESA1600x900p30, VESA1400x1050p30,
+  VESA1024x768p60, VESA1680x1024p30, VESA1680x1050p30, VESA1600x1200p30,
+  VESA1280x768p60, VESA1152x864p60, VESA1280x800p60, VESA1360x768p60,
+  VESA1366x768p60, VESA1920x1200p30, VESA1440x900p60, VESA1280x1024p60,
+  VESA1600x900p60, VESA1400x1050p60, VESA1680x1024p60, VESA1680x1050p60,
+  VESA1600x1200p60
 };
 
-#define HH_TABLE_LENGTH  sizeof(hh_info_table) / sizeof(QualityInfo)
+constexpr RateAndResolution hh_by_pixel_rate[] = {
+  HH640x360p30, HH800x480p30, HH848x480p30, HH854x480p30,
+  HH864x480p30, HH640x360p60, HH960x540p30, HH800x480p60,
+  HH848x480p60, HH854x480p60, HH864x480p60, HH960x540p60
+};
 
-QualityInfo get_cea_info(const H264VideoFormat& format) {
-  assert(format.rate_resolution < CEA_TABLE_LENGTH);
-  return cea_info_table[format.rate_resolution];
+// True if order lists every mode of the type once, in ascending
+// (pixel_rate, rate_resolution) order.
+constexpr bool is_ranked_by_pixel_rate(ResolutionType type,
+                                       const RateAndResolution* order,
+                                       unsigned rank = 0) {
+  return rank == GetVideoModeCount(type) ||
+      (order[rank] < GetVideoModeCount(type) &&
+       (rank == 0 ||
+        GetVideoMode(type, order[rank - 1]).pixel_rate <
+            GetVideoMode(type, order[rank]).pixel_rate ||
+        (GetVideoMode(type, order[rank - 1]).pixel_rate ==
+             GetVideoMode(type, order[rank]).pixel_rate &&
+         order[rank - 1] < order[rank])) &&
+       is_ranked_by_pixel_rate(type, order, rank + 1));
 }
 
-QualityInfo get_vesa_info(const H264VideoFormat& format) {
-  assert(format.rate_resolution < VESA_TABLE_LENGTH);
-  return vesa_info_table[format.rate_resolution];
+static_assert(sizeof(cea_by_pixel_rate) / sizeof(RateAndResolution) ==
+                  kCEAModeCount &&
+              is_ranked_by_pixel_rate(CEA, cea_by_pixel_rate),
+              "cea_by_pixel_rate is not ordered by pixel rate");
+static_assert(sizeof(vesa_by_pixel_rate) / sizeof(RateAndResolution) ==
+                  kVESAModeCount &&
+              is_ranked_by_pixel_rate(VESA, vesa_by_pixel_rate),
+              "vesa_by_pixel_rate is not ordered by pixel rate");
+static_assert(sizeof(hh_by_pixel_rate) / sizeof(RateAndResolution) ==
+                  kHHModeCount &&
+              is_ranked_by_pixel_rate(HH, hh_by_pixel_rate),
+              "hh_by_pixel_rate is not ordered by pixel rate");
+
+// Indexed by ResolutionType
+constexpr const RateAndResolution* mode_ranks[] = {
+  cea_by_pixel_rate, vesa_by_pixel_rate, hh_by_pixel_rate
+};
+
+inline unsigned lowest_bit(uint32_t bits) {
+  return __builtin_ctz(bits);
 }
 
-QualityInfo get_hh_info(const H264VideoFormat& format) {
-  assert(format.rate_resolution < HH_TABLE_LENGTH);
-  return hh_info_table[format.rate_resolution];
+// Bitmap lookups derived from kVideoModes: the rank of each mode and the
+// modes sharing its frame size.
+class ModeIndex {
+ public:
+  ModeIndex() {
+    for (unsigned type = CEA; type <= HH; ++type) {
+      unsigned count = GetVideoModeCount(ResolutionType(type));
+      for (unsigned rank = 0; rank < count; ++rank)
+        rank_of_[type][mode_ranks[type][rank]] = rank;
+      for (unsigned i = 0; i < count; ++i) {
+        const VideoMode& mode = GetVideoMode(ResolutionType(type), i);
+        same_size_[type][i] = 0;
+        for (unsigned j = 0; j < count; ++j) {
+          const VideoMode& other = GetVideoMode(ResolutionType(type), j);
+          if (mode.width == other.width && mode.height == other.height)
+            same_size_[type][i] |= 1u << j;
+        }
+      }
+    }
+  }
+
+  // The modes moved to the bits of their rank, so that the lowest set bit
+  // is the mode of the lowest pixel rate.
+  uint32_t Ranked(ResolutionType type, uint32_t modes) const {
+    uint32_t ranked = 0;
+    for (; modes; modes &= modes - 1)
+      ranked |= 1u << rank_of_[type][lowest_bit(modes)];
+    return ranked;
+  }
+
+  // All the modes with the frame size of any of the given ones.
+  uint32_t SameSize(ResolutionType type, uint32_t modes) const {
+    uint32_t result = 0;
+    for (; modes; modes &= modes - 1)
+      result |= same_size_[type][lowest_bit(modes)];
+    return result;
+  }
+
+ private:
+  unsigned rank_of_[HH + 1][32];
+  uint32_t same_size_[HH + 1][32];
+};
+
+const ModeIndex& mode_index() {
+  static const ModeIndex index;
+  return index;
 }
 
-QualityInfo get_quality_info(const H264VideoFormat& format) {
-  QualityInfo info;
-  switch (format.type) {
+uint32_t get_modes(const H264VideoCodec& codec, ResolutionType type) {
+  const RateAndResolutionsBitmap* bitmap = nullptr;
+  switch (type) {
   case CEA:
-    info = get_cea_info(format);
+    bitmap = &codec.cea_rr;
     break;
   case VESA:
-    info = get_vesa_info(format);
+    bitmap = &codec.vesa_rr;
     break;
   case HH:
-    info = get_hh_info(format);
-    break;
-  default:
-    assert(false);
+    bitmap = &codec.hh_rr;
     break;
   }
-  return info;
+  return bitmap->to_ulong() & ((1u << GetVideoModeCount(type)) - 1);
 }
 
-std::pair<unsigned, unsigned> get_resolution(const H264VideoFormat& format) {
-  QualityInfo info = get_quality_info(format);
-  return std::pair<unsigned, unsigned>(info.width, info.height);
+struct ModeChoice {
+  const H264VideoCodec* codec;
+  ResolutionType type;
+  RateAndResolution rate_resolution;
+  unsigned pixel_rate;
+};
+
+// Replaces choice with the lowest pixel rate one of modes of codec, unless
+// choice is better or equal in (pixel rate, profile, level). Called in the
+// order the formats are listed, this yields the first format of a list
+// stable sorted by (pixel rate, profile, level).
+void choose_mode(const H264VideoCodec& codec, ResolutionType type,
+                 uint32_t modes, ModeChoice& choice) {
+  if (!modes)
+    return;
+  RateAndResolution rr =
+      mode_ranks[type][lowest_bit(mode_index().Ranked(type, modes))];
+  unsigned pixel_rate = GetVideoMode(type, rr).pixel_rate;
+  if (choice.codec) {
+    if (choice.pixel_rate != pixel_rate) {
+      if (choice.pixel_rate < pixel_rate)
+        return;
+    } else if (choice.codec->profile != codec.profile) {
+      if (choice.codec->profile < codec.profile)
+        return;
+    } else if (choice.codec->level <= codec.level) {
+      return;
+    }
+  }
+  choice = {&codec, type, rr, pixel_rate};
+}
+
+// The smaller of two values, either may be 0 for none
+template <typename T>
+T min_specified(T a, T b) {
+  if (!a || !b)
+    return std::max(a, b);
+  return std::min(a, b);
 }
 
-bool video_format_sort_func(const H264VideoFormat& a, const H264VideoFormat& b) {
-  if (get_quality_info(a).weight != get_quality_info(b).weight)
-    return get_quality_info(a).weight < get_quality_info(b).weight;
-  if (a.profile != b.profile)
-    return a.profile < b.profile;
-  return a.level < b.level;
+// The parameters of a format for a pair of codecs, see
+// FindOptimalVideoFormat(). Also used for the 3D ones.
+template <typename Codec, typename Format>
+void set_codec_parameters(const Codec& local, const Codec& remote,
+                          Format& format) {
+  format.latency = std::max(local.latency, remote.latency);
+
+  if (local.min_slice_size && remote.min_slice_size) {
+    format.min_slice_size = std::max(local.min_slice_size, remote.min_slice_size);
+    const unsigned kMaxSlicesMask = 0x3ff;
+    const unsigned kSliceRatioMask = 0x7 << 10;
+    unsigned max_slices = min_specified(local.slice_enc_params & kMaxSlicesMask,
+                                        remote.slice_enc_params & kMaxSlicesMask);
+    unsigned slice_ratio = min_specified(local.slice_enc_params & kSliceRatioMask,
+                                         remote.slice_enc_params & kSliceRatioMask);
+    format.slice_enc_params = max_slices | slice_ratio;
+  } else {
+    format.min_slice_size = 0;
+    format.slice_enc_params = 0;
+  }
+
+  const unsigned kFrameSkipping = 1;
+  const unsigned kSkipIntervalMask = 0x7 << 1;
+  const unsigned kFrameRateChange = 1 << 4;
+  unsigned frame_rate_control =
+      local.frame_rate_control_support & remote.frame_rate_control_support &
+      (kFrameSkipping | kFrameRateChange);
+  if (frame_rate_control & kFrameSkipping) {
+    frame_rate_control |= min_specified(
+        local.frame_rate_control_support & kSkipIntervalMask,
+        remote.frame_rate_control_support & kSkipIntervalMask);
+  }
+  format.frame_rate_control_support = frame_rate_control;
+
+  format.max_hres = min_specified(local.max_hres, remote.max_hres);
+  format.max_vres = min_specified(local.max_vres, remote.max_vres);
 }
 
 template <typename RREnum>
 void PopulateVideoFormatList(
-    H264Profile profile,
-    H264Level level,
+    const H264VideoCodec& codec,
     const RateAndResolutionsBitmap& bitmap,
     RREnum max_value,
     std::vector<H264VideoFormat>& formats) {
@@ -169,21 +264,37 @@ void PopulateVideoFormatList(
     return;
 
   for (RateAndResolution rr = 0; rr <= static_cast<RateAndResolution>(max_value); ++rr) {
-    if (bitmap.test(rr))
-      formats.push_back(H264VideoFormat(profile, level, static_cast<RREnum>(rr)));
+    if (!bitmap.test(rr))
+      continue;
+    H264VideoFormat format(codec.profile, codec.level, static_cast<RREnum>(rr));
+    format.latency = codec.latency;
+    format.min_slice_size = codec.min_slice_size;
+    format.slice_enc_params = codec.slice_enc_params;
+    format.frame_rate_control_support = codec.frame_rate_control_support;
+    format.max_hres = codec.max_hres;
+    format.max_vres = codec.max_vres;
+    formats.push_back(format);
   }
 }
 
 }  // namespace
 
+VideoFormatInfo GetVideoFormatInfo(const H264VideoFormat& format) {
+  assert(format.type <= HH &&
+         format.rate_resolution < GetVideoModeCount(format.type));
+  const VideoMode& mode = GetVideoMode(format);
+  return VideoFormatInfo{mode.width, mode.height, mode.frame_rate,
+                         mode.interlaced};
+}
+
 void PopulateVideoFormatList(
     const H264VideoCodec& codec, std::vector<H264VideoFormat>& formats) {
   PopulateVideoFormatList<CEARatesAndResolutions>(
-      codec.profile, codec.level, codec.cea_rr, CEA1920x1080p24, formats);
+      codec, codec.cea_rr, CEA1920x1080p24, formats);
   PopulateVideoFormatList<VESARatesAndResolutions>(
-      codec.profile, codec.level, codec.vesa_rr, VESA1920x1200p30, formats);
+      codec, codec.vesa_rr, VESA1920x1200p30, formats);
   PopulateVideoFormatList<HHRatesAndResolutions>(
-      codec.profile, codec.level, codec.hh_rr, HH848x480p60, formats);
+      codec, codec.hh_rr, HH848x480p60, formats);
 }
 
 H264VideoFormat FindOptimalVideoFormat(
@@ -191,52 +302,163 @@ H264VideoFormat FindOptimalVideoFormat(
     const std::vector<H264VideoCodec>& local_codecs,
     const std::vector<H264VideoCodec>& remote_codecs,
     bool* success) {
-  std::vector<H264VideoFormat> local_formats, remote_formats;
-  for (const auto& codec : local_codecs)
-    PopulateVideoFormatList(codec, local_formats);
-  for (const auto& codec : remote_codecs)
-    PopulateVideoFormatList(codec, remote_formats);
+  const ModeIndex& index = mode_index();
 
-  std::sort(local_formats.begin(), local_formats.end(),
-      video_format_sort_func);
-  std::sort(remote_formats.begin(), remote_formats.end(),
-      video_format_sort_func);
+  // Local modes are matched by frame size only, the remote one may have
+  // a different rate.
+  uint32_t remote_sizes[HH + 1] = {0, 0, 0};
+  for (const auto& codec : remote_codecs)
+    for (unsigned type = CEA; type <= HH; ++type)
+      remote_sizes[type] |= get_modes(codec, ResolutionType(type));
+  for (unsigned type = CEA; type <= HH; ++type)
+    remote_sizes[type] = index.SameSize(ResolutionType(type), remote_sizes[type]);
 
-  auto it = local_formats.begin();
-  auto end = local_formats.end();
+  ModeChoice local = {nullptr, CEA, 0, 0};
+  for (const auto& codec : local_codecs)
+    for (unsigned type = CEA; type <= HH; ++type)
+      choose_mode(codec, ResolutionType(type),
+                  get_modes(codec, ResolutionType(type)) & remote_sizes[type],
+                  local);
 
   H264VideoFormat format;
 
-  while(it != end) {
-    auto match = std::find_if(
-        remote_formats.begin(),
-        remote_formats.end(),
-        [&it] (const H264VideoFormat& format) {
-            return ((*it).type == format.type) &&
-                   (get_resolution(*it) == get_resolution(format));
-        });
-
-    if (match != remote_formats.end()) {
-      format = *match;
-      break;
-    }
-    ++it;
-  }
-
   // Should not happen, 640x480p60 should be always supported!
-  if (it == end) {
+  if (!local.codec) {
     WDS_ERROR("Failed to find compatible video format.");
     if (success)
       *success = false;
     return format;
   }
 
+  uint32_t size = index.SameSize(local.type, 1u << local.rate_resolution);
+  ModeChoice remote = {nullptr, CEA, 0, 0};
+  for (const auto& codec : remote_codecs)
+    choose_mode(codec, local.type, get_modes(codec, local.type) & size, remote);
+  assert(remote.codec);
+
+  format.type = remote.type;
+  format.rate_resolution = remote.rate_resolution;
   // if remote device supports higher codec profile / level
   // downgrade them to what we support locally.
-  if (format.profile > (*it).profile)
-    format.profile = (*it).profile;
-  if (format.level > (*it).level)
-    format.level = (*it).level;
+  format.profile = std::min(remote.codec->profile, local.codec->profile);
+  format.level = std::min(remote.codec->level, local.codec->level);
+  set_codec_parameters(*local.codec, *remote.codec, format);
+  if (success)
+    *success = true;
+  return format;
+}
+
+H264VideoFormat FindOptimalVideoFormat(
+    const VideoFormatPolicy& policy,
+    const NativeVideoFormat& native,
+    const std::vector<H264VideoCodec>& local_codecs,
+    const std::vector<H264VideoCodec>& remote_codecs,
+    bool* success) {
+  H264VideoFormat format;
+  double cost = 0;
+  bool found = false;
+  for (unsigned type = CEA; type <= HH; ++type) {
+    uint32_t local_modes = 0;
+    uint32_t remote_modes = 0;
+    for (const auto& codec : local_codecs)
+      local_modes |= get_modes(codec, ResolutionType(type));
+    for (const auto& codec : remote_codecs)
+      remote_modes |= get_modes(codec, ResolutionType(type));
+
+    for (uint32_t common = local_modes & remote_modes; common;
+         common &= common - 1) {
+      H264VideoFormat candidate;
+      candidate.type = ResolutionType(type);
+      candidate.rate_resolution = lowest_bit(common);
+      double candidate_cost = policy.GetCost(native, candidate);
+      if (!found || candidate_cost < cost) {
+        format = candidate;
+        cost = candidate_cost;
+        found = true;
+      }
+    }
+  }
+
+  if (!found) {
+    WDS_ERROR("Failed to find compatible video format.");
+    if (success)
+      *success = false;
+    return H264VideoFormat();
+  }
+
+  // The best profile, then level, of a local and remote codec pair
+  // supporting the format
+  uint32_t mode = 1u << format.rate_resolution;
+  const H264VideoCodec* local_codec = nullptr;
+  const H264VideoCodec* remote_codec = nullptr;
+  for (const auto& local : local_codecs) {
+    if (!(get_modes(local, format.type) & mode))
+      continue;
+    for (const auto& remote : remote_codecs) {
+      if (!(get_modes(remote, format.type) & mode))
+        continue;
+      H264Profile profile = std::min(local.profile, remote.profile);
+      H264Level level = std::min(local.level, remote.level);
+      if (!local_codec || profile > format.profile ||
+          (profile == format.profile && level > format.level)) {
+        format.profile = profile;
+        format.level = level;
+        local_codec = &local;
+        remote_codec = &remote;
+      }
+    }
+  }
+  set_codec_parameters(*local_codec, *remote_codec, format);
+  if (success)
+    *success = true;
+  return format;
+}
+
+H264Video3DFormat FindOptimalVideo3DFormat(
+    const std::vector<Video3DMode>& preferred_modes,
+    const std::vector<H264Video3DCodec>& local_codecs,
+    const std::vector<H264Video3DCodec>& remote_codecs,
+    bool* success) {
+  uint64_t local_modes = 0;
+  uint64_t remote_modes = 0;
+  for (const auto& codec : local_codecs)
+    local_modes |= codec.modes.to_ullong();
+  for (const auto& codec : remote_codecs)
+    remote_modes |= codec.modes.to_ullong();
+  uint64_t common = local_modes & remote_modes;
+
+  auto it = std::find_if(preferred_modes.begin(), preferred_modes.end(),
+      [common](Video3DMode mode) {
+        return mode < 64 && (common & (uint64_t(1) << mode));
+      });
+  if (it == preferred_modes.end()) {
+    if (success)
+      *success = false;
+    return H264Video3DFormat();
+  }
+
+  H264Video3DFormat format(CBP, k3_1, *it);
+  const H264Video3DCodec* local_codec = nullptr;
+  const H264Video3DCodec* remote_codec = nullptr;
+  for (const auto& local : local_codecs) {
+    if (!local.modes.test(format.mode))
+      continue;
+    for (const auto& remote : remote_codecs) {
+      if (!remote.modes.test(format.mode))
+        continue;
+      H264Profile profile = std::min(local.profile, remote.profile);
+      H264Level level = std::min(local.level, remote.level);
+      if (!local_codec || profile > format.profile ||
+          (profile == format.profile && level > format.level)) {
+        format.profile = profile;
+        format.level = level;
+        local_codec = &local;
+        remote_codec = &remote;
+      }
+    }
+  }
+  assert(local_codec && remote_codec);
+  set_codec_parameters(*local_codec, *remote_codec, format);
   if (success)
     *success = true;
   return format;
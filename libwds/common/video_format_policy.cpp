@@ -0,0 +1,89 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "libwds/public/video_format_policy.h"
+
+namespace wds {
+
+namespace {
+
+// Tiers of NativeFirstPolicy costs, far apart from any pixel rate
+const double kNativeTier = 1e12;
+
+bool is_native(const NativeVideoFormat& native, const H264VideoFormat& format) {
+  return format.type == native.type &&
+         format.rate_resolution == native.rate_resolution;
+}
+
+// Frames (field pairs if interlaced) per second
+double get_frame_rate(const VideoMode& mode) {
+  return double(mode.pixel_rate) / (mode.width * mode.height);
+}
+
+}  // namespace
+
+double MaxQualityPolicy::GetCost(const NativeVideoFormat& native,
+                                 const H264VideoFormat& format) const {
+  return -double(GetVideoMode(format).pixel_rate);
+}
+
+double NativeFirstPolicy::GetCost(const NativeVideoFormat& native,
+                                  const H264VideoFormat& format) const {
+  if (is_native(native, format))
+    return -2 * kNativeTier;
+  const VideoMode& mode = GetVideoMode(format);
+  const VideoMode& native_mode =
+      GetVideoMode(native.type, native.rate_resolution);
+  if (mode.width <= native_mode.width && mode.height <= native_mode.height)
+    return -kNativeTier - mode.pixel_rate;
+  return mode.pixel_rate;
+}
+
+BandwidthCappedPolicy::BandwidthCappedPolicy(unsigned max_throughput,
+                                             double bits_per_pixel)
+  : max_throughput_(max_throughput),
+    bits_per_pixel_(bits_per_pixel) {
+}
+
+double BandwidthCappedPolicy::GetCost(const NativeVideoFormat& native,
+                                      const H264VideoFormat& format) const {
+  double bitrate = GetBitrate(format);
+  if (max_throughput_ == 0 || bitrate <= max_throughput_)
+    return -double(GetVideoMode(format).pixel_rate);
+  return bitrate;
+}
+
+double BandwidthCappedPolicy::GetBitrate(const H264VideoFormat& format) const {
+  return GetVideoMode(format).pixel_rate * bits_per_pixel_ / 1000;
+}
+
+LowestLatencyPolicy::LowestLatencyPolicy(double encoder_pixel_rate)
+  : encoder_pixel_rate_(encoder_pixel_rate) {
+}
+
+double LowestLatencyPolicy::GetCost(const NativeVideoFormat& native,
+                                    const H264VideoFormat& format) const {
+  const VideoMode& mode = GetVideoMode(format);
+  return 1 / get_frame_rate(mode) +
+         double(mode.width) * mode.height / encoder_pixel_rate_;
+}
+
+}  // namespace wds
@@ -23,6 +23,9 @@
 #define LIBWDS_PUBLIC_AUDIO_CODEC_H_
 
 #include <bitset>
+#include <vector>
+
+#include "wds_export.h"
 
 namespace wds {
 
@@ -68,6 +71,54 @@ struct AudioCodec {
   unsigned latency;
 };
 
+/**
+ * Ranks the audio codecs for @c FindOptimalAudioCodec.
+ */
+struct AudioCodecPreference {
+  AudioCodecPreference(const std::vector<AudioFormats>& formats,
+                       unsigned latency_per_rank_ms)
+  : formats(formats), latency_per_rank_ms(latency_per_rank_ms) {}
+
+  /// Most preferred first, formats not listed are never chosen.
+  std::vector<AudioFormats> formats;
+  /// Decoder latency worth one step down the @c formats list, 0 to only
+  /// break ties between codecs of the same format by their latency.
+  unsigned latency_per_rank_ms;
+};
+
+/**
+ * LPCM, which is sent as is, then AAC and AC3 (shorter frames first).
+ * A codec is passed over for the next one if its decoder is 20 ms slower.
+ */
+WDS_EXPORT AudioCodecPreference LowestLatencyAudioPreference();
+
+/**
+ * AAC, then AC3 and LPCM last. Latency only breaks ties.
+ */
+WDS_EXPORT AudioCodecPreference LowestBandwidthAudioPreference();
+
+/**
+ * An auxiliary function to find the optimal audio codec for streaming.
+ *
+ * Of the formats in @c preference supported by both devices, picks the
+ * one of the lowest rank plus remote decoder latency (the @c latency of
+ * 'wfd-audio-codecs', in units of 5 ms) weighted by the preference. The
+ * mode is the first one both devices support, in table order; the latency
+ * is the higher one of the two codecs.
+ *
+ * @param preference ranking of the formats
+ * @param local_codecs list of audio codecs that are supported by local device
+ * @param remote_codecs list of audio codecs that are supported by remote device
+ * @param success set to false if the devices have no listed format and
+ *        mode in common
+ * @return optimal audio codec with a single mode
+ */
+WDS_EXPORT AudioCodec FindOptimalAudioCodec(
+    const AudioCodecPreference& preference,
+    const std::vector<AudioCodec>& local_codecs,
+    const std::vector<AudioCodec>& remote_codecs,
+    bool* success = nullptr);
+
 }  // namespace wds
 
 #endif  // LIBWDS_PUBLIC_AUDIO_CODEC_H_
@@ -0,0 +1,96 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef LIBWDS_PUBLIC_CAPABILITY_CACHE_H_
+#define LIBWDS_PUBLIC_CAPABILITY_CACHE_H_
+
+#include <chrono>
+#include <list>
+#include <mutex>
+#include <string>
+
+#include "media_manager.h"
+#include "wds_export.h"
+
+namespace wds {
+
+/**
+ * Sink capabilities from earlier sessions, by peer identity.
+ *
+ * Lets a @c SourceMediaManager implement GetCachedSinkCapabilities() and
+ * SinkCapabilitiesReceived(), so that a sink reconnecting shortly after
+ * (e.g. over a flaky Wi-Fi Direct link) gets M4 without waiting for M3.
+ * The peer identity is up to the caller, e.g. the P2P device address or
+ * the IP address of the sink.
+ *
+ * The cache may be shared by sessions running on different threads.
+ */
+class WDS_EXPORT CapabilityCache {
+ public:
+  /**
+   * @param max_entries number of sinks kept, the least recently used one
+   *        is dropped first
+   * @param max_age_seconds time after which an entry is not used anymore,
+   *        0 disables the cache
+   */
+  explicit CapabilityCache(size_t max_entries = 16, int max_age_seconds = 600);
+
+  /**
+   * Looks up the capabilities of a sink.
+   *
+   * @param peer_id identity of the sink
+   * @param capabilities filled in if found
+   * @return true if an entry that is not too old was found
+   */
+  bool Find(const std::string& peer_id, SinkCapabilities* capabilities);
+
+  /**
+   * Adds or replaces the capabilities of a sink.
+   */
+  void Store(const std::string& peer_id, const SinkCapabilities& capabilities);
+
+  /**
+   * Forgets a sink, e.g. once a session with it failed.
+   */
+  void Remove(const std::string& peer_id);
+
+  /**
+   * Returns the number of entries, including the ones too old to be found.
+   */
+  size_t size() const;
+
+ private:
+  struct Entry {
+    std::string peer_id;
+    SinkCapabilities capabilities;
+    std::chrono::steady_clock::time_point stored;
+  };
+
+  mutable std::mutex mutex_;
+  // Most recently used first
+  std::list<Entry> entries_;
+  size_t max_entries_;
+  std::chrono::seconds max_age_;
+};
+
+}  // namespace wds
+
+#endif  // LIBWDS_PUBLIC_CAPABILITY_CACHE_H_
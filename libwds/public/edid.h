@@ -0,0 +1,66 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef LIBWDS_PUBLIC_EDID_H_
+#define LIBWDS_PUBLIC_EDID_H_
+
+#include <vector>
+
+#include "video_format.h"
+#include "wds_export.h"
+
+namespace wds {
+
+/**
+ * What a sink's display shows without scaling, from its EDID.
+ *
+ * @see ParseEdid
+ */
+struct EdidDisplayInfo {
+  EdidDisplayInfo() : has_preferred_timing(false) {}
+
+  /** The mode of the preferred timing, else the largest of the modes */
+  NativeVideoFormat native_format;
+  /** Modes of the frame size of a timing the display supports, at its
+   *  refresh rate or an integer fraction of it. Always has CEA640x480p60,
+   *  which all WFD devices support. */
+  RateAndResolutionsBitmap cea_rr;
+  RateAndResolutionsBitmap vesa_rr;
+  RateAndResolutionsBitmap hh_rr;
+  /** The first detailed timing, the native one of flat panels */
+  bool has_preferred_timing;
+  DisplayTiming preferred_timing;
+};
+
+/**
+ * Reads the base EDID block and the CEA-861 extensions: established,
+ * standard and detailed timings and the short video descriptors.
+ *
+ * @param edid the EDID, a multiple of 128 bytes
+ * @param info filled in if the EDID is valid
+ * @return false if the header or a checksum is wrong
+ */
+WDS_EXPORT bool ParseEdid(const std::vector<unsigned char>& edid,
+                          EdidDisplayInfo* info);
+
+}  // namespace wds
+
+#endif  // LIBWDS_PUBLIC_EDID_H_
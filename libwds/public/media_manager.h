@@ -22,6 +22,7 @@
 #ifndef LIBWDS_PUBLIC_MEDIA_MANAGER_H_
 #define LIBWDS_PUBLIC_MEDIA_MANAGER_H_
 
+#include <functional>
 #include <string>
 #include <vector>
 #include "audio_codec.h"
@@ -37,6 +38,23 @@ enum SessionType {
   AudioVideoSession = AudioSession | VideoSession  // Audio/video session
 };
 
+/**
+ * Capabilities of a WFD sink, as replied to M3.
+ *
+ * @see SourceMediaManager::GetCachedSinkCapabilities
+ */
+struct SinkCapabilities {
+  SinkCapabilities() : rtp_port0(0), rtp_port1(0) {}
+
+  NativeVideoFormat native_format;
+  std::vector<H264VideoCodec> video_codecs;
+  // Empty if the sink does not support 3D or was not asked
+  std::vector<H264Video3DCodec> video_3d_codecs;
+  std::vector<AudioCodec> audio_codecs;
+  int rtp_port0;
+  int rtp_port1;
+};
+
 /**
  * MediaManager interface.
  *
@@ -67,6 +85,33 @@ class MediaManager {
    */
   virtual void Teardown() = 0;
 
+  /**
+   * Reports the outcome of an asynchronous state change.
+   * @param success false if the media stream could not get to the state
+   */
+  using StateChangeCallback = std::function<void(bool success)>;
+
+  /**
+   * Triggers playback of the media stream and calls @a completed once it
+   * actually plays, e.g. from the media pipeline's bus watch. WFD source
+   * replies to PLAY only then.
+   *
+   * The default implementation calls Play() and completes right away.
+   */
+  virtual void PlayAsync(const StateChangeCallback& completed) {
+    Play();
+    completed(true);
+  }
+
+  /**
+   * Pauses playback of the media stream and calls @a completed once it
+   * is actually paused, see PlayAsync().
+   */
+  virtual void PauseAsync(const StateChangeCallback& completed) {
+    Pause();
+    completed(true);
+  }
+
   /**
    * Queries whether media stream is paused.
    * @return true if media stream is paused, false otherwise.
@@ -150,11 +195,85 @@ class SinkMediaManager : public MediaManager {
    */
   virtual bool SetOptimalVideoFormat(const H264VideoFormat& optimal_format) = 0;
 
+  /**
+   * Returns list of supported H264 stereoscopic 3D codecs, sent to the
+   * source in 'wfd_3d_video_formats'.
+   *
+   * The default implementation supports none.
+   *
+   * @return vector of supported H264 3D codecs
+   */
+  virtual std::vector<H264Video3DCodec> GetSupportedH264Video3DCodecs() const {
+    return std::vector<H264Video3DCodec>();
+  }
+
+  /**
+   * Sets the 3D format the source chose in M4, which the stream then uses
+   * instead of the one given to SetOptimalVideoFormat.
+   *
+   * @param optimal_format H264 3D format
+   * @return true if format can be used by media manager, false otherwise
+   */
+  virtual bool SetOptimalVideo3DFormat(const H264Video3DFormat& optimal_format) {
+    return false;
+  }
+
+  /**
+   * Returns the EDID of the display, sent to the source in
+   * 'wfd_display_edid'. Its size is a multiple of the 128 byte block.
+   *
+   * The default implementation has none.
+   *
+   * @return raw EDID, empty if unknown
+   */
+  virtual std::vector<unsigned char> GetDisplayEdid() const {
+    return std::vector<unsigned char>();
+  }
+
+  /**
+   * Returns the timing the display prefers, sent to the source in
+   * 'wfd_preferred_display_mode'.
+   *
+   * The default implementation has none.
+   *
+   * @param timing the preferred timing
+   * @return true if @a timing is set, false otherwise
+   */
+  virtual bool GetPreferredDisplayMode(DisplayTiming* timing) const {
+    return false;
+  }
+
+  /**
+   * Sets the timing the source chose in M4 with 'wfd_preferred_display_mode',
+   * which the stream then uses instead of a CEA, VESA or HH resolution.
+   *
+   * @param timing display timing
+   * @return true if timing can be used by media manager, false otherwise
+   */
+  virtual bool SetPreferredDisplayMode(const DisplayTiming& timing) {
+    return false;
+  }
+
   /**
    * Returns active connector type of a device
    * @return connector type. @see ConnectorType
    */
   virtual ConnectorType GetConnectorType() const = 0;
+
+  /**
+   * Queries whether the sink sends and receives RTCP on its first RTP
+   * port + 1. If so, RTCP is offered to the source in the M6 request.
+   * @return true if RTCP is supported, false otherwise.
+   */
+  virtual bool IsRtcpSupported() const = 0;
+
+  /**
+   * Sets the port the WFD source receives RTCP on (its RTP port + 1).
+   * Called from the M6 reply if the source accepted RTCP.
+   *
+   * @param port RTCP port of the WFD source
+   */
+  virtual void SetSourceRtcpPort(int port) = 0;
 };
 
 /**
@@ -169,6 +288,7 @@ class SourceMediaManager : public MediaManager {
 
    /**
     * Returns media type for the current session.
+    * Asked again once the optimal formats are initialized.
     * @see MediaType
     * @return media time.
     */
@@ -217,14 +337,52 @@ class SourceMediaManager : public MediaManager {
   /**
    * Gets optimal H264 format @see InitOptimalVideoFormat
    *
+   * Sent to the sink in M4 with its latency, slice and frame rate control
+   * parameters, which the encoder is expected to follow.
+   *
    * @return optimal H264 format
    */
   virtual H264VideoFormat GetOptimalVideoFormat() const = 0;
 
+  /**
+   * Queries whether the source can stream stereoscopic 3D. If so the
+   * sink is asked for its 3D formats in M3.
+   *
+   * The default implementation streams 2D only.
+   *
+   * @return true if 3D is supported, false otherwise
+   */
+  virtual bool IsVideo3DSupported() const { return false; }
+
+  /**
+   * Initializes optimal 3D video format, e.g. with FindOptimalVideo3DFormat
+   * for the 3D modes the source prefers. Called after InitOptimalVideoFormat
+   * if IsVideo3DSupported.
+   *
+   * @param sink_supported_codecs H264 3D codecs supported by the sink, empty if none
+   */
+  virtual void InitOptimalVideo3DFormat(
+      const std::vector<H264Video3DCodec>& sink_supported_codecs) {}
+
+  /**
+   * Gets optimal H264 3D format @see InitOptimalVideo3DFormat
+   *
+   * Sent to the sink in M4 next to the 2D one.
+   *
+   * @param format filled in if the stream is 3D
+   * @return true if the stream is 3D, false if it is 2D
+   */
+  virtual bool GetOptimalVideo3DFormat(H264Video3DFormat* format) const {
+    return false;
+  }
+
   /**
    * Initializes optimal audio codec
    * The optimal audio codec will be returned by GetOptimalAudioFormat
    *
+   * A sink without audio supports no codecs. To go on without audio,
+   * return true and a session type without @c AudioSession from then on.
+   *
    * @param sink_supported_codecs list of the codecs supported by sink
    * @return true if optimal audio codec is successfully initialized, false otherwise
    */
@@ -242,6 +400,80 @@ class SourceMediaManager : public MediaManager {
    * to recover the content streaming.
    */
   virtual void SendIDRPicture() = 0;
+
+  /**
+   * Sets the port the WFD sink receives RTCP on (its RTP port + 1).
+   * Called from M6 if the sink offered RTCP.
+   *
+   * If RTCP is enabled the source must also receive RTCP on the local
+   * RTP port + 1, @see GetLocalRtpPort.
+   *
+   * @param port RTCP port of the WFD sink
+   * @return true if RTCP is enabled for the session, false otherwise
+   */
+  virtual bool SetSinkRtcpPort(int port) = 0;
+
+  /**
+   * Returns the capabilities the same sink had in an earlier session,
+   * e.g. from a @c CapabilityCache.
+   *
+   * WFD source then initializes the optimal formats from them and sends M4
+   * right after M3, without waiting for the M3 reply. If the reply differs
+   * the formats are initialized again and M4 is sent once more.
+   *
+   * The default implementation knows no sink.
+   *
+   * @param capabilities filled in if the sink is known
+   * @return true if the sink is known, false otherwise
+   */
+  virtual bool GetCachedSinkCapabilities(SinkCapabilities* capabilities) const {
+    return false;
+  }
+
+  /**
+   * Called with the capabilities from the M3 reply once the optimal formats
+   * are initialized from them, to be returned by GetCachedSinkCapabilities
+   * in the next session with the same sink.
+   *
+   * @param capabilities capabilities of the sink
+   */
+  virtual void SinkCapabilitiesReceived(const SinkCapabilities& capabilities) {}
+
+  /**
+   * Returns when the stream could switch to the given video format, for
+   * wfd_av_format_change_timing of a format change. Called before M4 is
+   * sent, so a format the stream cannot switch to is refused here rather
+   * than after the sink accepted it.
+   *
+   * The default implementation does not support format changes.
+   *
+   * @param format new video format
+   * @param pts MPEG-TS PTS (90 kHz) of the first frame in the new format
+   * @param dts MPEG-TS DTS of that frame
+   * @return true if the stream can switch to @a format, false otherwise
+   * @see Source::ChangeVideoFormat
+   */
+  virtual bool GetVideoFormatChangeTiming(const H264VideoFormat& format,
+                                          unsigned long long* pts,
+                                          unsigned long long* dts) {
+    return false;
+  }
+
+  /**
+   * Switches the stream to the given video format, which the sink accepted
+   * in M4, at the timing returned by GetVideoFormatChangeTiming(). The
+   * first frame in the new format must be an IDR picture. Afterwards
+   * GetOptimalVideoFormat() returns the new format.
+   *
+   * A failure only leaves the stream in the current format, the session
+   * goes on.
+   *
+   * @param format new video format
+   * @return true if the stream switches, false otherwise
+   */
+  virtual bool ChangeVideoFormat(const H264VideoFormat& format) {
+    return false;
+  }
 };
 
 inline SourceMediaManager* ToSourceMediaManager(MediaManager* mng) {
@@ -168,6 +168,15 @@ class WDS_EXPORT Peer {
    * @see Delegate::CreateTimer()
    */
   virtual void OnTimerEvent(unsigned timer_id) = 0;
+
+  /**
+   * This method should be called by the client when its outgoing RTSP
+   * queue goes above the high watermark or drains below the low watermark.
+   * While the queue is congested the state machine coalesces or drops
+   * redundant requests instead of queuing them behind the pending ones.
+   * @param congested true if the queue is above the high watermark
+   */
+  virtual void OnSendQueueStateChanged(bool congested) = 0;
 };
 
 }
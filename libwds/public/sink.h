@@ -42,6 +42,14 @@ class WDS_EXPORT Sink : public Peer {
    * @return newly created Sink instance
    */
   static Sink* Create(Peer::Delegate* delegate, SinkMediaManager* mng);
+
+  /**
+   * Sends M13 request for an IDR picture, e.g. after a decoding error.
+   * While the outgoing RTSP queue is congested, repeated requests are
+   * coalesced into the one already sent.
+   * @return true if request was sent or coalesced, false otherwise.
+   */
+  virtual bool RequestIDR() = 0;
 };
 
 }
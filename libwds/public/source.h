@@ -23,6 +23,7 @@
 #define LIBWDS_PUBLIC_SOURCE_H_
 
 #include "peer.h"
+#include "video_format.h"
 
 namespace wds {
 
@@ -43,6 +44,21 @@ class WDS_EXPORT Source : public Peer {
   static Source* Create(Peer::Delegate* delegate,
                         SourceMediaManager* mng,
                         Peer::Observer* observer = nullptr);
+
+  /**
+   * Switches the stream to another video format without a new session.
+   *
+   * Sends M4 with the format and the wfd_av_format_change_timing from
+   * SourceMediaManager::GetVideoFormatChangeTiming(). Once the sink
+   * accepts it SourceMediaManager::ChangeVideoFormat() is called, if the
+   * sink rejects it the stream stays in the current format.
+   *
+   * @param format one of the formats the sink supports
+   * @return true if request can be sent, false otherwise (e.g. not
+   *         streaming yet, another format change is pending or the
+   *         media manager cannot switch to the format)
+   */
+  virtual bool ChangeVideoFormat(const H264VideoFormat& format) = 0;
 };
 
 }
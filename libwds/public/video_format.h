@@ -31,6 +31,10 @@ namespace wds {
 
 using RateAndResolution = unsigned;
 using RateAndResolutionsBitmap = std::bitset<32>;
+// A bit of the 3D video capability bitmap in 'wfd_3d_video_formats'
+// (frame size, rate and stereoscopic frame packing, Table 5-19)
+using Video3DMode = unsigned;
+using Video3DModesBitmap = std::bitset<64>;
 
 // NOTE : Do not change the elements order in the following enums!
 
@@ -122,13 +126,13 @@ enum H264Level {
 
 
 struct NativeVideoFormat {
-  NativeVideoFormat()
+  constexpr NativeVideoFormat()
   : type(CEA), rate_resolution(CEA640x480p60) {}
-  NativeVideoFormat(CEARatesAndResolutions rr)
+  constexpr NativeVideoFormat(CEARatesAndResolutions rr)
   : type(CEA), rate_resolution(rr) {}
-  NativeVideoFormat(VESARatesAndResolutions rr)
+  constexpr NativeVideoFormat(VESARatesAndResolutions rr)
   : type(VESA), rate_resolution(rr) {}
-  NativeVideoFormat(HHRatesAndResolutions rr)
+  constexpr NativeVideoFormat(HHRatesAndResolutions rr)
   : type(HH), rate_resolution(rr) {}
 
   ResolutionType type;
@@ -144,22 +148,35 @@ struct NativeVideoFormat {
  * to the sink.
  */
 struct H264VideoFormat {
-  H264VideoFormat()
-  : profile(CBP), level(k3_1), type(CEA), rate_resolution(CEA640x480p60) {}
+  constexpr H264VideoFormat()
+  : H264VideoFormat(CBP, k3_1, CEA, CEA640x480p60) {}
 
-  H264VideoFormat(H264Profile profile, H264Level level, CEARatesAndResolutions rr)
-  : profile(profile), level(level), type(CEA), rate_resolution(rr) {}
+  constexpr H264VideoFormat(H264Profile profile, H264Level level, CEARatesAndResolutions rr)
+  : H264VideoFormat(profile, level, CEA, rr) {}
 
-  H264VideoFormat(H264Profile profile, H264Level level, VESARatesAndResolutions rr)
-  : profile(profile), level(level), type(VESA), rate_resolution(rr) {}
+  constexpr H264VideoFormat(H264Profile profile, H264Level level, VESARatesAndResolutions rr)
+  : H264VideoFormat(profile, level, VESA, rr) {}
 
-  H264VideoFormat(H264Profile profile, H264Level level, HHRatesAndResolutions rr)
-  : profile(profile), level(level), type(HH), rate_resolution(rr) {}
+  constexpr H264VideoFormat(H264Profile profile, H264Level level, HHRatesAndResolutions rr)
+  : H264VideoFormat(profile, level, HH, rr) {}
+
+  constexpr H264VideoFormat(H264Profile profile, H264Level level,
+                            ResolutionType type, RateAndResolution rr)
+  : profile(profile), level(level), type(type), rate_resolution(rr),
+    latency(0), min_slice_size(0), slice_enc_params(0),
+    frame_rate_control_support(0), max_hres(0), max_vres(0) {}
 
   H264Profile profile;
   H264Level level;
   ResolutionType type;
   RateAndResolution rate_resolution;
+  // The parameters of @c H264VideoCodec that the stream is encoded with
+  unsigned char latency;
+  unsigned short min_slice_size;
+  unsigned short slice_enc_params;
+  unsigned char frame_rate_control_support;
+  unsigned short max_hres;
+  unsigned short max_vres;
 };
 
 /**
@@ -172,21 +189,264 @@ struct H264VideoFormat {
  */
 struct H264VideoCodec {
   H264VideoCodec()
-  : profile(CBP), level(k3_1), cea_rr(RateAndResolutionsBitmap().set(CEA640x480p60)) {}
+  : H264VideoCodec(CBP, k3_1, RateAndResolutionsBitmap().set(CEA640x480p60),
+                   RateAndResolutionsBitmap(), RateAndResolutionsBitmap()) {}
 
   H264VideoCodec(H264Profile profile, H264Level level,
                   const RateAndResolutionsBitmap& cea,
                   const RateAndResolutionsBitmap& vesa,
                   const RateAndResolutionsBitmap& hh)
-  : profile(profile), level(level), cea_rr(cea), vesa_rr(vesa), hh_rr(hh) {}
+  : profile(profile), level(level), cea_rr(cea), vesa_rr(vesa), hh_rr(hh),
+    latency(0), min_slice_size(0), slice_enc_params(0),
+    frame_rate_control_support(0), max_hres(0), max_vres(0) {}
 
   H264Profile profile;
   H264Level level;
   RateAndResolutionsBitmap cea_rr;
   RateAndResolutionsBitmap vesa_rr;
   RateAndResolutionsBitmap hh_rr;
+  // Decoder latency in units of 5 ms, 0 if not specified
+  unsigned char latency;
+  // Smallest slice in macroblocks, 0 if slice encoding is not supported
+  unsigned short min_slice_size;
+  // B9:B0 maximum number of slices per picture, B12:B10 maximum ratio
+  // of the slice size to min_slice_size
+  unsigned short slice_enc_params;
+  // B0 frame skipping, B3:B1 maximum frame skipping interval (0 for
+  // any), B4 dynamic frame rate change
+  unsigned char frame_rate_control_support;
+  // Largest resolution with the preferred display mode, 0 if none
+  unsigned short max_hres;
+  unsigned short max_vres;
+};
+
+/**
+ * A single stereoscopic 3D format that the source selects for streaming.
+ *
+ * H264Video3DFormat is a H264 profile, H264 level, and a single mode of
+ * the 3D video capability bitmap, e.g. a side-by-side one. The source
+ * sends it in M4 next to the 2D format when both devices support it.
+ */
+struct H264Video3DFormat {
+  H264Video3DFormat()
+  : H264Video3DFormat(CBP, k3_1, 0) {}
+
+  H264Video3DFormat(H264Profile profile, H264Level level, Video3DMode mode)
+  : profile(profile), level(level), mode(mode),
+    latency(0), min_slice_size(0), slice_enc_params(0),
+    frame_rate_control_support(0), max_hres(0), max_vres(0) {}
+
+  H264Profile profile;
+  H264Level level;
+  Video3DMode mode;
+  // As in @c H264VideoFormat
+  unsigned char latency;
+  unsigned short min_slice_size;
+  unsigned short slice_enc_params;
+  unsigned char frame_rate_control_support;
+  unsigned short max_hres;
+  unsigned short max_vres;
+};
+
+/**
+ * Represents a H.264-codec of 'wfd_3d_video_formats': a H264 profile,
+ * H264 level and the 3D modes supported with them.
+ */
+struct H264Video3DCodec {
+  H264Video3DCodec()
+  : H264Video3DCodec(CBP, k3_1, Video3DModesBitmap()) {}
+
+  H264Video3DCodec(H264Profile profile, H264Level level,
+                   const Video3DModesBitmap& modes)
+  : profile(profile), level(level), modes(modes),
+    latency(0), min_slice_size(0), slice_enc_params(0),
+    frame_rate_control_support(0), max_hres(0), max_vres(0) {}
+
+  H264Profile profile;
+  H264Level level;
+  Video3DModesBitmap modes;
+  // As in @c H264VideoCodec
+  unsigned char latency;
+  unsigned short min_slice_size;
+  unsigned short slice_enc_params;
+  unsigned char frame_rate_control_support;
+  unsigned short max_hres;
+  unsigned short max_vres;
+};
+
+/**
+ * Detailed timing of a display, as in 'wfd_preferred_display_mode' and
+ * in the detailed timing descriptors of EDID.
+ */
+struct DisplayTiming {
+  DisplayTiming()
+  : pixel_clock(0), h_active(0), h_blanking(0), h_sync_offset(0),
+    h_sync_width(0), h_sync_positive(false), v_active(0), v_blanking(0),
+    v_sync_offset(0), v_sync_width(0), v_sync_positive(false),
+    interlaced(false) {}
+
+  // In units of 10 kHz
+  unsigned pixel_clock;
+  unsigned short h_active;
+  unsigned short h_blanking;
+  unsigned short h_sync_offset;
+  unsigned short h_sync_width;
+  bool h_sync_positive;
+  // Lines of a field for interlaced timings
+  unsigned short v_active;
+  unsigned short v_blanking;
+  unsigned short v_sync_offset;
+  unsigned short v_sync_width;
+  bool v_sync_positive;
+  bool interlaced;
+};
+
+/**
+ * Frame size and rate of a single CEA, VESA or HH resolution.
+ * For interlaced resolutions @c frame_rate is the field rate, as in
+ * the resolution name (e.g. 60 for CEA1920x1080i60).
+ */
+struct VideoFormatInfo {
+  unsigned width;
+  unsigned height;
+  unsigned frame_rate;
+  bool interlaced;
+};
+
+/**
+ * A CEA, VESA or HH resolution of the Wi-Fi Display specification.
+ */
+struct VideoMode {
+  ResolutionType type;
+  /** Bit of the mode in the @c RateAndResolutionsBitmap of @c type */
+  RateAndResolution bit;
+  unsigned width;
+  unsigned height;
+  /** Field rate for interlaced modes, as in the mode name */
+  unsigned frame_rate;
+  bool interlaced;
+  /** width * height * frames (field pairs if interlaced) per second */
+  unsigned pixel_rate;
 };
 
+constexpr VideoMode MakeVideoMode(ResolutionType type, RateAndResolution bit,
+                                  unsigned width, unsigned height,
+                                  unsigned frame_rate, bool interlaced) {
+  return VideoMode{type, bit, width, height, frame_rate, interlaced,
+                   width * height * (interlaced ? frame_rate / 2 : frame_rate)};
+}
+
+constexpr unsigned kCEAModeCount = CEA1920x1080p24 + 1;
+constexpr unsigned kVESAModeCount = VESA1920x1200p30 + 1;
+constexpr unsigned kHHModeCount = HH848x480p60 + 1;
+constexpr unsigned kVideoModeCount =
+    kCEAModeCount + kVESAModeCount + kHHModeCount;
+
+/**
+ * All the video modes: CEA, then VESA, then HH, each in bit order.
+ * Use GetVideoMode() to look a mode up.
+ */
+constexpr VideoMode kVideoModes[kVideoModeCount] = {
+  MakeVideoMode(CEA, CEA640x480p60, 640, 480, 60, false),
+  MakeVideoMode(CEA, CEA720x480p60, 720, 480, 60, false),
+  MakeVideoMode(CEA, CEA720x480i60, 720, 480, 60, true),
+  MakeVideoMode(CEA, CEA720x576p50, 720, 576, 50, false),
+  MakeVideoMode(CEA, CEA720x576i50, 720, 576, 50, true),
+  MakeVideoMode(CEA, CEA1280x720p30, 1280, 720, 30, false),
+  MakeVideoMode(CEA, CEA1280x720p60, 1280, 720, 60, false),
+  MakeVideoMode(CEA, CEA1920x1080p30, 1920, 1080, 30, false),
+  MakeVideoMode(CEA, CEA1920x1080p60, 1920, 1080, 60, false),
+  MakeVideoMode(CEA, CEA1920x1080i60, 1920, 1080, 60, true),
+  MakeVideoMode(CEA, CEA1280x720p25, 1280, 720, 25, false),
+  MakeVideoMode(CEA, CEA1280x720p50, 1280, 720, 50, false),
+  MakeVideoMode(CEA, CEA1920x1080p25, 1920, 1080, 25, false),
+  MakeVideoMode(CEA, CEA1920x1080p50, 1920, 1080, 50, false),
+  MakeVideoMode(CEA, CEA1920x1080i50, 1920, 1080, 50, true),
+  MakeVideoMode(CEA, CEA1280x720p24, 1280, 720, 24, false),
+  MakeVideoMode(CEA, CEA1920x1080p24, 1920, 1080, 24, false),
+  MakeVideoMode(VESA, VESA800x600p30, 800, 600, 30, false),
+  MakeVideoMode(VESA, VESA800x600p60, 800, 600, 60, false),
+  MakeVideoMode(VESA, VESA1024x768p30, 1024, 768, 30, false),
+  MakeVideoMode(VESA, VESA1024x768p60, 1024, 768, 60, false),
+  MakeVideoMode(VESA, VESA1152x864p30, 1152, 864, 30, false),
+  MakeVideoMode(VESA, VESA1152x864p60, 1152, 864, 60, false),
+  MakeVideoMode(VESA, VESA1280x768p30, 1280, 768, 30, false),
+  MakeVideoMode(VESA, VESA1280x768p60, 1280, 768, 60, false),
+  MakeVideoMode(VESA, VESA1280x800p30, 1280, 800, 30, false),
+  MakeVideoMode(VESA, VESA1280x800p60, 1280, 800, 60, false),
+  MakeVideoMode(VESA, VESA1360x768p30, 1360, 768, 30, false),
+  MakeVideoMode(VESA, VESA1360x768p60, 1360, 768, 60, false),
+  MakeVideoMode(VESA, VESA1366x768p30, 1366, 768, 30, false),
+  MakeVideoMode(VESA, VESA1366x768p60, 1366, 768, 60, false),
+  MakeVideoMode(VESA, VESA1280x1024p30, 1280, 1024, 30, false),
+  MakeVideoMode(VESA, VESA1280x1024p60, 1280, 1024, 60, false),
+  MakeVideoMode(VESA, VESA1400x1050p30, 1400, 1050, 30, false),
+  MakeVideoMode(VESA, VESA1400x1050p60, 1400, 1050, 60, false),
+  MakeVideoMode(VESA, VESA1440x900p30, 1440, 900, 30, false),
+  MakeVideoMode(VESA, VESA1440x900p60, 1440, 900, 60, false),
+  MakeVideoMode(VESA, VESA1600x900p30, 1600, 900, 30, false),
+  MakeVideoMode(VESA, VESA1600x900p60, 1600, 900, 60, false),
+  MakeVideoMode(VESA, VESA1600x1200p30, 1600, 1200, 30, false),
+  MakeVideoMode(VESA, VESA1600x1200p60, 1600, 1200, 60, false),
+  MakeVideoMode(VESA, VESA1680x1024p30, 1680, 1024, 30, false),
+  MakeVideoMode(VESA, VESA1680x1024p60, 1680, 1024, 60, false),
+  MakeVideoMode(VESA, VESA1680x1050p30, 1680, 1050, 30, false),
+  MakeVideoMode(VESA, VESA1680x1050p60, 1680, 1050, 60, false),
+  MakeVideoMode(VESA, VESA1920x1200p30, 1920, 1200, 30, false),
+  MakeVideoMode(HH, HH800x480p30, 800, 480, 30, false),
+  MakeVideoMode(HH, HH800x480p60, 800, 480, 60, false),
+  MakeVideoMode(HH, HH854x480p30, 854, 480, 30, false),
+  MakeVideoMode(HH, HH854x480p60, 854, 480, 60, false),
+  MakeVideoMode(HH, HH864x480p30, 864, 480, 30, false),
+  MakeVideoMode(HH, HH864x480p60, 864, 480, 60, false),
+  MakeVideoMode(HH, HH640x360p30, 640, 360, 30, false),
+  MakeVideoMode(HH, HH640x360p60, 640, 360, 60, false),
+  MakeVideoMode(HH, HH960x540p30, 960, 540, 30, false),
+  MakeVideoMode(HH, HH960x540p60, 960, 540, 60, false),
+  MakeVideoMode(HH, HH848x480p30, 848, 480, 30, false),
+  MakeVideoMode(HH, HH848x480p60, 848, 480, 60, false)
+};
+
+/**
+ * Number of modes of the given resolution type.
+ */
+constexpr unsigned GetVideoModeCount(ResolutionType type) {
+  return type == CEA ? kCEAModeCount :
+         type == VESA ? kVESAModeCount : kHHModeCount;
+}
+
+/**
+ * Position of a mode in @c kVideoModes.
+ */
+constexpr unsigned GetVideoModeIndex(ResolutionType type,
+                                     RateAndResolution rate_resolution) {
+  return (type == CEA ? 0 :
+          type == VESA ? kCEAModeCount : kCEAModeCount + kVESAModeCount) +
+         rate_resolution;
+}
+
+/**
+ * Looks a mode up, at compile time if the arguments are constant.
+ * @c rate_resolution must be below GetVideoModeCount(type).
+ */
+constexpr const VideoMode& GetVideoMode(ResolutionType type,
+                                        RateAndResolution rate_resolution) {
+  return kVideoModes[GetVideoModeIndex(type, rate_resolution)];
+}
+
+constexpr const VideoMode& GetVideoMode(const H264VideoFormat& format) {
+  return GetVideoMode(format.type, format.rate_resolution);
+}
+
+/**
+ * An auxiliary function which returns frame size and rate of the
+ * resolution of the given @c H264VideoFormat.
+ *
+ * @param format the given @c H264VideoFormat instance.
+ * @return frame size and rate of the format resolution
+ */
+WDS_EXPORT VideoFormatInfo GetVideoFormatInfo(const H264VideoFormat& format);
+
 /**
  * An auxiliary function which populates list of @c H264VideoFormat
  * items from the given @c H264VideoCodec instance.
@@ -200,7 +460,14 @@ WDS_EXPORT void PopulateVideoFormatList(
 
 /**
  * An auxiliary function to find the optimal format for streaming.
- * The quality selection algorithm will pick codec with higher bandwidth.
+ * Picks the local resolution of the lowest width * height * frame rate
+ * whose frame size the remote device supports, and the remote resolution
+ * of that frame size of the lowest frame rate. See the overload in
+ * video_format_policy.h to choose by other criteria.
+ *
+ * The other parameters of the format are the ones both codecs support:
+ * the higher latency, slices no smaller and no more than both allow,
+ * the frame rate control of both and the smaller maximum resolution.
  *
  * @param native format of a remote device
  * @param local_codecs list of H264 codecs that are supported by local device
@@ -213,6 +480,24 @@ WDS_EXPORT H264VideoFormat FindOptimalVideoFormat(
     const std::vector<H264VideoCodec>& remote_codecs,
     bool* success = nullptr);
 
+/**
+ * An auxiliary function to find the 3D format for streaming.
+ * Picks the first of @c preferred_modes that both devices support, with
+ * the highest profile, then level, of a pair of codecs supporting it.
+ * The other parameters are combined as by FindOptimalVideoFormat().
+ *
+ * @param preferred_modes 3D modes the local device streams, best first
+ * @param local_codecs list of H264 3D codecs supported by local device
+ * @param remote_codecs list of H264 3D codecs supported by remote device
+ * @param success set to false if no preferred mode is supported by both
+ * @return optimal H264 3D video format
+ */
+WDS_EXPORT H264Video3DFormat FindOptimalVideo3DFormat(
+    const std::vector<Video3DMode>& preferred_modes,
+    const std::vector<H264Video3DCodec>& local_codecs,
+    const std::vector<H264Video3DCodec>& remote_codecs,
+    bool* success = nullptr);
+
 }  // namespace wds
 
 #endif  // LIBWDS_PUBLIC_VIDEO_FORMAT_H_
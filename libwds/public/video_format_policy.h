@@ -0,0 +1,146 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef LIBWDS_PUBLIC_VIDEO_FORMAT_POLICY_H_
+#define LIBWDS_PUBLIC_VIDEO_FORMAT_POLICY_H_
+
+#include <vector>
+
+#include "video_format.h"
+#include "wds_export.h"
+
+namespace wds {
+
+/**
+ * Cost model for choosing the video format to stream.
+ *
+ * The policy aware @c FindOptimalVideoFormat picks, among the resolutions
+ * supported by both devices, the one of the lowest cost. Media managers
+ * select a policy (or implement their own) to trade picture quality
+ * against bandwidth, power or latency.
+ */
+class WDS_EXPORT VideoFormatPolicy {
+ public:
+  virtual ~VideoFormatPolicy() {}
+
+  /**
+   * Returns the cost of streaming in the resolution of @c format.
+   *
+   * @param native native format of the remote device
+   * @param format candidate format, its profile and level are not set
+   * @return the cost, formats of a lower cost are preferred
+   */
+  virtual double GetCost(const NativeVideoFormat& native,
+                         const H264VideoFormat& format) const = 0;
+};
+
+/**
+ * Prefers the highest width * height * frame rate.
+ */
+class WDS_EXPORT MaxQualityPolicy : public VideoFormatPolicy {
+ public:
+  double GetCost(const NativeVideoFormat& native,
+                 const H264VideoFormat& format) const override;
+};
+
+/**
+ * Prefers the native format of the remote device, then the best
+ * resolution that fits in the native frame size (no scaling up on the
+ * sink), then the smallest larger one.
+ */
+class WDS_EXPORT NativeFirstPolicy : public VideoFormatPolicy {
+ public:
+  double GetCost(const NativeVideoFormat& native,
+                 const H264VideoFormat& format) const override;
+};
+
+/**
+ * Prefers the best resolution whose estimated bit rate fits in the
+ * available throughput, e.g. the maximum throughput of the peer's WFD
+ * information element, then the lowest bit rate.
+ */
+class WDS_EXPORT BandwidthCappedPolicy : public VideoFormatPolicy {
+ public:
+  /**
+   * @param max_throughput available throughput in kbit/s, 0 if unknown
+   * @param bits_per_pixel encoded bits per pixel the estimate assumes
+   */
+  explicit BandwidthCappedPolicy(unsigned max_throughput,
+                                 double bits_per_pixel = 0.1);
+
+  double GetCost(const NativeVideoFormat& native,
+                 const H264VideoFormat& format) const override;
+
+  /**
+   * Estimated bit rate of @c format, in kbit/s.
+   */
+  double GetBitrate(const H264VideoFormat& format) const;
+
+ private:
+  unsigned max_throughput_;
+  double bits_per_pixel_;
+};
+
+/**
+ * Prefers the lowest frame interval plus frame encoding time, i.e. high
+ * frame rates at small frame sizes. This also keeps the encoder load low.
+ */
+class WDS_EXPORT LowestLatencyPolicy : public VideoFormatPolicy {
+ public:
+  /**
+   * @param encoder_pixel_rate pixels per second the encoder handles
+   */
+  explicit LowestLatencyPolicy(double encoder_pixel_rate = 1920.0 * 1080 * 60);
+
+  double GetCost(const NativeVideoFormat& native,
+                 const H264VideoFormat& format) const override;
+
+ private:
+  double encoder_pixel_rate_;
+};
+
+/**
+ * Finds the format for streaming that @c policy prefers.
+ *
+ * Unlike the policy-less overload, only resolutions (frame size and rate)
+ * supported by both devices are considered. Of equal cost ones the first
+ * in CEA, VESA, HH table order is chosen. The profile and level are the
+ * highest ones both devices support for the resolution, the other
+ * parameters are combined from that pair of codecs as by the policy-less
+ * overload.
+ *
+ * @param policy the cost model
+ * @param remote_native_format native format of a remote device
+ * @param local_codecs list of H264 codecs that are supported by local device
+ * @param remote_codecs list of H264 codecs that are supported by remote device
+ * @param success set to false if the devices have no resolution in common
+ * @return optimal H264 video format
+ */
+WDS_EXPORT H264VideoFormat FindOptimalVideoFormat(
+    const VideoFormatPolicy& policy,
+    const NativeVideoFormat& remote_native_format,
+    const std::vector<H264VideoCodec>& local_codecs,
+    const std::vector<H264VideoCodec>& remote_codecs,
+    bool* success = nullptr);
+
+}  // namespace wds
+
+#endif  // LIBWDS_PUBLIC_VIDEO_FORMAT_POLICY_H_
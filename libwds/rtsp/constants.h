@@ -113,6 +113,7 @@ enum RTSPStatusCode {
   STATUS_SeeOther = 303,
   STATUS_NotAcceptable = 406,
   STATUS_UnsupportedMediaType = 415,
+  STATUS_InternalServerError = 500,
   STATUS_NotImplemented = 501
 };
 
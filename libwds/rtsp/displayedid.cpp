@@ -49,7 +49,7 @@ std::string DisplayEdid::ToString() const {
   if (is_none()) {
     ret += NONE;
   } else {
-    MAKE_HEX_STRING_2(edid_block_count, edid_block_count_);
+    MAKE_HEX_STRING_4(edid_block_count, edid_block_count_);
     ret += edid_block_count + std::string(SPACE) + edid_payload_;
   }
 
@@ -27,6 +27,58 @@
 namespace wds {
 namespace rtsp {
 
+namespace {
+
+// The lowest set bit, i.e. the lowest profile or level of a codec
+template <typename EnumType>
+EnumType MaskToEnum(unsigned char mask, EnumType biggest_value) {
+  if (!mask)
+    return static_cast<EnumType>(0);
+  unsigned result = __builtin_ctz(mask);
+  if (result > static_cast<unsigned>(biggest_value))
+    return biggest_value;
+  return static_cast<EnumType>(result);
+}
+
+}  // namespace
+
+H264Codec3d::H264Codec3d(const H264Video3DFormat& format)
+  : profile_(1 << format.profile),
+    level_(1 << format.level),
+    video_capability_3d_(1ull << format.mode),
+    latency_(format.latency),
+    min_slice_size_(format.min_slice_size),
+    slice_enc_params_(format.slice_enc_params),
+    frame_rate_control_support_(format.frame_rate_control_support),
+    max_hres_(format.max_hres),
+    max_vres_(format.max_vres) {
+}
+
+H264Codec3d::H264Codec3d(const H264Video3DCodec& codec)
+  : profile_(1 << codec.profile),
+    level_(1 << codec.level),
+    video_capability_3d_(codec.modes.to_ullong()),
+    latency_(codec.latency),
+    min_slice_size_(codec.min_slice_size),
+    slice_enc_params_(codec.slice_enc_params),
+    frame_rate_control_support_(codec.frame_rate_control_support),
+    max_hres_(codec.max_hres),
+    max_vres_(codec.max_vres) {
+}
+
+H264Video3DCodec H264Codec3d::ToH264Video3DCodec() const {
+  H264Video3DCodec result(MaskToEnum<H264Profile>(profile_, CHP),
+                          MaskToEnum<H264Level>(level_, k4_2),
+                          Video3DModesBitmap(video_capability_3d_));
+  result.latency = latency_;
+  result.min_slice_size = min_slice_size_;
+  result.slice_enc_params = slice_enc_params_;
+  result.frame_rate_control_support = frame_rate_control_support_;
+  result.max_hres = max_hres_;
+  result.max_vres = max_vres_;
+  return result;
+}
+
 Formats3d::Formats3d() : Property(Video3DFormatsPropertyType, true) {
 }
 
@@ -39,6 +91,33 @@ Formats3d::Formats3d(unsigned char native,
     h264_codecs_3d_(h264_codecs_3d) {
 }
 
+Formats3d::Formats3d(NativeVideoFormat format,
+    bool preferred_display_mode,
+    const std::vector<H264Video3DFormat>& h264_formats)
+  : Property(Video3DFormatsPropertyType),
+    native_((format.rate_resolution << 3) | format.type),
+    preferred_display_mode_(preferred_display_mode ? 1 : 0) {
+  for (const auto& h264_format : h264_formats)
+    h264_codecs_3d_.push_back(H264Codec3d(h264_format));
+}
+
+Formats3d::Formats3d(NativeVideoFormat format,
+    bool preferred_display_mode,
+    const std::vector<H264Video3DCodec>& h264_codecs)
+  : Property(Video3DFormatsPropertyType),
+    native_((format.rate_resolution << 3) | format.type),
+    preferred_display_mode_(preferred_display_mode ? 1 : 0) {
+  for (const auto& h264_codec : h264_codecs)
+    h264_codecs_3d_.push_back(H264Codec3d(h264_codec));
+}
+
+std::vector<H264Video3DCodec> Formats3d::GetH264Video3DCodecs() const {
+  std::vector<H264Video3DCodec> result;
+  for (const auto& codec : h264_codecs_3d_)
+    result.push_back(codec.ToH264Video3DCodec());
+  return result;
+}
+
 Formats3d::~Formats3d() {
   // TODO Auto-generated destructor stub
 }
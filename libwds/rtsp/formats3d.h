@@ -24,6 +24,7 @@
 #define LIBWDS_RTSP_FORMATS3D_H_
 
 #include "libwds/rtsp/property.h"
+#include "libwds/public/video_format.h"
 
 #include <vector>
 
@@ -49,6 +50,11 @@ struct H264Codec3d {
       max_hres_(max_hres),
       max_vres_(max_vres) {}
 
+  H264Codec3d(const H264Video3DFormat& format);
+  H264Codec3d(const H264Video3DCodec& codec);
+
+  H264Video3DCodec ToH264Video3DCodec() const;
+
   std::string ToString() const;
 
   unsigned char profile_;
@@ -70,12 +76,20 @@ class Formats3d: public Property {
   Formats3d(unsigned char native,
             unsigned char preferred_display_mode,
             const H264Codecs3d& h264_codecs_3d);
+  Formats3d(NativeVideoFormat format,
+            bool preferred_display_mode,
+            const std::vector<H264Video3DFormat>& h264_formats);
+  Formats3d(NativeVideoFormat format,
+            bool preferred_display_mode,
+            const std::vector<H264Video3DCodec>& h264_codecs);
   ~Formats3d() override;
 
   unsigned char native_resolution() const { return native_; }
   unsigned char preferred_display_mode() const { return preferred_display_mode_;}
   const H264Codecs3d& codecs() const { return h264_codecs_3d_; }
 
+  std::vector<H264Video3DCodec> GetH264Video3DCodecs() const;
+
   std::string ToString() const override;
 
  private:
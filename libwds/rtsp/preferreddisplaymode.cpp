@@ -49,6 +49,40 @@ PreferredDisplayMode::PreferredDisplayMode(
     h264_codec_(h264_codec) {
 }
 
+namespace {
+
+const unsigned short kSyncPositive = 1 << 15;
+
+}  // namespace
+
+PreferredDisplayMode::PreferredDisplayMode(const DisplayTiming& timing,
+                                           const H264VideoCodec& codec)
+  : PreferredDisplayMode(timing.pixel_clock, timing.h_active,
+        timing.h_blanking,
+        timing.h_sync_offset | (timing.h_sync_positive ? kSyncPositive : 0),
+        timing.h_sync_width, timing.v_active, timing.v_blanking,
+        timing.v_sync_offset | (timing.v_sync_positive ? kSyncPositive : 0),
+        timing.v_sync_width,
+        0, 0, 0,  // Neither 3D frame packing nor modes, default pixel depth
+        H264Codec(codec)) {
+}
+
+DisplayTiming PreferredDisplayMode::ToDisplayTiming() const {
+  DisplayTiming timing;
+  timing.pixel_clock = p_clock_;
+  timing.h_active = h_;
+  timing.h_blanking = hb_;
+  timing.h_sync_offset = hspol_hsoff_ & ~kSyncPositive;
+  timing.h_sync_positive = hspol_hsoff_ & kSyncPositive;
+  timing.h_sync_width = hsw_;
+  timing.v_active = v_;
+  timing.v_blanking = vb_;
+  timing.v_sync_offset = vspol_vsoff_ & ~kSyncPositive;
+  timing.v_sync_positive = vspol_vsoff_ & kSyncPositive;
+  timing.v_sync_width = vsw_;
+  return timing;
+}
+
 std::string PreferredDisplayMode::ToString() const {
   MAKE_HEX_STRING_6(p_clock, p_clock_);
   MAKE_HEX_STRING_4(h, h_);
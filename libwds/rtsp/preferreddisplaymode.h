@@ -37,9 +37,12 @@ class PreferredDisplayMode: public Property {
       unsigned short v, unsigned short vb, unsigned short vspol_vsoff,
       unsigned short vsw, unsigned char vbs3d, unsigned char modes_2d_s3d,
       unsigned char p_depth, const H264Codec& h264_codec);
+  PreferredDisplayMode(const DisplayTiming& timing, const H264VideoCodec& codec);
 
   ~PreferredDisplayMode() override;
 
+  DisplayTiming ToDisplayTiming() const;
+
   unsigned int p_clock() const { return p_clock_; }
   unsigned short h() const { return h_; }
   unsigned short hb() const { return hb_; }
@@ -0,0 +1,143 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <list>
+#include <vector>
+
+#include "libwds/public/audio_codec.h"
+#include "test_harness.h"
+
+using wds::AudioCodec;
+using wds::AudioModes;
+
+namespace {
+
+// What a desktop source sends
+std::vector<AudioCodec> StereoCodecs() {
+  return {MakeCodec(wds::LPCM, {wds::LPCM_48K_16B_2CH}),
+          MakeCodec(wds::AAC, {wds::AAC_48K_16B_2CH}),
+          MakeCodec(wds::AC3, {wds::AC3_48K_16B_2CH})};
+}
+
+// What a TV sends
+std::vector<AudioCodec> TvCodecs(unsigned lpcm_latency = 0) {
+  return {MakeCodec(wds::LPCM, {wds::LPCM_44_1K_16B_2CH, wds::LPCM_48K_16B_2CH},
+                    lpcm_latency),
+          MakeCodec(wds::AAC, {wds::AAC_48K_16B_2CH, wds::AAC_48K_16B_6CH}, 2),
+          MakeCodec(wds::AC3, {wds::AC3_48K_16B_2CH}, 2)};
+}
+
+bool IsCodec(const AudioCodec& codec, wds::AudioFormats format, unsigned mode,
+             unsigned latency) {
+  return codec.format == format && codec.modes == AudioModes().set(mode) &&
+         codec.latency == latency;
+}
+
+}  // namespace
+
+static bool test_lowest_latency ()
+{
+  bool success = false;
+  AudioCodec codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), StereoCodecs(), TvCodecs(), &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::LPCM, wds::LPCM_48K_16B_2CH, 0));
+
+  // AAC is one rank and 10 ms of decoding behind, 35 ms of LPCM is more
+  codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), StereoCodecs(), TvCodecs(7), &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::AAC, wds::AAC_48K_16B_2CH, 2));
+
+  // and on a tie the rank wins
+  codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), StereoCodecs(), TvCodecs(6), &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::LPCM, wds::LPCM_48K_16B_2CH, 6));
+  return 1;
+}
+
+static bool test_lowest_bandwidth ()
+{
+  bool success = false;
+  AudioCodec codec = wds::FindOptimalAudioCodec(
+      wds::LowestBandwidthAudioPreference(), StereoCodecs(), TvCodecs(), &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::AAC, wds::AAC_48K_16B_2CH, 2));
+
+  // Latency only breaks ties between codecs of the same format
+  std::vector<AudioCodec> remote = {
+      MakeCodec(wds::AC3, {wds::AC3_48K_16B_2CH}, 1),
+      MakeCodec(wds::AAC, {wds::AAC_48K_16B_2CH}, 9),
+      MakeCodec(wds::AAC, {wds::AAC_48K_16B_2CH}, 4)};
+  codec = wds::FindOptimalAudioCodec(
+      wds::LowestBandwidthAudioPreference(), StereoCodecs(), remote, &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::AAC, wds::AAC_48K_16B_2CH, 4));
+  return 1;
+}
+
+static bool test_modes ()
+{
+  // The first common mode, the higher latency
+  std::vector<AudioCodec> local = {
+      MakeCodec(wds::AAC, {wds::AAC_48K_16B_4CH, wds::AAC_48K_16B_6CH}, 3)};
+  std::vector<AudioCodec> remote = {
+      MakeCodec(wds::AAC, {wds::AAC_48K_16B_2CH, wds::AAC_48K_16B_6CH,
+                           wds::AAC_48K_16B_8CH}, 1)};
+  bool success = false;
+  AudioCodec codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), local, remote, &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::AAC, wds::AAC_48K_16B_6CH, 3));
+
+  // Same format, no common mode
+  local = {MakeCodec(wds::LPCM, {wds::LPCM_48K_16B_2CH})};
+  remote = {MakeCodec(wds::LPCM, {wds::LPCM_44_1K_16B_2CH})};
+  codec = wds::FindOptimalAudioCodec(
+      wds::LowestLatencyAudioPreference(), local, remote, &success);
+  ASSERT(!success);
+
+  // Formats not in the preference are not used
+  local = StereoCodecs();
+  remote = TvCodecs();
+  codec = wds::FindOptimalAudioCodec(
+      wds::AudioCodecPreference({wds::AC3}, 0), local, remote, &success);
+  ASSERT(success);
+  ASSERT(IsCodec(codec, wds::AC3, wds::AC3_48K_16B_2CH, 2));
+  remote = {MakeCodec(wds::LPCM, {wds::LPCM_48K_16B_2CH})};
+  codec = wds::FindOptimalAudioCodec(
+      wds::AudioCodecPreference({wds::AAC, wds::AC3}, 0), local, remote, &success);
+  ASSERT(!success);
+  return 1;
+}
+
+int main(const int argc, const char **argv)
+{
+  std::list<TestFunc> tests;
+
+  // Add tests
+  tests.push_back(test_lowest_latency);
+  tests.push_back(test_lowest_bandwidth);
+  tests.push_back(test_modes);
+
+  return RunTests(tests);
+}
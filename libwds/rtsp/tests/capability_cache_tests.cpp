@@ -0,0 +1,101 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <list>
+
+#include "libwds/public/capability_cache.h"
+#include "test_harness.h"
+
+using wds::CapabilityCache;
+using wds::SinkCapabilities;
+
+static bool test_find_and_store ()
+{
+  CapabilityCache cache;
+  SinkCapabilities found;
+  ASSERT(!cache.Find("02:00:00:00:00:01", &found));
+
+  cache.Store("02:00:00:00:00:01", MakeCapabilities(1028));
+  ASSERT(cache.Find("02:00:00:00:00:01", &found));
+  ASSERT(found.rtp_port0 == 1028);
+  ASSERT(found.native_format.rate_resolution == wds::CEA1280x720p30);
+  ASSERT(found.video_codecs.size() == 1);
+  ASSERT(found.audio_codecs.size() == 1);
+  ASSERT(!cache.Find("02:00:00:00:00:02", &found));
+
+  // Replaces the previous entry
+  cache.Store("02:00:00:00:00:01", MakeCapabilities(1030));
+  ASSERT(cache.size() == 1);
+  ASSERT(cache.Find("02:00:00:00:00:01", &found));
+  ASSERT(found.rtp_port0 == 1030);
+
+  cache.Remove("02:00:00:00:00:01");
+  ASSERT(!cache.Find("02:00:00:00:00:01", &found));
+  ASSERT(cache.size() == 0);
+  return 1;
+}
+
+static bool test_least_recently_used_is_dropped ()
+{
+  CapabilityCache cache(2);
+  SinkCapabilities found;
+  cache.Store("a", MakeCapabilities(1));
+  cache.Store("b", MakeCapabilities(2));
+  // "a" is now more recent than "b"
+  ASSERT(cache.Find("a", &found));
+  cache.Store("c", MakeCapabilities(3));
+
+  ASSERT(cache.size() == 2);
+  ASSERT(cache.Find("a", &found));
+  ASSERT(!cache.Find("b", &found));
+  ASSERT(cache.Find("c", &found));
+  ASSERT(found.rtp_port0 == 3);
+  return 1;
+}
+
+static bool test_disabled_cache ()
+{
+  SinkCapabilities found;
+
+  CapabilityCache no_entries(0);
+  no_entries.Store("a", MakeCapabilities(1));
+  ASSERT(no_entries.size() == 0);
+  ASSERT(!no_entries.Find("a", &found));
+
+  // Entries of no age are too old already, and dropped once found
+  CapabilityCache no_age(16, 0);
+  no_age.Store("a", MakeCapabilities(1));
+  ASSERT(!no_age.Find("a", &found));
+  ASSERT(no_age.size() == 0);
+  return 1;
+}
+
+int main(const int argc, const char **argv)
+{
+  std::list<TestFunc> tests;
+
+  // Add tests
+  tests.push_back(test_find_and_store);
+  tests.push_back(test_least_recently_used_is_dropped);
+  tests.push_back(test_disabled_cache);
+
+  return RunTests(tests);
+}
@@ -0,0 +1,213 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <list>
+#include <vector>
+
+#include "libwds/public/edid.h"
+#include "test_harness.h"
+
+using wds::EdidDisplayInfo;
+
+namespace {
+
+// A 1920x1080p60 monitor with established, standard and CEA-861 timings
+const unsigned char kMonitorEdid[] = {
+  0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x10, 0xac, 0x34, 0x12,
+  0x01, 0x00, 0x00, 0x00, 0x01, 0x1c, 0x01, 0x04, 0xa5, 0x35, 0x1e, 0x78,
+  0x3a, 0xee, 0x95, 0xa3, 0x54, 0x4c, 0x99, 0x26, 0x0f, 0x50, 0x54, 0x21,
+  0x08, 0x00, 0x81, 0x80, 0x95, 0x00, 0xb3, 0x00, 0x81, 0xc0, 0x01, 0x01,
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x02, 0x3a, 0x80, 0x18, 0x71, 0x38,
+  0x2d, 0x40, 0x58, 0x2c, 0x45, 0x00, 0x30, 0x1b, 0x21, 0x00, 0x00, 0x1e,
+  0x00, 0x00, 0x00, 0xfc, 0x00, 0x57, 0x44, 0x53, 0x20, 0x31, 0x30, 0x38,
+  0x30, 0x70, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x39, 0x02, 0x03, 0x10, 0x00,
+  0x4b, 0x90, 0x04, 0x1f, 0x22, 0x20, 0x13, 0x02, 0x11, 0x01, 0x05, 0x14,
+  0x01, 0x1d, 0x00, 0x72, 0x51, 0xd0, 0x1e, 0x20, 0x6e, 0x28, 0x55, 0x00,
+  0x30, 0x1b, 0x21, 0x00, 0x00, 0x1e, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x07
+};
+
+// A 1366x768 laptop panel, one detailed timing only
+const unsigned char kLaptopEdid[] = {
+  0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x10, 0xac, 0x34, 0x12,
+  0x01, 0x00, 0x00, 0x00, 0x01, 0x1c, 0x01, 0x04, 0xa5, 0x35, 0x1e, 0x78,
+  0x3a, 0xee, 0x95, 0xa3, 0x54, 0x4c, 0x99, 0x26, 0x0f, 0x50, 0x54, 0x00,
+  0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x71, 0x1c, 0x56, 0xaa, 0x50, 0x00,
+  0x16, 0x30, 0x30, 0x20, 0x35, 0x00, 0x30, 0x1b, 0x21, 0x00, 0x00, 0x1a,
+  0x00, 0x00, 0x00, 0xfc, 0x00, 0x57, 0x44, 0x53, 0x20, 0x70, 0x61, 0x6e,
+  0x65, 0x6c, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x1d
+};
+
+// A 3840x2160p60 TV, its CEA-861 modes are all below the native one
+const unsigned char kUhdEdid[] = {
+  0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00, 0x10, 0xac, 0x34, 0x12,
+  0x01, 0x00, 0x00, 0x00, 0x01, 0x1c, 0x01, 0x04, 0xa5, 0x35, 0x1e, 0x78,
+  0x3a, 0xee, 0x95, 0xa3, 0x54, 0x4c, 0x99, 0x26, 0x0f, 0x50, 0x54, 0x21,
+  0x00, 0x00, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x01,
+  0x01, 0x01, 0x01, 0x01, 0x01, 0x01, 0x08, 0xe8, 0x00, 0x30, 0xf2, 0x70,
+  0x5a, 0x80, 0xb0, 0x58, 0x8a, 0x00, 0x30, 0x1b, 0x21, 0x00, 0x00, 0x1e,
+  0x00, 0x00, 0x00, 0xfc, 0x00, 0x57, 0x44, 0x53, 0x20, 0x32, 0x31, 0x36,
+  0x30, 0x70, 0x0a, 0x20, 0x20, 0x20, 0x00, 0x00, 0x00, 0x10, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x10, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x01, 0x88, 0x02, 0x03, 0x07, 0x00,
+  0x42, 0x10, 0x04, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+  0x00, 0x00, 0x00, 0x9e
+};
+
+std::vector<unsigned char> ToVector(const unsigned char* edid, size_t size) {
+  return std::vector<unsigned char>(edid, edid + size);
+}
+
+wds::RateAndResolutionsBitmap Modes(std::initializer_list<unsigned> modes) {
+  wds::RateAndResolutionsBitmap bitmap;
+  for (unsigned mode : modes)
+    bitmap.set(mode);
+  return bitmap;
+}
+
+}  // namespace
+
+static bool test_monitor ()
+{
+  EdidDisplayInfo info;
+  ASSERT(wds::ParseEdid(ToVector(kMonitorEdid, sizeof(kMonitorEdid)), &info));
+  ASSERT(info.native_format.type == wds::CEA);
+  ASSERT(info.native_format.rate_resolution == wds::CEA1920x1080p60);
+  // 24 Hz only from its short video descriptor, 25 at half of 50 Hz
+  ASSERT(info.cea_rr == Modes({wds::CEA640x480p60, wds::CEA720x480p60,
+                               wds::CEA720x576p50, wds::CEA1280x720p30,
+                               wds::CEA1280x720p60, wds::CEA1920x1080p30,
+                               wds::CEA1920x1080p60, wds::CEA1920x1080i60,
+                               wds::CEA1280x720p25, wds::CEA1280x720p50,
+                               wds::CEA1920x1080p25, wds::CEA1920x1080p50,
+                               wds::CEA1920x1080i50, wds::CEA1920x1080p24}));
+  ASSERT(info.vesa_rr == Modes({wds::VESA800x600p30, wds::VESA800x600p60,
+                                wds::VESA1024x768p30, wds::VESA1024x768p60,
+                                wds::VESA1280x1024p30, wds::VESA1280x1024p60,
+                                wds::VESA1440x900p30, wds::VESA1440x900p60,
+                                wds::VESA1680x1050p30, wds::VESA1680x1050p60}));
+  ASSERT(info.hh_rr.none());
+
+  ASSERT(info.has_preferred_timing);
+  const wds::DisplayTiming& timing = info.preferred_timing;
+  ASSERT(timing.pixel_clock == 14850);
+  ASSERT(timing.h_active == 1920 && timing.h_blanking == 280);
+  ASSERT(timing.h_sync_offset == 88 && timing.h_sync_width == 44);
+  ASSERT(timing.v_active == 1080 && timing.v_blanking == 45);
+  ASSERT(timing.v_sync_offset == 4 && timing.v_sync_width == 5);
+  ASSERT(timing.h_sync_positive && timing.v_sync_positive);
+  ASSERT(!timing.interlaced);
+  return 1;
+}
+
+static bool test_laptop_panel ()
+{
+  EdidDisplayInfo info;
+  ASSERT(wds::ParseEdid(ToVector(kLaptopEdid, sizeof(kLaptopEdid)), &info));
+  ASSERT(info.native_format.type == wds::VESA);
+  ASSERT(info.native_format.rate_resolution == wds::VESA1366x768p60);
+  ASSERT(info.cea_rr == Modes({wds::CEA640x480p60}));
+  ASSERT(info.vesa_rr == Modes({wds::VESA1366x768p30, wds::VESA1366x768p60}));
+  ASSERT(info.hh_rr.none());
+  ASSERT(info.has_preferred_timing);
+  ASSERT(info.preferred_timing.h_active == 1366);
+  ASSERT(info.preferred_timing.v_active == 768);
+  ASSERT(info.preferred_timing.h_sync_positive);
+  ASSERT(!info.preferred_timing.v_sync_positive);
+  return 1;
+}
+
+static bool test_uhd_tv ()
+{
+  EdidDisplayInfo info;
+  ASSERT(wds::ParseEdid(ToVector(kUhdEdid, sizeof(kUhdEdid)), &info));
+  // No WFD mode is 3840x2160, the largest one the TV shows is native
+  ASSERT(info.native_format.type == wds::CEA);
+  ASSERT(info.native_format.rate_resolution == wds::CEA1920x1080p60);
+  ASSERT(info.cea_rr == Modes({wds::CEA640x480p60, wds::CEA1280x720p30,
+                               wds::CEA1280x720p60, wds::CEA1920x1080p30,
+                               wds::CEA1920x1080p60}));
+  ASSERT(info.preferred_timing.h_active == 3840);
+  ASSERT(info.preferred_timing.pixel_clock == 59400);
+  return 1;
+}
+
+static bool test_invalid_edid ()
+{
+  EdidDisplayInfo info;
+  std::vector<unsigned char> edid = ToVector(kMonitorEdid, sizeof(kMonitorEdid));
+  ASSERT(!wds::ParseEdid(std::vector<unsigned char>(), &info));
+  ASSERT(!wds::ParseEdid(std::vector<unsigned char>(edid.begin(), edid.begin() + 100), &info));
+
+  // A wrong checksum in the extension
+  edid[200] ^= 1;
+  ASSERT(!wds::ParseEdid(edid, &info));
+
+  // The header
+  edid = ToVector(kLaptopEdid, sizeof(kLaptopEdid));
+  edid[0] = 0x01;
+  edid[127] -= 1;
+  ASSERT(!wds::ParseEdid(edid, &info));
+
+  // Extensions beyond the base block's count are not read
+  edid = ToVector(kLaptopEdid, sizeof(kLaptopEdid));
+  edid.resize(256, 0xff);
+  ASSERT(wds::ParseEdid(edid, &info));
+  ASSERT(info.native_format.rate_resolution == wds::VESA1366x768p60);
+  return 1;
+}
+
+int main(const int argc, const char **argv)
+{
+  std::list<TestFunc> tests;
+
+  // Add tests
+  tests.push_back(test_monitor);
+  tests.push_back(test_laptop_panel);
+  tests.push_back(test_uhd_tv);
+  tests.push_back(test_invalid_edid);
+
+  return RunTests(tests);
+}
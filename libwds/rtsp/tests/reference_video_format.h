@@ -0,0 +1,91 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef LIBWDS_RTSP_TESTS_REFERENCE_VIDEO_FORMAT_H_
+#define LIBWDS_RTSP_TESTS_REFERENCE_VIDEO_FORMAT_H_
+
+#include <algorithm>
+#include <vector>
+
+#include "libwds/public/video_format.h"
+
+namespace wds {
+namespace reference {
+
+// The list based negotiation wds::FindOptimalVideoFormat() replaced,
+// kept to check the bitmap based one against. The lists are stable
+// sorted: std::sort left formats of the same weight, profile and level
+// in an unspecified order.
+
+inline unsigned QualityWeight(const H264VideoFormat& format) {
+  VideoFormatInfo info = GetVideoFormatInfo(format);
+  return info.width * info.height * info.frame_rate * (info.interlaced ? 1 : 2);
+}
+
+inline bool SameResolution(const H264VideoFormat& a, const H264VideoFormat& b) {
+  VideoFormatInfo info_a = GetVideoFormatInfo(a);
+  VideoFormatInfo info_b = GetVideoFormatInfo(b);
+  return a.type == b.type &&
+         info_a.width == info_b.width && info_a.height == info_b.height;
+}
+
+inline bool QualityLess(const H264VideoFormat& a, const H264VideoFormat& b) {
+  if (QualityWeight(a) != QualityWeight(b))
+    return QualityWeight(a) < QualityWeight(b);
+  if (a.profile != b.profile)
+    return a.profile < b.profile;
+  return a.level < b.level;
+}
+
+inline H264VideoFormat FindOptimalVideoFormat(
+    const std::vector<H264VideoCodec>& local_codecs,
+    const std::vector<H264VideoCodec>& remote_codecs,
+    bool* success) {
+  std::vector<H264VideoFormat> local_formats, remote_formats;
+  for (const auto& codec : local_codecs)
+    PopulateVideoFormatList(codec, local_formats);
+  for (const auto& codec : remote_codecs)
+    PopulateVideoFormatList(codec, remote_formats);
+
+  std::stable_sort(local_formats.begin(), local_formats.end(), QualityLess);
+  std::stable_sort(remote_formats.begin(), remote_formats.end(), QualityLess);
+
+  for (const auto& local : local_formats) {
+    auto match = std::find_if(remote_formats.begin(), remote_formats.end(),
+        [&local] (const H264VideoFormat& remote) {
+          return SameResolution(local, remote);
+        });
+    if (match == remote_formats.end())
+      continue;
+    H264VideoFormat format = *match;
+    format.profile = std::min(format.profile, local.profile);
+    format.level = std::min(format.level, local.level);
+    *success = true;
+    return format;
+  }
+  *success = false;
+  return H264VideoFormat();
+}
+
+}  // namespace reference
+}  // namespace wds
+
+#endif  // LIBWDS_RTSP_TESTS_REFERENCE_VIDEO_FORMAT_H_
@@ -0,0 +1,135 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+#ifndef LIBWDS_RTSP_TESTS_TEST_HARNESS_H_
+#define LIBWDS_RTSP_TESTS_TEST_HARNESS_H_
+
+#include <exception>
+#include <initializer_list>
+#include <iostream>
+#include <list>
+
+#include "libwds/public/media_manager.h"
+
+// Shared by the libwds test binaries: a test returns false (with one of
+// the ASSERT macros) on its first failed check, main() collects the
+// tests and returns RunTests().
+
+typedef bool (*TestFunc)(void);
+
+#define ASSERT_EQUAL(value, expected) \
+  if ((value) != (expected)) { \
+    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
+              << #value << ": " \
+              << "expected '" << (expected) \
+              << "', got '" << (value) << "'" \
+              << std::endl; \
+    return 0; \
+  }
+
+#define ASSERT(assertion) \
+  if (!(assertion)) { \
+    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
+              << "assertion failed: " << #assertion \
+              << std::endl; \
+    return 0; \
+  }
+
+#define ASSERT_NO_EXCEPTION(method_call) \
+  try { \
+    method_call; \
+  } catch (std::exception &x) { \
+    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
+              << "unexpected exception: " << #method_call << ": " \
+              << x.what() << std::endl; \
+    return false; \
+  }
+
+#define ASSERT_EXCEPTION(method_call) \
+  try { \
+    method_call; \
+    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
+              << "expected exception: " << #method_call << std::endl; \
+    return false; \
+  } catch (std::exception &x) { \
+    ; \
+  }
+
+// Runs all tests, the exit status of the test binary
+inline int RunTests(const std::list<TestFunc>& tests) {
+  int failures = 0;
+  for (TestFunc test : tests) {
+    if (!test())
+      failures++;
+  }
+
+  if (failures > 0) {
+    std::cout << std::endl << "Failed " << failures
+              << " out of " << tests.size() << " tests" << std::endl;
+    return 1;
+  }
+
+  std::cout << "Passed all " << tests.size() << " tests" << std::endl;
+  return 0;
+}
+
+// Fixtures
+
+// A codec with the given CEA, VESA and HH modes
+inline wds::H264VideoCodec MakeCodec(wds::H264Profile profile,
+                                     wds::H264Level level,
+                                     std::initializer_list<unsigned> cea = {},
+                                     std::initializer_list<unsigned> vesa = {},
+                                     std::initializer_list<unsigned> hh = {}) {
+  wds::H264VideoCodec codec(profile, level, wds::RateAndResolutionsBitmap(),
+                            wds::RateAndResolutionsBitmap(),
+                            wds::RateAndResolutionsBitmap());
+  for (unsigned mode : cea)
+    codec.cea_rr.set(mode);
+  for (unsigned mode : vesa)
+    codec.vesa_rr.set(mode);
+  for (unsigned mode : hh)
+    codec.hh_rr.set(mode);
+  return codec;
+}
+
+// An audio codec with the given modes
+inline wds::AudioCodec MakeCodec(wds::AudioFormats format,
+                                 std::initializer_list<unsigned> modes,
+                                 unsigned latency = 0) {
+  wds::AudioModes bitmap;
+  for (unsigned mode : modes)
+    bitmap.set(mode);
+  return wds::AudioCodec(format, bitmap, latency);
+}
+
+// A sink with one video and one audio codec, told apart by its port
+inline wds::SinkCapabilities MakeCapabilities(int rtp_port) {
+  wds::SinkCapabilities capabilities;
+  capabilities.native_format = wds::NativeVideoFormat(wds::CEA1280x720p30);
+  capabilities.video_codecs.push_back(wds::H264VideoCodec());
+  capabilities.audio_codecs.push_back(wds::AudioCodec());
+  capabilities.rtp_port0 = rtp_port;
+  return capabilities;
+}
+
+#endif  // LIBWDS_RTSP_TESTS_TEST_HARNESS_H_
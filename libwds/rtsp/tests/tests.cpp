@@ -41,49 +41,10 @@
 #include "libwds/rtsp/triggermethod.h"
 #include "libwds/rtsp/uibcsetting.h"
 #include "libwds/rtsp/videoformats.h"
+#include "test_harness.h"
 
 using wds::rtsp::Driver;
 
-typedef bool (*TestFunc)(void);
-
-#define ASSERT_EQUAL(value, expected) \
-  if ((value) != (expected)) { \
-    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
-              << #value << ": " \
-              << "expected '" << (expected) \
-              << "', got '" << (value) << "'" \
-              << std::endl; \
-    return 0; \
-  }
-
-#define ASSERT(assertion) \
-  if (!(assertion)) { \
-    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
-              << "assertion failed: " << #assertion \
-              << std::endl; \
-    return 0; \
-  }
-
-#define ASSERT_NO_EXCEPTION(method_call) \
-  try { \
-    method_call; \
-  } catch (std::exception &x) { \
-    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
-              << "unexpected exception: " << #method_call << ": " \
-              << x.what() << std::endl; \
-    return false; \
-  }
-
-#define ASSERT_EXCEPTION(method_call) \
-  try { \
-    method_call; \
-    std::cout << __func__ << " (" << __FILE__ << ":" << __LINE__ << "): " \
-              << "expected exception: " << #method_call << std::endl; \
-    return false; \
-  } catch (std::exception &x) { \
-    ; \
-  }
-
 static bool property_type_exists (std::vector<std::string> properties,
                                   wds::rtsp::PropertyType type)
 {
@@ -503,6 +464,14 @@ static bool test_valid_get_parameter_reply ()
   ASSERT_EQUAL(video_formats->GetNativeFormat().rate_resolution, 8);
   ASSERT_EQUAL(video_formats->GetNativeFormat().type, 0);
   ASSERT_EQUAL(video_formats->GetH264Formats().size(), 96);
+  ASSERT_EQUAL(video_formats->GetH264Formats()[0].frame_rate_control_support, 0x11);
+  auto h264_codecs = video_formats->GetH264VideoCodecs();
+  ASSERT_EQUAL(h264_codecs.size(), 2);
+  ASSERT_EQUAL(h264_codecs[1].latency, 0);
+  ASSERT_EQUAL(h264_codecs[1].min_slice_size, 0);
+  ASSERT_EQUAL(h264_codecs[1].frame_rate_control_support, 0x11);
+  ASSERT_EQUAL(h264_codecs[1].max_hres, 0x400);
+  ASSERT_EQUAL(h264_codecs[1].max_vres, 0x300);
 
   ASSERT_NO_EXCEPTION (prop =
       payload->GetProperty(wds::rtsp::Video3DFormatsPropertyType));
@@ -513,6 +482,20 @@ static bool test_valid_get_parameter_reply ()
   ASSERT_EQUAL(formats_3d->codecs().size(), 1);
   ASSERT(test_h264_codec_3d (formats_3d->codecs()[0],
                              0x03, 0x0F, 0x0000000000000005, 0, 0x0001, 0x1401, 0x13, 0, 0));
+  auto h264_codecs_3d = formats_3d->GetH264Video3DCodecs();
+  ASSERT_EQUAL(h264_codecs_3d.size(), 1);
+  ASSERT_EQUAL(h264_codecs_3d[0].profile, wds::CBP);
+  ASSERT_EQUAL(h264_codecs_3d[0].level, wds::k3_1);
+  ASSERT_EQUAL(h264_codecs_3d[0].modes.to_ullong(), 5);
+  ASSERT_EQUAL(h264_codecs_3d[0].slice_enc_params, 0x1401);
+
+  // The chosen 3D format as the source sends it in M4
+  wds::H264Video3DFormat format_3d(wds::CHP, wds::k4_1, 2);
+  format_3d.frame_rate_control_support = 0x11;
+  wds::rtsp::Formats3d selected_3d(wds::NativeVideoFormat(), false,
+                                   std::vector<wds::H264Video3DFormat>{format_3d});
+  ASSERT_EQUAL(selected_3d.ToString(),
+               "wfd_3d_video_formats: 00 00 02 08 0000000000000004 00 0000 0000 11 none none");
 
   ASSERT_NO_EXCEPTION (prop =
       payload->GetProperty(wds::rtsp::ContentProtectionPropertyType));
@@ -717,6 +700,61 @@ static bool test_valid_set_parameter ()
   return true;
 }
 
+static bool test_valid_set_parameter_3d_only ()
+{
+  std::string header("SET_PARAMETER rtsp://localhost/wfd1.0 RTSP/1.0\r\n"
+                     "CSeq: 3\r\n"
+                     "Content-Type: text/parameters\r\n"
+                     "Content-Length: 231\r\n\r\n");
+  std::string payload_buffer("wfd_3d_video_formats: 00 00 02 08 0000000000000004 00 0000 0000 11 none none\r\n"
+                      "wfd_client_rtp_ports: RTP/AVP/UDP;unicast 19000 0 mode=play\r\n"
+                      "wfd_presentation_URL: rtsp://192.168.173.1/wfd1.0/streamid=0 none\r\n"
+                      "wfd_video_formats: none\r\n");
+
+  // The M4 as the source builds it when a 3D format is chosen
+  wds::H264Video3DFormat format_3d(wds::CHP, wds::k4_1, 2);
+  format_3d.frame_rate_control_support = 0x11;
+  wds::rtsp::PropertyMapPayload selected;
+  selected.AddProperty(std::make_shared<wds::rtsp::Formats3d>(
+      wds::NativeVideoFormat(), false, std::vector<wds::H264Video3DFormat>{format_3d}));
+  selected.AddProperty(std::make_shared<wds::rtsp::ClientRtpPorts>(19000, 0));
+  selected.AddProperty(std::make_shared<wds::rtsp::PresentationUrl>(
+      "rtsp://192.168.173.1/wfd1.0/streamid=0", ""));
+  selected.AddProperty(std::make_shared<wds::rtsp::VideoFormats>());
+  ASSERT_EQUAL(selected.ToString(), payload_buffer);
+
+  std::unique_ptr<wds::rtsp::Message> message;
+  Driver::Parse(header, message);
+  ASSERT(message != NULL);
+  ASSERT(message->is_request());
+  Driver::Parse(payload_buffer, message);
+  ASSERT(message != NULL);
+
+  auto payload = ToPropertyMapPayload(message->payload());
+  ASSERT(payload);
+  std::shared_ptr<wds::rtsp::Property> prop;
+
+  ASSERT_NO_EXCEPTION (prop =
+      payload->GetProperty(wds::rtsp::VideoFormatsPropertyType));
+  ASSERT(prop);
+  ASSERT(prop->is_none());
+
+  ASSERT_NO_EXCEPTION (prop =
+      payload->GetProperty(wds::rtsp::Video3DFormatsPropertyType));
+  std::shared_ptr<wds::rtsp::Formats3d> formats_3d = std::static_pointer_cast<wds::rtsp::Formats3d> (prop);
+  ASSERT(formats_3d);
+  ASSERT(!formats_3d->is_none());
+  auto h264_codecs_3d = formats_3d->GetH264Video3DCodecs();
+  ASSERT_EQUAL(h264_codecs_3d.size(), 1);
+  ASSERT_EQUAL(h264_codecs_3d[0].profile, wds::CHP);
+  ASSERT_EQUAL(h264_codecs_3d[0].level, wds::k4_1);
+  ASSERT_EQUAL(h264_codecs_3d[0].modes.to_ullong(), 4);
+
+  ASSERT_EQUAL(message->ToString(), header + payload_buffer);
+
+  return true;
+}
+
 static bool test_valid_set_parameter_url_with_port ()
 {
   std::string header("SET_PARAMETER rtsp://localhost/wfd1.0 RTSP/1.0\r\n"
@@ -954,7 +992,6 @@ static bool test_number_conversion_in_errors ()
 int main(const int argc, const char **argv)
 {
   std::list<TestFunc> tests;
-  int failures = 0;
 
   // Add tests
   tests.push_back(test_valid_options);
@@ -965,6 +1002,7 @@ int main(const int argc, const char **argv)
   tests.push_back(test_valid_get_parameter_reply_with_errors);
   tests.push_back(test_valid_setup_reply);
   tests.push_back(test_valid_set_parameter);
+  tests.push_back(test_valid_set_parameter_3d_only);
   tests.push_back(test_valid_set_parameter_url_with_port);
   tests.push_back(test_valid_set_parameter_with_all_ipv4_url);
   tests.push_back(test_valid_setup);
@@ -980,19 +1018,5 @@ int main(const int argc, const char **argv)
   tests.push_back(test_hex_number_conversion_body_2);
   tests.push_back(test_number_conversion_in_errors);
 
-  // Run tests
-  for (std::list<TestFunc>::iterator it=tests.begin(); it!=tests.end(); ++it) {
-    TestFunc test = *it;
-    if (!test())
-      failures++;
-  }
-
-  if (failures > 0) {
-    std::cout << std::endl << "Failed " << failures
-              << " out of " << tests.size() << " tests" << std::endl;
-    return 1;
-  }
-
-  std::cout << "Passed all " << tests.size() << " tests" << std::endl;
-  return 0;
+  return RunTests(tests);
 }
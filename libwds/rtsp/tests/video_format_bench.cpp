@@ -0,0 +1,122 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Time per wds::FindOptimalVideoFormat() call, next to the list based
+ * implementation it replaced, for a few typical capability sets.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+#include "libwds/public/video_format.h"
+#include "reference_video_format.h"
+
+using wds::H264VideoCodec;
+using wds::RateAndResolutionsBitmap;
+
+namespace {
+
+struct Scenario {
+  const char* name;
+  std::vector<H264VideoCodec> local;
+  std::vector<H264VideoCodec> remote;
+};
+
+RateAndResolutionsBitmap Modes(std::initializer_list<unsigned> modes) {
+  RateAndResolutionsBitmap bitmap;
+  for (unsigned mode : modes)
+    bitmap.set(mode);
+  return bitmap;
+}
+
+H264VideoCodec AllModes(wds::H264Profile profile, wds::H264Level level) {
+  return H264VideoCodec(profile, level,
+      RateAndResolutionsBitmap((1u << (wds::CEA1920x1080p24 + 1)) - 1),
+      RateAndResolutionsBitmap((1u << (wds::VESA1920x1200p30 + 1)) - 1),
+      RateAndResolutionsBitmap((1u << (wds::HH848x480p60 + 1)) - 1));
+}
+
+// Time per call in nanoseconds
+template <typename Function>
+double Measure(Function find, const Scenario& scenario, unsigned& checksum) {
+  const int iterations = 100000;
+  auto start = std::chrono::steady_clock::now();
+  for (int i = 0; i < iterations; ++i) {
+    bool success = false;
+    wds::H264VideoFormat format = find(scenario.local, scenario.remote, &success);
+    checksum += format.rate_resolution + success;
+  }
+  std::chrono::duration<double, std::nano> elapsed =
+      std::chrono::steady_clock::now() - start;
+  return elapsed.count() / iterations;
+}
+
+}  // namespace
+
+int main(int argc, char *argv[])
+{
+  // A TV: CEA up to 1080p60, a few VESA modes, CBP and CHP
+  H264VideoCodec tv_cbp(wds::CBP, wds::k4_1,
+      Modes({wds::CEA640x480p60, wds::CEA720x480p60, wds::CEA1280x720p30,
+             wds::CEA1280x720p60, wds::CEA1920x1080p30, wds::CEA1920x1080p60,
+             wds::CEA1920x1080i60}),
+      Modes({wds::VESA800x600p60, wds::VESA1024x768p60, wds::VESA1280x1024p60}),
+      RateAndResolutionsBitmap());
+  H264VideoCodec tv_chp = tv_cbp;
+  tv_chp.profile = wds::CHP;
+  tv_chp.level = wds::k4_2;
+
+  H264VideoCodec minimal;
+  H264VideoCodec phone(wds::CBP, wds::k3_1, Modes({wds::CEA640x480p60}),
+      RateAndResolutionsBitmap(),
+      Modes({wds::HH800x480p30, wds::HH854x480p30, wds::HH640x360p30}));
+
+  std::vector<Scenario> scenarios = {
+    {"640x480 only", {minimal}, {minimal}},
+    {"all modes vs TV", {AllModes(wds::CHP, wds::k4_2)}, {tv_cbp, tv_chp}},
+    {"all modes vs phone", {AllModes(wds::CBP, wds::k4_1)}, {phone}},
+    {"all modes both sides",
+     {AllModes(wds::CBP, wds::k3_1), AllModes(wds::CHP, wds::k4_2)},
+     {AllModes(wds::CBP, wds::k4), AllModes(wds::CHP, wds::k4_1)}},
+  };
+
+  unsigned checksum = 0;
+  printf("%-24s %12s %12s %8s\n", "capabilities", "lists ns", "bitmaps ns",
+         "speedup");
+  for (const Scenario& scenario : scenarios) {
+    double lists = Measure(wds::reference::FindOptimalVideoFormat,
+                           scenario, checksum);
+    double bitmaps = Measure(
+        [] (const std::vector<H264VideoCodec>& local,
+            const std::vector<H264VideoCodec>& remote, bool* success) {
+          return wds::FindOptimalVideoFormat(wds::NativeVideoFormat(),
+                                             local, remote, success);
+        }, scenario, checksum);
+    printf("%-24s %12.0f %12.0f %7.1fx\n", scenario.name, lists, bitmaps,
+           lists / bitmaps);
+  }
+  // Keeps the calls from being optimized out
+  return checksum == 0 ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,488 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <stdlib.h>
+
+#include <iostream>
+#include <list>
+#include <vector>
+
+#include "libwds/public/video_format.h"
+#include "libwds/public/video_format_policy.h"
+#include "reference_video_format.h"
+#include "test_harness.h"
+
+using wds::H264VideoCodec;
+using wds::H264VideoFormat;
+using wds::NativeVideoFormat;
+
+namespace {
+
+const unsigned kModeCount[] = {
+  wds::CEA1920x1080p24 + 1, wds::VESA1920x1200p30 + 1, wds::HH848x480p60 + 1
+};
+const unsigned kAllModeCount = kModeCount[0] + kModeCount[1] + kModeCount[2];
+
+// Modes of all tables are numbered CEA first, then VESA and HH
+void AddMode(H264VideoCodec& codec, unsigned mode) {
+  if (mode < kModeCount[0]) {
+    codec.cea_rr.set(mode);
+    return;
+  }
+  mode -= kModeCount[0];
+  if (mode < kModeCount[1]) {
+    codec.vesa_rr.set(mode);
+    return;
+  }
+  codec.hh_rr.set(mode - kModeCount[1]);
+}
+
+std::ostream& operator<<(std::ostream& os, const H264VideoFormat& format) {
+  return os << "{profile " << format.profile << ", level " << format.level
+            << ", type " << format.type << ", mode " << format.rate_resolution
+            << "}";
+}
+
+// Compares FindOptimalVideoFormat() to the list based implementation
+bool MatchesReference(const std::vector<H264VideoCodec>& local,
+                      const std::vector<H264VideoCodec>& remote) {
+  bool success = false;
+  bool expected_success = false;
+  H264VideoFormat format = wds::FindOptimalVideoFormat(
+      NativeVideoFormat(), local, remote, &success);
+  H264VideoFormat expected = wds::reference::FindOptimalVideoFormat(
+      local, remote, &expected_success);
+  if (success == expected_success &&
+      format.profile == expected.profile && format.level == expected.level &&
+      format.type == expected.type &&
+      format.rate_resolution == expected.rate_resolution)
+    return true;
+  std::cout << "got " << format << (success ? "" : " (failed)")
+            << ", expected " << expected
+            << (expected_success ? "" : " (failed)") << std::endl;
+  return false;
+}
+
+// All the sets of up to two modes
+std::vector<H264VideoCodec> SmallModeSets(wds::H264Profile profile,
+                                          wds::H264Level level) {
+  std::vector<H264VideoCodec> sets;
+  sets.push_back(MakeCodec(profile, level));
+  for (unsigned i = 0; i < kAllModeCount; ++i) {
+    for (unsigned j = i; j < kAllModeCount; ++j) {
+      H264VideoCodec codec = MakeCodec(profile, level);
+      AddMode(codec, i);
+      AddMode(codec, j);
+      sets.push_back(codec);
+    }
+  }
+  return sets;
+}
+
+H264VideoCodec AllModes(wds::H264Profile profile, wds::H264Level level) {
+  H264VideoCodec codec = MakeCodec(profile, level);
+  for (unsigned mode = 0; mode < kAllModeCount; ++mode)
+    AddMode(codec, mode);
+  return codec;
+}
+
+// A TV: CEA up to 1080p60 and a few VESA modes, with CBP and CHP
+std::vector<H264VideoCodec> TvCodecs() {
+  std::initializer_list<unsigned> cea = {
+    wds::CEA640x480p60, wds::CEA720x480p60, wds::CEA1280x720p30,
+    wds::CEA1280x720p60, wds::CEA1920x1080p30, wds::CEA1920x1080p60,
+    wds::CEA1920x1080i60
+  };
+  std::initializer_list<unsigned> vesa = {
+    wds::VESA800x600p60, wds::VESA1024x768p60, wds::VESA1280x1024p60
+  };
+  return {MakeCodec(wds::CBP, wds::k4_1, cea, vesa),
+          MakeCodec(wds::CHP, wds::k4_2, cea, vesa)};
+}
+
+struct PolicyCase {
+  const char* name;
+  NativeVideoFormat native;
+  std::vector<H264VideoCodec> local;
+  std::vector<H264VideoCodec> remote;
+  bool success;
+  H264VideoFormat expected;
+};
+
+bool RunPolicyCases(const wds::VideoFormatPolicy& policy,
+                    const std::vector<PolicyCase>& cases) {
+  bool passed = true;
+  for (const PolicyCase& test_case : cases) {
+    bool success = !test_case.success;
+    H264VideoFormat format = wds::FindOptimalVideoFormat(policy,
+        test_case.native, test_case.local, test_case.remote, &success);
+    if (success != test_case.success ||
+        (success && (format.profile != test_case.expected.profile ||
+                     format.level != test_case.expected.level ||
+                     format.type != test_case.expected.type ||
+                     format.rate_resolution !=
+                         test_case.expected.rate_resolution))) {
+      std::cout << test_case.name << ": got " << format
+                << (success ? "" : " (failed)") << ", expected "
+                << test_case.expected
+                << (test_case.success ? "" : " (failed)") << std::endl;
+      passed = false;
+    }
+  }
+  return passed;
+}
+
+H264VideoCodec RandomCodec() {
+  H264VideoCodec codec = MakeCodec(wds::H264Profile(rand() % (wds::CHP + 1)),
+                                   wds::H264Level(rand() % (wds::k4_2 + 1)));
+  // Sparse and dense sets, with the bits past the tables set at times
+  int density = 1 + rand() % 8;
+  for (unsigned bit = 0; bit < 32; ++bit) {
+    if (rand() % 16 < density)
+      codec.cea_rr.set(bit);
+    if (rand() % 16 < density)
+      codec.vesa_rr.set(bit);
+    if (rand() % 16 < density)
+      codec.hh_rr.set(bit);
+  }
+  return codec;
+}
+
+}  // namespace
+
+static bool test_small_mode_sets ()
+{
+  std::vector<H264VideoCodec> local = SmallModeSets(wds::CHP, wds::k4);
+  std::vector<H264VideoCodec> remote = SmallModeSets(wds::CBP, wds::k4_2);
+  for (const H264VideoCodec& local_codec : local) {
+    for (const H264VideoCodec& remote_codec : remote) {
+      ASSERT(MatchesReference({local_codec}, {remote_codec}));
+    }
+  }
+  return true;
+}
+
+static bool test_profiles_and_levels ()
+{
+  // Every mode offered with every profile and level on both sides
+  for (unsigned mode = 0; mode < kAllModeCount; ++mode) {
+    std::vector<H264VideoCodec> codecs;
+    for (int profile = wds::CBP; profile <= wds::CHP; ++profile) {
+      for (int level = wds::k3_1; level <= wds::k4_2; ++level) {
+        codecs.push_back(MakeCodec(wds::H264Profile(profile),
+                                   wds::H264Level(level)));
+        AddMode(codecs.back(), mode);
+      }
+    }
+    for (const H264VideoCodec& local : codecs)
+      for (const H264VideoCodec& remote : codecs)
+        ASSERT(MatchesReference({local}, {remote, local}));
+    ASSERT(MatchesReference(codecs, codecs));
+  }
+  return true;
+}
+
+static bool test_random_codec_lists ()
+{
+  srand(1);
+  for (int i = 0; i < 200000; ++i) {
+    std::vector<H264VideoCodec> local, remote;
+    for (int n = rand() % 4; n > 0; --n)
+      local.push_back(RandomCodec());
+    for (int n = rand() % 4; n > 0; --n)
+      remote.push_back(RandomCodec());
+    ASSERT(MatchesReference(local, remote));
+  }
+  return true;
+}
+
+static bool test_no_common_mode ()
+{
+  H264VideoCodec local = MakeCodec(wds::CHP, wds::k4_2);
+  local.cea_rr.set(wds::CEA1920x1080p30);
+  H264VideoCodec remote = MakeCodec(wds::CHP, wds::k4_2);
+  remote.vesa_rr.set(wds::VESA1920x1200p30);
+  remote.cea_rr.set(wds::CEA1280x720p30);
+
+  bool success = true;
+  wds::FindOptimalVideoFormat(NativeVideoFormat(), {local}, {remote}, &success);
+  ASSERT(!success);
+  wds::FindOptimalVideoFormat(NativeVideoFormat(), {}, {remote}, &success);
+  ASSERT(!success);
+  return true;
+}
+
+// Mode lookups are constant expressions
+static_assert(wds::GetVideoMode(wds::CEA, wds::CEA1920x1080i60).pixel_rate ==
+                  1920 * 1080 * 30,
+              "wrong interlaced pixel rate");
+static_assert(wds::GetVideoMode(H264VideoFormat(wds::CHP, wds::k4_2,
+                                                wds::VESA1920x1200p30))
+                  .height == 1200,
+              "wrong VESA mode");
+static_assert(wds::GetVideoModeIndex(wds::HH, wds::HH848x480p60) ==
+                  wds::kVideoModeCount - 1,
+              "HH modes are not last");
+
+static bool test_video_mode_catalogue ()
+{
+  unsigned index = 0;
+  for (int type = wds::CEA; type <= wds::HH; ++type) {
+    for (unsigned rr = 0; rr < wds::GetVideoModeCount(wds::ResolutionType(type));
+         ++rr, ++index) {
+      const wds::VideoMode& mode = wds::kVideoModes[index];
+      ASSERT(&wds::GetVideoMode(wds::ResolutionType(type), rr) == &mode);
+      ASSERT(mode.type == type && mode.bit == rr);
+      H264VideoFormat format;
+      format.type = wds::ResolutionType(type);
+      format.rate_resolution = rr;
+      wds::VideoFormatInfo info = wds::GetVideoFormatInfo(format);
+      ASSERT(info.width == mode.width && info.height == mode.height);
+      ASSERT(info.frame_rate == mode.frame_rate &&
+             info.interlaced == mode.interlaced);
+      unsigned frames = mode.interlaced ? mode.frame_rate / 2 : mode.frame_rate;
+      ASSERT(mode.pixel_rate == mode.width * mode.height * frames);
+    }
+  }
+  ASSERT(index == wds::kVideoModeCount);
+  return true;
+}
+
+static bool test_max_quality_policy ()
+{
+  std::vector<PolicyCase> cases = {
+    {"all modes vs TV", NativeVideoFormat(wds::CEA1280x720p60),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1920x1080p60)},
+    {"local limit", NativeVideoFormat(),
+     {MakeCodec(wds::CBP, wds::k3_1,
+                {wds::CEA640x480p60, wds::CEA1280x720p30})}, TvCodecs(),
+     true, H264VideoFormat(wds::CBP, wds::k3_1, wds::CEA1280x720p30)},
+    {"VESA over CEA", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)},
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p60},
+                {wds::VESA1920x1200p30})},
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::VESA1920x1200p30)},
+    {"equal weight in table order", NativeVideoFormat(),
+     {AllModes(wds::CBP, wds::k4)},
+     {MakeCodec(wds::CBP, wds::k4, {wds::CEA1280x720p25}, {},
+                {wds::HH800x480p60})},
+     true, H264VideoFormat(wds::CBP, wds::k4, wds::CEA1280x720p25)},
+    {"profile before level", NativeVideoFormat(),
+     {MakeCodec(wds::CHP, wds::k3_1, {wds::CEA1920x1080p30}),
+      MakeCodec(wds::CBP, wds::k4_2, {wds::CEA1920x1080p30})},
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1920x1080p30})},
+     true, H264VideoFormat(wds::CHP, wds::k3_1, wds::CEA1920x1080p30)},
+    {"same size, other rate", NativeVideoFormat(),
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1920x1080p30})},
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1920x1080p60})},
+     false, H264VideoFormat()},
+  };
+  return RunPolicyCases(wds::MaxQualityPolicy(), cases);
+}
+
+static bool test_native_first_policy ()
+{
+  std::vector<H264VideoCodec> phone = {
+    MakeCodec(wds::CBP, wds::k3_1,
+              {wds::CEA640x480p60, wds::CEA1280x720p30}, {},
+              {wds::HH800x480p30, wds::HH854x480p30})
+  };
+  std::vector<PolicyCase> cases = {
+    {"native", NativeVideoFormat(wds::CEA1280x720p60),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1280x720p60)},
+    {"best that fits", NativeVideoFormat(wds::CEA1920x1080p60),
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA640x480p60,
+                wds::CEA1280x720p30, wds::CEA1280x720p60})}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1280x720p60)},
+    {"fits in width and height", NativeVideoFormat(wds::HH800x480p60),
+     {AllModes(wds::CBP, wds::k4_2)}, phone,
+     true, H264VideoFormat(wds::CBP, wds::k3_1, wds::CEA640x480p60)},
+    {"smallest larger", NativeVideoFormat(wds::HH640x360p30),
+     {MakeCodec(wds::CBP, wds::k4_2,
+                {wds::CEA1280x720p30, wds::CEA1920x1080p30})}, TvCodecs(),
+     true, H264VideoFormat(wds::CBP, wds::k4_2, wds::CEA1280x720p30)},
+  };
+  return RunPolicyCases(wds::NativeFirstPolicy(), cases);
+}
+
+static bool test_bandwidth_capped_policy ()
+{
+  // Estimated at 0.1 bit per pixel: 1080p60 12.4 Mbit/s, VESA1280x1024p60
+  // 7.9 Mbit/s, VESA800x600p60 2.9 Mbit/s, 720p30 2.8 Mbit/s, 640x480p60
+  // 1.8 Mbit/s
+  struct {
+    unsigned max_throughput;
+    PolicyCase test_case;
+  } cases[] = {
+    {50000, {"50 Mbit/s", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1920x1080p60)}},
+    {0, {"unknown throughput", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1920x1080p60)}},
+    {8000, {"8 Mbit/s", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::VESA1280x1024p60)}},
+    {3000, {"3 Mbit/s", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::VESA800x600p60)}},
+    {1000, {"nothing fits", NativeVideoFormat(),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA640x480p60)}},
+  };
+  bool passed = true;
+  for (const auto& test : cases) {
+    if (!RunPolicyCases(wds::BandwidthCappedPolicy(test.max_throughput),
+                        {test.test_case}))
+      passed = false;
+  }
+  ASSERT(passed);
+  return true;
+}
+
+static bool test_lowest_latency_policy ()
+{
+  std::vector<PolicyCase> cases = {
+    {"smallest 60 fps", NativeVideoFormat(wds::CEA1920x1080p60),
+     {AllModes(wds::CHP, wds::k4_2)}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA640x480p60)},
+    {"no 60 fps", NativeVideoFormat(),
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p30,
+                wds::CEA1920x1080p30, wds::CEA1920x1080i60})}, TvCodecs(),
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1280x720p30)},
+    {"frame rate over size", NativeVideoFormat(),
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p60}, {},
+                {wds::HH640x360p30})},
+     {MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p60}, {},
+                {wds::HH640x360p30})},
+     true, H264VideoFormat(wds::CHP, wds::k4_2, wds::CEA1280x720p60)},
+  };
+  return RunPolicyCases(wds::LowestLatencyPolicy(), cases);
+}
+
+static bool test_codec_parameters ()
+{
+  H264VideoCodec local = MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p30});
+  local.min_slice_size = 40;
+  local.slice_enc_params = (2 << 10) | 8;
+  local.frame_rate_control_support = 0x11 | (3 << 1);
+  H264VideoCodec remote = MakeCodec(wds::CHP, wds::k4_2, {wds::CEA1280x720p30});
+  remote.latency = 4;
+  remote.min_slice_size = 99;
+  remote.slice_enc_params = (5 << 10) | 4;
+  remote.frame_rate_control_support = 0x01 | (2 << 1);
+  remote.max_hres = 1280;
+  remote.max_vres = 720;
+
+  H264VideoFormat format = wds::FindOptimalVideoFormat(
+      NativeVideoFormat(), {local}, {remote});
+  ASSERT(format.latency == 4);
+  ASSERT(format.min_slice_size == 99);
+  ASSERT(format.slice_enc_params == ((2 << 10) | 4));
+  ASSERT(format.frame_rate_control_support == (0x01 | (2 << 1)));
+  ASSERT(format.max_hres == 1280);
+  ASSERT(format.max_vres == 720);
+
+  // Slices only if both support them, the policies combine the same way
+  local.min_slice_size = 0;
+  format = wds::FindOptimalVideoFormat(wds::MaxQualityPolicy(),
+      NativeVideoFormat(), {local}, {remote});
+  ASSERT(format.min_slice_size == 0);
+  ASSERT(format.slice_enc_params == 0);
+  ASSERT(format.latency == 4);
+  ASSERT(format.max_hres == 1280);
+
+  // The format of a codec keeps its parameters
+  std::vector<H264VideoFormat> formats;
+  wds::PopulateVideoFormatList(remote, formats);
+  ASSERT(formats.size() == 1);
+  ASSERT(formats[0].latency == 4);
+  ASSERT(formats[0].slice_enc_params == remote.slice_enc_params);
+  ASSERT(formats[0].max_vres == 720);
+  return 1;
+}
+
+static bool test_video_3d_format ()
+{
+  using wds::H264Video3DCodec;
+  using wds::H264Video3DFormat;
+  using wds::Video3DModesBitmap;
+
+  H264Video3DCodec local_cbp(wds::CBP, wds::k4_2, Video3DModesBitmap(0x3f));
+  H264Video3DCodec local_chp(wds::CHP, wds::k4_1, Video3DModesBitmap(0x0f));
+  local_chp.min_slice_size = 20;
+  H264Video3DCodec remote(wds::CHP, wds::k4_2,
+                          Video3DModesBitmap().set(2).set(5).set(40));
+  remote.latency = 3;
+  remote.min_slice_size = 30;
+
+  // The first preferred mode both support, the best profile for it
+  bool success = false;
+  H264Video3DFormat format = wds::FindOptimalVideo3DFormat(
+      {7, 2, 5}, {local_cbp, local_chp}, {remote}, &success);
+  ASSERT(success);
+  ASSERT(format.mode == 2);
+  ASSERT(format.profile == wds::CHP);
+  ASSERT(format.level == wds::k4_1);
+  ASSERT(format.latency == 3);
+  ASSERT(format.min_slice_size == 30);
+
+  format = wds::FindOptimalVideo3DFormat(
+      {5, 2}, {local_cbp, local_chp}, {remote}, &success);
+  ASSERT(success);
+  ASSERT(format.mode == 5);
+  ASSERT(format.profile == wds::CBP);
+  ASSERT(format.level == wds::k4_2);
+  ASSERT(format.min_slice_size == 0);
+
+  // Modes beyond the local ones, or not preferred, are not chosen
+  format = wds::FindOptimalVideo3DFormat(
+      {40, 64}, {local_cbp, local_chp}, {remote}, &success);
+  ASSERT(!success);
+  format = wds::FindOptimalVideo3DFormat(
+      {}, {local_cbp, local_chp}, {remote}, &success);
+  ASSERT(!success);
+  format = wds::FindOptimalVideo3DFormat({2}, {local_cbp}, {}, &success);
+  ASSERT(!success);
+  return 1;
+}
+
+int main(const int argc, const char **argv)
+{
+  std::list<TestFunc> tests;
+
+  // Add tests
+  tests.push_back(test_small_mode_sets);
+  tests.push_back(test_profiles_and_levels);
+  tests.push_back(test_random_codec_lists);
+  tests.push_back(test_no_common_mode);
+  tests.push_back(test_video_mode_catalogue);
+  tests.push_back(test_max_quality_policy);
+  tests.push_back(test_native_first_policy);
+  tests.push_back(test_bandwidth_capped_policy);
+  tests.push_back(test_lowest_latency_policy);
+  tests.push_back(test_codec_parameters);
+  tests.push_back(test_video_3d_format);
+
+  return RunTests(tests);
+}
@@ -68,12 +68,12 @@ H264Codec::H264Codec(const H264VideoFormat& format)
     cea_support((format.type == CEA) ? 1 << format.rate_resolution : 0),
     vesa_support((format.type == VESA) ? 1 << format.rate_resolution : 0),
     hh_support((format.type == HH) ? 1 << format.rate_resolution : 0),
-    latency(0),
-    min_slice_size(0),
-    slice_enc_params(0),
-    frame_rate_control_support(0),
-    max_hres(0),
-    max_vres(0) {
+    latency(format.latency),
+    min_slice_size(format.min_slice_size),
+    slice_enc_params(format.slice_enc_params),
+    frame_rate_control_support(format.frame_rate_control_support),
+    max_hres(format.max_hres),
+    max_vres(format.max_vres) {
 
 }
 
@@ -83,12 +83,12 @@ H264Codec::H264Codec(const H264VideoCodec& format)
     cea_support(format.cea_rr.to_ulong()),
     vesa_support(format.vesa_rr.to_ulong()),
     hh_support(format.hh_rr.to_ulong()),
-    latency(0),
-    min_slice_size(0),
-    slice_enc_params(0),
-    frame_rate_control_support(0),
-    max_hres(0),
-    max_vres(0) {
+    latency(format.latency),
+    min_slice_size(format.min_slice_size),
+    slice_enc_params(format.slice_enc_params),
+    frame_rate_control_support(format.frame_rate_control_support),
+    max_hres(format.max_hres),
+    max_vres(format.max_vres) {
 
 }
 
@@ -189,6 +189,12 @@ H264VideoCodec H264Codec::ToH264VideoCodec() const {
   result.cea_rr = RateAndResolutionsBitmap(cea_support);
   result.vesa_rr = RateAndResolutionsBitmap(vesa_support);
   result.hh_rr = RateAndResolutionsBitmap(hh_support);
+  result.latency = latency;
+  result.min_slice_size = min_slice_size;
+  result.slice_enc_params = slice_enc_params;
+  result.frame_rate_control_support = frame_rate_control_support;
+  result.max_hres = max_hres;
+  result.max_vres = max_vres;
   return result;
 }
 
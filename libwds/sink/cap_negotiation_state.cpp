@@ -21,6 +21,7 @@
 
 #include "libwds/sink/cap_negotiation_state.h"
 
+#include <cstdio>
 #include <iostream>
 
 #include "libwds/public/media_manager.h"
@@ -34,6 +35,7 @@
 #include "libwds/rtsp/formats3d.h"
 #include "libwds/rtsp/i2c.h"
 #include "libwds/rtsp/payload.h"
+#include "libwds/rtsp/preferreddisplaymode.h"
 #include "libwds/rtsp/presentationurl.h"
 #include "libwds/rtsp/propertyerrors.h"
 #include "libwds/rtsp/reply.h"
@@ -51,6 +53,24 @@ using rtsp::Reply;
 
 namespace sink {
 
+namespace {
+
+// EDID blocks are 128 bytes, sent as uppercase hex
+const size_t kEdidBlockSize = 128;
+
+std::string ToHexString(const std::vector<unsigned char>& data) {
+  std::string hex;
+  hex.reserve(data.size() * 2);
+  char digits[3];
+  for (unsigned char byte : data) {
+    std::snprintf(digits, sizeof(digits), "%02X", byte);
+    hex += digits;
+  }
+  return hex;
+}
+
+}  // namespace
+
 M3Handler::M3Handler(const InitParams& init_params)
   : MessageReceiver<Request::M3>(init_params) {
 }
@@ -62,6 +82,11 @@ std::unique_ptr<Reply> M3Handler::HandleMessage(Message* message) {
   if (!received_payload)
     return nullptr;
 
+  SinkMediaManager* sink_media_manager = ToSinkMediaManager(manager_);
+  DisplayTiming preferred_timing;
+  bool has_preferred_timing =
+      sink_media_manager->GetPreferredDisplayMode(&preferred_timing);
+
   auto reply = std::unique_ptr<Reply>(new Reply(rtsp::STATUS_OK));
   auto reply_payload = new rtsp::PropertyMapPayload();
   for (const std::string& property : received_payload->properties()) {
@@ -80,17 +105,40 @@ std::unique_ptr<Reply> M3Handler::HandleMessage(Message* message) {
           reply_payload->AddProperty(new_prop);
       } else if (property == GetPropertyName(rtsp::VideoFormatsPropertyType)){
           new_prop.reset(new rtsp::VideoFormats(ToSinkMediaManager(manager_)->GetNativeVideoFormat(),
-              false,
+              has_preferred_timing,
               ToSinkMediaManager(manager_)->GetSupportedH264VideoCodecs()));
           reply_payload->AddProperty(new_prop);
       } else if (property == GetPropertyName(rtsp::Video3DFormatsPropertyType)){
-          new_prop.reset(new rtsp::Formats3d());
+          const auto& codecs_3d =
+              ToSinkMediaManager(manager_)->GetSupportedH264Video3DCodecs();
+          if (codecs_3d.empty())
+            new_prop.reset(new rtsp::Formats3d());
+          else
+            new_prop.reset(new rtsp::Formats3d(
+                ToSinkMediaManager(manager_)->GetNativeVideoFormat(),
+                false,
+                codecs_3d));
           reply_payload->AddProperty(new_prop);
       } else if (property == GetPropertyName(rtsp::ContentProtectionPropertyType)){
           new_prop.reset(new rtsp::ContentProtection());
           reply_payload->AddProperty(new_prop);
       } else if (property == GetPropertyName(rtsp::DisplayEdidPropertyType)){
-          new_prop.reset(new rtsp::DisplayEdid());
+          const auto& edid = sink_media_manager->GetDisplayEdid();
+          if (edid.empty() || edid.size() % kEdidBlockSize)
+            new_prop.reset(new rtsp::DisplayEdid());
+          else
+            new_prop.reset(new rtsp::DisplayEdid(edid.size() / kEdidBlockSize,
+                                                 ToHexString(edid)));
+          reply_payload->AddProperty(new_prop);
+      } else if (property == GetPropertyName(rtsp::PreferredDisplayModePropertyType)){
+          // No 'none' form, the source only asks when 'wfd_video_formats'
+          // has the preferred display mode flag set
+          const auto& codecs = sink_media_manager->GetSupportedH264VideoCodecs();
+          if (!has_preferred_timing || codecs.empty()) {
+            WDS_WARNING("** GET_PARAMETER: No preferred display mode to reply with.");
+            continue;
+          }
+          new_prop.reset(new rtsp::PreferredDisplayMode(preferred_timing, codecs[0]));
           reply_payload->AddProperty(new_prop);
       } else if (property == GetPropertyName(rtsp::CoupledSinkPropertyType)){
           new_prop.reset(new rtsp::CoupledSink());
@@ -122,6 +170,20 @@ std::unique_ptr<Reply> M3Handler::HandleMessage(Message* message) {
 }
 
 
+namespace {
+
+std::unique_ptr<Reply> CreateUnsupportedFormatReply(rtsp::PropertyType type) {
+  auto reply = std::unique_ptr<Reply>(new Reply(rtsp::STATUS_SeeOther));
+  auto payload = new rtsp::PropertyErrorPayload();
+  std::vector<unsigned short> error_codes = {rtsp::STATUS_UnsupportedMediaType};
+  payload->AddPropertyError(
+      std::make_shared<rtsp::PropertyErrors>(type, error_codes));
+  reply->set_payload(std::unique_ptr<rtsp::Payload>(payload));
+  return reply;
+}
+
+}  // namespace
+
 M4Handler::M4Handler(const InitParams& init_params)
   : MessageReceiver<Request::M4>(init_params) {
 }
@@ -140,29 +202,61 @@ std::unique_ptr<Reply> M4Handler::HandleMessage(Message* message) {
     sink_media_manager->SetPresentationUrl(presentation_url->presentation_url_1());
   }
 
+  // Either replaces the CEA, VESA or HH resolution of 'wfd_video_formats'
+  auto preferred_display_mode =
+      static_cast<rtsp::PreferredDisplayMode*>(payload->GetProperty(rtsp::PreferredDisplayModePropertyType).get());
+  if (preferred_display_mode) {
+    if (!sink_media_manager->SetPreferredDisplayMode(
+            preferred_display_mode->ToDisplayTiming()))
+      return CreateUnsupportedFormatReply(rtsp::PreferredDisplayModePropertyType);
+  }
+
   auto video_formats =
       static_cast<rtsp::VideoFormats*>(payload->GetProperty(rtsp::VideoFormatsPropertyType).get());
+  auto formats_3d =
+      static_cast<rtsp::Formats3d*>(payload->GetProperty(rtsp::Video3DFormatsPropertyType).get());
+
+  if (!video_formats && !formats_3d && preferred_display_mode)
+    return std::unique_ptr<Reply>(new Reply(rtsp::STATUS_OK));
 
-  if (!video_formats) {
+  // A 2D format is selected, or a 3D one with 'wfd-video-formats' none
+  bool has_2d = video_formats && !video_formats->is_none();
+  bool has_3d = formats_3d && !formats_3d->is_none();
+  if (!has_2d && !has_3d) {
     WDS_ERROR("Failed to obtain 'wfd-video-formats' in M4 handler.");
     return nullptr;
   }
 
-  const auto& selected_formats = video_formats->GetH264Formats();
-  if (selected_formats.size() != 1) {
-    WDS_ERROR("Failed to obtain optimal video format from 'wfd-video-formats' in M4 handler.");
-    return nullptr;
+  if (has_2d) {
+    const auto& selected_formats = video_formats->GetH264Formats();
+    if (selected_formats.size() != 1) {
+      WDS_ERROR("Failed to obtain optimal video format from 'wfd-video-formats' in M4 handler.");
+      return nullptr;
+    }
+
+    if (!sink_media_manager->SetOptimalVideoFormat(selected_formats[0]))
+      return CreateUnsupportedFormatReply(rtsp::VideoFormatsPropertyType);
   }
 
-  if (!sink_media_manager->SetOptimalVideoFormat(selected_formats[0])) {
-    auto reply = std::unique_ptr<Reply>(new Reply(rtsp::STATUS_SeeOther));
-    auto payload = new rtsp::PropertyErrorPayload();
-    std::vector<unsigned short> error_codes = {rtsp::STATUS_UnsupportedMediaType};
-    auto property_errors =
-        std::make_shared<rtsp::PropertyErrors>(rtsp::VideoFormatsPropertyType, error_codes);
-    payload->AddPropertyError(property_errors);
-    reply->set_payload(std::unique_ptr<rtsp::Payload>(payload));
-    return reply;
+  if (has_3d) {
+    const auto& codecs_3d = formats_3d->GetH264Video3DCodecs();
+    if (codecs_3d.size() != 1 || codecs_3d[0].modes.count() != 1) {
+      WDS_ERROR("Failed to obtain optimal 3D format from 'wfd-3d-video-formats' in M4 handler.");
+      return nullptr;
+    }
+    const H264Video3DCodec& codec = codecs_3d[0];
+    Video3DMode mode = 0;
+    while (!codec.modes.test(mode))
+      ++mode;
+    H264Video3DFormat format_3d(codec.profile, codec.level, mode);
+    format_3d.latency = codec.latency;
+    format_3d.min_slice_size = codec.min_slice_size;
+    format_3d.slice_enc_params = codec.slice_enc_params;
+    format_3d.frame_rate_control_support = codec.frame_rate_control_support;
+    format_3d.max_hres = codec.max_hres;
+    format_3d.max_vres = codec.max_vres;
+    if (!sink_media_manager->SetOptimalVideo3DFormat(format_3d))
+      return CreateUnsupportedFormatReply(rtsp::Video3DFormatsPropertyType);
   }
 
   return std::unique_ptr<Reply>(new Reply(rtsp::STATUS_OK));
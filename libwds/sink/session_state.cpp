@@ -62,6 +62,7 @@ std::unique_ptr<Message> M6Handler::CreateMessage() {
   auto transport = new rtsp::TransportHeader();
   // we assume here that there is no coupled secondary sink
   transport->set_client_port(ToSinkMediaManager(manager_)->GetLocalRtpPorts().first);
+  transport->set_client_supports_rtcp(ToSinkMediaManager(manager_)->IsRtcpSupported());
   setup->header().set_transport(transport);
   setup->header().set_cseq(sender_->GetNextCSeq());
   setup->header().set_require_wfd_support(true);
@@ -73,6 +74,9 @@ bool M6Handler::HandleReply(Reply* reply) {
   const std::string& session_id = reply->header().session();
   if(reply->response_code() == rtsp::STATUS_OK && !session_id.empty()) {
     ToSinkMediaManager(manager_)->SetSessionId(session_id);
+    const rtsp::TransportHeader& transport = reply->header().transport();
+    if (transport.server_supports_rtcp() && transport.server_port() > 0)
+      ToSinkMediaManager(manager_)->SetSourceRtcpPort(transport.server_port() + 1);
     // FIXME : take timeout value from session.
     keep_alive_timer_ = sender_->CreateTimer(60);
     return true;
@@ -24,8 +24,10 @@
 #include "libwds/common/message_handler.h"
 #include "libwds/common/rtsp_input_handler.h"
 #include "libwds/public/wds_export.h"
+#include "libwds/rtsp/idrrequest.h"
 #include "libwds/rtsp/pause.h"
 #include "libwds/rtsp/play.h"
+#include "libwds/rtsp/setparameter.h"
 #include "libwds/rtsp/teardown.h"
 #include "libwds/rtsp/triggermethod.h"
 #include "libwds/public/media_manager.h"
@@ -109,6 +111,8 @@ class SinkImpl final : public Sink, public RTSPInputHandler, public MessageHandl
   bool Teardown() override;
   bool Play() override;
   bool Pause() override;
+  bool RequestIDR() override;
+  void OnSendQueueStateChanged(bool congested) override;
 
   // RTSPInputHandler
   void MessageParsed(std::unique_ptr<Message> message) override;
@@ -128,12 +132,16 @@ class SinkImpl final : public Sink, public RTSPInputHandler, public MessageHandl
   std::shared_ptr<SinkStateMachine> state_machine_;
   Delegate* delegate_;
   SinkMediaManager* manager_;
+  bool send_queue_congested_;
+  bool idr_requested_while_congested_;
 };
 
 SinkImpl::SinkImpl(Delegate* delegate, SinkMediaManager* mng)
   : state_machine_(new SinkStateMachine({delegate, mng, this})),
     delegate_(delegate),
-    manager_(mng) {
+    manager_(mng),
+    send_queue_congested_(false),
+    idr_requested_while_congested_(false) {
 }
 
 void SinkImpl::Start() {
@@ -180,6 +188,32 @@ bool SinkImpl::Pause() {
   return HandleCommand(CreateCommand<rtsp::Pause, Request::M9>());
 }
 
+bool SinkImpl::RequestIDR() {
+  // A second request queued behind the first one would reach the source
+  // at the same time and only cost it another IDR picture.
+  if (send_queue_congested_ && idr_requested_while_congested_) {
+    WDS_LOG("IDR request coalesced, RTSP send queue is congested");
+    return true;
+  }
+
+  auto m13 = CreateCommand<rtsp::SetParameter, Request::M13>();
+  auto payload = new rtsp::PropertyMapPayload();
+  payload->AddProperty(
+      std::shared_ptr<rtsp::Property>(new rtsp::IDRRequest()));
+  m13->set_payload(std::unique_ptr<rtsp::Payload>(payload));
+  if (!HandleCommand(std::move(m13)))
+    return false;
+
+  idr_requested_while_congested_ = send_queue_congested_;
+  return true;
+}
+
+void SinkImpl::OnSendQueueStateChanged(bool congested) {
+  send_queue_congested_ = congested;
+  if (!congested)
+    idr_requested_while_congested_ = false;
+}
+
 void SinkImpl::MessageParsed(std::unique_ptr<Message> message) {
   if (message->is_request() && !InitializeRequestId(ToRequest(message.get()))) {
     WDS_ERROR("Cannot identify the received message");
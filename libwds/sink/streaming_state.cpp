@@ -211,6 +211,17 @@ class M9SenderOptional final : public OptionalMessageSender<Request::M9> {
   }
 };
 
+class M13SenderOptional final : public OptionalMessageSender<Request::M13> {
+ public:
+  M13SenderOptional(const InitParams& init_params)
+    : OptionalMessageSender<Request::M13>(init_params) {
+  }
+ private:
+  bool HandleReply(Reply* reply) override {
+    return (reply->response_code() == rtsp::STATUS_OK);
+  }
+};
+
 StreamingState::StreamingState(const InitParams& init_params, MessageHandlerPtr m16_handler)
   : MessageSequenceWithOptionalSetHandler(init_params) {
   AddSequencedHandler(make_ptr(new TeardownHandler(init_params)));
@@ -219,10 +230,12 @@ StreamingState::StreamingState(const InitParams& init_params, MessageHandlerPtr
   AddOptionalHandler(make_ptr(new M3Handler(init_params)));
   AddOptionalHandler(make_ptr(new M4Handler(init_params)));
 
-  // optional senders that handle sending play, pause and teardown
+  // optional senders that handle sending play, pause, teardown
+  // and IDR requests
   AddOptionalHandler(make_ptr(new M7SenderOptional(init_params)));
   AddOptionalHandler(make_ptr(new M8SenderOptional(init_params)));
   AddOptionalHandler(make_ptr(new M9SenderOptional(init_params)));
+  AddOptionalHandler(make_ptr(new M13SenderOptional(init_params)));
   AddOptionalHandler(m16_handler);
 }
 
@@ -21,8 +21,12 @@
 
 #include "libwds/source/cap_negotiation_state.h"
 
+#include <algorithm>
+#include <list>
+
 #include "libwds/rtsp/audiocodecs.h"
 #include "libwds/rtsp/clientrtpports.h"
+#include "libwds/rtsp/formats3d.h"
 #include "libwds/rtsp/getparameter.h"
 #include "libwds/rtsp/payload.h"
 #include "libwds/rtsp/presentationurl.h"
@@ -35,6 +39,7 @@ namespace wds {
 
 using rtsp::AudioCodecs;
 using rtsp::ClientRtpPorts;
+using rtsp::Formats3d;
 using rtsp::GetParameter;
 using rtsp::Message;
 using rtsp::Payload;
@@ -46,32 +51,19 @@ using rtsp::VideoFormats;
 
 namespace source {
 
-class M3Handler final : public SequencedMessageSender {
- public:
-  using SequencedMessageSender::SequencedMessageSender;
-
- private:
-  std::unique_ptr<Message> CreateMessage() override;
-  bool HandleReply(Reply* reply) override;
-};
-
-class M4Handler final : public SequencedMessageSender {
- public:
-  using SequencedMessageSender::SequencedMessageSender;
-
- private:
-  std::unique_ptr<Message> CreateMessage() override;
-  bool HandleReply(Reply* reply) override;
-};
+namespace {
 
-std::unique_ptr<Message> M3Handler::CreateMessage() {
+std::unique_ptr<Message> CreateM3(Peer::Delegate* sender,
+                                  SourceMediaManager* source_manager) {
   GetParameter* get_param = new GetParameter("rtsp://localhost/wfd1.0");
-  get_param->header().set_cseq(sender_->GetNextCSeq());
+  get_param->header().set_cseq(sender->GetNextCSeq());
   std::vector<std::string> props;
 
-  SessionType media_type = ToSourceMediaManager(manager_)->GetSessionType();
+  SessionType media_type = source_manager->GetSessionType();
   if (media_type & VideoSession)
     props.push_back("wfd_video_formats");
+  if ((media_type & VideoSession) && source_manager->IsVideo3DSupported())
+    props.push_back("wfd_3d_video_formats");
   if (media_type & AudioSession)
     props.push_back("wfd_audio_codecs");
 
@@ -81,11 +73,11 @@ std::unique_ptr<Message> M3Handler::CreateMessage() {
   return std::unique_ptr<Message>(get_param);
 }
 
-bool M3Handler::HandleReply(Reply* reply) {
+bool ParseM3Reply(Reply* reply, SessionType media_type,
+                  SinkCapabilities* capabilities) {
   if (reply->response_code() != rtsp::STATUS_OK)
     return false;
 
-  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
   auto payload = ToPropertyMapPayload(reply->payload());
   if (!payload){
     WDS_ERROR("Failed to obtain payload from reply.");
@@ -97,33 +89,55 @@ bool M3Handler::HandleReply(Reply* reply) {
     WDS_ERROR("Failed to obtain RTP ports from source.");
     return false;
   }
-  source_manager->SetSinkRtpPorts(ports->rtp_port_0(), ports->rtp_port_1());
+  capabilities->rtp_port0 = ports->rtp_port_0();
+  capabilities->rtp_port1 = ports->rtp_port_1();
 
   auto video_formats = static_cast<VideoFormats*>(
       payload->GetProperty(rtsp::VideoFormatsPropertyType).get());
 
+  auto formats_3d = static_cast<Formats3d*>(
+      payload->GetProperty(rtsp::Video3DFormatsPropertyType).get());
+
   auto audio_codecs = static_cast<AudioCodecs*>(
       payload->GetProperty(rtsp::AudioCodecsPropertyType).get());
 
-  if (!video_formats && (source_manager->GetSessionType() & VideoSession)) {
+  if (!video_formats && (media_type & VideoSession)) {
     WDS_ERROR("Failed to obtain WFD_VIDEO_FORMATS property");
     return false;
   }
 
-  if (!audio_codecs && (source_manager->GetSessionType() & AudioSession)) {
-    WDS_ERROR("Failed to obtain WFD_AUDIO_CODECS property");
-    return false;
+  // Same as "none": the media manager is left to go on without audio
+  if (!audio_codecs && (media_type & AudioSession))
+    WDS_WARNING("Sink did not reply with WFD_AUDIO_CODECS property");
+
+  if (video_formats) {
+    capabilities->native_format = video_formats->GetNativeFormat();
+    capabilities->video_codecs = video_formats->GetH264VideoCodecs();
   }
+  if (formats_3d)
+    capabilities->video_3d_codecs = formats_3d->GetH264Video3DCodecs();
+  if (audio_codecs)
+    capabilities->audio_codecs = audio_codecs->audio_codecs();
+
+  return true;
+}
+
+bool InitOptimalFormats(SourceMediaManager* source_manager,
+                        const SinkCapabilities& capabilities) {
+  source_manager->SetSinkRtpPorts(capabilities.rtp_port0, capabilities.rtp_port1);
 
-  if (video_formats && !source_manager->InitOptimalVideoFormat(
-      video_formats->GetNativeFormat(),
-      video_formats->GetH264VideoCodecs())) {
+  SessionType media_type = source_manager->GetSessionType();
+  if ((media_type & VideoSession) && !source_manager->InitOptimalVideoFormat(
+      capabilities.native_format, capabilities.video_codecs)) {
     WDS_ERROR("Cannot initalize optimal video format from the supported by sink.");
     return false;
   }
 
-  if (audio_codecs && !source_manager->InitOptimalAudioFormat(
-      audio_codecs->audio_codecs())) {
+  if ((media_type & VideoSession) && source_manager->IsVideo3DSupported())
+    source_manager->InitOptimalVideo3DFormat(capabilities.video_3d_codecs);
+
+  if ((media_type & AudioSession) && !source_manager->InitOptimalAudioFormat(
+      capabilities.audio_codecs)) {
     WDS_ERROR("Cannot initalize optimal audio format from the supported by sink.");
     return false;
   }
@@ -131,25 +145,74 @@ bool M3Handler::HandleReply(Reply* reply) {
   return true;
 }
 
-std::unique_ptr<Message> M4Handler::CreateMessage() {
+bool IsSameCodec(const H264VideoCodec& a, const H264VideoCodec& b) {
+  return a.profile == b.profile && a.level == b.level &&
+         a.cea_rr == b.cea_rr && a.vesa_rr == b.vesa_rr && a.hh_rr == b.hh_rr &&
+         a.latency == b.latency && a.min_slice_size == b.min_slice_size &&
+         a.slice_enc_params == b.slice_enc_params &&
+         a.frame_rate_control_support == b.frame_rate_control_support &&
+         a.max_hres == b.max_hres && a.max_vres == b.max_vres;
+}
+
+bool IsSameCodec(const H264Video3DCodec& a, const H264Video3DCodec& b) {
+  return a.profile == b.profile && a.level == b.level && a.modes == b.modes &&
+         a.latency == b.latency && a.min_slice_size == b.min_slice_size &&
+         a.slice_enc_params == b.slice_enc_params &&
+         a.frame_rate_control_support == b.frame_rate_control_support &&
+         a.max_hres == b.max_hres && a.max_vres == b.max_vres;
+}
+
+bool IsSameCodec(const AudioCodec& a, const AudioCodec& b) {
+  return a.format == b.format && a.modes == b.modes && a.latency == b.latency;
+}
+
+template <typename Codec>
+bool IsSameCodecs(const std::vector<Codec>& a, const std::vector<Codec>& b) {
+  return a.size() == b.size() &&
+         std::equal(a.begin(), a.end(), b.begin(),
+             [](const Codec& x, const Codec& y) { return IsSameCodec(x, y); });
+}
+
+bool IsSameCapabilities(const SinkCapabilities& a, const SinkCapabilities& b) {
+  return a.native_format.type == b.native_format.type &&
+         a.native_format.rate_resolution == b.native_format.rate_resolution &&
+         IsSameCodecs(a.video_codecs, b.video_codecs) &&
+         IsSameCodecs(a.video_3d_codecs, b.video_3d_codecs) &&
+         IsSameCodecs(a.audio_codecs, b.audio_codecs) &&
+         a.rtp_port0 == b.rtp_port0 && a.rtp_port1 == b.rtp_port1;
+}
+
+std::unique_ptr<Message> CreateM4(Peer::Delegate* sender,
+                                  SourceMediaManager* source_manager) {
   SetParameter* set_param = new SetParameter("rtsp://localhost/wfd1.0");
-  set_param->header().set_cseq(sender_->GetNextCSeq());
-  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
+  set_param->header().set_cseq(sender->GetNextCSeq());
   const auto& ports = source_manager->GetSinkRtpPorts();
   auto payload = new rtsp::PropertyMapPayload();
 
   payload->AddProperty(
       std::shared_ptr<Property>(new ClientRtpPorts(ports.first, ports.second)));
-  std::string presentation_Url_1 = "rtsp://" + sender_->GetLocalIPAddress() + "/wfd1.0/streamid=0";
+  std::string presentation_Url_1 = "rtsp://" + sender->GetLocalIPAddress() + "/wfd1.0/streamid=0";
   payload->AddProperty(
       std::shared_ptr<Property>(new rtsp::PresentationUrl(presentation_Url_1, "")));
 
   if (source_manager->GetSessionType() & VideoSession) {
-    payload->AddProperty(
-        std::shared_ptr<VideoFormats>(new VideoFormats(
-            NativeVideoFormat(),  // Should be all zeros.
-            false,
-            {source_manager->GetOptimalVideoFormat()})));
+    // Only one of the 2D and the 3D formats is selected, the other is none
+    H264Video3DFormat format_3d;
+    if (source_manager->GetOptimalVideo3DFormat(&format_3d)) {
+      payload->AddProperty(
+          std::shared_ptr<VideoFormats>(new VideoFormats()));
+      payload->AddProperty(
+          std::shared_ptr<Formats3d>(new Formats3d(
+              NativeVideoFormat(),  // Should be all zeros.
+              false,
+              std::vector<H264Video3DFormat>{format_3d})));
+    } else {
+      payload->AddProperty(
+          std::shared_ptr<VideoFormats>(new VideoFormats(
+              NativeVideoFormat(),  // Should be all zeros.
+              false,
+              {source_manager->GetOptimalVideoFormat()})));
+    }
   }
 
   if (source_manager->GetSessionType() & AudioSession) {
@@ -162,10 +225,136 @@ std::unique_ptr<Message> M4Handler::CreateMessage() {
   return std::unique_ptr<Message>(set_param);
 }
 
+}  // namespace
+
+class M3Handler final : public SequencedMessageSender {
+ public:
+  using SequencedMessageSender::SequencedMessageSender;
+
+ private:
+  std::unique_ptr<Message> CreateMessage() override;
+  bool HandleReply(Reply* reply) override;
+};
+
+class M4Handler final : public SequencedMessageSender {
+ public:
+  using SequencedMessageSender::SequencedMessageSender;
+
+ private:
+  std::unique_ptr<Message> CreateMessage() override;
+  bool HandleReply(Reply* reply) override;
+};
+
+// Sends M4 for the cached capabilities right after M3 and checks them
+// against the M3 reply once it arrives. If they changed M4 is sent again
+// for the new ones.
+class CachedCapabilitiesHandler final : public MessageSenderBase {
+ public:
+  CachedCapabilitiesHandler(const InitParams& init_params,
+                            const SinkCapabilities& capabilities);
+
+ private:
+  void Start() override;
+  void Reset() override;
+  bool CanSend(Message* message) const override;
+  bool HandleReply(Reply* reply) override;
+
+  void SendRequest(std::unique_ptr<Message> message, Request::ID id);
+
+  SinkCapabilities capabilities_;
+  Message* to_be_send_;
+  // Requests waiting for a reply, in the order they were sent
+  std::list<Request::ID> sent_;
+  bool capabilities_changed_;
+};
+
+std::unique_ptr<Message> M3Handler::CreateMessage() {
+  return CreateM3(sender_, ToSourceMediaManager(manager_));
+}
+
+bool M3Handler::HandleReply(Reply* reply) {
+  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
+  SinkCapabilities capabilities;
+  if (!ParseM3Reply(reply, source_manager->GetSessionType(), &capabilities) ||
+      !InitOptimalFormats(source_manager, capabilities))
+    return false;
+
+  source_manager->SinkCapabilitiesReceived(capabilities);
+  return true;
+}
+
+std::unique_ptr<Message> M4Handler::CreateMessage() {
+  return CreateM4(sender_, ToSourceMediaManager(manager_));
+}
+
 bool M4Handler::HandleReply(Reply* reply) {
   return (reply->response_code() == rtsp::STATUS_OK);
 }
 
+CachedCapabilitiesHandler::CachedCapabilitiesHandler(
+    const InitParams& init_params, const SinkCapabilities& capabilities)
+  : MessageSenderBase(init_params),
+    capabilities_(capabilities),
+    to_be_send_(nullptr),
+    capabilities_changed_(false) {
+}
+
+void CachedCapabilitiesHandler::Start() {
+  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
+  SendRequest(CreateM3(sender_, source_manager), Request::M3);
+  SendRequest(CreateM4(sender_, source_manager), Request::M4);
+}
+
+void CachedCapabilitiesHandler::Reset() {
+  to_be_send_ = nullptr;
+  sent_.clear();
+  capabilities_changed_ = false;
+  MessageSenderBase::Reset();
+}
+
+bool CachedCapabilitiesHandler::CanSend(Message* message) const {
+  return message && (message == to_be_send_);
+}
+
+void CachedCapabilitiesHandler::SendRequest(std::unique_ptr<Message> message,
+                                            Request::ID id) {
+  to_be_send_ = message.get();
+  sent_.push_back(id);
+  Send(std::move(message));
+  to_be_send_ = nullptr;
+}
+
+bool CachedCapabilitiesHandler::HandleReply(Reply* reply) {
+  assert(!sent_.empty());
+  Request::ID id = sent_.front();
+  sent_.pop_front();
+  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
+
+  if (id == Request::M3) {
+    SinkCapabilities capabilities;
+    if (!ParseM3Reply(reply, source_manager->GetSessionType(), &capabilities))
+      return false;
+    if (!IsSameCapabilities(capabilities, capabilities_)) {
+      WDS_LOG("Sink capabilities changed since the last session");
+      if (!InitOptimalFormats(source_manager, capabilities))
+        return false;
+      capabilities_ = capabilities;
+      capabilities_changed_ = true;
+    }
+    source_manager->SinkCapabilitiesReceived(capabilities);
+    return true;
+  }
+
+  // The M4 for the cached capabilities is answered after M3, a sink that
+  // changed may well have rejected it
+  if (capabilities_changed_) {
+    capabilities_changed_ = false;
+    SendRequest(CreateM4(sender_, source_manager), Request::M4);
+    return true;
+  }
+  return (reply->response_code() == rtsp::STATUS_OK);
+}
+
 CapNegotiationState::CapNegotiationState(const InitParams &init_params)
   : MessageSequenceHandler(init_params) {
   AddSequencedHandler(make_ptr(new M3Handler(init_params)));
@@ -175,5 +364,40 @@ CapNegotiationState::CapNegotiationState(const InitParams &init_params)
 CapNegotiationState::~CapNegotiationState() {
 }
 
+void CapNegotiationState::Start() {
+  if (current_handler_)
+    return;
+
+  SourceMediaManager* source_manager = ToSourceMediaManager(manager_);
+  SinkCapabilities capabilities;
+  if (!source_manager->GetCachedSinkCapabilities(&capabilities) ||
+      !InitOptimalFormats(source_manager, capabilities)) {
+    MessageSequenceHandler::Start();
+    return;
+  }
+
+  WDS_LOG("Sending M4 for the cached sink capabilities");
+  cached_handler_ = make_ptr(new CachedCapabilitiesHandler(
+      {sender_, manager_, this}, capabilities));
+  current_handler_ = cached_handler_;
+  current_handler_->Start();
+}
+
+void CapNegotiationState::Reset() {
+  MessageSequenceHandler::Reset();
+  cached_handler_.reset();
+}
+
+void CapNegotiationState::OnCompleted(MessageHandlerPtr handler) {
+  if (handler != cached_handler_) {
+    MessageSequenceHandler::OnCompleted(handler);
+    return;
+  }
+  // Replaces both M3 and M4 handlers
+  assert(handler == current_handler_);
+  current_handler_->Reset();
+  observer_->OnCompleted(shared_from_this());
+}
+
 }  // namespace source
 }  // namespace wds
@@ -28,11 +28,20 @@ namespace wds {
 namespace source {
 
 // Capability negotiation state for RTSP source.
-// Includes M3 and M4 messages handling
+// Includes M3 and M4 messages handling. If the media manager knows the
+// sink from an earlier session M4 does not wait for the M3 reply.
 class CapNegotiationState : public MessageSequenceHandler {
  public:
   CapNegotiationState(const InitParams& init_params);
   ~CapNegotiationState() override;
+
+  void Start() override;
+  void Reset() override;
+
+ private:
+  void OnCompleted(MessageHandlerPtr handler) override;
+
+  MessageHandlerPtr cached_handler_;
 };
 
 }  // source
@@ -72,8 +72,13 @@ class M6Handler final : public MessageReceiver<Request::M6> {
 
     auto transport = new rtsp::TransportHeader();
     // we assume here that there is no coupled secondary sink
-    transport->set_client_port(ToSourceMediaManager(manager_)->GetSinkRtpPorts().first);
+    int sink_port = ToSourceMediaManager(manager_)->GetSinkRtpPorts().first;
+    bool rtcp = message->header().transport().client_supports_rtcp() &&
+                ToSourceMediaManager(manager_)->SetSinkRtcpPort(sink_port + 1);
+    transport->set_client_port(sink_port);
+    transport->set_client_supports_rtcp(rtcp);
     transport->set_server_port(ToSourceMediaManager(manager_)->GetLocalRtpPort());
+    transport->set_server_supports_rtcp(rtcp);
     reply->header().set_transport(transport);
 
     return reply;
@@ -92,12 +97,17 @@ M7Handler::M7Handler(const InitParams& init_params)
   : MessageReceiver<Request::M7>(init_params) {
 }
 
-std::unique_ptr<Reply> M7Handler::HandleMessage(
-    Message* message) {
-  if (!manager_->IsPaused())
-    return std::unique_ptr<Reply>(new Reply(rtsp::STATUS_NotAcceptable));
-  manager_->Play();
-  return std::unique_ptr<Reply>(new Reply(rtsp::STATUS_OK));
+void M7Handler::HandleMessageAsync(Message* message,
+                                   const ReplyCallback& send_reply) {
+  if (!manager_->IsPaused()) {
+    send_reply(std::unique_ptr<Reply>(new Reply(rtsp::STATUS_NotAcceptable)));
+    return;
+  }
+  // Replied to once the stream is actually playing
+  manager_->PlayAsync([send_reply](bool playing) {
+    send_reply(std::unique_ptr<Reply>(new Reply(
+        playing ? rtsp::STATUS_OK : rtsp::STATUS_InternalServerError)));
+  });
 }
 
 M16Sender::M16Sender(const InitParams& init_params)
@@ -28,9 +28,11 @@
 #include "libwds/common/message_handler.h"
 #include "libwds/common/rtsp_input_handler.h"
 #include "libwds/public/wds_export.h"
+#include "libwds/rtsp/avformatchangetiming.h"
 #include "libwds/rtsp/getparameter.h"
 #include "libwds/rtsp/setparameter.h"
 #include "libwds/rtsp/triggermethod.h"
+#include "libwds/rtsp/videoformats.h"
 #include "libwds/public/media_manager.h"
 
 namespace wds {
@@ -91,11 +93,17 @@ class SourceStateMachine : public MessageSequenceHandler {
    SourceStateMachine(const InitParams& init_params, unsigned& timer_id)
      : MessageSequenceHandler(init_params) {
      MessageHandlerPtr m16_sender = make_ptr(new source::M16Sender(init_params));
+     m16_sender_ = std::static_pointer_cast<source::M16Sender>(m16_sender);
      AddSequencedHandler(make_ptr(new source::InitState(init_params)));
      AddSequencedHandler(make_ptr(new source::CapNegotiationState(init_params)));
      AddSequencedHandler(make_ptr(new source::SessionState(init_params, timer_id, m16_sender)));
      AddSequencedHandler(make_ptr(new source::StreamingState(init_params, m16_sender)));
    }
+
+   bool KeepAlivePending() const { return m16_sender_->HasPendingReplies(); }
+
+ private:
+   std::shared_ptr<source::M16Sender> m16_sender_;
 };
 
 class SourceImpl final : public Source, public RTSPInputHandler, public MessageHandler::Observer {
@@ -110,12 +118,14 @@ class SourceImpl final : public Source, public RTSPInputHandler, public MessageH
   bool Teardown() override;
   bool Play() override;
   bool Pause() override;
+  bool ChangeVideoFormat(const H264VideoFormat& format) override;
 
   // public MessageHandler::Observer
   void OnCompleted(MessageHandlerPtr handler) override;
   void OnError(MessageHandlerPtr handler) override;
 
   void OnTimerEvent(unsigned timer_id) override;
+  void OnSendQueueStateChanged(bool congested) override;
 
   // RTSPInputHandler
   void MessageParsed(std::unique_ptr<Message> message) override;
@@ -130,6 +140,7 @@ class SourceImpl final : public Source, public RTSPInputHandler, public MessageH
   Delegate* delegate_;
   SourceMediaManager* media_manager_;
   Peer::Observer* observer_;
+  bool send_queue_congested_;
 };
 
 SourceImpl::SourceImpl(Delegate* delegate, SourceMediaManager* mng, Peer::Observer* observer)
@@ -137,7 +148,8 @@ SourceImpl::SourceImpl(Delegate* delegate, SourceMediaManager* mng, Peer::Observ
     state_machine_(new SourceStateMachine({delegate, mng, this}, keep_alive_timer_)),
     delegate_(delegate),
     media_manager_(mng),
-    observer_(observer) {
+    observer_(observer),
+    send_queue_congested_(false) {
 }
 
 void SourceImpl::Start() {
@@ -160,8 +172,20 @@ void SourceImpl::OnTimerEvent(unsigned timer_id) {
     observer_->ErrorOccurred(TimeoutError);
 }
 
+void SourceImpl::OnSendQueueStateChanged(bool congested) {
+  send_queue_congested_ = congested;
+}
+
 void SourceImpl::SendKeepAlive() {
   delegate_->ReleaseTimer(keep_alive_timer_);
+  // The previous keep-alive is still stuck in the send queue or waiting
+  // for its reply, another one would only queue up behind it.
+  if (send_queue_congested_ && state_machine_->KeepAlivePending()) {
+    WDS_LOG("Keep-alive skipped, RTSP send queue is congested");
+    keep_alive_timer_ =
+        delegate_->CreateTimer(kDefaultKeepAliveTimeout - kDefaultTimeoutValue);
+    return;
+  }
   auto get_param = std::unique_ptr<Request>(
       new rtsp::GetParameter("rtsp://localhost/wfd1.0"));
   get_param->header().set_cseq(delegate_->GetNextCSeq());
@@ -188,6 +212,25 @@ std::unique_ptr<Message> CreateM5(int send_cseq, rtsp::TriggerMethod::Method met
   return std::move(set_param);
 }
 
+std::unique_ptr<Message> CreateM4(int send_cseq, const H264VideoFormat& format,
+                                  unsigned long long pts,
+                                  unsigned long long dts) {
+  auto set_param = std::unique_ptr<Request>(
+      new rtsp::SetParameter("rtsp://localhost/wfd1.0"));
+  set_param->header().set_cseq(send_cseq);
+  auto payload = new rtsp::PropertyMapPayload();
+  payload->AddProperty(
+      std::shared_ptr<rtsp::Property>(new rtsp::VideoFormats(
+          NativeVideoFormat(),  // Should be all zeros.
+          false,
+          {format})));
+  payload->AddProperty(
+      std::shared_ptr<rtsp::Property>(new rtsp::AVFormatChangeTiming(pts, dts)));
+  set_param->set_payload(std::unique_ptr<rtsp::Payload>(payload));
+  set_param->set_id(Request::M4);
+  return std::move(set_param);
+}
+
 }
 
 bool SourceImpl::Teardown() {
@@ -220,6 +263,23 @@ bool SourceImpl::Pause() {
   return true;
 }
 
+bool SourceImpl::ChangeVideoFormat(const H264VideoFormat& format) {
+  // Neither a CSeq nor a timing is taken for a change that is refused
+  auto m4 = CreateM4(0, format, 0, 0);
+  if (!state_machine_->CanSend(m4.get()))
+    return false;
+
+  unsigned long long pts = 0;
+  unsigned long long dts = 0;
+  if (!media_manager_->GetVideoFormatChangeTiming(format, &pts, &dts)) {
+    WDS_WARNING("The media manager cannot change the video format");
+    return false;
+  }
+  m4 = CreateM4(delegate_->GetNextCSeq(), format, pts, dts);
+  state_machine_->Send(std::move(m4));
+  return true;
+}
+
 void SourceImpl::OnCompleted(MessageHandlerPtr handler) {
   assert(handler == state_machine_);
   if (observer_)
@@ -25,6 +25,7 @@
 #include "libwds/source/cap_negotiation_state.h"
 #include "libwds/source/session_state.h"
 #include "libwds/rtsp/reply.h"
+#include "libwds/rtsp/videoformats.h"
 
 namespace wds {
 
@@ -54,14 +55,17 @@ class M9Handler final : public MessageReceiver<Request::M9> {
     : MessageReceiver<Request::M9>(init_params) {
   }
 
-  std::unique_ptr<Reply> HandleMessage(
-      Message* message) override {
-    int response_code = rtsp::STATUS_NotAcceptable;
-    if (!manager_->IsPaused()) {
-      manager_->Pause();
-      response_code = rtsp::STATUS_OK;
+  void HandleMessageAsync(Message* message,
+                          const ReplyCallback& send_reply) override {
+    if (manager_->IsPaused()) {
+      send_reply(std::unique_ptr<Reply>(new Reply(rtsp::STATUS_NotAcceptable)));
+      return;
     }
-    return std::unique_ptr<Reply>(new Reply(response_code));
+    // Same as for PLAY, see M7Handler
+    manager_->PauseAsync([send_reply](bool paused) {
+      send_reply(std::unique_ptr<Reply>(new Reply(
+          paused ? rtsp::STATUS_OK : rtsp::STATUS_InternalServerError)));
+    });
   }
 };
 
@@ -75,6 +79,46 @@ class M5Sender final : public OptionalMessageSender<Request::M5> {
   }
 };
 
+// M4 changing the video format of the stream, see Source::ChangeVideoFormat()
+class M4Sender final : public OptionalMessageSender<Request::M4> {
+ public:
+  M4Sender(const InitParams& init_params)
+    : OptionalMessageSender<Request::M4>(init_params) {
+  }
+
+ private:
+  bool CanSend(Message* message) const override {
+    // One format change at a time
+    return OptionalMessageSender<Request::M4>::CanSend(message) &&
+           !HasPendingReplies();
+  }
+
+  void Send(std::unique_ptr<Message> message) override {
+    auto payload = ToPropertyMapPayload(message->payload());
+    auto video_formats = payload ? static_cast<rtsp::VideoFormats*>(
+        payload->GetProperty(rtsp::VideoFormatsPropertyType).get()) : nullptr;
+    if (!video_formats || video_formats->GetH264Formats().size() != 1) {
+      observer_->OnError(shared_from_this());
+      return;
+    }
+    format_ = video_formats->GetH264Formats()[0];
+    OptionalMessageSender<Request::M4>::Send(std::move(message));
+  }
+
+  bool HandleReply(Reply* reply) override {
+    // The session goes on in the current format
+    if (reply->response_code() != rtsp::STATUS_OK) {
+      WDS_WARNING("Sink rejected the video format change");
+      return true;
+    }
+    if (!ToSourceMediaManager(manager_)->ChangeVideoFormat(format_))
+      WDS_WARNING("Cannot switch to the video format the sink accepted");
+    return true;
+  }
+
+  H264VideoFormat format_;
+};
+
 class M13Handler final : public MessageReceiver<Request::M13> {
  public:
   M13Handler(const InitParams& init_params)
@@ -93,6 +137,7 @@ StreamingState::StreamingState(const InitParams& init_params,
   : MessageSequenceWithOptionalSetHandler(init_params) {
   AddSequencedHandler(make_ptr(new M8Handler(init_params)));
 
+  AddOptionalHandler(make_ptr(new M4Sender(init_params)));
   AddOptionalHandler(make_ptr(new M5Sender(init_params)));
   AddOptionalHandler(make_ptr(new M7Handler(init_params)));
   AddOptionalHandler(make_ptr(new M9Handler(init_params)));
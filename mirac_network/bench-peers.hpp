@@ -0,0 +1,198 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+
+#ifndef BENCH_PEERS_HPP
+#define BENCH_PEERS_HPP
+
+#include <functional>
+#include <memory>
+#include <string>
+
+#include "libwds/public/media_manager.h"
+#include "libwds/public/sink.h"
+#include "libwds/public/source.h"
+#include "mirac-broker.hpp"
+
+/*
+ * Media-less source and sink sessions for the network benchmarks: they run
+ * the real wds state machines over MiracBroker but never touch GStreamer.
+ */
+
+namespace bench {
+
+inline wds::H264VideoCodec AllModesCodec(wds::H264Profile profile)
+{
+    wds::RateAndResolutionsBitmap cea_rr, vesa_rr, hh_rr;
+    for (wds::RateAndResolution i = wds::CEA640x480p60; i <= wds::CEA1920x1080p24; ++i)
+        cea_rr.set(i);
+    for (wds::RateAndResolution i = wds::VESA800x600p30; i <= wds::VESA1920x1200p30; ++i)
+        vesa_rr.set(i);
+    for (wds::RateAndResolution i = wds::HH800x480p30; i <= wds::HH848x480p60; ++i)
+        hh_rr.set(i);
+    return wds::H264VideoCodec(profile, wds::k4_2, cea_rr, vesa_rr, hh_rr);
+}
+
+class SourceMediaManager : public wds::SourceMediaManager
+{
+    public:
+        explicit SourceMediaManager (std::function<void()> on_play)
+            : on_play_(on_play), playing_(false), port1_(0), port2_(0) {}
+
+        void Play() override
+            { playing_ = true; if (on_play_) on_play_(); }
+        void Pause() override { playing_ = false; }
+        void Teardown() override { playing_ = false; }
+        bool IsPaused() const override { return !playing_; }
+        std::string GetSessionId() const override { return "bench"; }
+        wds::SessionType GetSessionType() const override
+            { return wds::VideoSession; }
+        void SetSinkRtpPorts(int port1, int port2) override
+            { port1_ = port1; port2_ = port2; }
+        std::pair<int,int> GetSinkRtpPorts() const override
+            { return std::pair<int,int>(port1_, port2_); }
+        int GetLocalRtpPort() const override { return 0; }
+
+        bool InitOptimalVideoFormat(const wds::NativeVideoFormat& native,
+            const std::vector<wds::H264VideoCodec>& codecs) override
+            {
+                bool success = false;
+                format_ = wds::FindOptimalVideoFormat(native,
+                    {AllModesCodec(wds::CHP)}, codecs, &success);
+                return success;
+            }
+        wds::H264VideoFormat GetOptimalVideoFormat() const override
+            { return format_; }
+        bool InitOptimalAudioFormat(const std::vector<wds::AudioCodec>&) override
+            { return true; }
+        wds::AudioCodec GetOptimalAudioFormat() const override
+            { return wds::AudioCodec(); }
+        void SendIDRPicture() override {}
+        bool SetSinkRtcpPort(int) override { return false; }
+
+    private:
+        std::function<void()> on_play_;
+        bool playing_;
+        int port1_;
+        int port2_;
+        wds::H264VideoFormat format_;
+};
+
+class SinkMediaManager : public wds::SinkMediaManager
+{
+    public:
+        SinkMediaManager (std::function<void()> on_play,
+                          std::function<void()> on_teardown,
+                          std::function<void()> on_pause = nullptr)
+            : on_play_(on_play), on_teardown_(on_teardown),
+              on_pause_(on_pause), playing_(false) {}
+
+        void Play() override
+            { playing_ = true; if (on_play_) on_play_(); }
+        void Pause() override
+            { playing_ = false; if (on_pause_) on_pause_(); }
+        void Teardown() override
+            { playing_ = false; if (on_teardown_) on_teardown_(); }
+        bool IsPaused() const override { return !playing_; }
+        std::string GetSessionId() const override { return session_; }
+        std::pair<int,int> GetLocalRtpPorts() const override
+            { return std::pair<int,int>(1028, 0); }
+        void SetPresentationUrl(const std::string& url) override
+            { url_ = url; }
+        std::string GetPresentationUrl() const override { return url_; }
+        void SetSessionId(const std::string& session) override
+            { session_ = session; }
+        std::vector<wds::H264VideoCodec> GetSupportedH264VideoCodecs() const override
+            { return {AllModesCodec(wds::CHP), AllModesCodec(wds::CBP)}; }
+        wds::NativeVideoFormat GetNativeVideoFormat() const override
+            { return wds::NativeVideoFormat(wds::CEA1920x1080p60); }
+        bool SetOptimalVideoFormat(const wds::H264VideoFormat&) override
+            { return true; }
+        wds::ConnectorType GetConnectorType() const override
+            { return wds::ConnectorTypeNone; }
+        bool IsRtcpSupported() const override { return false; }
+        void SetSourceRtcpPort(int) override {}
+
+    private:
+        std::function<void()> on_play_;
+        std::function<void()> on_teardown_;
+        std::function<void()> on_pause_;
+        bool playing_;
+        std::string url_;
+        std::string session_;
+};
+
+/* source side of a session, created for an accepted connection */
+class SourceSession : public MiracBroker
+{
+    public:
+        SourceSession (MiracNetwork* connection, std::function<void()> on_play)
+            : MiracBroker(connection),
+              media_manager_(on_play),
+              source_(wds::Source::Create(this, &media_manager_))
+            { source_->Start(); }
+
+        wds::Peer* Peer() const override { return source_.get(); }
+
+    private:
+        void got_message(const std::string& data) override
+            { source_->RTSPDataReceived(data); }
+
+        SourceMediaManager media_manager_;
+        std::unique_ptr<wds::Source> source_;
+};
+
+/* sink side of a session, connects to the source on creation */
+class SinkSession : public MiracBroker
+{
+    public:
+        SinkSession (const std::string& host, const std::string& port,
+                     std::function<void()> on_play,
+                     std::function<void()> on_teardown = nullptr,
+                     std::function<void()> on_pause = nullptr)
+            : MiracBroker(host, port),
+              media_manager_(on_play, on_teardown, on_pause),
+              failed_(false) {}
+
+        wds::Sink* sink() const { return sink_.get(); }
+        wds::Peer* Peer() const override { return sink_.get(); }
+        bool failed() const { return failed_; }
+
+    private:
+        void got_message(const std::string& data) override
+            { sink_->RTSPDataReceived(data); }
+        void on_connected() override
+            {
+                sink_.reset(wds::Sink::Create(this, &media_manager_));
+                sink_->Start();
+            }
+        void on_connection_failure(ConnectionFailure failure) override
+            { failed_ = true; }
+
+        SinkMediaManager media_manager_;
+        std::unique_ptr<wds::Sink> sink_;
+        bool failed_;
+};
+
+}  // namespace bench
+
+#endif  /* BENCH_PEERS_HPP */
@@ -0,0 +1,158 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Measures the CPU time per frame of the desktop capture path: colour
+ * conversion with videoconvert against miracscreenconvert, alone and
+ * followed by x264enc, for an idle desktop (a still picture) and a full
+ * motion one (the picture scrolling every frame). videotestsrc stands in
+ * for ximagesrc so that the numbers do not depend on an X server; its own
+ * cost is measured separately and subtracted.
+ */
+
+#include <glib.h>
+#include <gst/gst.h>
+#include <sys/resource.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <string>
+
+#include "mirac-gst-screen-convert.hpp"
+
+static gint64 cpu_time ()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+    return (gint64) (usage.ru_utime.tv_sec + usage.ru_stime.tv_sec) * G_USEC_PER_SEC +
+           usage.ru_utime.tv_usec + usage.ru_stime.tv_usec;
+}
+
+// Runs the pipeline to EOS, returns the CPU milliseconds per frame or a
+// negative value on failure; static_share gets the static frames seen by
+// an element named "screenconvert"
+static double run_pipeline (const std::string& description, int frames, double* static_share)
+{
+    GError* error = NULL;
+    GstElement* pipeline = gst_parse_launch(description.c_str(), &error);
+    if (!pipeline) {
+        g_printerr("Cannot create pipeline: %s\n", error->message);
+        g_error_free(error);
+        return -1;
+    }
+
+    gint64 start = cpu_time();
+    gst_element_set_state(pipeline, GST_STATE_PLAYING);
+    GstBus* bus = gst_element_get_bus(pipeline);
+    GstMessage* message = gst_bus_timed_pop_filtered(bus, GST_CLOCK_TIME_NONE,
+        (GstMessageType) (GST_MESSAGE_EOS | GST_MESSAGE_ERROR));
+    bool ok = GST_MESSAGE_TYPE(message) == GST_MESSAGE_EOS;
+    gst_message_unref(message);
+    gst_object_unref(bus);
+    double ms_per_frame = (cpu_time() - start) / 1000.0 / frames;
+
+    GstElement* convert = gst_bin_get_by_name(GST_BIN(pipeline), "screenconvert");
+    if (convert) {
+        MiracScreenConvertStats stats = MiracScreenConvertGetStats(convert);
+        *static_share = stats.frames ? 100.0 * stats.static_frames / stats.frames : 0;
+        gst_object_unref(convert);
+    }
+
+    gst_element_set_state(pipeline, GST_STATE_NULL);
+    gst_object_unref(pipeline);
+    return ok ? ms_per_frame : -1;
+}
+
+int main (int argc, char *argv[])
+{
+    gint frames = 300;
+    gint width = 1920;
+    gint height = 1080;
+
+    GOptionEntry main_entries[] =
+    {
+        { "frames", 0, 0, G_OPTION_ARG_INT, &frames, "Number of frames per run, 300 by default", "count"},
+        { "width", 0, 0, G_OPTION_ARG_INT, &width, "Frame width, 1920 by default", "pixels"},
+        { "height", 0, 0, G_OPTION_ARG_INT, &height, "Frame height, 1080 by default", "pixels"},
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- desktop capture path benchmark");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    g_option_context_add_group (context, gst_init_get_option_group ());
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("option parsing failed: %s\n", error->message);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    if (!MiracRegisterScreenConvert()) {
+        g_printerr("Cannot register miracscreenconvert\n");
+        return 1;
+    }
+    frames = std::max(frames, 1);
+
+    struct {
+        const char* name;
+        const char* source;
+    } scenes[] = {
+        { "idle", "pattern=smpte" },
+        { "motion", "pattern=smpte horizontal-speed=16" },
+    };
+    struct {
+        const char* name;
+        const char* elements;
+    } converters[] = {
+        { "videoconvert", "videoconvert" },
+        { "miracscreenconvert", "miracscreenconvert name=screenconvert" },
+    };
+    const std::string encoder =
+        " ! x264enc tune=zerolatency speed-preset=ultrafast bitrate=8000";
+
+    g_print("%dx%d, CPU ms per frame without the capture itself\n", width, height);
+    g_print("%-7s %-19s %9s %9s %8s\n", "desktop", "converter", "convert", "+encode", "static");
+    for (const auto& scene : scenes) {
+        std::string source = "videotestsrc num-buffers=" + std::to_string(frames) + " " +
+            scene.source + " ! video/x-raw,format=BGRx,framerate=60/1,width=" +
+            std::to_string(width) + ",height=" + std::to_string(height);
+        double unused;
+        double capture = run_pipeline(source + " ! fakesink", frames, &unused);
+        if (capture < 0)
+            return 1;
+
+        for (const auto& converter : converters) {
+            std::string converted = source + " ! " + converter.elements +
+                                    " ! video/x-raw,format=I420";
+            double static_share = 0;
+            double convert = run_pipeline(converted + " ! fakesink", frames, &static_share);
+            double encode = run_pipeline(converted + encoder + " ! fakesink", frames, &unused);
+            if (convert < 0 || encode < 0)
+                return 1;
+            g_print("%-7s %-19s %9.2f %9.2f %7.0f%%\n", scene.name, converter.name,
+                    convert - capture, encode - capture, static_share);
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,229 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Connection churn benchmark: every sink connects, runs the session setup
+ * (M1..M7), pauses (M9), resumes (M7), tears down (M8) and disconnects.
+ * The source side runs in a single MiracListenerPool worker, so the CPU
+ * time reported per connection covers both ends of the session including
+ * the disconnect handling.
+ */
+
+#include <glib.h>
+#include <sys/resource.h>
+
+#include <cstdio>
+#include <functional>
+#include <list>
+#include <memory>
+
+#include "bench-peers.hpp"
+#include "mirac-listener-pool.hpp"
+
+class ChurnClient
+{
+    public:
+        ChurnClient (const std::string& port, uint connections, uint parallel)
+            : port_(port), remaining_(connections), parallel_(parallel),
+              completed_(0), failed_(0),
+              loop_(g_main_loop_new(NULL, FALSE))
+            { }
+        ~ChurnClient ()
+            { g_main_loop_unref(loop_); }
+
+        void run ()
+            {
+                last_progress_ = g_get_monotonic_time();
+                for (uint i = 0; i < parallel_ && remaining_ > 0; i++)
+                    start();
+
+                GSource *source = g_timeout_source_new(10);
+                g_source_set_callback(source, check_cb, this, NULL);
+                g_source_attach(source, NULL);
+                g_source_unref(source);
+
+                g_main_loop_run(loop_);
+                sessions_.clear();
+            }
+
+        uint completed() const { return completed_; }
+        uint failed() const { return failed_; }
+
+    private:
+        struct Session
+        {
+            std::unique_ptr<bench::SinkSession> sink;
+            bool resumed;
+            bool done;
+            uint pending;   /* deferred steps still queued */
+        };
+
+        struct Step
+        {
+            Session* session;
+            std::function<void(wds::Sink*)> run;
+        };
+
+        /* libwds is not re-entrant from its own media manager calls,
+         * so every step of the session runs from an idle callback */
+        static void defer (Session* session, std::function<void(wds::Sink*)> run)
+            {
+                session->pending++;
+                g_idle_add_full(G_PRIORITY_DEFAULT_IDLE, run_step_cb,
+                                new Step { session, run }, delete_step_cb);
+            }
+        static gboolean run_step_cb (gpointer data_ptr)
+            {
+                Step* step = static_cast<Step*> (data_ptr);
+                if (!step->session->sink->failed())
+                    step->run(step->session->sink->sink());
+                return G_SOURCE_REMOVE;
+            }
+        static void delete_step_cb (gpointer data_ptr)
+            {
+                Step* step = static_cast<Step*> (data_ptr);
+                step->session->pending--;
+                delete step;
+            }
+
+        static gboolean check_cb (gpointer data_ptr)
+            { return static_cast<ChurnClient*> (data_ptr)->check(); }
+
+        void start ()
+            {
+                remaining_--;
+                sessions_.push_back(Session());
+                Session* session = &sessions_.back();
+                session->resumed = false;
+                session->done = false;
+                session->pending = 0;
+                session->sink.reset(new bench::SinkSession("127.0.0.1", port_,
+                    [this, session] { on_play(session); },
+                    [this, session] { on_teardown(session); },
+                    [this, session] { on_pause(session); }));
+            }
+
+        void on_play (Session* session)
+            {
+                if (!session->resumed)
+                    defer(session, [] (wds::Sink* sink) { sink->Pause(); });
+                else
+                    defer(session, [] (wds::Sink* sink) { sink->Teardown(); });
+            }
+
+        void on_pause (Session* session)
+            {
+                session->resumed = true;
+                defer(session, [] (wds::Sink* sink) { sink->Play(); });
+            }
+
+        void on_teardown (Session* session)
+            {
+                session->done = true;
+                completed_++;
+                last_progress_ = g_get_monotonic_time();
+            }
+
+        /* finished and failed sessions are disconnected and replaced */
+        gboolean check ()
+            {
+                for (auto it = sessions_.begin(); it != sessions_.end();) {
+                    if ((it->done || it->sink->failed()) && it->pending == 0) {
+                        if (!it->done)
+                            failed_++;
+                        it = sessions_.erase(it);
+                        if (remaining_ > 0)
+                            start();
+                    } else {
+                        ++it;
+                    }
+                }
+                /* give up on sessions that stopped making progress */
+                gint64 stalled = g_get_monotonic_time() - last_progress_;
+                if (!sessions_.empty() && stalled < 10 * G_USEC_PER_SEC)
+                    return G_SOURCE_CONTINUE;
+                failed_ += sessions_.size() + remaining_;
+                g_main_loop_quit(loop_);
+                return G_SOURCE_REMOVE;
+            }
+
+        std::string port_;
+        uint remaining_;
+        uint parallel_;
+        uint completed_;
+        uint failed_;
+        gint64 last_progress_;
+        GMainLoop *loop_;
+        std::list<Session> sessions_;
+};
+
+static double cpu_seconds (const struct rusage& usage)
+{
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec +
+           (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+int main (int argc, char *argv[])
+{
+    gint connections = 2000;
+    gint parallel = 16;
+
+    GOptionEntry main_entries[] =
+    {
+        { "connections", 0, 0, G_OPTION_ARG_INT, &connections, "Number of sink connections, 2000 by default", "count"},
+        { "parallel", 0, 0, G_OPTION_ARG_INT, &parallel, "Number of sessions in flight, 16 by default", "count"},
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- RTSP connection churn benchmark");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("option parsing failed: %s\n", error->message);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    MiracListenerPool pool("0", 1, [] (MiracNetwork* connection) {
+        return new bench::SourceSession(connection, nullptr);
+    });
+    ChurnClient client(std::to_string(pool.get_host_port()),
+                       std::max(connections, 1), std::max(parallel, 1));
+
+    struct rusage before, after;
+    getrusage(RUSAGE_SELF, &before);
+    gint64 start = g_get_monotonic_time();
+    client.run();
+    gint64 end = g_get_monotonic_time();
+    getrusage(RUSAGE_SELF, &after);
+
+    double secs = (end - start) / (double) G_USEC_PER_SEC;
+    double cpu = cpu_seconds(after) - cpu_seconds(before);
+    uint total = client.completed() + client.failed();
+    g_print("%9s %7s %14s %16s\n", "completed", "failed", "connections/s",
+            "cpu us/connection");
+    g_print("%9u %7u %14.0f %16.1f\n", client.completed(), client.failed(),
+            total / secs, total ? cpu * 1e6 / total : 0.0);
+
+    return 0;
+}
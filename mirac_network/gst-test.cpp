@@ -54,6 +54,10 @@ int main (int argc, char *argv[])
     gchar* wfd_stream_option = NULL;
     gchar* hostname_option = NULL;
     gint port = 0;
+    gint latency = MiracGstSink::default_latency;
+    gboolean glass_to_glass = FALSE;
+    gboolean lip_sync = FALSE;
+    gint stats_interval = 0;
     
     GOptionEntry main_entries[] =
     {
@@ -61,10 +65,14 @@ int main (int argc, char *argv[])
         { "stream", 0, 0, G_OPTION_ARG_STRING, &wfd_stream_option, "Specify WFD stream type for testsource: audio, video, both or desktop capture", "(audio|video|both|desktop)"},
         { "hostname", 0, 0, G_OPTION_ARG_STRING, &hostname_option, "Specify optional hostname or ip address to stream to or listen on", "host"},
         { "port", 0, 0, G_OPTION_ARG_INT, &port, "Specify optional UDP port number to stream to or listen on", "port"},
+        { "latency", 0, 0, G_OPTION_ARG_INT, &latency, "Specify sink jitterbuffer latency in milliseconds", "ms"},
+        { "stats", 0, 0, G_OPTION_ARG_INT, &stats_interval, "Log frame timing statistics every N seconds", "N"},
+        { "glass-to-glass", 0, 0, G_OPTION_ARG_NONE, &glass_to_glass, "Measure end-to-end latency with timestamps painted by the testsource (same host only)", NULL},
+        { "lip-sync", 0, 0, G_OPTION_ARG_NONE, &lip_sync, "Measure the audio/video offset with flashes and beeps sent by the testsource (--stream=both)", NULL},
         { NULL }
     };
 
-    context = g_option_context_new ("- WFD source/sink demo application\n\nExample:\ngst-test --device=testsource --stream=both --hostname=127.0.0.1 --port=5000\ngst-test --device=sink --port=5000");
+    context = g_option_context_new ("- WFD source/sink demo application\n\nExample:\ngst-test --device=testsource --stream=both --hostname=127.0.0.1 --port=5000\ngst-test --device=sink --port=5000\n\nGlass-to-glass latency on loopback:\ngst-test --device=sink --port=5000 --glass-to-glass\ngst-test --device=testsource --stream=video --hostname=127.0.0.1 --port=5000 --glass-to-glass\n\nLip-sync offset:\ngst-test --device=sink --port=5000 --lip-sync\ngst-test --device=testsource --stream=both --hostname=127.0.0.1 --port=5000 --lip-sync");
     g_option_context_add_main_entries (context, main_entries, NULL);
     
    if (!g_option_context_parse (context, &argc, &argv, &error)) {
@@ -97,12 +105,26 @@ int main (int argc, char *argv[])
     std::unique_ptr<MiracGstTestSource> source_pipeline;
 
     if (g_strcmp0(wfd_device_option, "testsource") == 0) {
-        source_pipeline.reset(new MiracGstTestSource(wfd_stream, hostname, port));
+        if (glass_to_glass || lip_sync) {
+            // Needs frames wide enough for the stamp, 640x480p60 is;
+            // audio is LPCM 48 kHz stereo
+            wds::AudioCodec audio_codec;
+            source_pipeline.reset(new MiracGstTestSource(wfd_stream, wds::H264VideoFormat(),
+                                                         &audio_codec, hostname, port));
+            if (glass_to_glass)
+                source_pipeline->EnableFrameStamps();
+            if (lip_sync)
+                source_pipeline->EnableLipSyncMarkers();
+        } else {
+            source_pipeline.reset(new MiracGstTestSource(wfd_stream, hostname, port));
+        }
         source_pipeline->SetState(GST_STATE_PLAYING);
         WDS_LOG("Source UDP port: %d", source_pipeline->UdpSourcePort());
+        source_pipeline->FrameTiming().SetLogInterval(stats_interval);
     } else if (g_strcmp0(wfd_device_option, "sink") == 0) {
-        sink_pipeline.reset(new MiracGstSink(hostname, port));
+        sink_pipeline.reset(new MiracGstSink(hostname, port, latency, glass_to_glass, lip_sync));
         WDS_LOG("Listening on port %d", sink_pipeline->sink_udp_port());
+        sink_pipeline->FrameTiming().SetLogInterval(stats_interval);
     }
 
     g_free(wfd_device_option);
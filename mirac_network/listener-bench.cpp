@@ -0,0 +1,193 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Measures how RTSP accept rate and session setup rate (M1..M7) scale with
+ * the number of MiracListenerPool workers. The sink side is simulated by
+ * client threads, each running its own main loop.
+ */
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <memory>
+#include <thread>
+#include <vector>
+
+#include "bench-peers.hpp"
+#include "mirac-listener-pool.hpp"
+
+class ClientThread
+{
+    public:
+        ClientThread (const std::string& port, uint connections)
+            : port_(port), connections_(connections),
+              established_(0), failed_(0), done_time_(0)
+            { thread_ = std::thread(&ClientThread::run, this); }
+
+        void join() { thread_.join(); }
+        uint established() const { return established_; }
+        uint failed() const { return failed_; }
+        gint64 done_time() const { return done_time_; }
+
+    private:
+        static gboolean check_cb (gpointer data_ptr)
+            { return static_cast<ClientThread*> (data_ptr)->check(); }
+
+        gboolean check()
+            {
+                failed_ = std::count_if(sessions_.begin(), sessions_.end(),
+                    [] (const std::unique_ptr<bench::SinkSession>& session) {
+                        return session->failed();
+                    });
+                if (established_ + failed_ < connections_ &&
+                    g_get_monotonic_time() < deadline_)
+                    return G_SOURCE_CONTINUE;
+                done_time_ = g_get_monotonic_time();
+                g_main_loop_quit(loop_);
+                return G_SOURCE_REMOVE;
+            }
+
+        void run()
+            {
+                GMainContext *context = g_main_context_new();
+                g_main_context_push_thread_default(context);
+                loop_ = g_main_loop_new(context, FALSE);
+                deadline_ = g_get_monotonic_time() + 30 * G_USEC_PER_SEC;
+
+                for (uint i = 0; i < connections_; i++)
+                    sessions_.push_back(std::unique_ptr<bench::SinkSession>(
+                        new bench::SinkSession("127.0.0.1", port_,
+                                               [this] { ++established_; })));
+
+                GSource *source = g_timeout_source_new(1);
+                g_source_set_callback(source, check_cb, this, NULL);
+                g_source_attach(source, context);
+                g_source_unref(source);
+
+                g_main_loop_run(loop_);
+
+                sessions_.clear();
+                g_main_loop_unref(loop_);
+                g_main_context_pop_thread_default(context);
+                g_main_context_unref(context);
+            }
+
+        std::string port_;
+        uint connections_;
+        uint established_;
+        uint failed_;
+        gint64 done_time_;
+        gint64 deadline_;
+        GMainLoop *loop_;
+        std::vector<std::unique_ptr<bench::SinkSession>> sessions_;
+        std::thread thread_;
+};
+
+static void raise_fd_limit ()
+{
+    struct rlimit limit;
+    if (getrlimit(RLIMIT_NOFILE, &limit) == 0) {
+        limit.rlim_cur = limit.rlim_max;
+        setrlimit(RLIMIT_NOFILE, &limit);
+    }
+}
+
+static void run_round (uint workers, uint clients, uint connections)
+{
+    MiracListenerPool pool("0", workers, [] (MiracNetwork* connection) {
+        return new bench::SourceSession(connection, nullptr);
+    });
+    std::string port = std::to_string(pool.get_host_port());
+
+    gint64 start = g_get_monotonic_time();
+    std::vector<std::unique_ptr<ClientThread>> threads;
+    for (uint i = 0; i < clients; i++) {
+        uint count = connections / clients + (i < connections % clients ? 1 : 0);
+        threads.push_back(std::unique_ptr<ClientThread>(new ClientThread(port, count)));
+    }
+
+    /* accepted_count() is only polled here, never on the worker hot path */
+    gint64 accept_done = 0;
+    while (pool.accepted_count() < connections &&
+           g_get_monotonic_time() - start < 30 * G_USEC_PER_SEC)
+        g_usleep(100);
+    accept_done = g_get_monotonic_time();
+
+    uint established = 0, failed = 0;
+    gint64 setup_done = start;
+    for (auto& thread : threads) {
+        thread->join();
+        established += thread->established();
+        failed += thread->failed();
+        setup_done = std::max(setup_done, thread->done_time());
+    }
+
+    double accept_secs = (accept_done - start) / (double) G_USEC_PER_SEC;
+    double setup_secs = (setup_done - start) / (double) G_USEC_PER_SEC;
+    g_print("%7u %9lu %12.0f %9u %12.0f %7u\n", workers,
+            (unsigned long) pool.accepted_count(),
+            pool.accepted_count() / accept_secs,
+            established, established / setup_secs, failed);
+}
+
+int main (int argc, char *argv[])
+{
+    gint connections = 1000;
+    gint max_workers = sysconf(_SC_NPROCESSORS_ONLN);
+    gint clients = max_workers;
+
+    GOptionEntry main_entries[] =
+    {
+        { "connections", 0, 0, G_OPTION_ARG_INT, &connections, "Number of sink connections per round, 1000 by default", "count"},
+        { "workers", 0, 0, G_OPTION_ARG_INT, &max_workers, "Maximum number of listener workers, number of cores by default", "count"},
+        { "clients", 0, 0, G_OPTION_ARG_INT, &clients, "Number of sink client threads, number of cores by default", "count"},
+        { NULL }
+    };
+
+    GError *error = NULL;
+    GOptionContext *context = g_option_context_new ("- SO_REUSEPORT listener pool benchmark");
+    g_option_context_add_main_entries (context, main_entries, NULL);
+    if (!g_option_context_parse (context, &argc, &argv, &error)) {
+        g_printerr ("option parsing failed: %s\n", error->message);
+        g_option_context_free(context);
+        return 1;
+    }
+    g_option_context_free(context);
+
+    raise_fd_limit();
+
+    g_print("%7s %9s %12s %9s %12s %7s\n", "workers", "accepted",
+            "accepts/s", "sessions", "sessions/s", "failed");
+    max_workers = std::max(max_workers, 1);
+    for (gint workers = 1; ; workers = std::min(workers * 2, max_workers)) {
+        run_round(workers, std::max(clients, 1), std::max(connections, 1));
+        if (workers == max_workers)
+            break;
+    }
+
+    return 0;
+}
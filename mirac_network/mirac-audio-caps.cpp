@@ -0,0 +1,70 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mirac-audio-caps.hpp"
+
+// Channel counts in mode bit order, see audio_codec.h
+static const unsigned aac_channels[] = { 2, 4, 6, 8 };
+static const unsigned ac3_channels[] = { 2, 4, 6 };
+
+static unsigned lowest_mode (const wds::AudioModes &modes, unsigned count)
+{
+    for (unsigned mode = 0; mode < count; mode++)
+        if (modes.test(mode))
+            return mode;
+    return 0;
+}
+
+MiracAudioEncoding MiracAudioEncodingFor (const wds::AudioCodec &codec)
+{
+    MiracAudioEncoding encoding;
+    encoding.format = codec.format;
+    encoding.rate = 48000;
+    encoding.channels = 2;
+
+    switch (codec.format) {
+    case wds::LPCM:
+        // dvdlpcmenc and mpegtsmux take 48 kHz but not 44.1 kHz; the
+        // former is mandatory for sinks anyway
+        encoding.encoder = "dvdlpcmenc";
+        break;
+    case wds::AAC:
+        encoding.channels = aac_channels[lowest_mode(codec.modes, G_N_ELEMENTS(aac_channels))];
+        encoding.encoder = "avenc_aac";
+        break;
+    case wds::AC3:
+        encoding.channels = ac3_channels[lowest_mode(codec.modes, G_N_ELEMENTS(ac3_channels))];
+        encoding.encoder = "avenc_ac3";
+        break;
+    }
+    return encoding;
+}
+
+GstCaps *MiracRawAudioCaps (const MiracAudioEncoding &encoding)
+{
+    GstCaps *caps = gst_caps_new_simple("audio/x-raw",
+                                        "rate", G_TYPE_INT, encoding.rate,
+                                        "channels", G_TYPE_INT, encoding.channels,
+                                        NULL);
+    if (encoding.format == wds::LPCM)
+        gst_caps_set_simple(caps, "format", G_TYPE_STRING, "S16BE", NULL);
+    return caps;
+}
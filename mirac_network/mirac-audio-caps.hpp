@@ -0,0 +1,45 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_AUDIO_CAPS_HPP
+#define MIRAC_AUDIO_CAPS_HPP
+
+#include <gst/gst.h>
+
+#include "libwds/public/audio_codec.h"
+
+// Encoder settings derived from a negotiated wfd_audio_codecs entry
+struct MiracAudioEncoding {
+    wds::AudioFormats format;
+    unsigned rate;
+    unsigned channels;
+    const char *encoder;    // element factory
+};
+
+// Uses the mode with the fewest channels if several are set. LPCM is
+// always LPCM_48K_16B_2CH.
+MiracAudioEncoding MiracAudioEncodingFor (const wds::AudioCodec &codec);
+
+// audio/x-raw caps forced in front of the encoder. LPCM is sent as
+// 16 bit big endian samples, with no encoding delay at all.
+GstCaps *MiracRawAudioCaps (const MiracAudioEncoding &encoding);
+
+#endif
@@ -19,8 +19,9 @@
  * 02110-1301 USA
  */
 
-#include <glib-unix.h>
 #include <algorithm>
+#include <cstring>
+#include <sys/socket.h>
 
 #include "mirac-broker.hpp"
 #include "mirac-glib-logging.hpp"
@@ -60,6 +61,13 @@ gboolean MiracBroker::connect_cb (gint fd, GIOCondition condition, gpointer data
     return (*broker)->connect_cb(fd, condition);
 }
 
+/* static C callback wrapper */
+gboolean MiracBroker::netlink_cb (gint fd, GIOCondition condition, gpointer data_ptr)
+{
+    auto broker = static_cast<MiracBroker**> (data_ptr);
+    return (*broker)->netlink_cb(fd, condition);
+}
+
 /* static C callback wrapper */
 gboolean MiracBroker::try_connect (gpointer data_ptr)
 {
@@ -70,14 +78,12 @@ gboolean MiracBroker::try_connect (gpointer data_ptr)
 
 gboolean MiracBroker::send_cb (gint fd, GIOCondition condition)
 {
-    try {
-        if (!connection_->Send())
-            return G_SOURCE_CONTINUE;
-    } catch (const MiracConnectionLostException &exception) {
-        on_connection_failure(CONNECTION_LOST);
-    } catch (const std::exception &x) {
-        WDS_WARNING("exception: %s", x.what());
-    }
+    MiracIoResult result = flush_send_queue();
+    if (result.status() == MiracIoResult::WouldBlock)
+        return G_SOURCE_CONTINUE;
+    send_watch_id_ = 0;
+    if (result.failed())
+        handle_io_failure(result);
     return G_SOURCE_REMOVE;
 }
 
@@ -85,18 +91,142 @@ gboolean MiracBroker::send_cb (gint fd, GIOCondition condition)
 gboolean MiracBroker::receive_cb (gint fd, GIOCondition condition)
 {
     std::string msg;
+    MiracIoResult result = connection_->TryReceive(msg);
+    if (result.done()) {
+        WDS_VLOG("Received RTSP message:\n%s", msg.c_str());
+        got_message (msg);
+    } else if (result.failed()) {
+        handle_io_failure(result);
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+gboolean MiracBroker::netlink_cb (gint fd, GIOCondition condition)
+{
     try {
-        if (connection_->Receive(msg)) {
-            WDS_VLOG("Received RTSP message:\n%s", msg.c_str());
-            got_message (msg);
+        if (netlink_->ProcessEvents()) {
+            local_address_.clear();
+            if (netlink_->GetAddress(interface_).empty())
+                WDS_WARNING("interface %s has no address", interface_.c_str());
         }
-    } catch (const MiracConnectionLostException &exception) {
-        on_connection_failure(CONNECTION_LOST);
-        return G_SOURCE_REMOVE;
+    } catch (const std::exception &x) {
+        WDS_WARNING("exception: %s", x.what());
     }
     return G_SOURCE_CONTINUE;
 }
 
+void MiracBroker::set_interface(const std::string& interface)
+{
+    interface_ = interface;
+    local_address_.clear();
+
+    /* SO_BINDTODEVICE also takes effect on a socket already listening */
+    if (network_)
+        network_->SetInterface(interface_);
+    if (connection_)
+        connection_->SetInterface(interface_);
+
+    remove_sources(&netlink_source_ptr_);
+    netlink_.reset();
+    if (interface_.empty())
+        return;
+
+    netlink_.reset(new MiracNetlink());
+    add_fd_watch(netlink_->GetHandle(), G_IO_IN,
+                 netlink_cb, &netlink_source_ptr_);
+}
+
+/* hands queued messages to the socket one at a time, so that the queue
+ * depth and the latency of each message can be accounted */
+MiracIoResult MiracBroker::flush_send_queue()
+{
+    MiracIoResult result = connection_->TrySend();
+    while (result.done()) {
+        if (in_flight_since_ > 0) {
+            gint64 latency = g_get_monotonic_time() - in_flight_since_;
+            send_stats_.messages++;
+            send_stats_.last_latency = latency;
+            send_stats_.max_latency = std::max(send_stats_.max_latency, latency);
+            send_stats_.total_latency += latency;
+            in_flight_since_ = 0;
+        }
+        if (send_queue_.empty())
+            break;
+
+        OutgoingMessage message = std::move(send_queue_.front());
+        send_queue_.pop_front();
+        send_queue_bytes_ -= message.data.size();
+        in_flight_since_ = message.queued_at;
+        result = connection_->TrySend(message.data);
+    }
+
+    update_send_queue_state();
+    return result;
+}
+
+size_t MiracBroker::send_queue_depth() const
+{
+    return send_queue_bytes_ +
+        (connection_ ? connection_->GetSendBufferSize() : 0);
+}
+
+void MiracBroker::update_send_queue_state()
+{
+    size_t depth = send_queue_depth();
+    send_stats_.depth = depth;
+    send_stats_.max_depth = std::max(send_stats_.max_depth, depth);
+
+    bool congested = send_queue_congested_ ?
+        depth > send_low_watermark_ : depth >= send_high_watermark_;
+    if (congested == send_queue_congested_)
+        return;
+
+    send_queue_congested_ = congested;
+    if (congested)
+        send_stats_.congestion_events++;
+    WDS_LOG("RTSP send queue %s (%zu bytes)",
+            congested ? "congested" : "drained", depth);
+
+    /* the peer only updates its state here, so this is safe even when
+     * called from inside libwds */
+    if (wds::Peer* peer = Peer())
+        peer->OnSendQueueStateChanged(congested);
+}
+
+void MiracBroker::reset_send_queue()
+{
+    send_queue_.clear();
+    send_queue_bytes_ = 0;
+    in_flight_since_ = 0;
+    send_watch_id_ = 0;
+    send_queue_congested_ = false;
+    send_stats_.depth = 0;
+}
+
+void MiracBroker::set_send_queue_limits(size_t low_watermark,
+                                        size_t high_watermark, size_t limit)
+{
+    send_low_watermark_ = low_watermark;
+    send_high_watermark_ = std::max(high_watermark, low_watermark);
+    send_queue_limit_ = std::max(limit, send_high_watermark_);
+}
+
+void MiracBroker::handle_io_failure (const MiracIoResult& result)
+{
+    if (result.status() == MiracIoResult::Error)
+        WDS_WARNING("%s failed: %s", result.call(), strerror(result.error()));
+    connection_lost_ = true;
+    report_failure(CONNECTION_LOST);
+}
+
+void MiracBroker::report_failure (ConnectionFailure failure)
+{
+    on_connection_failure(failure);
+    if (failure_callback_)
+        failure_callback_();
+}
+
 gboolean MiracBroker::listen_cb (gint fd, GIOCondition condition)
 {
     try {
@@ -125,30 +255,62 @@ gboolean MiracBroker::connect_cb (gint fd, GIOCondition condition)
     } catch (const std::exception &x) {
         gdouble elapsed = 1000 * g_timer_elapsed(connect_timer_, NULL);
         if (elapsed + connect_wait_ > connect_timeout_) {
-            on_connection_failure(CONNECTION_TIMEOUT);
+            report_failure(CONNECTION_TIMEOUT);
         } else {
-            connect_wait_id_ = g_timeout_add (connect_wait_, try_connect, this);
+            connect_wait_id_ = add_source(g_timeout_source_new(connect_wait_),
+                                          try_connect, this);
         }
     }
     return G_SOURCE_REMOVE;
 }
 
+uint MiracBroker::add_source(GSource *source, GSourceFunc func,
+                             gpointer data_ptr, GDestroyNotify notify)
+{
+    g_source_set_callback(source, func, data_ptr, notify);
+    uint source_id = g_source_attach(source, context_);
+    g_source_unref(source);
+    return source_id;
+}
+
+uint MiracBroker::add_fd_watch(gint fd, GIOCondition condition,
+                               GUnixFDSourceFunc func, gpointer data_ptr)
+{
+    return add_source(g_unix_fd_source_new(fd, condition),
+                      reinterpret_cast<GSourceFunc>(func), data_ptr);
+}
+
+void MiracBroker::remove_source(uint source_id)
+{
+    GSource *source = g_main_context_find_source_by_id(context_, source_id);
+    if (source)
+        g_source_destroy(source);
+}
+
+void MiracBroker::remove_sources(gpointer data_ptr)
+{
+    GSource *source;
+    while ((source = g_main_context_find_source_by_user_data(context_, data_ptr)))
+        g_source_destroy(source);
+}
+
 void MiracBroker::network(MiracNetwork *connection)
 {
-    while (g_source_remove_by_user_data(&network_source_ptr_))
-        ;
+    remove_sources(&network_source_ptr_);
     network_.reset(connection);
 }
 
 void MiracBroker::connection(MiracNetwork *connection)
 {
-    while (g_source_remove_by_user_data(&connection_source_ptr_))
-        ;
+    remove_sources(&connection_source_ptr_);
     connection_.reset(connection);
+    connection_lost_ = false;
+    reset_send_queue();
+    local_address_.clear();
 
     if (connection_)
-        g_unix_fd_add(connection_->GetHandle(), G_IO_IN,
-                      receive_cb, &connection_source_ptr_);
+        add_fd_watch(connection_->GetHandle(), G_IO_IN,
+                     receive_cb, &connection_source_ptr_);
 }
 
 void MiracBroker::try_connect()
@@ -157,14 +319,14 @@ void MiracBroker::try_connect()
 
     connect_wait_id_ = 0;
     network(new MiracNetwork());
-
-    if (network_->Connect(peer_address_.c_str(), peer_port_.c_str())) {
-        g_unix_fd_add(network_->GetHandle(), G_IO_OUT,
-                      MiracBroker::send_cb, &network_source_ptr_);
-    } else {
-        g_unix_fd_add(network_->GetHandle(), G_IO_OUT,
-                      MiracBroker::connect_cb, &network_source_ptr_);
-    }
+    network_->SetTcpProfile(MiracTcpProfile::RtspControl());
+    network_->SetInterface(interface_);
+
+    /* connect_cb() also completes a connection that was established
+     * immediately, it is the one promoting network_ to connection_ */
+    network_->Connect(peer_address_.c_str(), peer_port_.c_str());
+    add_fd_watch(network_->GetHandle(), G_IO_OUT,
+                 MiracBroker::connect_cb, &network_source_ptr_);
 }
 
 unsigned short MiracBroker::get_host_port() const
@@ -177,34 +339,92 @@ std::string MiracBroker::get_peer_address() const
     return connection_->GetPeerAddress();
 }
 
+bool MiracBroker::is_connected() const
+{
+    return connection_ && !connection_lost_;
+}
+
 MiracBroker::MiracBroker (const std::string& listen_port):
-    connect_timer_(NULL)
+    context_(g_main_context_ref_thread_default()),
+    send_cseq_(0),
+    connection_lost_(false),
+    send_queue_bytes_(0),
+    in_flight_since_(0),
+    send_watch_id_(0),
+    send_queue_congested_(false),
+    send_low_watermark_(4 * 1024),
+    send_high_watermark_(16 * 1024),
+    send_queue_limit_(64 * 1024),
+    send_stats_(),
+    connect_timer_(NULL),
+    connect_wait_id_(0)
 {
     network_source_ptr_ = this;
     connection_source_ptr_ = this;
+    netlink_source_ptr_ = this;
 
     network(new MiracNetwork());
+    network_->SetTcpProfile(MiracTcpProfile::RtspControl());
 
     network_->Bind(NULL, listen_port.c_str());
-    g_unix_fd_add(network_->GetHandle(), G_IO_IN,
-                  MiracBroker::listen_cb, &network_source_ptr_);
+    add_fd_watch(network_->GetHandle(), G_IO_IN,
+                 MiracBroker::listen_cb, &network_source_ptr_);
 }
 
-MiracBroker::MiracBroker(const std::string& peer_address, const std::string& peer_port, uint timeout):
+MiracBroker::MiracBroker(const std::string& peer_address, const std::string& peer_port, uint timeout,
+                         const std::string& interface):
+    context_(g_main_context_ref_thread_default()),
+    send_cseq_(0),
+    connection_lost_(false),
+    send_queue_bytes_(0),
+    in_flight_since_(0),
+    send_watch_id_(0),
+    send_queue_congested_(false),
+    send_low_watermark_(4 * 1024),
+    send_high_watermark_(16 * 1024),
+    send_queue_limit_(64 * 1024),
+    send_stats_(),
     peer_address_(peer_address),
     peer_port_(peer_port),
+    connect_wait_id_(0),
     connect_timeout_(timeout)
 {
     network_source_ptr_ = this;
     connection_source_ptr_ = this;
+    netlink_source_ptr_ = this;
+    set_interface(interface);
     connect_timer_ = g_timer_new();
     try_connect();
 }
 
+MiracBroker::MiracBroker (MiracNetwork* connection):
+    context_(g_main_context_ref_thread_default()),
+    send_cseq_(0),
+    connection_lost_(false),
+    send_queue_bytes_(0),
+    in_flight_since_(0),
+    send_watch_id_(0),
+    send_queue_congested_(false),
+    send_low_watermark_(4 * 1024),
+    send_high_watermark_(16 * 1024),
+    send_queue_limit_(64 * 1024),
+    send_stats_(),
+    connect_timer_(NULL),
+    connect_wait_id_(0)
+{
+    network_source_ptr_ = this;
+    connection_source_ptr_ = this;
+    netlink_source_ptr_ = this;
+
+    this->connection(connection);
+    set_interface(connection->GetInterface());
+}
+
 MiracBroker::~MiracBroker ()
 {
     network(NULL);
     connection(NULL);
+    remove_sources(&netlink_source_ptr_);
 
     if (connect_timer_) {
         g_timer_destroy(connect_timer_);
@@ -212,23 +432,59 @@ MiracBroker::~MiracBroker ()
     }
 
     if (connect_wait_id_ > 0) {
-        g_source_remove(connect_wait_id_);
+        remove_source(connect_wait_id_);
         connect_wait_id_ = 0;
     }
     while (!timers_.empty())
-        g_source_remove(timers_.front());
+        remove_source(timers_.front());
+
+    g_main_context_unref(context_);
 }
 
 void MiracBroker::SendRTSPData(const std::string& data) {
   WDS_VLOG("Sending RTSP message:\n%s", data.c_str());
 
-  if (connection_ && !connection_->Send(data))
-      g_unix_fd_add(connection_->GetHandle(), G_IO_OUT,
-                    send_cb, &connection_source_ptr_);
+  if (!connection_ || connection_lost_)
+      return;
+
+  if (send_queue_depth() + data.size() > send_queue_limit_) {
+      WDS_WARNING("RTSP send queue over %zu bytes, dropping the connection",
+                  send_queue_limit_);
+      send_stats_.overflows++;
+      reset_send_queue();
+      connection_lost_ = true;
+      // receive_cb() sees the hang-up and reports it, outside of libwds
+      shutdown(connection_->GetHandle(), SHUT_RDWR);
+      return;
+  }
+
+  send_queue_.push_back({data, g_get_monotonic_time()});
+  send_queue_bytes_ += data.size();
+
+  /* a failure is not reported from here, as that would re-enter the
+   * delegate from inside libwds: receive_cb() sees the same hang-up */
+  MiracIoResult result = flush_send_queue();
+  if (result.status() == MiracIoResult::WouldBlock && send_watch_id_ == 0)
+      send_watch_id_ = add_fd_watch(connection_->GetHandle(), G_IO_OUT,
+                                    send_cb, &connection_source_ptr_);
 }
 
 std::string MiracBroker::GetLocalIPAddress() const {
-  return "127.0.0.1";  // FIXME : return the actual local IP address.
+  if (!local_address_.empty())
+    return local_address_;
+
+  if (netlink_)
+    local_address_ = netlink_->GetAddress(interface_);
+  // Without a bound interface the address the peer reached us at is the
+  // one on the right link.
+  if (local_address_.empty() && connection_) {
+    try {
+      local_address_ = connection_->GetLocalAddress();
+    } catch (const std::exception &x) {
+      WDS_WARNING("exception: %s", x.what());
+    }
+  }
+  return local_address_.empty() ? "127.0.0.1" : local_address_;
 }
 
 void MiracBroker::on_timeout_remove(gpointer user_data) {
@@ -252,12 +508,10 @@ void MiracBroker::OnTimeout(uint timer_id) {
 
 uint MiracBroker::CreateTimer(int seconds) {
   TimerCallbackData* data = new TimerCallbackData(this);
-  uint timer_id = g_timeout_add_seconds_full(
-                        G_PRIORITY_DEFAULT,
-                        seconds,
-                        on_timeout,
-                        data,
-                        on_timeout_remove);
+  uint timer_id = add_source(g_timeout_source_new_seconds(seconds),
+                             on_timeout,
+                             data,
+                             on_timeout_remove);
   if (timer_id > 0) {
     data->timer_id_ = timer_id;
     timers_.push_back(timer_id);
@@ -272,12 +526,11 @@ void MiracBroker::ReleaseTimer(uint timer_id) {
   if (timer_id > 0) {
     auto it = std::find(timers_.begin(), timers_.end(), timer_id);
     if (it != timers_.end() )
-      g_source_remove(*it);
+      remove_source(*it);
   }
 }
 
 int MiracBroker::GetNextCSeq(int* initial_peer_cseq) const {
-  static int send_cseq_;
   ++send_cseq_;
   if (initial_peer_cseq && send_cseq_ == *initial_peer_cseq)
     send_cseq_ *= 2;
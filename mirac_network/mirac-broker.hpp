@@ -24,21 +24,60 @@
 #define MIRAC_BROKER_HPP
 
 #include <glib.h>
+#include <glib-unix.h>
+#include <deque>
+#include <functional>
 #include <memory>
 #include <map>
 #include <vector>
 
 #include "libwds/public/peer.h"
+#include "mirac-netlink.hpp"
 #include "mirac-network.hpp"
 
 class MiracBroker : public wds::Peer::Delegate
 {
     public:
         MiracBroker (const std::string& listen_port);
-        MiracBroker(const std::string& peer_address, const std::string& peer_port, uint timeout = 3000);
+        MiracBroker(const std::string& peer_address, const std::string& peer_port, uint timeout = 3000,
+                    const std::string& interface = std::string());
+        /* takes ownership of an already accepted connection,
+         * see MiracListenerPool; the interface is the listener's */
+        explicit MiracBroker (MiracNetwork* connection);
         virtual ~MiracBroker ();
         unsigned short get_host_port() const;
         std::string get_peer_address() const;
+        /* binds the RTSP sockets to a network interface (e.g. a P2P
+         * group), which is also where the local address is looked up;
+         * an empty name removes the binding */
+        void set_interface(const std::string& interface);
+        const std::string& get_interface() const { return interface_; }
+        bool is_connected() const;
+
+        /* called after on_connection_failure(), from one of the broker's
+         * event sources: it must not destroy the broker right away */
+        typedef std::function<void ()> FailureCallback;
+        void set_failure_callback(FailureCallback callback)
+            { failure_callback_ = callback; }
+
+        /* Outgoing RTSP messages are queued per connection. Above the
+         * high watermark the peer is told the queue is congested, below
+         * the low watermark it is told it drained; a peer that lets the
+         * queue grow past the limit is disconnected. Sizes in bytes. */
+        void set_send_queue_limits(size_t low_watermark, size_t high_watermark,
+                                   size_t limit);
+        struct SendQueueStats {
+            size_t depth;               /* queued and not yet written */
+            size_t max_depth;
+            guint64 messages;           /* written to the socket */
+            guint64 congestion_events;  /* high watermark crossings */
+            guint64 overflows;          /* disconnects at the limit */
+            gint64 last_latency;        /* queued to written, in us */
+            gint64 max_latency;
+            gint64 total_latency;       /* divide by messages for mean */
+        };
+        const SendQueueStats& get_send_queue_stats() const { return send_stats_; }
+
         virtual wds::Peer* Peer() const = 0;
         void OnTimeout(uint timer_id);
 
@@ -65,6 +104,7 @@ class MiracBroker : public wds::Peer::Delegate
         static gboolean listen_cb (gint fd, GIOCondition condition, gpointer data_ptr);
         static gboolean connect_cb (gint fd, GIOCondition condition, gpointer data_ptr);
         static gboolean try_connect(gpointer data_ptr);
+        static gboolean netlink_cb (gint fd, GIOCondition condition, gpointer data_ptr);
         static void on_timeout_remove(gpointer user_data);
 
         gboolean send_cb (gint fd, GIOCondition condition);
@@ -72,10 +112,28 @@ class MiracBroker : public wds::Peer::Delegate
         gboolean listen_cb (gint fd, GIOCondition condition);
         gboolean connect_cb (gint fd, GIOCondition condition);
         void try_connect();
+        gboolean netlink_cb (gint fd, GIOCondition condition);
+        void handle_io_failure (const MiracIoResult& result);
+        void report_failure (ConnectionFailure failure);
+
+        MiracIoResult flush_send_queue();
+        size_t send_queue_depth() const;
+        void update_send_queue_state();
+        void reset_send_queue();
 
         void handle_body(const std::string msg);
         void handle_header(const std::string msg);
 
+        /* all event sources are attached to the main context that was
+         * the thread default when the broker was created */
+        uint add_fd_watch(gint fd, GIOCondition condition,
+                          GUnixFDSourceFunc func, gpointer data_ptr);
+        uint add_source(GSource *source, GSourceFunc func, gpointer data_ptr,
+                        GDestroyNotify notify = NULL);
+        void remove_source(uint source_id);
+        void remove_sources(gpointer data_ptr);
+        GMainContext *context_;
+
         void network(MiracNetwork* connection);
         std::unique_ptr<MiracNetwork> network_;
         MiracBroker *network_source_ptr_;
@@ -85,10 +143,34 @@ class MiracBroker : public wds::Peer::Delegate
         MiracBroker *connection_source_ptr_;
 
         std::vector<uint> timers_;
+        mutable int send_cseq_;
+        bool connection_lost_;
+        FailureCallback failure_callback_;
+
+        struct OutgoingMessage {
+            std::string data;
+            gint64 queued_at;
+        };
+        std::deque<OutgoingMessage> send_queue_;
+        size_t send_queue_bytes_;
+        gint64 in_flight_since_;     /* message left in the socket buffer */
+        uint send_watch_id_;
+        bool send_queue_congested_;
+        size_t send_low_watermark_;
+        size_t send_high_watermark_;
+        size_t send_queue_limit_;
+        SendQueueStats send_stats_;
 
         std::string peer_address_;
         std::string peer_port_;
 
+        /* address lookup for the bound interface, the cached address is
+         * dropped whenever netlink reports an address change */
+        std::string interface_;
+        std::unique_ptr<MiracNetlink> netlink_;
+        MiracBroker *netlink_source_ptr_;
+        mutable std::string local_address_;
+
         GTimer *connect_timer_;
         uint connect_wait_id_;
         uint connect_timeout_;
@@ -0,0 +1,177 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mirac-color-convert.hpp"
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+// BT.601, 8 bit fixed point: Y = 16 + (66 R + 129 G + 25 B) / 256 etc.
+static inline uint8_t luma (int b, int g, int r)
+{
+    return ((66 * r + 129 * g + 25 * b + 128) >> 8) + 16;
+}
+
+static inline uint8_t chroma_u (int b, int g, int r)
+{
+    return ((-38 * r - 74 * g + 112 * b + 128) >> 8) + 128;
+}
+
+static inline uint8_t chroma_v (int b, int g, int r)
+{
+    return ((112 * r - 94 * g - 18 * b + 128) >> 8) + 128;
+}
+
+// Converts pixels [x, width) of a row pair; row1 may equal row0 for the
+// last row of an odd height frame
+static void convert_tail (const uint8_t *row0, const uint8_t *row1, int x, int width,
+                          uint8_t *y0, uint8_t *y1, uint8_t *u, uint8_t *v, bool second_row)
+{
+    for (; x < width; x += 2) {
+        int x1 = x + 1 < width ? x + 1 : x;
+        const uint8_t *p[4] = { row0 + 4 * x, row0 + 4 * x1, row1 + 4 * x, row1 + 4 * x1 };
+
+        y0[x] = luma(p[0][0], p[0][1], p[0][2]);
+        if (x1 != x)
+            y0[x1] = luma(p[1][0], p[1][1], p[1][2]);
+        if (second_row) {
+            y1[x] = luma(p[2][0], p[2][1], p[2][2]);
+            if (x1 != x)
+                y1[x1] = luma(p[3][0], p[3][1], p[3][2]);
+        }
+
+        int b = (p[0][0] + p[1][0] + p[2][0] + p[3][0] + 2) >> 2;
+        int g = (p[0][1] + p[1][1] + p[2][1] + p[3][1] + 2) >> 2;
+        int r = (p[0][2] + p[1][2] + p[2][2] + p[3][2] + 2) >> 2;
+        u[x / 2] = chroma_u(b, g, r);
+        v[x / 2] = chroma_v(b, g, r);
+    }
+}
+
+#ifdef __SSE2__
+// Sums the two 32 bit halves of each 64 bit lane of two madd results
+// and returns the four sums in order
+static inline __m128i pair_sums (__m128i a, __m128i b)
+{
+    a = _mm_add_epi32(a, _mm_shuffle_epi32(a, _MM_SHUFFLE(2, 3, 0, 1)));
+    b = _mm_add_epi32(b, _mm_shuffle_epi32(b, _MM_SHUFFLE(2, 3, 0, 1)));
+    a = _mm_shuffle_epi32(a, _MM_SHUFFLE(3, 1, 2, 0));
+    b = _mm_shuffle_epi32(b, _MM_SHUFFLE(3, 1, 2, 0));
+    return _mm_unpacklo_epi64(a, b);
+}
+
+// Luma of 4 BGRx pixels as 32 bit values
+static inline __m128i luma4 (__m128i pixels, __m128i coefficients)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = _mm_madd_epi16(_mm_unpacklo_epi8(pixels, zero), coefficients);
+    __m128i hi = _mm_madd_epi16(_mm_unpackhi_epi8(pixels, zero), coefficients);
+    __m128i sums = pair_sums(lo, hi);
+    return _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(128)), 8),
+                         _mm_set1_epi32(16));
+}
+
+// 8 luma bytes from 8 pixels
+static inline void store_luma8 (const uint8_t *row, uint8_t *y, __m128i coefficients)
+{
+    __m128i a = luma4(_mm_loadu_si128((const __m128i*) row), coefficients);
+    __m128i b = luma4(_mm_loadu_si128((const __m128i*) (row + 16)), coefficients);
+    __m128i packed = _mm_packs_epi32(a, b);
+    _mm_storel_epi64((__m128i*) y, _mm_packus_epi16(packed, packed));
+}
+
+// Averages of the 2x2 blocks of 4 pixels of two rows: B G R X B G R X
+static inline __m128i average2x2 (const uint8_t *row0, const uint8_t *row1)
+{
+    const __m128i zero = _mm_setzero_si128();
+    __m128i a = _mm_loadu_si128((const __m128i*) row0);
+    __m128i b = _mm_loadu_si128((const __m128i*) row1);
+    __m128i lo = _mm_add_epi16(_mm_unpacklo_epi8(a, zero), _mm_unpacklo_epi8(b, zero));
+    __m128i hi = _mm_add_epi16(_mm_unpackhi_epi8(a, zero), _mm_unpackhi_epi8(b, zero));
+    // Left plus right pixel of each block
+    lo = _mm_add_epi16(lo, _mm_srli_si128(lo, 8));
+    hi = _mm_add_epi16(hi, _mm_srli_si128(hi, 8));
+    __m128i sums = _mm_unpacklo_epi64(lo, hi);
+    return _mm_srli_epi16(_mm_add_epi16(sums, _mm_set1_epi16(2)), 2);
+}
+
+// 4 chroma bytes from 4 blocks given as two average2x2() results
+static inline uint32_t chroma4 (__m128i blocks01, __m128i blocks23, __m128i coefficients)
+{
+    __m128i sums = pair_sums(_mm_madd_epi16(blocks01, coefficients),
+                             _mm_madd_epi16(blocks23, coefficients));
+    sums = _mm_add_epi32(_mm_srai_epi32(_mm_add_epi32(sums, _mm_set1_epi32(128)), 8),
+                         _mm_set1_epi32(128));
+    __m128i packed = _mm_packs_epi32(sums, sums);
+    return _mm_cvtsi128_si32(_mm_packus_epi16(packed, packed));
+}
+#endif
+
+static void convert (const uint8_t *bgrx, int stride, int width, int height,
+                     int first_row, int last_row, const MiracI420Frame &frame, bool simd)
+{
+#ifdef __SSE2__
+    const __m128i y_coefficients = _mm_setr_epi16(25, 129, 66, 0, 25, 129, 66, 0);
+    const __m128i u_coefficients = _mm_setr_epi16(112, -74, -38, 0, 112, -74, -38, 0);
+    const __m128i v_coefficients = _mm_setr_epi16(-18, -94, 112, 0, -18, -94, 112, 0);
+#endif
+
+    for (int row = first_row; row < last_row && row < height; row += 2) {
+        bool second_row = row + 1 < height;
+        const uint8_t *row0 = bgrx + (long) row * stride;
+        const uint8_t *row1 = second_row ? row0 + stride : row0;
+        uint8_t *y0 = frame.planes[0] + (long) row * frame.strides[0];
+        uint8_t *y1 = y0 + frame.strides[0];
+        uint8_t *u = frame.planes[1] + (long) row / 2 * frame.strides[1];
+        uint8_t *v = frame.planes[2] + (long) row / 2 * frame.strides[2];
+
+        int x = 0;
+#ifdef __SSE2__
+        // 8 pixels, two rows at a time
+        for (; simd && second_row && x + 8 <= width; x += 8) {
+            store_luma8(row0 + 4 * x, y0 + x, y_coefficients);
+            store_luma8(row1 + 4 * x, y1 + x, y_coefficients);
+            __m128i blocks01 = average2x2(row0 + 4 * x, row1 + 4 * x);
+            __m128i blocks23 = average2x2(row0 + 4 * x + 16, row1 + 4 * x + 16);
+            uint32_t u4 = chroma4(blocks01, blocks23, u_coefficients);
+            uint32_t v4 = chroma4(blocks01, blocks23, v_coefficients);
+            for (int i = 0; i < 4; i++) {
+                u[x / 2 + i] = u4 >> (8 * i);
+                v[x / 2 + i] = v4 >> (8 * i);
+            }
+        }
+#endif
+        convert_tail(row0, row1, x, width, y0, y1, u, v, second_row);
+    }
+}
+
+void MiracConvertBgrxToI420 (const uint8_t *bgrx, int stride, int width, int height,
+                             int first_row, int last_row, const MiracI420Frame &frame)
+{
+    convert(bgrx, stride, width, height, first_row, last_row, frame, true);
+}
+
+void MiracConvertBgrxToI420Scalar (const uint8_t *bgrx, int stride, int width, int height,
+                                   int first_row, int last_row, const MiracI420Frame &frame)
+{
+    convert(bgrx, stride, width, height, first_row, last_row, frame, false);
+}
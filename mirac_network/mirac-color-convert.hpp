@@ -0,0 +1,46 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_COLOR_CONVERT_HPP
+#define MIRAC_COLOR_CONVERT_HPP
+
+#include <cstdint>
+
+// An I420 frame: three planes, chroma subsampled 2x2
+struct MiracI420Frame {
+    uint8_t *planes[3];
+    int strides[3];
+};
+
+/*
+ * Converts rows [first_row, last_row) of a BGRx / BGRA frame (X11 on
+ * little endian hosts) to I420 with BT.601 limited range coefficients.
+ * first_row must be even; each chroma sample is the average of a 2x2
+ * block. Uses SSE2 where the compiler targets it.
+ */
+void MiracConvertBgrxToI420 (const uint8_t *bgrx, int stride, int width, int height,
+                             int first_row, int last_row, const MiracI420Frame &frame);
+
+// Plain C version, for testing the SIMD one against
+void MiracConvertBgrxToI420Scalar (const uint8_t *bgrx, int stride, int width, int height,
+                                   int first_row, int last_row, const MiracI420Frame &frame);
+
+#endif
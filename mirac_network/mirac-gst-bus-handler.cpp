@@ -20,8 +20,82 @@
  */
 
 #include <gst/gst.h>
+#include "mirac-gst-bus-handler.hpp"
 #include "libwds/public/logging.h"
 
+MiracGstStateWaiter::MiracGstStateWaiter ()
+  : pipeline_(NULL),
+    target_(GST_STATE_VOID_PENDING)
+{
+}
+
+void MiracGstStateWaiter::SetState (GstElement *pipeline, GstState state, const Callback &callback)
+{
+    if (!callbacks_.empty() && (pipeline != pipeline_ || state != target_))
+        Complete(false);
+
+    pipeline_ = pipeline;
+    target_ = state;
+    callbacks_.push_back(callback);
+
+    switch (gst_element_set_state(pipeline, state)) {
+    case GST_STATE_CHANGE_FAILURE:
+        Complete(false);
+        break;
+    case GST_STATE_CHANGE_ASYNC:
+        break;
+    default:
+        // Also NO_PREROLL: live sources are in PAUSED right away
+        Complete(true);
+        break;
+    }
+}
+
+void MiracGstStateWaiter::OnMessage (GstMessage *message)
+{
+    if (callbacks_.empty())
+        return;
+
+    // Errors come from the elements, state changes from the pipeline too
+    if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_ERROR) {
+        Complete(false);
+    } else if (GST_MESSAGE_TYPE(message) == GST_MESSAGE_STATE_CHANGED &&
+               GST_MESSAGE_SRC(message) == GST_OBJECT(pipeline_)) {
+        GstState state, pending;
+        gst_message_parse_state_changed(message, NULL, &state, &pending);
+        if (state == target_ && pending == GST_STATE_VOID_PENDING)
+            Complete(true);
+    }
+}
+
+void MiracGstStateWaiter::Complete (bool reached)
+{
+    // The callbacks may start the next change
+    std::vector<Callback> callbacks;
+    callbacks.swap(callbacks_);
+    for (auto &callback : callbacks)
+        if (callback)
+            callback(reached);
+}
+
+GSource* MiracGstAddBusWatch (GstElement *pipeline, MiracGstStateWaiter *waiter)
+{
+    GstBus *bus = gst_pipeline_get_bus(GST_PIPELINE(pipeline));
+    GSource *source = gst_bus_create_watch(bus);
+    gst_object_unref(bus);
+    g_source_set_callback(source, reinterpret_cast<GSourceFunc>(mirac_gstbus_callback),
+                          waiter, NULL);
+    g_source_attach(source, g_main_context_get_thread_default());
+    return source;
+}
+
+GstState MiracGstTargetState (GstElement *pipeline)
+{
+    GstState state, pending;
+    gst_element_get_state(pipeline, &state, &pending, 0);
+    return pending != GST_STATE_VOID_PENDING ? pending : state;
+}
+
 
 gboolean
 mirac_gstbus_callback (GstBus     *bus,
@@ -31,6 +105,9 @@ mirac_gstbus_callback (GstBus     *bus,
     GError *err = NULL;
     gchar *debug = NULL;
 
+    if (data)
+        static_cast<MiracGstStateWaiter*>(data)->OnMessage(message);
+
     switch (GST_MESSAGE_TYPE (message)) {
     case GST_MESSAGE_ERROR:
         gst_message_parse_error (message, &err, &debug);
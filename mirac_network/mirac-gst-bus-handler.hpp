@@ -22,9 +22,51 @@
 #ifndef MIRAC_GST_BUS_HANDLER_HPP
 #define MIRAC_GST_BUS_HANDLER_HPP
 
+#include <gst/gst.h>
+#include <functional>
+#include <vector>
+
+/*
+ * State changes of a pipeline that complete in the background: the
+ * callback runs once the bus watch sees the pipeline reach the state,
+ * so that the main loop never waits in gst_element_get_state().
+ */
+class MiracGstStateWaiter
+{
+public:
+    typedef std::function<void (bool reached)> Callback;
+
+    MiracGstStateWaiter ();
+
+    // Starts changing the state of pipeline. callback (if any) runs right
+    // away if the change is synchronous, with false if it fails or is
+    // superseded by another one.
+    void SetState (GstElement *pipeline, GstState state, const Callback &callback);
+
+    // Called by mirac_gstbus_callback()
+    void OnMessage (GstMessage *message);
+
+private:
+    void Complete (bool reached);
+
+    GstElement *pipeline_;
+    GstState target_;
+    std::vector<Callback> callbacks_;
+};
+
+// Watches the bus of pipeline from the thread default main context, which
+// for a session of MiracListenerPool is its worker's and not the global
+// default one: remove it with g_source_destroy() and g_source_unref()
+// rather than by id. waiter may be NULL.
+GSource* MiracGstAddBusWatch (GstElement *pipeline, MiracGstStateWaiter *waiter);
+
+// The state pipeline is in or changing to, without waiting for it
+GstState MiracGstTargetState (GstElement *pipeline);
+
+// Logs errors, warnings and infos; data is a MiracGstStateWaiter or NULL
 gboolean
 mirac_gstbus_callback (GstBus     *bus,
                      GstMessage *message,
                      gpointer    data);
 
-#endif
\ No newline at end of file
+#endif
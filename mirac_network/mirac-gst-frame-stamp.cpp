@@ -0,0 +1,139 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <cstring>
+
+#include "mirac-gst-frame-stamp.hpp"
+
+// Two guard blocks (white, black) followed by the low 32 bits of the
+// capture time in milliseconds, most significant bit first
+static const unsigned block_size = 16;
+static const unsigned guard_blocks = 2;
+static const unsigned stamp_bits = 32;
+static const unsigned stamp_width = (guard_blocks + stamp_bits) * block_size;
+
+static const guint8 white = 235;
+static const guint8 black = 16;
+
+struct StampReader {
+    MiracFrameStampCallback callback;
+    gpointer user_data;
+};
+
+// Width of the luma plane, 0 if the frames can not carry a stamp
+static int luma_width (GstPad *pad)
+{
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+        return 0;
+
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    const gchar *format = gst_structure_get_string(structure, "format");
+    int width = 0;
+    if (!gst_structure_get_int(structure, "width", &width) || !format ||
+        (g_strcmp0(format, "I420") && g_strcmp0(format, "YV12") &&
+         g_strcmp0(format, "NV12")))
+        width = 0;
+    gst_caps_unref(caps);
+
+    return width >= (int) stamp_width ? width : 0;
+}
+
+static void paint_block (guint8 *luma, int stride, unsigned index, guint8 value)
+{
+    for (unsigned y = 0; y < block_size; y++)
+        memset(luma + y * stride + index * block_size, value, block_size);
+}
+
+static GstPadProbeReturn stamp_probe_cb (GstPad *pad, GstPadProbeInfo *info, gpointer)
+{
+    int width = luma_width(pad);
+    if (!width)
+        return GST_PAD_PROBE_OK;
+
+    GstBuffer *buffer = gst_buffer_make_writable(GST_PAD_PROBE_INFO_BUFFER(info));
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+
+    // Default strides, as allocated by videoconvert
+    int stride = GST_ROUND_UP_4(width);
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE))
+        return GST_PAD_PROBE_OK;
+
+    if (map.size >= (gsize) stride * block_size) {
+        guint32 stamp = g_get_monotonic_time() / 1000;
+        paint_block(map.data, stride, 0, white);
+        paint_block(map.data, stride, 1, black);
+        for (unsigned bit = 0; bit < stamp_bits; bit++) {
+            bool set = stamp & (1u << (stamp_bits - 1 - bit));
+            paint_block(map.data, stride, guard_blocks + bit, set ? white : black);
+        }
+    }
+    gst_buffer_unmap(buffer, &map);
+
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn reader_probe_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    StampReader *reader = static_cast<StampReader*>(data_ptr);
+    if (!luma_width(pad))
+        return GST_PAD_PROBE_OK;
+
+    GstMapInfo map;
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+
+    // Only the block centres of the first row are read: its offset does
+    // not depend on the stride the decoder picked
+    const guint8 *row = map.data;
+    bool stamped = map.size >= stamp_width &&
+                   row[block_size / 2] > 128 && row[block_size + block_size / 2] < 128;
+    guint32 stamp = 0;
+    for (unsigned bit = 0; stamped && bit < stamp_bits; bit++) {
+        stamp <<= 1;
+        if (row[(guard_blocks + bit) * block_size + block_size / 2] > 128)
+            stamp |= 1;
+    }
+    gst_buffer_unmap(buffer, &map);
+
+    if (stamped) {
+        guint32 now = g_get_monotonic_time() / 1000;
+        // Unsigned difference handles the 49 day wrap around
+        reader->callback((gint64) (guint32) (now - stamp) * 1000, reader->user_data);
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracAddFrameStamper (GstPad *pad)
+{
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, stamp_probe_cb, NULL, NULL);
+}
+
+void MiracAddFrameStampReader (GstPad *pad, MiracFrameStampCallback callback,
+                               gpointer user_data)
+{
+    StampReader *reader = g_new(StampReader, 1);
+    reader->callback = callback;
+    reader->user_data = user_data;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, reader_probe_cb, reader, g_free);
+}
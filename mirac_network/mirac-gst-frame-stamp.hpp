@@ -0,0 +1,48 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_GST_FRAME_STAMP_HPP
+#define MIRAC_GST_FRAME_STAMP_HPP
+
+#include <gst/gst.h>
+
+/*
+ * Glass-to-glass latency measurement. The source paints the capture time
+ * into the top left corner of every frame as a row of black and white
+ * 16x16 blocks, large enough to survive H.264 encoding, and the sink reads
+ * it back from decoded frames. The time is CLOCK_MONOTONIC, so both ends
+ * must run on the same host (loopback).
+ *
+ * Frames must be planar or semi-planar YUV (I420, YV12, NV12) at least
+ * 544 pixels wide; others are passed through untouched.
+ */
+
+// Stamps raw frames flowing through pad, e.g. the encoder sink pad
+void MiracAddFrameStamper (GstPad *pad);
+
+typedef void (*MiracFrameStampCallback) (gint64 latency, gpointer user_data);
+
+// Reports the latency (microseconds) of each stamped decoded frame
+// flowing through pad, e.g. the video sink pad
+void MiracAddFrameStampReader (GstPad *pad, MiracFrameStampCallback callback,
+                               gpointer user_data);
+
+#endif
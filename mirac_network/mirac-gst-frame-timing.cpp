@@ -0,0 +1,309 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <sstream>
+
+#include "mirac-gst-frame-timing.hpp"
+#include "libwds/public/logging.h"
+
+// Entries waiting for their buffer to leave a stage; buffers dropped
+// inside the stage are flushed out by the ones following them
+static const size_t max_pending = 512;
+
+MiracLatencyHistogram::MiracLatencyHistogram ()
+  : count(0), total(0), min(0), max(0), buckets()
+{
+}
+
+void MiracLatencyHistogram::Add (gint64 latency)
+{
+    latency = std::max<gint64>(latency, 0);
+    min = count ? std::min(min, latency) : latency;
+    max = std::max(max, latency);
+    total += latency;
+    count++;
+
+    unsigned bucket = 0;
+    while (bucket + 1 < bucket_count && (latency >> (bucket + 1)))
+        bucket++;
+    buckets[bucket]++;
+}
+
+gint64 MiracLatencyHistogram::Percentile (double fraction) const
+{
+    guint64 wanted = count * fraction;
+    guint64 seen = 0;
+    for (unsigned bucket = 0; bucket < bucket_count; bucket++) {
+        seen += buckets[bucket];
+        if (seen > wanted)
+            return std::min<gint64>((gint64) 2 << bucket, max);
+    }
+    return max;
+}
+
+struct MiracFrameTiming::StageTimer {
+    MiracFrameTiming *owner;
+    std::string name;
+    StageKey key;
+    std::deque<std::pair<guint64, gint64>> pending;
+    MiracLatencyHistogram latency;
+};
+
+static GstBuffer *probe_buffer (GstPadProbeInfo *info)
+{
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+        GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST(info);
+        return gst_buffer_list_length(list) ? gst_buffer_list_get(list, 0) : NULL;
+    }
+    return GST_PAD_PROBE_INFO_BUFFER(info);
+}
+
+static bool buffer_key (GstPadProbeInfo *info, MiracFrameTiming::StageKey key, guint64 *result)
+{
+    GstBuffer *buffer = probe_buffer(info);
+    if (!buffer)
+        return false;
+
+    if (key == MiracFrameTiming::MATCH_PTS) {
+        *result = GST_BUFFER_PTS(buffer);
+        return GST_CLOCK_TIME_IS_VALID(*result);
+    }
+
+    guint8 header[4];
+    if (gst_buffer_extract(buffer, 0, header, sizeof(header)) != sizeof(header))
+        return false;
+    *result = header[2] << 8 | header[3];
+    return true;
+}
+
+// Whether a buffer entering with key a left no later than one with key b
+static bool not_after (MiracFrameTiming::StageKey key, guint64 a, guint64 b)
+{
+    if (key == MiracFrameTiming::MATCH_PTS)
+        return a <= b;
+    // RTP sequence numbers wrap around
+    return (gint16) (a - b) <= 0;
+}
+
+MiracFrameTiming::MiracFrameTiming ()
+  : watch_qos(false),
+    frames(0),
+    late(0),
+    log_source(NULL)
+{
+}
+
+MiracFrameTiming::~MiracFrameTiming ()
+{
+    SetLogInterval(0);
+    for (GstElement *element : stats_elements)
+        gst_object_unref(element);
+}
+
+void MiracFrameTiming::AddStage (const std::string &name, GstPad *in, GstPad *out, StageKey key)
+{
+    StageTimer *timer = new StageTimer;
+    timer->owner = this;
+    timer->name = name;
+    timer->key = key;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        timers.push_back(std::unique_ptr<StageTimer>(timer));
+    }
+
+    GstPadProbeType type = (GstPadProbeType) (GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST);
+    gst_pad_add_probe(in, type, stage_in_cb, timer, NULL);
+    gst_pad_add_probe(out, type, stage_out_cb, timer, NULL);
+}
+
+GstPadProbeReturn MiracFrameTiming::stage_in_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    StageTimer *timer = static_cast<StageTimer*>(data_ptr);
+    guint64 key;
+    if (!buffer_key(info, timer->key, &key))
+        return GST_PAD_PROBE_OK;
+
+    std::lock_guard<std::mutex> lock(timer->owner->mutex);
+    if (timer->pending.size() >= max_pending)
+        timer->pending.pop_front();
+    timer->pending.push_back(std::make_pair(key, g_get_monotonic_time()));
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn MiracFrameTiming::stage_out_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    StageTimer *timer = static_cast<StageTimer*>(data_ptr);
+    guint64 key;
+    if (!buffer_key(info, timer->key, &key))
+        return GST_PAD_PROBE_OK;
+
+    gint64 now = g_get_monotonic_time();
+    std::lock_guard<std::mutex> lock(timer->owner->mutex);
+    while (!timer->pending.empty() && not_after(timer->key, timer->pending.front().first, key)) {
+        // Every frame aggregated into this buffer (e.g. by a muxer) has
+        // left the stage; a packet only matches itself
+        if (timer->key == MATCH_PTS || timer->pending.front().first == key)
+            timer->latency.Add(now - timer->pending.front().second);
+        timer->pending.pop_front();
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracFrameTiming::CountFrames (GstPad *pad)
+{
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, frame_cb, this, NULL);
+}
+
+GstPadProbeReturn MiracFrameTiming::frame_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    MiracFrameTiming *self = static_cast<MiracFrameTiming*>(data_ptr);
+    std::lock_guard<std::mutex> lock(self->mutex);
+    self->frames++;
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracFrameTiming::WatchQoS (GstPad *pad)
+{
+    watch_qos = true;
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_EVENT_UPSTREAM, qos_cb, this, NULL);
+}
+
+GstPadProbeReturn MiracFrameTiming::qos_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    MiracFrameTiming *self = static_cast<MiracFrameTiming*>(data_ptr);
+    GstEvent *event = GST_PAD_PROBE_INFO_EVENT(info);
+    if (GST_EVENT_TYPE(event) != GST_EVENT_QOS)
+        return GST_PAD_PROBE_OK;
+
+    GstQOSType type;
+    gdouble proportion;
+    GstClockTimeDiff diff;
+    GstClockTime timestamp;
+    gst_event_parse_qos(event, &type, &proportion, &diff, &timestamp);
+    // A positive jitter means the frame reached the sink after its
+    // presentation time
+    if (diff > 0) {
+        std::lock_guard<std::mutex> lock(self->mutex);
+        self->late++;
+        self->lateness.Add(GST_TIME_AS_USECONDS(diff));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracFrameTiming::AddStatsElement (GstElement *element)
+{
+    std::lock_guard<std::mutex> lock(mutex);
+    stats_elements.push_back(GST_ELEMENT(gst_object_ref(element)));
+}
+
+static void read_element_stats (GstElement *element, MiracFrameTiming::Stats &stats)
+{
+    // Auto plugging sinks are bins, the statistics are on the sink inside
+    if (GST_IS_BIN(element)) {
+        GstIterator *it = gst_bin_iterate_sinks(GST_BIN(element));
+        GValue item = G_VALUE_INIT;
+        while (gst_iterator_next(it, &item) == GST_ITERATOR_OK) {
+            read_element_stats(GST_ELEMENT(g_value_get_object(&item)), stats);
+            g_value_reset(&item);
+        }
+        g_value_unset(&item);
+        gst_iterator_free(it);
+        return;
+    }
+
+    if (!g_object_class_find_property(G_OBJECT_GET_CLASS(element), "stats"))
+        return;
+    GstStructure *structure = NULL;
+    g_object_get(element, "stats", &structure, NULL);
+    if (!structure)
+        return;
+
+    guint64 value;
+    if (gst_structure_get_uint64(structure, "dropped", &value))
+        stats.dropped += value;
+    if (gst_structure_get_uint64(structure, "num-lost", &value))
+        stats.lost += value;
+    gst_structure_free(structure);
+}
+
+MiracFrameTiming::Stats MiracFrameTiming::GetStats () const
+{
+    Stats stats;
+    // Elements are only released in the destructor
+    std::vector<GstElement*> elements;
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        elements = stats_elements;
+        for (const auto &timer : timers)
+            stats.stages.push_back(Stage { timer->name, timer->latency });
+        if (watch_qos)
+            stats.stages.push_back(Stage { "lateness", lateness });
+        stats.frames = frames;
+        stats.late = late;
+    }
+    stats.dropped = 0;
+    stats.lost = 0;
+    for (GstElement *element : elements)
+        read_element_stats(element, stats);
+    return stats;
+}
+
+std::string MiracFrameTiming::Format () const
+{
+    Stats stats = GetStats();
+    std::ostringstream out;
+    out << stats.frames << " frames, " << stats.dropped << " dropped, "
+        << stats.late << " late, " << stats.lost << " packets lost";
+    for (const Stage &stage : stats.stages) {
+        const MiracLatencyHistogram &latency = stage.latency;
+        out << "; " << stage.name;
+        if (!latency.count) {
+            out << " -";
+            continue;
+        }
+        out << " mean " << latency.total / (gint64) latency.count
+            << " p95 <" << latency.Percentile(0.95)
+            << " max " << latency.max << " us";
+    }
+    return out.str();
+}
+
+void MiracFrameTiming::SetLogInterval (guint interval)
+{
+    if (log_source) {
+        g_source_destroy(log_source);
+        g_source_unref(log_source);
+        log_source = NULL;
+    }
+    if (!interval)
+        return;
+    log_source = g_timeout_source_new_seconds(interval);
+    g_source_set_callback(log_source, log_cb, this, NULL);
+    g_source_attach(log_source, g_main_context_get_thread_default());
+}
+
+gboolean MiracFrameTiming::log_cb (gpointer data_ptr)
+{
+    MiracFrameTiming *self = static_cast<MiracFrameTiming*>(data_ptr);
+    WDS_LOG("Frame timing: %s", self->Format().c_str());
+    return G_SOURCE_CONTINUE;
+}
@@ -0,0 +1,117 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_GST_FRAME_TIMING_HPP
+#define MIRAC_GST_FRAME_TIMING_HPP
+
+#include <gst/gst.h>
+
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// Latency distribution with power of two buckets: bucket i counts
+// samples in [2^i, 2^(i+1)) microseconds, the last one everything above
+struct MiracLatencyHistogram {
+    static const unsigned bucket_count = 24;
+
+    MiracLatencyHistogram ();
+    void Add (gint64 latency);
+    // Upper bound of the bucket holding the given fraction of samples
+    gint64 Percentile (double fraction) const;
+
+    guint64 count;
+    gint64 total;
+    gint64 min;
+    gint64 max;
+    guint64 buckets[bucket_count];
+};
+
+/*
+ * Per-stage latency, frame drop and late frame counters for a pipeline,
+ * collected with pad probes. A stage is the path between two pads; the
+ * time a buffer enters is matched with the time it, or the first buffer
+ * aggregating it, leaves.
+ */
+class MiracFrameTiming
+{
+public:
+    enum StageKey {
+        MATCH_PTS,          // stages that keep buffer timestamps
+        MATCH_RTP_SEQUENCE  // RTP in, RTP out (rtpjitterbuffer)
+    };
+
+    struct Stage {
+        std::string name;
+        MiracLatencyHistogram latency;
+    };
+
+    struct Stats {
+        std::vector<Stage> stages;
+        guint64 frames;     // frames that left the pipeline
+        guint64 dropped;    // frames dropped inside the pipeline
+        guint64 late;       // frames that missed their presentation time
+        guint64 lost;       // RTP packets that never arrived
+    };
+
+    MiracFrameTiming ();
+    ~MiracFrameTiming ();
+
+    void AddStage (const std::string &name, GstPad *in, GstPad *out, StageKey key);
+    // Frames leaving the pipeline through pad
+    void CountFrames (GstPad *pad);
+    // Late frames as reported by QoS events travelling upstream from pad,
+    // also recorded as a "lateness" stage
+    void WatchQoS (GstPad *pad);
+    // Elements whose statistics are read on demand: a base sink's
+    // rendered / dropped frames or rtpjitterbuffer's lost packets. May be
+    // called from a streaming thread, e.g. as rtpbin creates its buffers
+    void AddStatsElement (GstElement *element);
+
+    Stats GetStats () const;
+    std::string Format () const;
+
+    // Logs Format() every interval seconds from the thread default main
+    // context, 0 stops
+    void SetLogInterval (guint interval);
+
+private:
+    struct StageTimer;
+
+    static GstPadProbeReturn stage_in_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    static GstPadProbeReturn stage_out_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    static GstPadProbeReturn frame_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    static GstPadProbeReturn qos_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    static gboolean log_cb (gpointer data_ptr);
+
+    mutable std::mutex mutex;
+    std::vector<std::unique_ptr<StageTimer>> timers;
+    MiracLatencyHistogram lateness;
+    bool watch_qos;
+    guint64 frames;
+    guint64 late;
+    std::vector<GstElement*> stats_elements;
+    GSource* log_source;        // on the thread default context
+};
+
+#endif
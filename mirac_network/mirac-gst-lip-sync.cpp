@@ -0,0 +1,225 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "mirac-gst-lip-sync.hpp"
+#include "libwds/public/logging.h"
+
+static const GstClockTime marker_period = GST_SECOND;
+static const GstClockTime burst_length = 40 * GST_MSECOND;
+
+static const guint8 white = 235;
+static const guint8 black = 16;
+
+// A burst starts after at least this much silence
+static const GstClockTime min_silence = 200 * GST_MSECOND;
+static const gint16 loud = 4096;
+// Onsets further apart than this belong to different markers
+static const GstClockTimeDiff max_pair_distance = 500 * GST_MSECOND;
+
+static bool caps_int (GstPad *pad, const char *field, int *value)
+{
+    GstCaps *caps = gst_pad_get_current_caps(pad);
+    if (!caps)
+        return false;
+    bool found = gst_structure_get_int(gst_caps_get_structure(caps, 0), field, value);
+    gst_caps_unref(caps);
+    return found;
+}
+
+static GstPadProbeReturn video_marker_cb (GstPad *pad, GstPadProbeInfo *info, gpointer)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    int width, height;
+    if (!GST_BUFFER_PTS_IS_VALID(buffer) || !GST_BUFFER_DURATION_IS_VALID(buffer) ||
+        !caps_int(pad, "width", &width) || !caps_int(pad, "height", &height))
+        return GST_PAD_PROBE_OK;
+
+    // The frame shown while a new period starts is the flash
+    GstClockTime start = GST_BUFFER_PTS(buffer);
+    GstClockTime period_start = start - start % marker_period;
+    bool flash = period_start == start ||
+                 period_start + marker_period < start + GST_BUFFER_DURATION(buffer);
+
+    buffer = gst_buffer_make_writable(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE))
+        return GST_PAD_PROBE_OK;
+    // Default luma stride, as allocated by videoconvert
+    gsize luma_size = (gsize) GST_ROUND_UP_4(width) * height;
+    memset(map.data, flash ? white : black, std::min(luma_size, map.size));
+    gst_buffer_unmap(buffer, &map);
+    return GST_PAD_PROBE_OK;
+}
+
+static GstPadProbeReturn audio_marker_cb (GstPad *pad, GstPadProbeInfo *info, gpointer)
+{
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    int rate;
+    if (!GST_BUFFER_PTS_IS_VALID(buffer) || !GST_BUFFER_DURATION_IS_VALID(buffer) ||
+        !caps_int(pad, "rate", &rate))
+        return GST_PAD_PROBE_OK;
+
+    guint64 frames = gst_util_uint64_scale_round(GST_BUFFER_DURATION(buffer), rate, GST_SECOND);
+    gsize size = gst_buffer_get_size(buffer);
+    if (!frames || size % frames)
+        return GST_PAD_PROBE_OK;
+    gsize frame_size = size / frames;
+
+    buffer = gst_buffer_make_writable(buffer);
+    GST_PAD_PROBE_INFO_DATA(info) = buffer;
+    GstMapInfo map;
+    if (!gst_buffer_map(buffer, &map, GST_MAP_WRITE))
+        return GST_PAD_PROBE_OK;
+    // Zero is silence in every signed and float format
+    for (guint64 frame = 0; frame < frames; frame++) {
+        GstClockTime time = GST_BUFFER_PTS(buffer) + gst_util_uint64_scale(frame, GST_SECOND, rate);
+        if (time % marker_period >= burst_length)
+            memset(map.data + frame * frame_size, 0, frame_size);
+    }
+    gst_buffer_unmap(buffer, &map);
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracAddLipSyncMarkers (GstPad *video_pad, GstPad *audio_pad)
+{
+    gst_pad_add_probe(video_pad, GST_PAD_PROBE_TYPE_BUFFER, video_marker_cb, NULL, NULL);
+    gst_pad_add_probe(audio_pad, GST_PAD_PROBE_TYPE_BUFFER, audio_marker_cb, NULL, NULL);
+}
+
+// What the sink renders at: the timestamp in running time
+static GstClockTime running_time (GstPad *pad, GstClockTime timestamp)
+{
+    GstEvent *event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (!event)
+        return GST_CLOCK_TIME_NONE;
+    GstSegment segment;
+    gst_event_copy_segment(event, &segment);
+    gst_event_unref(event);
+    return gst_segment_to_running_time(&segment, GST_FORMAT_TIME, timestamp);
+}
+
+MiracLipSyncMeter::MiracLipSyncMeter ()
+  : bright(false),
+    last_sound(GST_CLOCK_TIME_NONE),
+    video_onset(GST_CLOCK_TIME_NONE),
+    audio_onset(GST_CLOCK_TIME_NONE),
+    min_offset(G_MAXINT64),
+    max_offset(G_MININT64),
+    total_offset(0),
+    count(0)
+{
+}
+
+void MiracLipSyncMeter::WatchVideo (GstPad *pad)
+{
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, video_cb, this, NULL);
+}
+
+void MiracLipSyncMeter::WatchAudio (GstPad *pad)
+{
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, audio_cb, this, NULL);
+}
+
+GstPadProbeReturn MiracLipSyncMeter::video_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    MiracLipSyncMeter *self = static_cast<MiracLipSyncMeter*>(data_ptr);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    GstMapInfo map;
+    if (!GST_BUFFER_PTS_IS_VALID(buffer) || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+
+    // The whole picture is flat, a few pixels of the first row tell
+    const gsize samples = 64;
+    unsigned sum = 0;
+    for (gsize i = 0; i < samples && i < map.size; i++)
+        sum += map.data[i];
+    bool flash = map.size >= samples && sum / samples > 128;
+    gst_buffer_unmap(buffer, &map);
+
+    std::lock_guard<std::mutex> lock(self->mutex);
+    if (flash && !self->bright)
+        self->OnOnset(&self->video_onset, running_time(pad, GST_BUFFER_PTS(buffer)));
+    self->bright = flash;
+    return GST_PAD_PROBE_OK;
+}
+
+GstPadProbeReturn MiracLipSyncMeter::audio_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr)
+{
+    MiracLipSyncMeter *self = static_cast<MiracLipSyncMeter*>(data_ptr);
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    int rate, channels;
+    if (!GST_BUFFER_PTS_IS_VALID(buffer) || !caps_int(pad, "rate", &rate) ||
+        !caps_int(pad, "channels", &channels))
+        return GST_PAD_PROBE_OK;
+
+    GstClockTime start = running_time(pad, GST_BUFFER_PTS(buffer));
+    GstMapInfo map;
+    if (!GST_CLOCK_TIME_IS_VALID(start) || !gst_buffer_map(buffer, &map, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+
+    const gint16 *samples = reinterpret_cast<const gint16*>(map.data);
+    gsize frames = map.size / sizeof(gint16) / channels;
+    std::lock_guard<std::mutex> lock(self->mutex);
+    for (gsize frame = 0; frame < frames; frame++) {
+        if (std::abs(samples[frame * channels]) < loud)
+            continue;
+        GstClockTime time = start + gst_util_uint64_scale(frame, GST_SECOND, rate);
+        if (!GST_CLOCK_TIME_IS_VALID(self->last_sound) || time - self->last_sound > min_silence)
+            self->OnOnset(&self->audio_onset, time);
+        self->last_sound = time;
+    }
+    gst_buffer_unmap(buffer, &map);
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracLipSyncMeter::OnOnset (GstClockTime *onset, GstClockTime time)
+{
+    *onset = time;
+    if (!GST_CLOCK_TIME_IS_VALID(video_onset) || !GST_CLOCK_TIME_IS_VALID(audio_onset))
+        return;
+
+    GstClockTimeDiff offset = GST_CLOCK_DIFF(video_onset, audio_onset);
+    // An unmatched onset of the previous marker (e.g. a lost flash frame)
+    // is dropped, the newer one waits for its pair
+    if (std::abs(offset) > max_pair_distance) {
+        if (onset == &video_onset)
+            audio_onset = GST_CLOCK_TIME_NONE;
+        else
+            video_onset = GST_CLOCK_TIME_NONE;
+        return;
+    }
+    video_onset = GST_CLOCK_TIME_NONE;
+    audio_onset = GST_CLOCK_TIME_NONE;
+
+    gint64 offset_ms = offset / GST_MSECOND;
+    min_offset = std::min(min_offset, offset_ms);
+    max_offset = std::max(max_offset, offset_ms);
+    total_offset += offset_ms;
+    count++;
+    WDS_LOG("Lip sync: audio %+" G_GINT64_FORMAT " ms after video (min %+" G_GINT64_FORMAT
+            ", mean %+" G_GINT64_FORMAT ", max %+" G_GINT64_FORMAT " over %u markers)",
+            offset_ms, min_offset, total_offset / count, max_offset, count);
+}
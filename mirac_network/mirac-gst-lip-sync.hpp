@@ -0,0 +1,66 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_GST_LIP_SYNC_HPP
+#define MIRAC_GST_LIP_SYNC_HPP
+
+#include <gst/gst.h>
+#include <mutex>
+
+/*
+ * Lip-sync offset measurement. At every full second of running time the
+ * source shows one white frame in an otherwise black picture and lets a
+ * 40 ms tone burst through an otherwise silent audio track. The sink
+ * finds the onset of both in the decoded streams and reports how much
+ * later, in running time, the audio burst is rendered than the flash.
+ * Both ends only rely on their own pipeline clock, so unlike the
+ * glass-to-glass mode this works across hosts.
+ */
+
+// Source side: video_pad carries raw I420 frames, audio_pad raw audio
+// in any signed or float sample format
+void MiracAddLipSyncMarkers (GstPad *video_pad, GstPad *audio_pad);
+
+class MiracLipSyncMeter
+{
+public:
+    MiracLipSyncMeter ();
+
+    // Decoded I420 frames
+    void WatchVideo (GstPad *pad);
+    // Decoded S16LE audio
+    void WatchAudio (GstPad *pad);
+
+private:
+    static GstPadProbeReturn video_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    static GstPadProbeReturn audio_cb (GstPad *pad, GstPadProbeInfo *info, gpointer data_ptr);
+    void OnOnset (GstClockTime *onset, GstClockTime time);
+
+    std::mutex mutex;
+    bool bright;                    // last frame was the flash
+    GstClockTime last_sound;        // running time of the last loud sample
+    GstClockTime video_onset;
+    GstClockTime audio_onset;
+    gint64 min_offset, max_offset, total_offset;
+    unsigned count;
+};
+
+#endif
@@ -0,0 +1,352 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+#include "mirac-gst-screen-convert.hpp"
+#include "mirac-color-convert.hpp"
+#include "libwds/public/logging.h"
+
+// Rows compared at once; even, so that bands map to whole chroma rows
+static const int band_rows = 16;
+
+struct MiracScreenConvert {
+    GstElement parent;
+    GstPad *sinkpad;
+    GstPad *srcpad;
+
+    int width;
+    int height;
+    // Previous input and output, to find and copy the unchanged bands;
+    // only used from the streaming thread
+    GstBuffer *last_input;
+    GstBuffer *last_output;
+
+    MiracScreenConvertStats stats;  // object lock
+};
+
+struct MiracScreenConvertClass {
+    GstElementClass parent_class;
+};
+
+#define MIRAC_TYPE_SCREEN_CONVERT (mirac_screen_convert_get_type())
+#define MIRAC_SCREEN_CONVERT(obj) \
+    (G_TYPE_CHECK_INSTANCE_CAST((obj), MIRAC_TYPE_SCREEN_CONVERT, MiracScreenConvert))
+
+G_DEFINE_TYPE (MiracScreenConvert, mirac_screen_convert, GST_TYPE_ELEMENT);
+
+static GstStaticPadTemplate sink_template = GST_STATIC_PAD_TEMPLATE ("sink",
+    GST_PAD_SINK, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, format = (string) { BGRx, BGRA }, "
+                     "width = (int) [ 1, max ], height = (int) [ 1, max ], "
+                     "framerate = (fraction) [ 0, max ]"));
+
+static GstStaticPadTemplate src_template = GST_STATIC_PAD_TEMPLATE ("src",
+    GST_PAD_SRC, GST_PAD_ALWAYS,
+    GST_STATIC_CAPS ("video/x-raw, format = (string) I420, "
+                     "width = (int) [ 1, max ], height = (int) [ 1, max ], "
+                     "framerate = (fraction) [ 0, max ]"));
+
+// Default I420 strides and offsets, as videoconvert allocates them
+struct I420Layout {
+    I420Layout (int width, int height)
+    {
+        strides[0] = GST_ROUND_UP_4(width);
+        strides[1] = strides[2] = GST_ROUND_UP_4(GST_ROUND_UP_2(width) / 2);
+        offsets[0] = 0;
+        offsets[1] = strides[0] * GST_ROUND_UP_2(height);
+        offsets[2] = offsets[1] + strides[1] * GST_ROUND_UP_2(height) / 2;
+        size = offsets[2] + strides[2] * GST_ROUND_UP_2(height) / 2;
+    }
+
+    MiracI420Frame Frame (guint8 *data) const
+    {
+        MiracI420Frame frame;
+        for (int i = 0; i < 3; i++) {
+            frame.planes[i] = data + offsets[i];
+            frame.strides[i] = strides[i];
+        }
+        return frame;
+    }
+
+    int strides[3];
+    gsize offsets[3];
+    gsize size;
+};
+
+static void copy_rows (const MiracI420Frame &from, const MiracI420Frame &to,
+                       int width, int first_row, int last_row)
+{
+    for (int row = first_row; row < last_row; row++)
+        memcpy(to.planes[0] + row * to.strides[0], from.planes[0] + row * from.strides[0], width);
+
+    int chroma_width = (width + 1) / 2;
+    for (int row = first_row / 2; row < (last_row + 1) / 2; row++) {
+        for (int plane = 1; plane < 3; plane++)
+            memcpy(to.planes[plane] + row * to.strides[plane],
+                   from.planes[plane] + row * from.strides[plane], chroma_width);
+    }
+}
+
+static void reset (MiracScreenConvert *self)
+{
+    gst_buffer_replace(&self->last_input, NULL);
+    gst_buffer_replace(&self->last_output, NULL);
+}
+
+// The caps on the other side of the element: the same sizes and rates
+// in the other format
+static GstCaps *transform_caps (GstCaps *caps, bool to_source)
+{
+    GstCaps *result = gst_caps_new_empty();
+    for (guint i = 0; i < gst_caps_get_size(caps); i++) {
+        GstStructure *structure = gst_structure_copy(gst_caps_get_structure(caps, i));
+        gst_structure_remove_fields(structure, "format", "colorimetry", "chroma-site", NULL);
+        if (to_source) {
+            gst_structure_set(structure,
+                              "format", G_TYPE_STRING, "I420",
+                              "colorimetry", G_TYPE_STRING, "bt601",
+                              NULL);
+            gst_caps_append_structure(result, structure);
+        } else {
+            GstStructure *with_alpha = gst_structure_copy(structure);
+            gst_structure_set(structure, "format", G_TYPE_STRING, "BGRx", NULL);
+            gst_structure_set(with_alpha, "format", G_TYPE_STRING, "BGRA", NULL);
+            gst_caps_append_structure(result, structure);
+            gst_caps_append_structure(result, with_alpha);
+        }
+    }
+    return result;
+}
+
+static gboolean query_caps (MiracScreenConvert *self, GstPad *pad, GstQuery *query)
+{
+    bool sink = pad == self->sinkpad;
+    GstCaps *filter = NULL;
+    gst_query_parse_caps(query, &filter);
+
+    GstCaps *peer_filter = filter ? transform_caps(filter, sink) : NULL;
+    GstCaps *peer = gst_pad_peer_query_caps(sink ? self->srcpad : self->sinkpad, peer_filter);
+    GstCaps *template_caps = gst_pad_get_pad_template_caps(pad);
+    GstCaps *result;
+    if (gst_caps_is_any(peer)) {
+        result = gst_caps_ref(template_caps);
+    } else {
+        GstCaps *transformed = transform_caps(peer, !sink);
+        result = gst_caps_intersect(transformed, template_caps);
+        gst_caps_unref(transformed);
+    }
+    if (filter) {
+        GstCaps *filtered = gst_caps_intersect_full(filter, result, GST_CAPS_INTERSECT_FIRST);
+        gst_caps_unref(result);
+        result = filtered;
+    }
+
+    gst_query_set_caps_result(query, result);
+    gst_caps_unref(result);
+    gst_caps_unref(template_caps);
+    gst_caps_unref(peer);
+    if (peer_filter)
+        gst_caps_unref(peer_filter);
+    return TRUE;
+}
+
+static gboolean query_cb (GstPad *pad, GstObject *parent, GstQuery *query)
+{
+    MiracScreenConvert *self = MIRAC_SCREEN_CONVERT(parent);
+
+    if (GST_QUERY_TYPE(query) == GST_QUERY_CAPS)
+        return query_caps(self, pad, query);
+    return gst_pad_query_default(pad, parent, query);
+}
+
+static gboolean sink_event_cb (GstPad *pad, GstObject *parent, GstEvent *event)
+{
+    MiracScreenConvert *self = MIRAC_SCREEN_CONVERT(parent);
+
+    if (GST_EVENT_TYPE(event) != GST_EVENT_CAPS)
+        return gst_pad_event_default(pad, parent, event);
+
+    GstCaps *caps = NULL;
+    gst_event_parse_caps(event, &caps);
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    int width = 0, height = 0;
+    if (!gst_structure_get_int(structure, "width", &width) ||
+        !gst_structure_get_int(structure, "height", &height)) {
+        gst_event_unref(event);
+        return FALSE;
+    }
+
+    self->width = width;
+    self->height = height;
+    reset(self);
+
+    GstCaps *output_caps = transform_caps(caps, true);
+    gst_event_unref(event);
+    gboolean pushed = gst_pad_push_event(self->srcpad, gst_event_new_caps(output_caps));
+    gst_caps_unref(output_caps);
+    return pushed;
+}
+
+static GstFlowReturn chain_cb (GstPad *, GstObject *parent, GstBuffer *input)
+{
+    MiracScreenConvert *self = MIRAC_SCREEN_CONVERT(parent);
+    const int width = self->width;
+    const int height = self->height;
+    // Frames without GstVideoMeta, i.e. tightly packed
+    const int stride = width * 4;
+    const int bands = (height + band_rows - 1) / band_rows;
+    const I420Layout layout(width, height);
+
+    GstMapInfo in;
+    if (!gst_buffer_map(input, &in, GST_MAP_READ)) {
+        gst_buffer_unref(input);
+        return GST_FLOW_ERROR;
+    }
+    if (!width || in.size < (gsize) stride * height) {
+        WDS_ERROR("Unexpected frame size %" G_GSIZE_FORMAT " for %dx%d", in.size, width, height);
+        gst_buffer_unmap(input, &in);
+        gst_buffer_unref(input);
+        return GST_FLOW_NOT_NEGOTIATED;
+    }
+
+    std::vector<bool> changed(bands, true);
+    int changed_bands = bands;
+    GstMapInfo previous;
+    if (self->last_output && gst_buffer_map(self->last_input, &previous, GST_MAP_READ)) {
+        changed_bands = 0;
+        for (int band = 0; band < bands; band++) {
+            gsize offset = (gsize) band * band_rows * stride;
+            gsize size = (gsize) std::min(band_rows, height - band * band_rows) * stride;
+            changed[band] = memcmp(in.data + offset, previous.data + offset, size) != 0;
+            changed_bands += changed[band];
+        }
+        gst_buffer_unmap(self->last_input, &previous);
+    }
+
+    GstBuffer *output;
+    if (!changed_bands) {
+        // Shares the memory of the previous frame
+        output = gst_buffer_copy(self->last_output);
+    } else {
+        output = gst_buffer_new_allocate(NULL, layout.size, NULL);
+        GstMapInfo out, last_out;
+        gst_buffer_map(output, &out, GST_MAP_WRITE);
+        bool have_last = changed_bands < bands &&
+                         gst_buffer_map(self->last_output, &last_out, GST_MAP_READ);
+
+        MiracI420Frame frame = layout.Frame(out.data);
+        for (int band = 0; band < bands; band++) {
+            int first_row = band * band_rows;
+            int last_row = std::min(first_row + band_rows, height);
+            if (changed[band] || !have_last)
+                MiracConvertBgrxToI420(in.data, stride, width, height, first_row, last_row, frame);
+            else
+                copy_rows(layout.Frame(last_out.data), frame, width, first_row, last_row);
+        }
+
+        if (have_last)
+            gst_buffer_unmap(self->last_output, &last_out);
+        gst_buffer_unmap(output, &out);
+    }
+    gst_buffer_copy_into(output, input,
+                         (GstBufferCopyFlags) (GST_BUFFER_COPY_FLAGS | GST_BUFFER_COPY_TIMESTAMPS),
+                         0, -1);
+    if (changed_bands)
+        GST_BUFFER_FLAG_UNSET(output, MIRAC_BUFFER_FLAG_STATIC);
+    else
+        GST_BUFFER_FLAG_SET(output, MIRAC_BUFFER_FLAG_STATIC);
+    gst_buffer_unmap(input, &in);
+
+    gst_buffer_replace(&self->last_output, output);
+    gst_buffer_replace(&self->last_input, input);
+    gst_buffer_unref(input);
+
+    GST_OBJECT_LOCK(self);
+    self->stats.frames++;
+    if (!changed_bands)
+        self->stats.static_frames++;
+    self->stats.bands += bands;
+    self->stats.converted_bands += changed_bands;
+    GST_OBJECT_UNLOCK(self);
+
+    return gst_pad_push(self->srcpad, output);
+}
+
+static GstStateChangeReturn change_state (GstElement *element, GstStateChange transition)
+{
+    GstStateChangeReturn result =
+        GST_ELEMENT_CLASS(mirac_screen_convert_parent_class)->change_state(element, transition);
+    if (transition == GST_STATE_CHANGE_PAUSED_TO_READY)
+        reset(MIRAC_SCREEN_CONVERT(element));
+    return result;
+}
+
+static void mirac_screen_convert_class_init (MiracScreenConvertClass *klass)
+{
+    GstElementClass *element_class = GST_ELEMENT_CLASS(klass);
+
+    gst_element_class_set_static_metadata(element_class,
+        "Screen capture converter", "Filter/Converter/Video",
+        "Converts the changed parts of captured BGRx frames to I420",
+        "Intel Corporation");
+    gst_element_class_add_pad_template(element_class,
+        gst_static_pad_template_get(&sink_template));
+    gst_element_class_add_pad_template(element_class,
+        gst_static_pad_template_get(&src_template));
+    element_class->change_state = change_state;
+}
+
+static void mirac_screen_convert_init (MiracScreenConvert *self)
+{
+    self->sinkpad = gst_pad_new_from_static_template(&sink_template, "sink");
+    gst_pad_set_chain_function(self->sinkpad, chain_cb);
+    gst_pad_set_event_function(self->sinkpad, sink_event_cb);
+    gst_pad_set_query_function(self->sinkpad, query_cb);
+    gst_element_add_pad(GST_ELEMENT(self), self->sinkpad);
+
+    self->srcpad = gst_pad_new_from_static_template(&src_template, "src");
+    gst_pad_set_query_function(self->srcpad, query_cb);
+    gst_element_add_pad(GST_ELEMENT(self), self->srcpad);
+
+    self->width = self->height = 0;
+    self->last_input = self->last_output = NULL;
+    memset(&self->stats, 0, sizeof(self->stats));
+}
+
+bool MiracRegisterScreenConvert ()
+{
+    static const bool registered = gst_element_register(NULL, "miracscreenconvert",
+                                                        GST_RANK_NONE, MIRAC_TYPE_SCREEN_CONVERT);
+    return registered;
+}
+
+MiracScreenConvertStats MiracScreenConvertGetStats (GstElement *element)
+{
+    MiracScreenConvert *self = MIRAC_SCREEN_CONVERT(element);
+
+    GST_OBJECT_LOCK(self);
+    MiracScreenConvertStats stats = self->stats;
+    GST_OBJECT_UNLOCK(self);
+    return stats;
+}
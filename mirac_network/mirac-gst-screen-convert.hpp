@@ -0,0 +1,56 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_GST_SCREEN_CONVERT_HPP
+#define MIRAC_GST_SCREEN_CONVERT_HPP
+
+#include <gst/gst.h>
+
+/*
+ * "miracscreenconvert" converts captured BGRx / BGRA frames to I420 for
+ * the encoder (see mirac-color-convert.hpp), only redoing the parts of
+ * the screen that changed. Every frame is compared with the previous one
+ * in bands of 16 rows: unchanged bands are copied from the previous
+ * output and a frame without any change is pushed as a new reference to
+ * the previous output, flagged MIRAC_BUFFER_FLAG_STATIC, so an idle
+ * desktop costs little more than the comparison.
+ *
+ * The element is registered with the application rather than as a
+ * plugin, by MiracRegisterScreenConvert().
+ */
+
+// Set on output frames identical to the previous one
+#define MIRAC_BUFFER_FLAG_STATIC GST_BUFFER_FLAG_LAST
+
+// Safe to call more than once; false if the element can not be used
+bool MiracRegisterScreenConvert ();
+
+struct MiracScreenConvertStats {
+    guint64 frames;
+    guint64 static_frames;      // without any changed band
+    guint64 bands;              // of all frames
+    guint64 converted_bands;
+};
+
+// Counters of a miracscreenconvert element
+MiracScreenConvertStats MiracScreenConvertGetStats (GstElement *element);
+
+#endif
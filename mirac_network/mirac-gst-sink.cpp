@@ -21,100 +21,377 @@
 
 #include "mirac-gst-sink.hpp"
 #include "mirac-gst-bus-handler.hpp"
+#include "mirac-gst-frame-stamp.hpp"
+#include "mirac-rtp-sockets.hpp"
 #include "libwds/public/logging.h"
 
+#include <algorithm>
 #include <cassert>
 
-void _set_udp_caps(GstElement *playbin, GstElement *source, gpointer    user_data)
-{
-    GstCaps* caps = gst_caps_new_simple ("application/x-rtp",
-        "media", G_TYPE_STRING, "video",
-        "clock-rate", G_TYPE_INT, 1,
-        "encoding-name", G_TYPE_STRING, "MP2T",
-        NULL);
+static void set_property_if_exists(GstElement* element, const char* name, const char* value) {
+  if (g_object_class_find_property(G_OBJECT_GET_CLASS(element), name))
+    gst_util_set_object_arg(G_OBJECT(element), name, value);
+}
 
-    g_object_set(source, "caps", caps, NULL);
-    gst_caps_unref(caps);
+static GstElement* add_element(GstElement* bin, const char* factory, const char* name = NULL) {
+  GstElement* element = gst_element_factory_make(factory, name);
+  if (element)
+    gst_bin_add(GST_BIN(bin), element);
+  return element;
 }
 
-MiracGstSink::MiracGstSink (std::string hostname, int port) {
+// Receiver reports are what the source adapts its bitrate to, the
+// default 5 s minimum would make it react too late
+static const guint64 rtcp_min_interval = GST_SECOND;
+
+MiracGstSink::MiracGstSink (std::string hostname, int port, guint latency, bool glass_to_glass,
+                            bool lip_sync)
+  : gst_elem(NULL),
+    bus_watch(NULL),
+    depayloader(NULL),
+    video_parser(NULL),
+    rtcp_socket(NULL),
+    rtcp_supported(false),
+    g2g_report_time(0),
+    g2g_min(G_MAXINT64),
+    g2g_max(0),
+    g2g_total(0),
+    g2g_frames(0) {
   // todo (shalamov): move out pipeline initialization
   // from constructor, otherwise we can't check error conditions
-  std::string gst_pipeline;
+  gst_elem = gst_pipeline_new(NULL);
+  if (!AddElements(latency)) {
+    WDS_ERROR("Cannot initialize gstreamer pipeline");
+    gst_object_unref(gst_elem);
+    gst_elem = NULL;
+    return;
+  }
 
-  std::string url =  "udp://" + (!hostname.empty() ? hostname  : "::") + (port > 0 ? ":" + std::to_string(port) : ":");
-  gst_pipeline = "playbin uri=" + url;
+  BindSockets(!hostname.empty() ? hostname : "::", port);
 
-  GError *err = NULL;
-  gst_elem = gst_parse_launch(gst_pipeline.c_str(), &err);
-  if (err != NULL) {
-      WDS_ERROR("Cannot initialize gstreamer pipeline: [%s] %s", g_quark_to_string(err->domain), err->message);
+  if (glass_to_glass) {
+    GstElement* decoder = gst_bin_get_by_name(GST_BIN(gst_elem), "decoder");
+    GstPad* pad = gst_element_get_static_pad(decoder, "src");
+    MiracAddFrameStampReader(pad, glass_to_glass_cb, this);
+    gst_object_unref(pad);
+    gst_object_unref(decoder);
   }
 
-  if (gst_elem) {
-      GstBus* bus = gst_pipeline_get_bus (GST_PIPELINE (gst_elem));
-      bus_watch_id = gst_bus_add_watch (bus, mirac_gstbus_callback, this);
-      gst_object_unref (bus);
+  if (lip_sync) {
+    lip_sync_meter.reset(new MiracLipSyncMeter);
+    GstElement* decoder = gst_bin_get_by_name(GST_BIN(gst_elem), "decoder");
+    GstPad* pad = gst_element_get_static_pad(decoder, "src");
+    lip_sync_meter->WatchVideo(pad);
+    gst_object_unref(pad);
+    gst_object_unref(decoder);
+  }
+
+  InstallFrameTiming();
+
+  bus_watch = MiracGstAddBusWatch(gst_elem, &state_waiter);
+
+  gst_element_set_state (gst_elem, GST_STATE_PLAYING);
+}
+
+void MiracGstSink::BindSockets(const std::string& address, int port) {
+  GstElement* source = gst_bin_get_by_name(GST_BIN(gst_elem), "source");
+  GstElement* rtcp_source = gst_bin_get_by_name(GST_BIN(gst_elem), "rtcpsource");
+
+  GSocket* rtp_socket = NULL;
+  if (!port && MiracBindRtpSockets(MiracSocketFamilyOf(address), std::string(),
+                                   &rtp_socket, &rtcp_socket)) {
+    // The port is kept for sink_udp_port(), udpsrc uses the socket
+    g_object_set(source, "socket", rtp_socket, "port", MiracSocketPort(rtp_socket), NULL);
+    g_object_set(rtcp_source, "socket", rtcp_socket, "close-socket", FALSE, NULL);
+    g_object_unref(rtp_socket);
+    rtcp_supported = true;
+  } else {
+    g_object_set(source, "address", address.c_str(), "port", port, NULL);
+    g_object_set(rtcp_source, "address", address.c_str(), "port", port ? port + 1 : 0, NULL);
+    rtcp_supported = port > 0;
+  }
+
+  gst_object_unref(source);
+  gst_object_unref(rtcp_source);
+}
+
+void MiracGstSink::InstallFrameTiming() {
+  GstElement* source = gst_bin_get_by_name(GST_BIN(gst_elem), "source");
+  GstElement* decoder = gst_bin_get_by_name(GST_BIN(gst_elem), "decoder");
+  GstElement* sink = gst_bin_get_by_name(GST_BIN(gst_elem), "videosink");
+
+  // rtpbin passes packets through unchanged, the time they spend in it
+  // is the jitterbuffer latency
+  GstPad* source_src = gst_element_get_static_pad(source, "src");
+  GstPad* depayloader_sink = gst_element_get_static_pad(depayloader, "sink");
+  GstPad* decoder_sink = gst_element_get_static_pad(decoder, "sink");
+  GstPad* decoder_src = gst_element_get_static_pad(decoder, "src");
+
+  frame_timing.AddStage("jitterbuffer", source_src, depayloader_sink,
+                        MiracFrameTiming::MATCH_RTP_SEQUENCE);
+  frame_timing.AddStage("decode", decoder_sink, decoder_src, MiracFrameTiming::MATCH_PTS);
+  frame_timing.CountFrames(decoder_src);
+  frame_timing.WatchQoS(decoder_src);
+  frame_timing.AddStatsElement(sink);
+
+  gst_object_unref(source_src);
+  gst_object_unref(depayloader_sink);
+  gst_object_unref(decoder_sink);
+  gst_object_unref(decoder_src);
+  gst_object_unref(source);
+  gst_object_unref(decoder);
+  gst_object_unref(sink);
+}
+
+bool MiracGstSink::AddElements(guint latency) {
+  GstElement* source = add_element(gst_elem, "udpsrc", "source");
+  GstElement* rtcp_source = add_element(gst_elem, "udpsrc", "rtcpsource");
+  GstElement* rtpbin = add_element(gst_elem, "rtpbin", "rtpbin");
+  depayloader = add_element(gst_elem, "rtpmp2tdepay");
+  GstElement* demux = add_element(gst_elem, "tsdemux");
+  video_parser = add_element(gst_elem, "h264parse");
+  GstElement* decoder = add_element(gst_elem, "avdec_h264", "decoder");
+  GstElement* convert = add_element(gst_elem, "videoconvert");
+  GstElement* sink = add_element(gst_elem, "autovideosink", "videosink");
+  if (!source || !rtcp_source || !rtpbin || !depayloader || !demux || !video_parser ||
+      !decoder || !convert || !sink)
+    return false;
+
+  GstCaps* caps = gst_caps_new_simple ("application/x-rtp",
+      "media", G_TYPE_STRING, "video",
+      "clock-rate", G_TYPE_INT, 90000,
+      "encoding-name", G_TYPE_STRING, "MP2T",
+      NULL);
+  g_object_set(source, "caps", caps, NULL);
+  gst_caps_unref(caps);
+  caps = gst_caps_new_empty_simple("application/x-rtcp");
+  g_object_set(rtcp_source, "caps", caps, NULL);
+  gst_caps_unref(caps);
+
+  // Packets later than the budget are dropped rather than delaying
+  // every following frame
+  g_object_set(rtpbin, "latency", latency, NULL);
+  set_property_if_exists(rtpbin, "drop-on-latency", "true");
+  // WFD sources send PTS close to PCR, the 700 ms tsdemux adds by default
+  // for smooth demuxing of broadcast streams is not needed
+  set_property_if_exists(demux, "latency", "0");
+  // Frame threading delays output by one frame per thread
+  set_property_if_exists(decoder, "thread-type", "slice");
+
+  g_signal_connect(rtpbin, "pad-added", G_CALLBACK(rtpbin_pad_added_cb), this);
+  g_signal_connect(rtpbin, "new-jitterbuffer", G_CALLBACK(new_jitterbuffer_cb), this);
+  g_signal_connect(demux, "pad-added", G_CALLBACK(demux_pad_added_cb), this);
+
+  if (!gst_element_link_pads(source, "src", rtpbin, "recv_rtp_sink_0") ||
+      !gst_element_link_pads(rtcp_source, "src", rtpbin, "recv_rtcp_sink_0"))
+    return false;
+
+  // The session exists once its first pad was requested
+  GObject* session = NULL;
+  g_signal_emit_by_name(rtpbin, "get-internal-session", 0, &session);
+  if (session) {
+    g_object_set(session, "rtcp-min-interval", rtcp_min_interval, NULL);
+    g_object_unref(session);
+  }
+
+  return gst_element_link(depayloader, demux) &&
+         gst_element_link_many(video_parser, decoder, convert, sink, NULL);
+}
+
+void MiracGstSink::rtpbin_pad_added_cb(GstElement* rtpbin, GstPad* pad, gpointer data_ptr) {
+  MiracGstSink* self = static_cast<MiracGstSink*>(data_ptr);
+  gchar* name = gst_pad_get_name(pad);
+  bool rtp = g_str_has_prefix(name, "recv_rtp_src_");
+  g_free(name);
+  if (!rtp)
+    return;
+
+  // A new SSRC (e.g. the source restarted its pipeline) replaces the
+  // stream that was linked before
+  GstPad* depayloader_pad = gst_element_get_static_pad(self->depayloader, "sink");
+  GstPad* peer = gst_pad_get_peer(depayloader_pad);
+  if (peer) {
+    gst_pad_unlink(peer, depayloader_pad);
+    gst_object_unref(peer);
+  }
+  if (gst_pad_link(pad, depayloader_pad) != GST_PAD_LINK_OK)
+    WDS_WARNING("Cannot link RTP stream");
+  gst_object_unref(depayloader_pad);
+}
+
+void MiracGstSink::new_jitterbuffer_cb(GstElement* rtpbin, GstElement* jitterbuffer,
+                                       guint session, guint ssrc, gpointer data_ptr) {
+  MiracGstSink* self = static_cast<MiracGstSink*>(data_ptr);
+  self->frame_timing.AddStatsElement(jitterbuffer);
+}
+
+bool MiracGstSink::IsRtcpSupported() const {
+  return rtcp_supported;
+}
+
+void MiracGstSink::SetSourceRtcpAddress(const std::string& hostname, int port) {
+  assert(gst_elem);
+  GstElement* rtcp_sink = add_element(gst_elem, "udpsink");
+  if (!rtcp_sink) {
+    WDS_WARNING("Cannot send RTCP");
+    return;
+  }
+  // Sent from the port receiving RTCP, as RFC 3550 expects
+  if (rtcp_socket)
+    g_object_set(rtcp_sink, "socket", rtcp_socket, "close-socket", FALSE, NULL);
+  g_object_set(rtcp_sink,
+               "host", hostname.c_str(), "port", port,
+               "sync", FALSE, "async", FALSE,
+               NULL);
+
+  GstElement* rtpbin = gst_bin_get_by_name(GST_BIN(gst_elem), "rtpbin");
+  if (gst_element_link_pads(rtpbin, "send_rtcp_src_0", rtcp_sink, "sink"))
+    gst_element_sync_state_with_parent(rtcp_sink);
+  else
+    WDS_WARNING("Cannot link RTCP output");
+  gst_object_unref(rtpbin);
+  WDS_LOG("Sending RTCP receiver reports to %s:%d", hostname.c_str(), port);
+}
+
+void MiracGstSink::demux_pad_added_cb(GstElement* demux, GstPad* pad, gpointer data_ptr) {
+  MiracGstSink* self = static_cast<MiracGstSink*>(data_ptr);
+  gchar* name = gst_pad_get_name(pad);
+  bool video = g_str_has_prefix(name, "video");
+  g_free(name);
 
-      g_signal_connect(gst_elem, "source-setup", G_CALLBACK(_set_udp_caps), NULL);
-      gst_element_set_state (gst_elem, GST_STATE_PLAYING);
+  if (video) {
+    GstPad* parser_pad = gst_element_get_static_pad(self->video_parser, "sink");
+    if (gst_pad_is_linked(parser_pad) || gst_pad_link(pad, parser_pad) != GST_PAD_LINK_OK)
+      WDS_WARNING("Cannot link video stream");
+    gst_object_unref(parser_pad);
+    return;
   }
+
+  // Audio codec depends on what was negotiated, let decodebin find it
+  GstElement* decoder = gst_element_factory_make("decodebin", NULL);
+  if (!decoder)
+    return;
+  g_signal_connect(decoder, "pad-added", G_CALLBACK(audio_pad_added_cb), self);
+  gst_bin_add(GST_BIN(self->gst_elem), decoder);
+  gst_element_sync_state_with_parent(decoder);
+
+  GstPad* decoder_pad = gst_element_get_static_pad(decoder, "sink");
+  if (gst_pad_link(pad, decoder_pad) != GST_PAD_LINK_OK)
+    WDS_WARNING("Cannot link audio stream");
+  gst_object_unref(decoder_pad);
+}
+
+void MiracGstSink::audio_pad_added_cb(GstElement* decoder, GstPad* pad, gpointer data_ptr) {
+  MiracGstSink* self = static_cast<MiracGstSink*>(data_ptr);
+  GstElement* bin = self->gst_elem;
+  GstElement* convert = add_element(bin, "audioconvert");
+  GstElement* resample = add_element(bin, "audioresample");
+  GstElement* sink = add_element(bin, "autoaudiosink");
+  // The lip-sync meter reads 16 bit samples
+  GstCaps* caps = self->lip_sync_meter ?
+      gst_caps_new_simple("audio/x-raw", "format", G_TYPE_STRING, "S16LE", NULL) : NULL;
+  bool linked = convert && resample && sink &&
+                gst_element_link_filtered(convert, resample, caps) &&
+                gst_element_link(resample, sink);
+  if (caps)
+    gst_caps_unref(caps);
+  if (!linked) {
+    WDS_WARNING("Cannot create audio output");
+    return;
+  }
+  if (self->lip_sync_meter) {
+    GstPad* resample_pad = gst_element_get_static_pad(resample, "sink");
+    self->lip_sync_meter->WatchAudio(resample_pad);
+    gst_object_unref(resample_pad);
+  }
+  gst_element_sync_state_with_parent(sink);
+  gst_element_sync_state_with_parent(resample);
+  gst_element_sync_state_with_parent(convert);
+
+  GstPad* convert_pad = gst_element_get_static_pad(convert, "sink");
+  gst_pad_link(pad, convert_pad);
+  gst_object_unref(convert_pad);
+}
+
+void MiracGstSink::glass_to_glass_cb(gint64 latency, gpointer data_ptr) {
+  MiracGstSink* self = static_cast<MiracGstSink*>(data_ptr);
+  self->g2g_min = std::min(self->g2g_min, latency);
+  self->g2g_max = std::max(self->g2g_max, latency);
+  self->g2g_total += latency;
+  self->g2g_frames++;
+
+  gint64 now = g_get_monotonic_time();
+  if (!self->g2g_report_time)
+    self->g2g_report_time = now;
+  if (now - self->g2g_report_time < G_TIME_SPAN_SECOND)
+    return;
+
+  WDS_LOG("Glass-to-glass latency over %u frames: min %" G_GINT64_FORMAT
+          " ms, mean %" G_GINT64_FORMAT " ms, max %" G_GINT64_FORMAT " ms",
+          self->g2g_frames, self->g2g_min / 1000,
+          self->g2g_total / self->g2g_frames / 1000, self->g2g_max / 1000);
+  self->g2g_report_time = now;
+  self->g2g_min = G_MAXINT64;
+  self->g2g_max = 0;
+  self->g2g_total = 0;
+  self->g2g_frames = 0;
 }
 
 int MiracGstSink::sink_udp_port() {
     if (gst_elem == NULL)
         return 0;
 
-    GstElement* source = NULL;
-    g_object_get(gst_elem, "source", &source, NULL);
+    GstElement* source = gst_bin_get_by_name(GST_BIN(gst_elem), "source");
 
     if (source == NULL)
         return 0;
 
     gint port = 0;
     g_object_get(source, "port", &port, NULL);
+    gst_object_unref(source);
     return port;
 }
 
-void MiracGstSink::Play() {
-  assert(gst_elem);
-  if(!IsInState(GST_STATE_PLAYING)) {
-    gst_element_set_state(gst_elem, GST_STATE_PLAYING);
-    IsInState(GST_STATE_PLAYING);
-  }
+void MiracGstSink::Play(const MiracGstStateWaiter::Callback& done) {
+  ChangeState(GST_STATE_PLAYING, done);
 }
 
-void MiracGstSink::Pause() {
-  assert(gst_elem);
-  if(!IsPaused()) {
-    gst_element_set_state(gst_elem, GST_STATE_PAUSED);
-    IsPaused();
-  }
+void MiracGstSink::Pause(const MiracGstStateWaiter::Callback& done) {
+  ChangeState(GST_STATE_PAUSED, done);
 }
 
-void MiracGstSink::Teardown() {
+void MiracGstSink::Teardown(const MiracGstStateWaiter::Callback& done) {
+  ChangeState(GST_STATE_READY, done);
+}
+
+void MiracGstSink::ChangeState(GstState state, const MiracGstStateWaiter::Callback& done) {
   assert(gst_elem);
-  if(!IsInState(GST_STATE_READY)) {
-    gst_element_set_state(gst_elem, GST_STATE_READY);
-    IsInState(GST_STATE_READY);
-  }
+  // Waiting for the decoders here would stall the RTSP keep-alives
+  if (!IsInState(state))
+    state_waiter.SetState(gst_elem, state, done);
+  else if (done)
+    done(true);
 }
 
 bool MiracGstSink::IsPaused() const {
   return IsInState(GST_STATE_PAUSED);
 }
 
+// The state being changed to counts, see ChangeState()
 bool MiracGstSink::IsInState(GstState state) const {
   assert(gst_elem);
-  GstState current_state;
-  gst_element_get_state(gst_elem, &current_state, NULL, GST_CLOCK_TIME_NONE);
-  return current_state == state;
+  return MiracGstTargetState(gst_elem) == state;
 }
 
 MiracGstSink::~MiracGstSink () {
   if (gst_elem) {
+    if (bus_watch) {
+      g_source_destroy(bus_watch);
+      g_source_unref(bus_watch);
+    }
     gst_element_set_state (gst_elem, GST_STATE_NULL);
-    g_source_remove (bus_watch_id);
     gst_object_unref (GST_OBJECT (gst_elem));
   }
+  if (rtcp_socket)
+    g_object_unref(rtcp_socket);
 }
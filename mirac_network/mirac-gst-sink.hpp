@@ -22,26 +22,77 @@
 #ifndef MIRAC_GST_SINK_HPP
 #define MIRAC_GST_SINK_HPP
 
+#include <gio/gio.h>
 #include <gst/gst.h>
+#include <memory>
 #include <string>
 
+#include "mirac-gst-bus-handler.hpp"
+#include "mirac-gst-frame-timing.hpp"
+#include "mirac-gst-lip-sync.hpp"
+
 class MiracGstSink
 {
 public:
-    MiracGstSink(std::string hostname, int port);
+    // Jitterbuffer latency budget, in milliseconds
+    static const guint default_latency = 40;
+
+    // udpsrc ! rtpbin ! rtpmp2tdepay ! tsdemux ! h264parse ! decoder !
+    // videoconvert ! autovideosink, with audio decoded by decodebin. RTCP
+    // is received on port + 1 (a free pair is picked if port is 0). In
+    // glass-to-glass mode decoded frames stamped by a MiracGstTestSource
+    // on the same host report their end-to-end latency, in lip-sync mode
+    // the audio offset of its markers is logged.
+    MiracGstSink(std::string hostname, int port, guint latency = default_latency,
+                 bool glass_to_glass = false, bool lip_sync = false);
     ~MiracGstSink ();
 
-    void Play();
-    void Pause();
+    // The state changes return right away, done (if any) is called once
+    // the pipeline is in the state
+    void Play(const MiracGstStateWaiter::Callback& done = nullptr);
+    void Pause(const MiracGstStateWaiter::Callback& done = nullptr);
     bool IsPaused() const;
-    void Teardown();
+    void Teardown(const MiracGstStateWaiter::Callback& done = nullptr);
 
     int sink_udp_port();
 
+    bool IsRtcpSupported() const;
+    // Starts sending receiver reports to the source
+    void SetSourceRtcpAddress(const std::string& hostname, int port);
+
+    // Jitterbuffer and decode latency, late and dropped frames
+    MiracFrameTiming& FrameTiming() { return frame_timing; }
+
 private:
     bool IsInState(GstState state) const;
+    void ChangeState(GstState state, const MiracGstStateWaiter::Callback& done);
+    bool AddElements(guint latency);
+    void BindSockets(const std::string& hostname, int port);
+    void InstallFrameTiming();
+
+    static void rtpbin_pad_added_cb(GstElement* rtpbin, GstPad* pad, gpointer data_ptr);
+    static void new_jitterbuffer_cb(GstElement* rtpbin, GstElement* jitterbuffer,
+                                    guint session, guint ssrc, gpointer data_ptr);
+    static void demux_pad_added_cb(GstElement* demux, GstPad* pad, gpointer data_ptr);
+    static void audio_pad_added_cb(GstElement* decoder, GstPad* pad, gpointer data_ptr);
+    static void glass_to_glass_cb(gint64 latency, gpointer data_ptr);
+
     GstElement* gst_elem;
-    guint bus_watch_id;
+    GSource* bus_watch;
+    MiracGstStateWaiter state_waiter;
+    GstElement* depayloader;
+    GstElement* video_parser;
+    // NULL if RTCP uses the port + 1 given to udpsrc
+    GSocket* rtcp_socket;
+    bool rtcp_supported;
+
+    // Glass-to-glass samples since the last report, streaming thread only
+    gint64 g2g_report_time;
+    gint64 g2g_min, g2g_max, g2g_total;
+    unsigned g2g_frames;
+
+    MiracFrameTiming frame_timing;
+    std::unique_ptr<MiracLipSyncMeter> lip_sync_meter;
 };
 
 #endif
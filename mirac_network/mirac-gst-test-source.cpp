@@ -21,28 +21,58 @@
  * 02110-1301 USA
  */
 
+#include <algorithm>
 #include <iostream>
-#include <gio/gio.h>
 
 #include "mirac-gst-test-source.hpp"
 #include "mirac-gst-bus-handler.hpp"
+#include "mirac-audio-caps.hpp"
+#include "mirac-gst-frame-stamp.hpp"
+#include "mirac-gst-lip-sync.hpp"
+#include "mirac-gst-screen-convert.hpp"
+#include "mirac-rtp-sockets.hpp"
 #include "libwds/public/logging.h"
 
-MiracGstTestSource::MiracGstTestSource (wfd_test_stream_t wfd_stream_type, std::string hostname, int port)
+// MP2T RTP timestamps, in which RTCP reports the jitter
+static const double rtp_clock_rate = 90000;
+// Lowest bitrate the rate controller goes to, relative to the
+// negotiated one
+static const unsigned min_bitrate_divisor = 10;
+// Static frames tracked through the encoder, more than it ever holds
+static const size_t max_static_pts = 64;
+
+MiracGstTestSource::MiracGstTestSource (wfd_test_stream_t wfd_stream_type, std::string hostname, int port,
+                                        const std::string& interface)
+  : gst_elem(NULL),
+    bus_watch(NULL),
+    has_audio(false),
+    encoder(NULL),
+    key_frame_timeout(NULL),
+    last_key_frame_request(0),
+    key_frame_stats(),
+    key_frame_requested_at(0),
+    key_frame_encoded(false),
+    play_requested_at(0),
+    first_packet_latency(0),
+    rtcp_socket(NULL),
+    encoding(),
+    pending_switch(),
+    switch_probe_installed(false),
+    idle_stats()
 {
     std::string gst_pipeline;
 
     std::string hostname_port = (!hostname.empty() ? "host=" + hostname + " ": " ") + (port > 0 ? "port=" + std::to_string(port) : "");
 
     if (wfd_stream_type == WFD_TEST_BOTH) {
-        gst_pipeline = "videotestsrc ! videoconvert ! video/x-raw,format=I420 ! x264enc ! muxer.  audiotestsrc ! avenc_ac3 ! muxer.  mpegtsmux name=muxer ! rtpmp2tpay ! udpsink name=sink " +
+        gst_pipeline = "videotestsrc ! videoconvert ! video/x-raw,format=I420 ! x264enc name=encoder ! muxer.  audiotestsrc ! avenc_ac3 ! muxer.  mpegtsmux name=muxer ! rtpmp2tpay ! udpsink name=sink " +
             hostname_port;
     } else if (wfd_stream_type == WFD_TEST_AUDIO) {
         gst_pipeline = "audiotestsrc ! avenc_ac3 ! mpegtsmux ! rtpmp2tpay ! udpsink name=sink " + hostname_port;
     } else if (wfd_stream_type == WFD_TEST_VIDEO) {
-        gst_pipeline = "videotestsrc ! videoconvert ! video/x-raw,format=I420 ! x264enc ! mpegtsmux ! rtpmp2tpay ! udpsink name=sink " + hostname_port;
+        gst_pipeline = "videotestsrc ! videoconvert ! video/x-raw,format=I420 ! x264enc name=encoder ! mpegtsmux ! rtpmp2tpay ! udpsink name=sink " + hostname_port;
     } else if (wfd_stream_type == WFD_DESKTOP) {
-        gst_pipeline = "ximagesrc ! videoconvert ! video/x-raw,format=I420 ! x264enc tune=zerolatency ! mpegtsmux ! rtpmp2tpay ! udpsink name=sink " + hostname_port;
+        gst_pipeline = "ximagesrc ! videoconvert ! video/x-raw,format=I420 ! x264enc name=encoder tune=zerolatency ! mpegtsmux ! rtpmp2tpay ! udpsink name=sink " + hostname_port;
     }
 
     GError *err = NULL;
@@ -50,28 +80,818 @@ MiracGstTestSource::MiracGstTestSource (wfd_test_stream_t wfd_stream_type, std::
     if (err != NULL) {
         WDS_ERROR("Cannot initialize gstreamer pipeline: [%s] %s", g_quark_to_string(err->domain), err->message);
     }
+    has_audio = gst_elem && (wfd_stream_type == WFD_TEST_AUDIO || wfd_stream_type == WFD_TEST_BOTH);
+
+    Init(hostname, interface);
+}
+
+static GstElement* add_element(GstElement* bin, const char* factory, const char* name = NULL)
+{
+    GstElement* element = gst_element_factory_make(factory, name);
+    if (!element) {
+        WDS_ERROR("Cannot create gstreamer element %s", factory);
+        return NULL;
+    }
+    gst_bin_add(GST_BIN(bin), element);
+    return element;
+}
+
+MiracGstTestSource::MiracGstTestSource (wfd_test_stream_t wfd_stream_type, const wds::H264VideoFormat& format,
+                                        const wds::AudioCodec* audio_codec, std::string hostname, int port,
+                                        const std::string& interface)
+  : gst_elem(NULL),
+    bus_watch(NULL),
+    has_audio(false),
+    encoder(NULL),
+    key_frame_timeout(NULL),
+    last_key_frame_request(0),
+    key_frame_stats(),
+    key_frame_requested_at(0),
+    key_frame_encoded(false),
+    play_requested_at(0),
+    first_packet_latency(0),
+    rtcp_socket(NULL),
+    encoding(),
+    pending_switch(),
+    switch_probe_installed(false),
+    idle_stats()
+{
+    gst_elem = gst_pipeline_new(NULL);
+
+    GstElement* muxer = add_element(gst_elem, "mpegtsmux");
+    GstElement* payloader = add_element(gst_elem, "rtpmp2tpay");
+    GstElement* rtpbin = add_element(gst_elem, "rtpbin", "rtpbin");
+    GstElement* sink = add_element(gst_elem, "udpsink", "sink");
+
+    // The send_rtp_src pad appears once send_rtp_sink is requested
+    bool ok = muxer && payloader && rtpbin && sink &&
+              gst_element_link(muxer, payloader) &&
+              gst_element_link_pads(payloader, "src", rtpbin, "send_rtp_sink_0") &&
+              gst_element_link_pads(rtpbin, "send_rtp_src_0", sink, "sink");
+    if (ok && wfd_stream_type != WFD_TEST_AUDIO)
+        ok = AddVideoBranch(wfd_stream_type, format, muxer);
+    if (ok && wfd_stream_type != WFD_TEST_VIDEO && audio_codec) {
+        has_audio = AddAudioBranch(wfd_stream_type, *audio_codec, muxer);
+        // The screen is still worth sharing without its sound
+        if (!has_audio && wfd_stream_type == WFD_DESKTOP) {
+            WDS_WARNING("Streaming the desktop without audio");
+        } else {
+            ok = has_audio;
+        }
+    }
+
+    if (!ok) {
+        WDS_ERROR("Cannot initialize gstreamer pipeline");
+        gst_object_unref(gst_elem);
+        gst_elem = NULL;
+        return;
+    }
+
+    if (!hostname.empty())
+        g_object_set(sink, "host", hostname.c_str(), NULL);
+    if (port > 0)
+        g_object_set(sink, "port", port, NULL);
+
+    Init(hostname, interface);
+}
+
+bool MiracGstTestSource::AddVideoBranch(wfd_test_stream_t wfd_stream_type, const wds::H264VideoFormat& format,
+                                        GstElement* muxer)
+{
+    GstElement* source = add_element(gst_elem, wfd_stream_type == WFD_DESKTOP ? "ximagesrc" : "videotestsrc");
+    // Frames are dropped before scaling and converting so that a fast
+    // capture does not cost more than the negotiated rate
+    GstElement* rate = add_element(gst_elem, "videorate");
+    // Named so that SwitchVideoFormat() can switch at a given frame
+    GstElement* scale = add_element(gst_elem, "videoscale", "scale");
+    GstElement* convert = add_element(gst_elem, "videoconvert");
+    // The desktop is converted to I420 by miracscreenconvert, which only
+    // redoes what changed on the screen; videoconvert just passes the
+    // BGRx frames of ximagesrc through (or handles 16 bit displays).
+    GstElement* screen_convert = NULL;
+    if (wfd_stream_type == WFD_DESKTOP && MiracRegisterScreenConvert())
+        screen_convert = add_element(gst_elem, "miracscreenconvert", "screenconvert");
+    // Named so that the rate controller can scale the resolution down
+    GstElement* filter = add_element(gst_elem, "capsfilter", "rawcaps");
+    GstElement* encoder = add_element(gst_elem, "x264enc", "encoder");
+    if (!source || !rate || !scale || !convert || !filter || !encoder)
+        return false;
+
+    if (wfd_stream_type == WFD_DESKTOP) {
+        // XShm capture of the XDamage reported regions only, on top of
+        // the last frame
+        g_object_set(source, "use-damage", TRUE, NULL);
+    } else {
+        g_object_set(source, "is-live", TRUE, NULL);
+    }
+
+    gst_util_set_object_arg(G_OBJECT(encoder), "tune", "zerolatency");
+    // Named so that SetVideoFormat() can change the profile and level
+    GstElement* h264_filter = add_element(gst_elem, "capsfilter", "h264caps");
+    if (!h264_filter)
+        return false;
+
+    ConfigureVideo(format, filter, encoder, h264_filter);
+    return gst_element_link_many(source, rate, scale, convert, NULL) &&
+           (screen_convert ? gst_element_link_many(convert, screen_convert, filter, NULL)
+                           : gst_element_link(convert, filter)) &&
+           gst_element_link_many(filter, encoder, h264_filter, muxer, NULL);
+}
+
+void MiracGstTestSource::ConfigureVideo(const wds::H264VideoFormat& format, GstElement* raw_filter,
+                                        GstElement* video_encoder, GstElement* h264_filter)
+{
+    encoding = MiracVideoEncodingFor(format);
+    // Also cleared, for a later format without slices
+    std::string options = encoding.slices ? "slices=" + std::to_string(encoding.slices) : "";
+    g_object_set(video_encoder,
+                 "bitrate", encoding.bitrate,
+                 "key-int-max", encoding.key_int_max,
+                 "interlaced", encoding.interlaced,
+                 "vbv-buf-capacity", encoding.vbv_buffer_ms,
+                 "option-string", options.c_str(),
+                 NULL);
+
+    GstCaps* raw_caps = MiracRawVideoCapsFor(format);
+    GstCaps* h264_caps = MiracH264CapsFor(format);
+    g_object_set(raw_filter, "caps", raw_caps, NULL);
+    g_object_set(h264_filter, "caps", h264_caps, NULL);
+    gst_caps_unref(raw_caps);
+    gst_caps_unref(h264_caps);
+
+    WDS_LOG("Encoding %ux%u%c%u, %s level %s, %u kbit/s, %u slices",
+            encoding.width, encoding.height, encoding.interlaced ? 'i' : 'p',
+            encoding.frame_rate, encoding.profile, encoding.level, encoding.bitrate,
+            std::max(encoding.slices, 1u));
+    rate_controller.reset(new MiracRateController(encoding.bitrate,
+                                                  encoding.bitrate / min_bitrate_divisor));
+}
+
+bool MiracGstTestSource::SetVideoFormat(const wds::H264VideoFormat& format)
+{
+    GstElement* raw_filter = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "rawcaps") : NULL;
+    GstElement* h264_filter = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "h264caps") : NULL;
+    // x264enc only takes most of its settings in READY, and the streaming
+    // threads must not be running while the rate controller is replaced
+    bool ok = raw_filter && h264_filter && encoder && GST_STATE(gst_elem) <= GST_STATE_READY &&
+              GST_STATE_PENDING(gst_elem) == GST_STATE_VOID_PENDING;
+    if (ok) {
+        ConfigureVideo(format, raw_filter, encoder, h264_filter);
+        // A switch for the previous format must not follow this one
+        std::lock_guard<std::mutex> lock(switch_mutex);
+        if (pending_switch.raw_caps) {
+            gst_caps_unref(pending_switch.raw_caps);
+            gst_caps_unref(pending_switch.h264_caps);
+        }
+        pending_switch = PendingSwitch();
+    }
+
+    if (raw_filter)
+        gst_object_unref(raw_filter);
+    if (h264_filter)
+        gst_object_unref(h264_filter);
+    return ok;
+}
+
+static bool is_streaming(GstElement* pipeline)
+{
+    return GST_STATE(pipeline) > GST_STATE_READY ||
+           GST_STATE_PENDING(pipeline) != GST_STATE_VOID_PENDING;
+}
+
+bool MiracGstTestSource::CanSwitchVideoFormat(const wds::H264VideoFormat& format)
+{
+    if (!gst_elem || !encoder)
+        return false;
+    if (!is_streaming(gst_elem))
+        return true;
+    std::lock_guard<std::mutex> lock(encoding_mutex);
+    return MiracVideoEncodingFor(format).interlaced == encoding.interlaced;
+}
+
+bool MiracGstTestSource::SwitchVideoFormat(const wds::H264VideoFormat& format, GstClockTime at)
+{
+    if (!gst_elem || !encoder)
+        return false;
+    if (!is_streaming(gst_elem))
+        return SetVideoFormat(format);
+    if (!CanSwitchVideoFormat(format)) {
+        WDS_WARNING("Cannot switch between progressive and interlaced while streaming");
+        return false;
+    }
+
+    MiracVideoEncoding switched = MiracVideoEncodingFor(format);
+    {
+        std::lock_guard<std::mutex> lock(encoding_mutex);
+        switched.key_int_max = encoding.key_int_max;
+        switched.slices = encoding.slices;
+        switched.vbv_buffer_ms = encoding.vbv_buffer_ms;
+    }
+
+    GstElement* scale = gst_bin_get_by_name(GST_BIN(gst_elem), "scale");
+    if (!scale)
+        return false;
+
+    PendingSwitch replaced;
+    bool install;
+    {
+        std::lock_guard<std::mutex> lock(switch_mutex);
+        replaced = pending_switch;
+        pending_switch.encoding = switched;
+        pending_switch.raw_caps = MiracRawVideoCapsFor(format);
+        pending_switch.h264_caps = MiracH264CapsFor(format);
+        pending_switch.at = at;
+        install = !switch_probe_installed;
+        switch_probe_installed = true;
+    }
+    if (replaced.raw_caps) {
+        WDS_WARNING("Replacing a video format switch that is still pending");
+        gst_caps_unref(replaced.raw_caps);
+        gst_caps_unref(replaced.h264_caps);
+    }
+
+    // Upstream of the scaler, so that the frame it passes is the first
+    // one scaled to the new caps
+    if (install) {
+        GstPad* pad = gst_element_get_static_pad(scale, "sink");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, switch_probe_cb, this, NULL);
+        gst_object_unref(pad);
+    }
+    gst_object_unref(scale);
+    return true;
+}
+
+static GstClockTime buffer_running_time(GstPad* pad, GstBuffer* buffer)
+{
+    if (!GST_BUFFER_PTS_IS_VALID(buffer))
+        return GST_CLOCK_TIME_NONE;
+    GstEvent* event = gst_pad_get_sticky_event(pad, GST_EVENT_SEGMENT, 0);
+    if (!event)
+        return GST_CLOCK_TIME_NONE;
+    GstSegment segment;
+    gst_event_copy_segment(event, &segment);
+    gst_event_unref(event);
+    return gst_segment_to_running_time(&segment, GST_FORMAT_TIME, GST_BUFFER_PTS(buffer));
+}
+
+GstPadProbeReturn MiracGstTestSource::switch_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    GstClockTime running_time = buffer_running_time(pad, GST_PAD_PROBE_INFO_BUFFER(info));
+
+    PendingSwitch pending;
+    {
+        std::lock_guard<std::mutex> lock(self->switch_mutex);
+        // Frames without a timestamp do not hold a switch back
+        if (self->pending_switch.raw_caps &&
+            GST_CLOCK_TIME_IS_VALID(self->pending_switch.at) &&
+            GST_CLOCK_TIME_IS_VALID(running_time) &&
+            running_time < self->pending_switch.at)
+            return GST_PAD_PROBE_OK;
+        pending = self->pending_switch;
+        self->pending_switch = PendingSwitch();
+        self->switch_probe_installed = false;
+    }
+
+    if (pending.raw_caps) {
+        self->ApplyVideoSwitch(pending, pad, running_time);
+        gst_caps_unref(pending.raw_caps);
+        gst_caps_unref(pending.h264_caps);
+    }
+    return GST_PAD_PROBE_REMOVE;
+}
+
+void MiracGstTestSource::ApplyVideoSwitch(const PendingSwitch& pending, GstPad* pad,
+                                          GstClockTime running_time)
+{
+    GstElement* raw_filter = gst_bin_get_by_name(GST_BIN(gst_elem), "rawcaps");
+    GstElement* h264_filter = gst_bin_get_by_name(GST_BIN(gst_elem), "h264caps");
+    if (raw_filter && h264_filter) {
+        std::lock_guard<std::mutex> lock(encoding_mutex);
+        encoding = pending.encoding;
+        rate_controller.reset(new MiracRateController(encoding.bitrate,
+                                                      encoding.bitrate / min_bitrate_divisor));
+        g_object_set(encoder, "bitrate", encoding.bitrate, NULL);
+        // The scaler renegotiates before it handles the frame in the probe
+        g_object_set(h264_filter, "caps", pending.h264_caps, NULL);
+        g_object_set(raw_filter, "caps", pending.raw_caps, NULL);
+    }
+    bool ok = raw_filter && h264_filter;
+    if (raw_filter)
+        gst_object_unref(raw_filter);
+    if (h264_filter)
+        gst_object_unref(h264_filter);
+    if (!ok) {
+        WDS_WARNING("Cannot switch the video format, the pipeline has no caps filters");
+        return;
+    }
+
+    // x264enc starts over with an IDR picture on new caps anyway, this
+    // also covers a change of the profile or level only. Same event as
+    // gst_video_event_new_downstream_force_key_unit() creates, sent ahead
+    // of the frame so that it is that one.
+    GstStructure* structure = gst_structure_new("GstForceKeyUnit",
+                                                "timestamp", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+                                                "stream-time", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+                                                "running-time", G_TYPE_UINT64, running_time,
+                                                "all-headers", G_TYPE_BOOLEAN, TRUE,
+                                                "count", G_TYPE_UINT, 0,
+                                                NULL);
+    bool sent = gst_pad_send_event(pad, gst_event_new_custom(GST_EVENT_CUSTOM_DOWNSTREAM, structure));
+    {
+        std::lock_guard<std::mutex> lock(key_frame_mutex);
+        key_frame_stats.requests++;
+        if (sent) {
+            key_frame_stats.sent++;
+            if (!key_frame_requested_at) {
+                key_frame_requested_at = g_get_monotonic_time();
+                key_frame_encoded = false;
+            }
+        }
+    }
+    if (!sent)
+        WDS_WARNING("Encoder did not accept the IDR picture request of the switch");
+
+    WDS_LOG("Switched to %ux%u%c%u, %s level %s, %u kbit/s at %" GST_TIME_FORMAT,
+            pending.encoding.width, pending.encoding.height,
+            pending.encoding.interlaced ? 'i' : 'p', pending.encoding.frame_rate,
+            pending.encoding.profile, pending.encoding.level, pending.encoding.bitrate,
+            GST_TIME_ARGS(running_time));
+}
+
+GstClockTime MiracGstTestSource::RunningTime() const
+{
+    if (!gst_elem || GST_STATE(gst_elem) != GST_STATE_PLAYING)
+        return GST_CLOCK_TIME_NONE;
+    GstClock* clock = gst_element_get_clock(gst_elem);
+    if (!clock)
+        return GST_CLOCK_TIME_NONE;
+    GstClockTime now = gst_clock_get_time(clock);
+    gst_object_unref(clock);
+    return now - gst_element_get_base_time(gst_elem);
+}
+
+void MiracGstTestSource::SetDestination(const std::string& hostname, int port)
+{
+    GstElement* sink = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "sink") : NULL;
+    if (!sink)
+        return;
+    g_object_set(sink, "host", hostname.c_str(), "port", port, NULL);
+    gst_object_unref(sink);
+}
+
+bool MiracGstTestSource::AddAudioBranch(wfd_test_stream_t wfd_stream_type, const wds::AudioCodec& codec,
+                                        GstElement* muxer)
+{
+    MiracAudioEncoding encoding = MiracAudioEncodingFor(codec);
+
+    GstElement* source = add_element(gst_elem, wfd_stream_type == WFD_DESKTOP ? "pulsesrc" : "audiotestsrc");
+    GstElement* convert = add_element(gst_elem, "audioconvert");
+    GstElement* resample = add_element(gst_elem, "audioresample");
+    // Named for EnableLipSyncMarkers()
+    GstElement* filter = add_element(gst_elem, "capsfilter", "audiocaps");
+    GstElement* encoder = add_element(gst_elem, encoding.encoder);
+    bool ok = source && convert && resample && filter && encoder;
+
+    if (ok && wfd_stream_type == WFD_DESKTOP) {
+        // What the desktop plays rather than the microphone. The pipeline
+        // clock stays with ximagesrc's system clock so that both streams
+        // are timestamped against the same one; 10 ms capture periods
+        // keep the audio from lagging the video.
+        g_object_set(source,
+                     "device", "@DEFAULT_MONITOR@",
+                     "provide-clock", FALSE,
+                     "latency-time", (gint64) 10000,
+                     NULL);
+        // pulsesrc connects to the server in READY, without one the
+        // whole pipeline would fail to start
+        ok = gst_element_set_state(source, GST_STATE_READY) != GST_STATE_CHANGE_FAILURE;
+        gst_element_set_state(source, GST_STATE_NULL);
+        if (!ok)
+            WDS_ERROR("Cannot capture audio from PulseAudio");
+    } else if (ok) {
+        g_object_set(source, "is-live", TRUE, "samplesperbuffer", 480, NULL);
+    }
 
+    if (ok) {
+        GstCaps* caps = MiracRawAudioCaps(encoding);
+        g_object_set(filter, "caps", caps, NULL);
+        gst_caps_unref(caps);
+        ok = gst_element_link_many(source, convert, resample, filter, encoder, muxer, NULL);
+    }
+
+    if (!ok) {
+        // Leaves the pipeline as it was, e.g. to stream video only
+        GstElement* elements[] = {source, convert, resample, filter, encoder};
+        for (GstElement* element : elements) {
+            if (element)
+                gst_bin_remove(GST_BIN(gst_elem), element);
+        }
+        return false;
+    }
+
+    WDS_LOG("Encoding audio with %s, %u Hz, %u channels",
+            encoding.encoder, encoding.rate, encoding.channels);
+    return true;
+}
+
+void MiracGstTestSource::Init(const std::string& hostname, const std::string& interface)
+{
     if (gst_elem) {
-        GstBus* bus = gst_pipeline_get_bus (GST_PIPELINE (gst_elem));
-        bus_watch_id = gst_bus_add_watch (bus, mirac_gstbus_callback, this);
-        gst_object_unref (bus);
+        bus_watch = MiracGstAddBusWatch(gst_elem, &state_waiter);
+
+        BindSockets(hostname, interface);
+
+        InstallKeyFrameProbes();
+        InstallFrameTiming();
+    }
+}
+
+void MiracGstTestSource::InstallFrameTiming()
+{
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(gst_elem), "sink");
+    if (encoder && sink) {
+        GstPad* encoder_sink = gst_element_get_static_pad(encoder, "sink");
+        GstPad* encoder_src = gst_element_get_static_pad(encoder, "src");
+        GstPad* udp_sink = gst_element_get_static_pad(sink, "sink");
+        frame_timing.AddStage("encode", encoder_sink, encoder_src, MiracFrameTiming::MATCH_PTS);
+        frame_timing.AddStage("mux", encoder_src, udp_sink, MiracFrameTiming::MATCH_PTS);
+        frame_timing.CountFrames(encoder_src);
+        gst_object_unref(encoder_sink);
+        gst_object_unref(encoder_src);
+        gst_object_unref(udp_sink);
+    }
+    if (sink)
+        gst_object_unref(sink);
+}
+
+void MiracGstTestSource::InstallKeyFrameProbes()
+{
+    encoder = gst_bin_get_by_name(GST_BIN(gst_elem), "encoder");
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(gst_elem), "sink");
+    if (encoder && sink) {
+        GstPad* pad = gst_element_get_static_pad(encoder, "src");
+        gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, encoder_probe_cb, this, NULL);
+        gst_object_unref(pad);
+
+        pad = gst_element_get_static_pad(sink, "sink");
+        gst_pad_add_probe(pad, (GstPadProbeType) (GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST),
+                          sink_probe_cb, this, NULL);
+        gst_object_unref(pad);
+    }
+    if (sink)
+        gst_object_unref(sink);
+}
+
+void MiracGstTestSource::RequestKeyFrame()
+{
+    if (!encoder) {
+        WDS_WARNING("No video encoder to request an IDR picture from");
+        return;
+    }
+
+    gint64 now = g_get_monotonic_time();
+    {
+        std::lock_guard<std::mutex> lock(key_frame_mutex);
+        key_frame_stats.requests++;
+        // A request that never produced a key frame (e.g. sent while
+        // paused) must not swallow the following ones forever
+        if (key_frame_requested_at && !key_frame_timeout &&
+            now - key_frame_requested_at > 4 * min_key_frame_interval)
+            key_frame_requested_at = 0;
+        // The IDR frame already asked for answers this request too
+        if (key_frame_timeout || key_frame_requested_at) {
+            key_frame_stats.coalesced++;
+            return;
+        }
+        key_frame_requested_at = now;
+        key_frame_encoded = false;
+    }
+
+    gint64 wait = last_key_frame_request + min_key_frame_interval - now;
+    if (last_key_frame_request && wait > 0) {
+        // On the caller's context, a pooled session's worker runs it
+        key_frame_timeout = g_timeout_source_new(wait / G_TIME_SPAN_MILLISECOND + 1);
+        g_source_set_callback(key_frame_timeout, key_frame_timeout_cb, this, NULL);
+        g_source_attach(key_frame_timeout, g_main_context_get_thread_default());
+    } else {
+        SendKeyFrameRequest();
+    }
+}
+
+gboolean MiracGstTestSource::key_frame_timeout_cb(gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    g_source_unref(self->key_frame_timeout);
+    self->key_frame_timeout = NULL;
+    self->SendKeyFrameRequest();
+    return G_SOURCE_REMOVE;
+}
+
+void MiracGstTestSource::SendKeyFrameRequest()
+{
+    unsigned count;
+    {
+        std::lock_guard<std::mutex> lock(key_frame_mutex);
+        count = key_frame_stats.sent;
+    }
+
+    // Same event as gst_video_event_new_upstream_force_key_unit() creates,
+    // built here to avoid depending on libgstvideo for a single call
+    GstStructure* structure = gst_structure_new("GstForceKeyUnit",
+                                                "running-time", G_TYPE_UINT64, GST_CLOCK_TIME_NONE,
+                                                "all-headers", G_TYPE_BOOLEAN, TRUE,
+                                                "count", G_TYPE_UINT, count,
+                                                NULL);
+    // Sent to the encoder src pad, as if it came from the muxer
+    if (!gst_element_send_event(encoder, gst_event_new_custom(GST_EVENT_CUSTOM_UPSTREAM, structure))) {
+        WDS_WARNING("Encoder did not accept the IDR picture request");
+        std::lock_guard<std::mutex> lock(key_frame_mutex);
+        key_frame_requested_at = 0;
+        return;
+    }
+
+    last_key_frame_request = g_get_monotonic_time();
+    std::lock_guard<std::mutex> lock(key_frame_mutex);
+    key_frame_stats.sent++;
+}
+
+GstPadProbeReturn MiracGstTestSource::encoder_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    if (!GST_BUFFER_FLAG_IS_SET(buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+        std::lock_guard<std::mutex> lock(self->key_frame_mutex);
+        if (self->key_frame_requested_at)
+            self->key_frame_encoded = true;
+    }
+
+    std::lock_guard<std::mutex> lock(self->idle_mutex);
+    if (self->idle_filter) {
+        gsize size = gst_buffer_get_size(buffer);
+        self->idle_stats.encoded_bytes += size;
+        // x264enc keeps the input timestamps and, with zerolatency, the
+        // frame order
+        std::deque<GstClockTime>& pts = self->static_pts;
+        while (!pts.empty() && pts.front() < GST_BUFFER_PTS(buffer))
+            pts.pop_front();
+        if (!pts.empty() && pts.front() == GST_BUFFER_PTS(buffer)) {
+            pts.pop_front();
+            self->idle_stats.static_encoded++;
+            self->idle_stats.static_bytes += size;
+        }
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+bool MiracGstTestSource::EnableIdleFrameSkipping(gint64 refresh_interval)
+{
+    GstElement* convert = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "screenconvert") : NULL;
+    if (!convert || !encoder) {
+        if (convert)
+            gst_object_unref(convert);
+        return false;
+    }
+    gst_object_unref(convert);
+
+    {
+        std::lock_guard<std::mutex> lock(idle_mutex);
+        if (idle_filter)
+            return true;
+        idle_filter.reset(new MiracIdleFrameFilter(idle_settle_time, refresh_interval));
+    }
+
+    GstPad* pad = gst_element_get_static_pad(encoder, "sink");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, idle_probe_cb, this, NULL);
+    gst_object_unref(pad);
+    return true;
+}
+
+GstPadProbeReturn MiracGstTestSource::idle_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    GstBuffer* buffer = GST_PAD_PROBE_INFO_BUFFER(info);
+    bool changed = !GST_BUFFER_FLAG_IS_SET(buffer, MIRAC_BUFFER_FLAG_STATIC);
+    gint64 time = GST_BUFFER_PTS_IS_VALID(buffer) ? GST_BUFFER_PTS(buffer) / GST_USECOND
+                                                  : g_get_monotonic_time();
+    // An IDR picture the sink asked for (e.g. M13 after packet loss) must
+    // not wait for the next refresh of a static screen
+    bool key_frame_pending;
+    {
+        std::lock_guard<std::mutex> lock(self->key_frame_mutex);
+        key_frame_pending = self->key_frame_requested_at && !self->key_frame_encoded;
+    }
+
+    std::lock_guard<std::mutex> lock(self->idle_mutex);
+    bool was_idle = self->idle_filter->idle();
+    bool send = self->idle_filter->OnFrame(changed, time, key_frame_pending);
+    if (was_idle != self->idle_filter->idle())
+        WDS_LOG("Screen %s", was_idle ? "changed, back to the full frame rate" : "is static, skipping frames");
+
+    IdleStats& stats = self->idle_stats;
+    stats.frames++;
+    if (!changed) {
+        stats.static_frames++;
+        if (!send) {
+            stats.skipped++;
+            return GST_PAD_PROBE_DROP;
+        }
+        if (self->static_pts.size() < max_static_pts)
+            self->static_pts.push_back(GST_BUFFER_PTS(buffer));
+    }
+    return GST_PAD_PROBE_OK;
+}
+
+MiracGstTestSource::IdleStats MiracGstTestSource::GetIdleStats() const
+{
+    std::lock_guard<std::mutex> lock(idle_mutex);
+    return idle_stats;
+}
+
+GstPadProbeReturn MiracGstTestSource::sink_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    std::lock_guard<std::mutex> lock(self->key_frame_mutex);
+    if (self->play_requested_at) {
+        self->first_packet_latency = g_get_monotonic_time() - self->play_requested_at;
+        self->play_requested_at = 0;
+        WDS_LOG("First RTP packet sent %" G_GINT64_FORMAT " us after PLAY", self->first_packet_latency);
+    }
+
+    // The pipeline has no queues, so the first packet reaching udpsink
+    // after the key frame left the encoder is the start of that frame
+    if (!self->key_frame_encoded)
+        return GST_PAD_PROBE_OK;
+
+    KeyFrameStats& stats = self->key_frame_stats;
+    stats.delivered++;
+    stats.last_latency = g_get_monotonic_time() - self->key_frame_requested_at;
+    stats.max_latency = std::max(stats.max_latency, stats.last_latency);
+    self->key_frame_requested_at = 0;
+    self->key_frame_encoded = false;
+    WDS_LOG("IDR picture sent %" G_GINT64_FORMAT " us after request", stats.last_latency);
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracGstTestSource::EnableFrameStamps()
+{
+    if (!encoder)
+        return;
+    GstPad* pad = gst_element_get_static_pad(encoder, "sink");
+    MiracAddFrameStamper(pad);
+    gst_object_unref(pad);
+}
+
+void MiracGstTestSource::EnableLipSyncMarkers()
+{
+    GstElement* video = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "rawcaps") : NULL;
+    GstElement* audio = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "audiocaps") : NULL;
+    if (video && audio) {
+        GstPad* video_pad = gst_element_get_static_pad(video, "src");
+        GstPad* audio_pad = gst_element_get_static_pad(audio, "src");
+        MiracAddLipSyncMarkers(video_pad, audio_pad);
+        gst_object_unref(video_pad);
+        gst_object_unref(audio_pad);
+    } else {
+        WDS_WARNING("Lip-sync markers need a pipeline with audio and video");
+    }
+    if (video)
+        gst_object_unref(video);
+    if (audio)
+        gst_object_unref(audio);
+}
+
+MiracGstTestSource::KeyFrameStats MiracGstTestSource::GetKeyFrameStats() const
+{
+    std::lock_guard<std::mutex> lock(key_frame_mutex);
+    return key_frame_stats;
+}
+
+void MiracGstTestSource::BindSockets(const std::string& hostname, const std::string& interface)
+{
+    // Bound right away so that UdpSourcePort() has a port to report, with
+    // the next one reserved for RTCP
+    GSocket* rtp_socket = NULL;
+    if (!MiracBindRtpSockets(MiracSocketFamilyOf(hostname), interface, &rtp_socket, &rtcp_socket))
+        return;
+
+    GstElement* sink = gst_bin_get_by_name(GST_BIN(gst_elem), "sink");
+    g_object_set(sink, "socket", rtp_socket, NULL);
+    gst_object_unref(sink);
+    g_object_unref(rtp_socket);
+}
+
+bool MiracGstTestSource::EnableRtcp(const std::string& hostname, int port)
+{
+    GstElement* rtpbin = gst_elem ? gst_bin_get_by_name(GST_BIN(gst_elem), "rtpbin") : NULL;
+    if (!rtpbin || !rtcp_socket || !rate_controller) {
+        if (rtpbin)
+            gst_object_unref(rtpbin);
+        return false;
+    }
+
+    // Sender reports leave from, and receiver reports arrive on, the
+    // same socket
+    GstElement* rtcp_sink = add_element(gst_elem, "udpsink");
+    GstElement* rtcp_source = add_element(gst_elem, "udpsrc");
+    bool ok = rtcp_sink && rtcp_source;
+    if (ok) {
+        g_object_set(rtcp_sink,
+                     "socket", rtcp_socket, "close-socket", FALSE,
+                     "host", hostname.c_str(), "port", port,
+                     "sync", FALSE, "async", FALSE,
+                     NULL);
+        GstCaps* caps = gst_caps_new_empty_simple("application/x-rtcp");
+        g_object_set(rtcp_source, "socket", rtcp_socket, "close-socket", FALSE, "caps", caps, NULL);
+        gst_caps_unref(caps);
+
+        ok = gst_element_link_pads(rtpbin, "send_rtcp_src_0", rtcp_sink, "sink") &&
+             gst_element_link_pads(rtcp_source, "src", rtpbin, "recv_rtcp_sink_0");
     }
+    gst_object_unref(rtpbin);
+    if (!ok) {
+        WDS_ERROR("Cannot set up RTCP");
+        return false;
+    }
+
+    GstPad* pad = gst_element_get_static_pad(rtcp_source, "src");
+    gst_pad_add_probe(pad, GST_PAD_PROBE_TYPE_BUFFER, rtcp_probe_cb, this, NULL);
+    gst_object_unref(pad);
+
+    gst_element_sync_state_with_parent(rtcp_sink);
+    gst_element_sync_state_with_parent(rtcp_source);
+    WDS_LOG("Sending RTCP to %s:%d", hostname.c_str(), port);
+    return true;
 }
 
-void MiracGstTestSource::SetState(GstState state)
+GstPadProbeReturn MiracGstTestSource::rtcp_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr)
+{
+    MiracGstTestSource* self = static_cast<MiracGstTestSource*>(data_ptr);
+    GstMapInfo map;
+    if (!gst_buffer_map(GST_PAD_PROBE_INFO_BUFFER(info), &map, GST_MAP_READ))
+        return GST_PAD_PROBE_OK;
+
+    // Parsed here rather than with GstRTCPBuffer to keep libgstrtp out;
+    // the only reports coming in are the sink's about this stream
+    std::vector<MiracRtcpReportBlock> reports;
+    bool parsed = MiracParseRtcpReports(map.data, map.size, reports);
+    gst_buffer_unmap(GST_PAD_PROBE_INFO_BUFFER(info), &map);
+    if (!parsed)
+        WDS_WARNING("Malformed RTCP packet");
+    for (const MiracRtcpReportBlock& report : reports)
+        self->OnReceiverReport(report);
+    return GST_PAD_PROBE_OK;
+}
+
+void MiracGstTestSource::OnReceiverReport(const MiracRtcpReportBlock& report)
+{
+    std::lock_guard<std::mutex> lock(encoding_mutex);
+    unsigned old_scale = rate_controller->scale();
+    if (!rate_controller->OnReport(report.fraction_lost, report.jitter * 1000 / rtp_clock_rate))
+        return;
+
+    unsigned scale = rate_controller->scale();
+    WDS_LOG("Receiver reports %.1f%% loss, %u jitter: %u kbit/s at %u%% resolution",
+            report.fraction_lost * 100, report.jitter, rate_controller->bitrate(), scale);
+    g_object_set(encoder, "bitrate", rate_controller->bitrate(), NULL);
+    if (scale == old_scale)
+        return;
+
+    // Even dimensions, as I420 needs
+    MiracVideoEncoding scaled = encoding;
+    scaled.width = encoding.width * scale / 100 & ~1u;
+    scaled.height = encoding.height * scale / 100 & ~1u;
+    GstCaps* caps = MiracRawVideoCaps(scaled);
+    GstElement* filter = gst_bin_get_by_name(GST_BIN(gst_elem), "rawcaps");
+    g_object_set(filter, "caps", caps, NULL);
+    gst_object_unref(filter);
+    gst_caps_unref(caps);
+}
+
+void MiracGstTestSource::SetState(GstState state, const MiracGstStateWaiter::Callback& done)
 {
     if (gst_elem) {
-        gst_element_set_state (gst_elem, state);
+        if (state == GST_STATE_PLAYING && GST_STATE(gst_elem) != GST_STATE_PLAYING) {
+            std::lock_guard<std::mutex> lock(key_frame_mutex);
+            play_requested_at = g_get_monotonic_time();
+        }
+        state_waiter.SetState(gst_elem, state, done);
+    } else if (done) {
+        done(false);
     }
 }
 
+gint64 MiracGstTestSource::FirstPacketLatency() const
+{
+    std::lock_guard<std::mutex> lock(key_frame_mutex);
+    return first_packet_latency;
+}
+
 GstState MiracGstTestSource::GetState() const
 {
     if (!gst_elem)
         return GST_STATE_NULL;
-    GstState result;
-    gst_element_get_state (gst_elem, &result, NULL, GST_CLOCK_TIME_NONE);
-    return result;
+    return MiracGstTargetState(gst_elem);
 }
 
 int MiracGstTestSource::UdpSourcePort()
@@ -97,9 +917,25 @@ int MiracGstTestSource::UdpSourcePort()
 
 MiracGstTestSource::~MiracGstTestSource ()
 {
+    if (key_frame_timeout) {
+        g_source_destroy(key_frame_timeout);
+        g_source_unref(key_frame_timeout);
+    }
+    if (encoder)
+        gst_object_unref(encoder);
     if (gst_elem) {
+        // Before going to NULL, the state waiter must not see its messages
+        if (bus_watch) {
+            g_source_destroy(bus_watch);
+            g_source_unref(bus_watch);
+        }
         gst_element_set_state (gst_elem, GST_STATE_NULL);
-        g_source_remove (bus_watch_id);
         gst_object_unref (GST_OBJECT (gst_elem));
     }
+    if (rtcp_socket)
+        g_object_unref(rtcp_socket);
+    if (pending_switch.raw_caps) {
+        gst_caps_unref(pending_switch.raw_caps);
+        gst_caps_unref(pending_switch.h264_caps);
+    }
 }
@@ -24,7 +24,19 @@
 #ifndef MIRAC_GST_TEST_SOURCE_HPP
 #define MIRAC_GST_TEST_SOURCE_HPP
 
+#include <gio/gio.h>
 #include <gst/gst.h>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+#include "libwds/public/audio_codec.h"
+#include "libwds/public/video_format.h"
+#include "mirac-gst-bus-handler.hpp"
+#include "mirac-gst-frame-timing.hpp"
+#include "mirac-idle-frames.hpp"
+#include "mirac-rate-controller.hpp"
+#include "mirac-video-caps.hpp"
 
 enum wfd_test_stream_t {WFD_TEST_AUDIO, WFD_TEST_VIDEO, WFD_TEST_BOTH, WFD_DESKTOP, WFD_UNKNOWN_STREAM};
 
@@ -32,17 +44,174 @@ enum wfd_test_stream_t {WFD_TEST_AUDIO, WFD_TEST_VIDEO, WFD_TEST_BOTH, WFD_DESKT
 class MiracGstTestSource
 {
 public:
-    MiracGstTestSource(wfd_test_stream_t wfd_stream, std::string hostname, int port);
+    // A non-empty interface binds the RTP and RTCP sockets to it, so that
+    // the stream leaves through the same P2P group as the RTSP session.
+    MiracGstTestSource(wfd_test_stream_t wfd_stream, std::string hostname, int port,
+                       const std::string& interface = std::string());
+    // Builds the pipeline for the negotiated video format and audio codec:
+    // the capture is scaled and rate converted to its resolution and
+    // x264enc is set up for its profile and level; audio (pulsesrc
+    // monitoring the default output for WFD_DESKTOP) is encoded with the
+    // codec's encoder, with no audio_codec the stream is video only. A
+    // WFD_DESKTOP pipeline whose audio can not be captured streams the
+    // video only as well, see HasAudio(). The stream is sent through
+    // rtpbin, so that RTCP can be enabled for it.
+    MiracGstTestSource(wfd_test_stream_t wfd_stream, const wds::H264VideoFormat& format,
+                       const wds::AudioCodec* audio_codec, std::string hostname, int port,
+                       const std::string& interface = std::string());
     ~MiracGstTestSource ();
 
-    void SetState(GstState state);
+    // Neither waits for the pipeline: done (if any) is called once it is
+    // in the state, GetState() is the state it is in or changing to
+    void SetState(GstState state, const MiracGstStateWaiter::Callback& done = nullptr);
     GstState GetState() const;
 
+    // Microseconds from the last SetState(GST_STATE_PLAYING) to the first
+    // RTP packet reaching udpsink, 0 until there is one
+    gint64 FirstPacketLatency() const;
+
     int UdpSourcePort();
 
+    // Whether the pipeline was built with an audio stream
+    bool HasAudio() const { return has_audio; }
+
+    // A pipeline can be built ahead of the negotiation and fixed up when
+    // the format and the sink's port are known. The video format can
+    // only be changed in the READY state or below, false otherwise.
+    bool SetVideoFormat(const wds::H264VideoFormat& format);
+    // False if the pipeline streams and the format is interlaced
+    // differently from the negotiated one, see SwitchVideoFormat()
+    bool CanSwitchVideoFormat(const wds::H264VideoFormat& format);
+    // Changes the video format of a playing or paused pipeline in place:
+    // from the first captured frame at or after the running time at (the
+    // next one if GST_CLOCK_TIME_NONE) the capture is scaled and rate
+    // converted to the new resolution, and that frame is encoded as an
+    // IDR picture. The interlacing, slices and VBV buffer of the
+    // negotiated format are kept. A switch still pending is replaced.
+    bool SwitchVideoFormat(const wds::H264VideoFormat& format,
+                           GstClockTime at = GST_CLOCK_TIME_NONE);
+    // Of the playing pipeline, GST_CLOCK_TIME_NONE otherwise
+    GstClockTime RunningTime() const;
+    void SetDestination(const std::string& hostname, int port);
+
+    // Sends RTCP to the sink at hostname:port and receives its reports on
+    // UdpSourcePort() + 1. The receiver reports drive the encoder bitrate
+    // and resolution, see MiracRateController; the frame rate is kept.
+    // Returns false if the pipeline was not built for a video format.
+    bool EnableRtcp(const std::string& hostname, int port);
+
+    struct KeyFrameStats {
+        unsigned requests;      // RequestKeyFrame() calls
+        unsigned coalesced;     // requests folded into one already pending
+        unsigned sent;          // force key unit events sent to the encoder
+        unsigned delivered;     // requested IDR frames seen leaving udpsink
+        gint64 last_latency;    // request to first IDR packet at udpsink, us
+        gint64 max_latency;
+    };
+
+    // Asks the encoder for an IDR frame. At most one request is sent per
+    // min_key_frame_interval, repeated requests in between (e.g. a sink
+    // sending M13 for every lost packet) are coalesced into a single one.
+    void RequestKeyFrame();
+    KeyFrameStats GetKeyFrameStats() const;
+
+    // Paints the capture time into every frame for the glass-to-glass
+    // mode of MiracGstSink, see mirac-gst-frame-stamp.hpp
+    void EnableFrameStamps();
+
+    // Flashes and beeps once per second for the lip-sync mode of
+    // MiracGstSink, see mirac-gst-lip-sync.hpp
+    void EnableLipSyncMarkers();
+
+    struct IdleStats {
+        guint64 frames;             // reaching the encoder
+        guint64 static_frames;      // identical to the previous one
+        guint64 skipped;            // static frames not encoded
+        guint64 encoded_bytes;      // of all encoded frames
+        guint64 static_encoded;     // static frames encoded anyway
+        guint64 static_bytes;       // their encoded size
+    };
+
+    // Keeps the frame rate of a static WFD_DESKTOP screen low: only one
+    // refresh frame per refresh_interval is encoded and sent, and any
+    // change brings back the full rate, see MiracIdleFrameFilter.
+    // Returns false if the pipeline has no miracscreenconvert.
+    bool EnableIdleFrameSkipping(gint64 refresh_interval = idle_refresh_interval);
+    IdleStats GetIdleStats() const;
+
+    // Encode and mux/payload latency of video frames
+    MiracFrameTiming& FrameTiming() { return frame_timing; }
+
+    static const gint64 min_key_frame_interval = 250 * G_TIME_SPAN_MILLISECOND;
+    static const gint64 idle_settle_time = 500 * G_TIME_SPAN_MILLISECOND;
+    static const gint64 idle_refresh_interval = G_TIME_SPAN_SECOND;
+
 private:
+    bool AddVideoBranch(wfd_test_stream_t wfd_stream, const wds::H264VideoFormat& format, GstElement* muxer);
+    bool AddAudioBranch(wfd_test_stream_t wfd_stream, const wds::AudioCodec& codec, GstElement* muxer);
+    void ConfigureVideo(const wds::H264VideoFormat& format, GstElement* raw_filter,
+                        GstElement* video_encoder, GstElement* h264_filter);
+    void Init(const std::string& hostname, const std::string& interface);
+    void InstallKeyFrameProbes();
+    void InstallFrameTiming();
+    void SendKeyFrameRequest();
+    struct PendingSwitch;
+    void ApplyVideoSwitch(const PendingSwitch& pending, GstPad* pad, GstClockTime running_time);
+    void OnReceiverReport(const MiracRtcpReportBlock& report);
+
+    static gboolean key_frame_timeout_cb(gpointer data_ptr);
+    static GstPadProbeReturn encoder_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr);
+    static GstPadProbeReturn sink_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr);
+    static GstPadProbeReturn rtcp_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr);
+    static GstPadProbeReturn idle_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr);
+    static GstPadProbeReturn switch_probe_cb(GstPad* pad, GstPadProbeInfo* info, gpointer data_ptr);
+    void BindSockets(const std::string& hostname, const std::string& interface);
+
     GstElement* gst_elem;
-    guint bus_watch_id;
+    GSource* bus_watch;
+    MiracGstStateWaiter state_waiter;
+    bool has_audio;
+
+    GstElement* encoder;
+    GSource* key_frame_timeout;      // on the thread default context
+    gint64 last_key_frame_request;   // when the last event was sent
+
+    // Shared with the streaming thread pad probes
+    mutable std::mutex key_frame_mutex;
+    KeyFrameStats key_frame_stats;
+    gint64 key_frame_requested_at;   // 0 when no request is in flight
+    bool key_frame_encoded;
+    gint64 play_requested_at;        // 0 once the first packet was sent
+    gint64 first_packet_latency;
+
+    MiracFrameTiming frame_timing;
+
+    GSocket* rtcp_socket;
+    // Negotiated encoding, the upper limit of the rate controller. Both
+    // are used from the RTCP streaming thread and replaced on the video
+    // streaming thread by a switch while playing, under encoding_mutex.
+    std::mutex encoding_mutex;
+    MiracVideoEncoding encoding;
+    std::unique_ptr<MiracRateController> rate_controller;
+
+    // Set by SwitchVideoFormat(), taken by switch_probe_cb() on the
+    // videoscale sink pad once a frame reaches the running time
+    struct PendingSwitch {
+        MiracVideoEncoding encoding;
+        GstCaps* raw_caps;          // NULL if none is pending
+        GstCaps* h264_caps;
+        GstClockTime at;
+    };
+    std::mutex switch_mutex;
+    PendingSwitch pending_switch;
+    bool switch_probe_installed;
+
+    // Shared with the encoder streaming thread
+    mutable std::mutex idle_mutex;
+    std::unique_ptr<MiracIdleFrameFilter> idle_filter;
+    IdleStats idle_stats;
+    // Timestamps of the static frames inside the encoder
+    std::deque<GstClockTime> static_pts;
 };
 
 #endif
@@ -0,0 +1,49 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "mirac-idle-frames.hpp"
+
+MiracIdleFrameFilter::MiracIdleFrameFilter (int64_t settle_time, int64_t refresh_interval)
+  : settle_time_(settle_time), refresh_interval_(refresh_interval),
+    last_change_(0), last_sent_(0), started_(false), idle_(false)
+{
+}
+
+bool MiracIdleFrameFilter::OnFrame (bool changed, int64_t time, bool forced)
+{
+    if (changed || !started_) {
+        started_ = true;
+        idle_ = false;
+        last_change_ = last_sent_ = time;
+        return true;
+    }
+
+    if (time - last_change_ < settle_time_) {
+        last_sent_ = time;
+        return true;
+    }
+
+    idle_ = true;
+    if (!forced && time - last_sent_ < refresh_interval_)
+        return false;
+    last_sent_ = time;
+    return true;
+}
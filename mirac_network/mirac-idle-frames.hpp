@@ -0,0 +1,57 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_IDLE_FRAMES_HPP
+#define MIRAC_IDLE_FRAMES_HPP
+
+#include <cstdint>
+
+/*
+ * Decides which frames of a mostly static screen are encoded. Frames are
+ * sent at the full rate while the screen changes and for settle_time
+ * after the last change, so that the encoder can refine the picture;
+ * after that only one static frame per refresh_interval is sent, to keep
+ * the sink's decoder and jitter buffer alive. The first changed frame
+ * goes out right away and brings back the full rate. Times are in
+ * microseconds.
+ */
+class MiracIdleFrameFilter
+{
+public:
+    MiracIdleFrameFilter (int64_t settle_time, int64_t refresh_interval);
+
+    // Whether the frame captured at time is to be encoded. A forced
+    // frame (e.g. the IDR picture a sink asked for) is sent even while
+    // idle, without bringing back the full rate.
+    bool OnFrame (bool changed, int64_t time, bool forced = false);
+    // Whether static frames are being skipped
+    bool idle () const { return idle_; }
+
+private:
+    int64_t settle_time_;
+    int64_t refresh_interval_;
+    int64_t last_change_;
+    int64_t last_sent_;
+    bool started_;
+    bool idle_;
+};
+
+#endif
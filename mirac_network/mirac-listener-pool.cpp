@@ -0,0 +1,193 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2014 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+#include <glib-unix.h>
+#include <algorithm>
+
+#include "mirac-listener-pool.hpp"
+#include "mirac-glib-logging.hpp"
+
+MiracListenerPool::Worker::Worker (MiracNetwork* listener, SessionFactory factory):
+    listener_(listener),
+    factory_(factory),
+    reap_scheduled_(false),
+    context_(g_main_context_new()),
+    accepted_(0),
+    sessions_count_(0)
+{
+    loop_ = g_main_loop_new(context_, FALSE);
+
+    GUnixFDSourceFunc func = listen_cb;
+    GSource *source = g_unix_fd_source_new(listener_->GetHandle(), G_IO_IN);
+    g_source_set_callback(source, reinterpret_cast<GSourceFunc>(func),
+                          this, NULL);
+    g_source_attach(source, context_);
+    g_source_unref(source);
+}
+
+MiracListenerPool::Worker::~Worker ()
+{
+    Stop();
+    g_main_loop_unref(loop_);
+    g_main_context_unref(context_);
+}
+
+/* static C callback wrapper */
+gboolean MiracListenerPool::Worker::listen_cb (gint fd, GIOCondition condition, gpointer data_ptr)
+{
+    auto worker = static_cast<Worker*> (data_ptr);
+    return worker->listen_cb();
+}
+
+static gboolean quit_cb (gpointer data_ptr)
+{
+    g_main_loop_quit(static_cast<GMainLoop*> (data_ptr));
+    return G_SOURCE_REMOVE;
+}
+
+void MiracListenerPool::Worker::Start()
+{
+    thread_ = std::thread(&Worker::run, this);
+}
+
+void MiracListenerPool::Worker::Stop()
+{
+    if (!thread_.joinable())
+        return;
+
+    /* an idle source rather than g_main_loop_quit() so that a worker
+     * which did not enter its loop yet still sees the request */
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, quit_cb, loop_, NULL);
+    g_source_attach(source, context_);
+    g_source_unref(source);
+
+    thread_.join();
+}
+
+void MiracListenerPool::Worker::run()
+{
+    g_main_context_push_thread_default(context_);
+    g_main_loop_run(loop_);
+
+    /* sessions hold sources on our context, release them here */
+    sessions_.clear();
+    sessions_count_.store(0, std::memory_order_relaxed);
+    g_main_context_pop_thread_default(context_);
+}
+
+gboolean MiracListenerPool::Worker::reap_cb (gpointer data_ptr)
+{
+    auto worker = static_cast<Worker*> (data_ptr);
+    worker->reap_scheduled_ = false;
+    worker->reap_sessions();
+    return G_SOURCE_REMOVE;
+}
+
+/* a failing session is still inside one of its own callbacks, so it is
+ * destroyed from an idle source along with its pipeline and sockets */
+void MiracListenerPool::Worker::schedule_reap()
+{
+    if (reap_scheduled_)
+        return;
+    reap_scheduled_ = true;
+
+    GSource *source = g_idle_source_new();
+    g_source_set_callback(source, reap_cb, this, NULL);
+    g_source_attach(source, context_);
+    g_source_unref(source);
+}
+
+void MiracListenerPool::Worker::reap_sessions()
+{
+    sessions_.remove_if([] (const std::unique_ptr<MiracBroker>& session) {
+        return !session->is_connected();
+    });
+    sessions_count_.store(sessions_.size(), std::memory_order_relaxed);
+}
+
+gboolean MiracListenerPool::Worker::listen_cb ()
+{
+    try {
+        std::unique_ptr<MiracNetwork> connection(listener_->Accept());
+        accepted_.fetch_add(1, std::memory_order_relaxed);
+        MiracBroker* session = factory_(connection.release());
+        if (session) {
+            session->set_failure_callback([this] () { schedule_reap(); });
+            sessions_.push_back(std::unique_ptr<MiracBroker>(session));
+        }
+    } catch (const std::exception &x) {
+        WDS_WARNING("exception: %s", x.what());
+    }
+
+    sessions_count_.store(sessions_.size(), std::memory_order_relaxed);
+    return G_SOURCE_CONTINUE;
+}
+
+MiracListenerPool::MiracListenerPool (const std::string& listen_port,
+                                      uint workers, SessionFactory factory,
+                                      const std::string& interface)
+{
+    std::string port = listen_port;
+
+    for (uint i = 0; i < std::max(workers, 1u); i++) {
+        std::unique_ptr<MiracNetwork> listener(new MiracNetwork());
+        listener->SetTcpProfile(MiracTcpProfile::RtspControl());
+        listener->SetInterface(interface);
+        listener->Bind(NULL, port.c_str(), true);
+        /* with an ephemeral port all listeners must share the first one */
+        if (i == 0)
+            port = std::to_string(listener->GetHostPort());
+        workers_.push_back(std::unique_ptr<Worker>(
+            new Worker(listener.release(), factory)));
+    }
+
+    for (auto& worker : workers_)
+        worker->Start();
+}
+
+MiracListenerPool::~MiracListenerPool ()
+{
+    for (auto& worker : workers_)
+        worker->Stop();
+}
+
+unsigned short MiracListenerPool::get_host_port() const
+{
+    return workers_.front()->get_host_port();
+}
+
+guint64 MiracListenerPool::accepted_count() const
+{
+    guint64 count = 0;
+    for (const auto& worker : workers_)
+        count += worker->accepted();
+    return count;
+}
+
+guint64 MiracListenerPool::session_count() const
+{
+    guint64 count = 0;
+    for (const auto& worker : workers_)
+        count += worker->sessions();
+    return count;
+}
@@ -0,0 +1,108 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2014 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+
+#ifndef MIRAC_LISTENER_POOL_HPP
+#define MIRAC_LISTENER_POOL_HPP
+
+#include <glib.h>
+#include <atomic>
+#include <functional>
+#include <list>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mirac-broker.hpp"
+#include "mirac-network.hpp"
+
+/*
+ * Accepts RTSP connections on several SO_REUSEPORT listeners bound to
+ * the same port. Every listener is owned by a worker thread running its
+ * own GMainContext, and the sessions created for the connections it
+ * accepts live and die on that thread only.
+ */
+class MiracListenerPool
+{
+    public:
+        /* called on the worker thread with the accepted connection,
+         * the returned broker is owned by the worker */
+        typedef std::function<MiracBroker* (MiracNetwork* connection)> SessionFactory;
+
+        /* a non-empty interface binds the listeners to it, see
+         * MiracBroker::set_interface() */
+        MiracListenerPool (const std::string& listen_port, uint workers,
+                           SessionFactory factory,
+                           const std::string& interface = std::string());
+        ~MiracListenerPool ();
+
+        unsigned short get_host_port() const;
+        uint worker_count() const { return workers_.size(); }
+
+        /* totals over all workers, for statistics only */
+        guint64 accepted_count() const;
+        guint64 session_count() const;
+
+    private:
+        class Worker
+        {
+            public:
+                Worker (MiracNetwork* listener, SessionFactory factory);
+                ~Worker ();
+
+                void Start();
+                void Stop();
+
+                unsigned short get_host_port() const
+                    { return listener_->GetHostPort(); }
+                guint64 accepted() const
+                    { return accepted_.load(std::memory_order_relaxed); }
+                guint64 sessions() const
+                    { return sessions_count_.load(std::memory_order_relaxed); }
+
+            private:
+                static gboolean listen_cb (gint fd, GIOCondition condition, gpointer data_ptr);
+                static gboolean reap_cb (gpointer data_ptr);
+                gboolean listen_cb ();
+                void run();
+                void schedule_reap();
+                void reap_sessions();
+
+                std::unique_ptr<MiracNetwork> listener_;
+                SessionFactory factory_;
+                std::list<std::unique_ptr<MiracBroker>> sessions_;
+                bool reap_scheduled_;
+
+                GMainContext *context_;
+                GMainLoop *loop_;
+                std::thread thread_;
+
+                std::atomic<guint64> accepted_;
+                std::atomic<guint64> sessions_count_;
+        };
+
+        std::vector<std::unique_ptr<Worker>> workers_;
+};
+
+
+#endif  /* MIRAC_LISTENER_POOL_HPP */
@@ -0,0 +1,259 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+
+#include <cerrno>
+#include <cstring>
+#include <algorithm>
+
+#include <unistd.h>
+#include <net/if.h>
+#include <arpa/inet.h>
+#include <linux/netlink.h>
+#include <linux/rtnetlink.h>
+
+#include "mirac-netlink.hpp"
+
+
+MiracNetlink::MiracNetlink ()
+{
+    struct sockaddr_nl local;
+
+    sequence = 0;
+    handle = socket(AF_NETLINK, SOCK_RAW | SOCK_CLOEXEC, NETLINK_ROUTE);
+    if (handle < 0)
+        throw MiracException(errno, "socket()", __FUNCTION__);
+
+    /* subscribe before the dump so that no change is missed in between */
+    memset(&local, 0x00, sizeof(local));
+    local.nl_family = AF_NETLINK;
+    local.nl_groups = RTMGRP_IPV4_IFADDR | RTMGRP_IPV6_IFADDR;
+    if (bind(handle, reinterpret_cast<struct sockaddr *> (&local),
+        sizeof(local)))
+    {
+        close(handle);
+        throw MiracException(errno, "bind()", __FUNCTION__);
+    }
+
+    try {
+        Dump();
+    } catch (...) {
+        close(handle);
+        throw;
+    }
+}
+
+
+MiracNetlink::~MiracNetlink ()
+{
+    close(handle);
+}
+
+
+void MiracNetlink::Dump ()
+{
+    struct {
+        struct nlmsghdr header;
+        struct ifaddrmsg message;
+    } request;
+    struct sockaddr_nl kernel;
+    char buffer[16384];
+    bool done = false;
+
+    memset(&request, 0x00, sizeof(request));
+    request.header.nlmsg_len = NLMSG_LENGTH(sizeof(struct ifaddrmsg));
+    request.header.nlmsg_type = RTM_GETADDR;
+    request.header.nlmsg_flags = NLM_F_REQUEST | NLM_F_DUMP;
+    request.header.nlmsg_seq = ++sequence;
+    request.message.ifa_family = AF_UNSPEC;
+
+    memset(&kernel, 0x00, sizeof(kernel));
+    kernel.nl_family = AF_NETLINK;
+    if (sendto(handle, &request, request.header.nlmsg_len, 0,
+        reinterpret_cast<struct sockaddr *> (&kernel), sizeof(kernel)) < 0)
+        throw MiracException(errno, "sendto()", __FUNCTION__);
+
+    /* the dump is read blocking, notifications arriving meanwhile are
+     * applied in order with the dumped addresses */
+    while (!done)
+    {
+        ssize_t length = recv(handle, buffer, sizeof(buffer), 0);
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            throw MiracException(errno, "recv()", __FUNCTION__);
+        }
+        Parse(buffer, length, &done);
+    }
+}
+
+
+bool MiracNetlink::ProcessEvents ()
+{
+    char buffer[16384];
+    bool changed = false;
+    bool done;
+
+    for (;;)
+    {
+        ssize_t length = recv(handle, buffer, sizeof(buffer), MSG_DONTWAIT);
+        if (length < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            if (errno == EAGAIN || errno == EWOULDBLOCK)
+                break;
+            /* notifications were dropped, start over from a fresh dump */
+            if (errno == ENOBUFS)
+            {
+                addresses.clear();
+                Dump();
+                changed = true;
+                continue;
+            }
+            throw MiracException(errno, "recv()", __FUNCTION__);
+        }
+        if (Parse(buffer, length, &done))
+            changed = true;
+    }
+
+    return changed;
+}
+
+
+bool MiracNetlink::Parse (const void *buffer, size_t length, bool *done)
+{
+    bool changed = false;
+    int remaining = static_cast<int> (length);
+
+    for (const struct nlmsghdr *header =
+            static_cast<const struct nlmsghdr *> (buffer);
+         NLMSG_OK(header, remaining);
+         header = NLMSG_NEXT(header, remaining))
+    {
+        if (header->nlmsg_type == NLMSG_DONE)
+        {
+            *done = true;
+            continue;
+        }
+        if (header->nlmsg_type == NLMSG_ERROR)
+        {
+            const struct nlmsgerr *error =
+                static_cast<const struct nlmsgerr *> (NLMSG_DATA(header));
+            if (header->nlmsg_seq == sequence && error->error)
+                throw MiracException(-error->error, "RTM_GETADDR",
+                    __FUNCTION__);
+            continue;
+        }
+        if (header->nlmsg_type != RTM_NEWADDR &&
+            header->nlmsg_type != RTM_DELADDR)
+            continue;
+
+        const struct ifaddrmsg *message =
+            static_cast<const struct ifaddrmsg *> (NLMSG_DATA(header));
+        if (message->ifa_family != AF_INET && message->ifa_family != AF_INET6)
+            continue;
+
+        /* for point-to-point links IFA_ADDRESS is the peer, the local
+         * address is in IFA_LOCAL */
+        const void *data = NULL;
+        const void *local = NULL;
+        int attributes_length = IFA_PAYLOAD(header);
+        for (const struct rtattr *attribute = IFA_RTA(message);
+             RTA_OK(attribute, attributes_length);
+             attribute = RTA_NEXT(attribute, attributes_length))
+        {
+            if (attribute->rta_type == IFA_ADDRESS)
+                data = RTA_DATA(attribute);
+            else if (attribute->rta_type == IFA_LOCAL)
+                local = RTA_DATA(attribute);
+        }
+        if (local)
+            data = local;
+        if (!data)
+            continue;
+
+        char address[INET6_ADDRSTRLEN];
+        char name[IF_NAMESIZE];
+        if (!inet_ntop(message->ifa_family, data, address, sizeof(address)))
+            continue;
+
+        MiracInterfaceAddress entry;
+        entry.index = message->ifa_index;
+        entry.name = if_indextoname(message->ifa_index, name) ? name : "";
+        entry.family = message->ifa_family;
+        entry.address = address;
+        entry.prefix_length = message->ifa_prefixlen;
+
+        auto it = std::find_if(addresses.begin(), addresses.end(),
+            [&entry] (const MiracInterfaceAddress &cached) {
+                return cached.index == entry.index &&
+                    cached.address == entry.address;
+            });
+        /* IPv6 addresses are unusable until duplicate address detection
+         * has finished, a later RTM_NEWADDR clears the flag */
+        bool usable = header->nlmsg_type == RTM_NEWADDR &&
+            !(message->ifa_flags & IFA_F_TENTATIVE);
+        if (usable && it == addresses.end())
+        {
+            addresses.push_back(entry);
+            changed = true;
+        }
+        else if (!usable && it != addresses.end())
+        {
+            addresses.erase(it);
+            changed = true;
+        }
+    }
+
+    return changed;
+}
+
+
+std::string MiracNetlink::GetAddress (const std::string &interface,
+    int family) const
+{
+    const MiracInterfaceAddress *found = NULL;
+
+    for (const MiracInterfaceAddress &entry : addresses)
+    {
+        if (entry.name != interface)
+            continue;
+        if (family != AF_UNSPEC && entry.family != family)
+            continue;
+        if (!found || (found->family != AF_INET && entry.family == AF_INET))
+            found = &entry;
+    }
+    return found ? found->address : std::string();
+}
+
+
+std::string MiracNetlink::GetInterface (const std::string &address) const
+{
+    for (const MiracInterfaceAddress &entry : addresses)
+    {
+        if (entry.address == address)
+            return entry.name;
+    }
+    return std::string();
+}
@@ -0,0 +1,80 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+
+#ifndef MIRAC_NETLINK_HPP
+#define MIRAC_NETLINK_HPP
+
+#include <sys/socket.h>
+#include <string>
+#include <vector>
+
+#include "mirac-exception.hpp"
+
+
+struct MiracInterfaceAddress
+{
+    int index;                  /* interface index */
+    std::string name;           /* interface name, e.g. p2p-wlan0-0 */
+    int family;                 /* AF_INET or AF_INET6 */
+    std::string address;        /* numeric address */
+    unsigned char prefix_length;
+};
+
+
+/*
+ * Cache of the local interface addresses, filled with an RTM_GETADDR dump
+ * and kept current by the RTM_NEWADDR / RTM_DELADDR notifications of the
+ * kernel. The notification socket is non-blocking: watch GetHandle() for
+ * input and call ProcessEvents() when it becomes readable.
+ */
+class MiracNetlink
+{
+    public:
+        MiracNetlink ();
+        virtual ~MiracNetlink ();
+
+        int GetHandle () const
+            { return handle; }
+        /* returns true when the cached addresses changed */
+        bool ProcessEvents ();
+
+        const std::vector<MiracInterfaceAddress> & GetAddresses () const
+            { return addresses; }
+        /* first address of the interface, IPv4 preferred for AF_UNSPEC;
+         * empty if the interface has none (yet) */
+        std::string GetAddress (const std::string &interface,
+                                int family = AF_UNSPEC) const;
+        /* name of the interface owning a local address, empty if none */
+        std::string GetInterface (const std::string &address) const;
+
+    private:
+        int handle;
+        unsigned sequence;
+        std::vector<MiracInterfaceAddress> addresses;
+
+        void Dump ();
+        bool Parse (const void *buffer, size_t length, bool *done);
+};
+
+
+#endif  /* MIRAC_NETLINK_HPP */
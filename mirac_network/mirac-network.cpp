@@ -92,7 +92,103 @@ void MiracNetwork::Close ()
 }
 
 
-void MiracNetwork::Bind (const char *address, const char *service)
+void MiracNetwork::SetTcpProfile (const MiracTcpProfile &profile)
+{
+    tcp_profile = profile;
+    if (handle >= 0)
+        ApplyTcpProfile();
+}
+
+
+void MiracNetwork::ApplyTcpProfile ()
+{
+    int on = 1;
+
+    if (tcp_profile.no_delay && setsockopt(handle, IPPROTO_TCP, TCP_NODELAY,
+        &on, sizeof(on)))
+        throw MiracException(errno, "setsockopt(TCP_NODELAY)", __FUNCTION__);
+    if (tcp_profile.quick_ack)
+        RearmQuickAck();
+    if (tcp_profile.user_timeout > 0 && setsockopt(handle, IPPROTO_TCP,
+        TCP_USER_TIMEOUT, &tcp_profile.user_timeout,
+        sizeof(tcp_profile.user_timeout)))
+        throw MiracException(errno, "setsockopt(TCP_USER_TIMEOUT)",
+            __FUNCTION__);
+
+    if (tcp_profile.keep_alive)
+    {
+        if (setsockopt(handle, SOL_SOCKET, SO_KEEPALIVE, &on, sizeof(on)))
+            throw MiracException(errno, "setsockopt(SO_KEEPALIVE)",
+                __FUNCTION__);
+        if (tcp_profile.keep_idle > 0 && setsockopt(handle, IPPROTO_TCP,
+            TCP_KEEPIDLE, &tcp_profile.keep_idle,
+            sizeof(tcp_profile.keep_idle)))
+            throw MiracException(errno, "setsockopt(TCP_KEEPIDLE)",
+                __FUNCTION__);
+        if (tcp_profile.keep_interval > 0 && setsockopt(handle, IPPROTO_TCP,
+            TCP_KEEPINTVL, &tcp_profile.keep_interval,
+            sizeof(tcp_profile.keep_interval)))
+            throw MiracException(errno, "setsockopt(TCP_KEEPINTVL)",
+                __FUNCTION__);
+        if (tcp_profile.keep_count > 0 && setsockopt(handle, IPPROTO_TCP,
+            TCP_KEEPCNT, &tcp_profile.keep_count,
+            sizeof(tcp_profile.keep_count)))
+            throw MiracException(errno, "setsockopt(TCP_KEEPCNT)",
+                __FUNCTION__);
+    }
+
+    if (tcp_profile.tos >= 0)
+    {
+        int domain = AF_INET;
+        socklen_t optlen = sizeof(domain);
+        if (getsockopt(handle, SOL_SOCKET, SO_DOMAIN, &domain, &optlen))
+            throw MiracException(errno, "getsockopt()", __FUNCTION__);
+        if (domain == AF_INET6)
+        {
+            if (setsockopt(handle, IPPROTO_IPV6, IPV6_TCLASS,
+                &tcp_profile.tos, sizeof(tcp_profile.tos)))
+                throw MiracException(errno, "setsockopt(IPV6_TCLASS)",
+                    __FUNCTION__);
+        }
+        else if (setsockopt(handle, IPPROTO_IP, IP_TOS,
+            &tcp_profile.tos, sizeof(tcp_profile.tos)))
+            throw MiracException(errno, "setsockopt(IP_TOS)", __FUNCTION__);
+    }
+}
+
+
+void MiracNetwork::RearmQuickAck ()
+{
+    int on = 1;
+
+    /* the kernel drops back to delayed ACKs on its own, so this is not
+     * sticky; failures are harmless and ignored */
+    setsockopt(handle, IPPROTO_TCP, TCP_QUICKACK, &on, sizeof(on));
+}
+
+
+void MiracNetwork::SetInterface (const std::string &name)
+{
+    bool unbind = name.empty() && !interface_name.empty();
+
+    interface_name = name;
+    if (handle >= 0 && (unbind || !name.empty()))
+        ApplyInterface();
+}
+
+
+void MiracNetwork::ApplyInterface ()
+{
+    /* an empty name removes a previous binding */
+    if (setsockopt(handle, SOL_SOCKET, SO_BINDTODEVICE,
+        interface_name.c_str(), interface_name.size()))
+        throw MiracException(errno, "setsockopt(SO_BINDTODEVICE)",
+            __FUNCTION__);
+}
+
+
+void MiracNetwork::Bind (const char *address, const char *service,
+    bool reuse_port)
 {
     int ec;
     int reuse = 1;
@@ -119,6 +215,16 @@ void MiracNetwork::Bind (const char *address, const char *service)
         if (setsockopt(handle, SOL_SOCKET, SO_REUSEADDR,
             &reuse, sizeof(reuse)))
             throw MiracException(errno, "setsockopt()", __FUNCTION__);
+        /* several listeners bound to the same port, kernel balances
+         * incoming connections between them */
+        if (reuse_port && setsockopt(handle, SOL_SOCKET, SO_REUSEPORT,
+            &reuse, sizeof(reuse)))
+            throw MiracException(errno, "setsockopt(SO_REUSEPORT)",
+                __FUNCTION__);
+        /* accepted sockets inherit the options from the listener */
+        ApplyTcpProfile();
+        if (!interface_name.empty())
+            ApplyInterface();
 	if (bind(handle, bind_addr->ai_addr, bind_addr->ai_addrlen) == 0)
            break;
         else if (!bind_addr->ai_next)
@@ -128,7 +234,7 @@ void MiracNetwork::Bind (const char *address, const char *service)
     }
     freeaddrinfo(addr_res);
 
-    if (listen(handle, 1))
+    if (listen(handle, reuse_port ? SOMAXCONN : 1))
         throw MiracException(errno, "listen()", __FUNCTION__);
 }
 
@@ -143,7 +249,11 @@ MiracNetwork * MiracNetwork::Accept ()
         throw MiracException(errno, "accept()", __FUNCTION__);
     if (ioctl(ch, FIONBIO, &nonblock))
         throw MiracException(errno, "ioctl(FIONBIO)", __FUNCTION__);
-    return new MiracNetwork(ch);
+    MiracNetwork *connection = new MiracNetwork(ch);
+    connection->interface_name = interface_name;
+    /* re-applied, not everything is inherited (e.g. TCP_QUICKACK) */
+    connection->SetTcpProfile(tcp_profile);
+    return connection;
 }
 
 
@@ -183,6 +293,9 @@ bool MiracNetwork::Connect (const char *address, const char *service)
         addr->ai_socktype | SOCK_NONBLOCK, addr->ai_protocol);
     if (handle < 0)
         throw MiracException(errno, "socket()", __FUNCTION__);
+    ApplyTcpProfile();
+    if (!interface_name.empty())
+        ApplyInterface();
     if (connect(handle, addr->ai_addr, addr->ai_addrlen))
     {
         if (errno == EINPROGRESS)
@@ -215,6 +328,40 @@ std::string MiracNetwork::GetPeerAddress ()
 }
 
 
+std::string MiracNetwork::GetLocalAddress ()
+{
+    struct sockaddr_storage addr;
+    socklen_t addrsize = sizeof(addr);
+    char namebuf[INET6_ADDRSTRLEN];
+    const void *data;
+
+    if (getsockname(handle,
+        reinterpret_cast<struct sockaddr *> (&addr), &addrsize))
+        throw MiracException(errno, "getsockname()", __FUNCTION__);
+
+    if (addr.ss_family == AF_INET)
+    {
+        data = &reinterpret_cast<struct sockaddr_in *> (&addr)->sin_addr;
+    }
+    else if (addr.ss_family == AF_INET6)
+    {
+        struct in6_addr *ip6addr =
+            &reinterpret_cast<struct sockaddr_in6 *> (&addr)->sin6_addr;
+        /* connection from an IPv4 peer to a dual stack listener */
+        if (IN6_IS_ADDR_V4MAPPED(ip6addr))
+            return inet_ntop(AF_INET, &ip6addr->s6_addr[12], namebuf,
+                sizeof(namebuf));
+        data = ip6addr;
+    }
+    else
+        throw MiracException("unsupported address family", __FUNCTION__);
+
+    if (!inet_ntop(addr.ss_family, data, namebuf, sizeof(namebuf)))
+        throw MiracException(errno, "inet_ntop()", __FUNCTION__);
+    return std::string(namebuf);
+}
+
+
 unsigned short MiracNetwork::GetHostPort ()
 {
     socklen_t addrsize = std::max(sizeof(sockaddr_in), sizeof(sockaddr_in6));
@@ -242,81 +389,125 @@ unsigned short MiracNetwork::GetHostPort ()
 }
 
 
-bool MiracNetwork::Receive (std::string &message)
+void MiracIoResult::check (const char *function) const
+{
+    if (status_ == ConnectionLost)
+        throw MiracConnectionLostException(function);
+    if (status_ == Error)
+        throw MiracException(error_, call_, function);
+}
+
+
+/* reads everything available into buffer, until the socket would block */
+MiracIoResult MiracNetwork::Fill (std::string &buffer, size_t *received)
 {
     int ec;
     char nb[page_size];
 
-    do {
+    *received = 0;
+    for (;;) {
         ec = recv(handle, nb, page_size, 0);
         if (ec > 0)
-            message.append(nb, ec);
+        {
+            buffer.append(nb, ec);
+            *received += ec;
+            if (tcp_profile.quick_ack)
+                RearmQuickAck();
+        }
         else if (ec < 0)
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
+                return MiracIoResult(MiracIoResult::WouldBlock);
+            if (errno == EINTR)
+                continue;
             if (errno == ECONNRESET)
-                throw MiracConnectionLostException( __FUNCTION__);
-            throw MiracException(errno, "recv()", __FUNCTION__);
+                return MiracIoResult(MiracIoResult::ConnectionLost);
+            return MiracIoResult(MiracIoResult::Error, errno, "recv()");
         }
         else  // ec == 0
-            throw MiracConnectionLostException( __FUNCTION__);
-    } while (ec > 0);
-
-    return true;
+            return MiracIoResult(MiracIoResult::ConnectionLost);
+    }
 }
 
 
-bool MiracNetwork::Receive (std::string &message, size_t length)
+MiracIoResult MiracNetwork::TryReceive (std::string &message)
 {
-    int ec;
-    char nb[page_size];
+    size_t received;
+    MiracIoResult result = Fill(message, &received);
+
+    /* data read before the peer hung up is still delivered, the loss is
+     * reported by the next call */
+    if (result.failed() && received == 0)
+        return result;
+    return MiracIoResult(received > 0 ?
+        MiracIoResult::Done : MiracIoResult::WouldBlock);
+}
 
-    do {
-        ec = recv(handle, nb, page_size, 0);
-        if (ec > 0)
-            recv_buf.append(nb, ec);
-        else if (ec < 0)
-        {
-            if (errno == EAGAIN || errno == EWOULDBLOCK)
-                break;
-            if (errno == ECONNRESET)
-                throw MiracConnectionLostException( __FUNCTION__);
-            throw MiracException(errno, "recv()", __FUNCTION__);
-        }
-        else  // ec == 0
-            throw MiracConnectionLostException( __FUNCTION__);
-    } while (ec > 0);
+
+MiracIoResult MiracNetwork::TryReceive (std::string &message, size_t length)
+{
+    size_t received;
+    MiracIoResult result = Fill(recv_buf, &received);
 
     if (recv_buf.size() < length)
-        return false;
+        return result.failed() ?
+            result : MiracIoResult(MiracIoResult::WouldBlock);
 
     message = recv_buf.substr(0, length);
     recv_buf.erase(0, length);
-    return true;
+    return MiracIoResult();
 }
 
 
-bool MiracNetwork::Send (const std::string &message)
+MiracIoResult MiracNetwork::TrySend (const std::string &message)
 {
     int ec;
 
     if (!message.empty())
         send_buf.append(message);
-    do {
+    while (!send_buf.empty()) {
         ec = send(handle, send_buf.c_str(), send_buf.size(), MSG_NOSIGNAL);
         if (ec > 0)
             send_buf.erase(0, ec);
         else
         {
             if (errno == EAGAIN || errno == EWOULDBLOCK)
-                return false;
-            if (errno == EPIPE || errno == ENOTCONN)
-                throw MiracConnectionLostException(__FUNCTION__);
-            throw MiracException(errno, "send()", __FUNCTION__);
+                return MiracIoResult(MiracIoResult::WouldBlock);
+            if (errno == EINTR)
+                continue;
+            if (errno == EPIPE || errno == ENOTCONN || errno == ECONNRESET)
+                return MiracIoResult(MiracIoResult::ConnectionLost);
+            return MiracIoResult(MiracIoResult::Error, errno, "send()");
         }
-    } while (send_buf.size() > 0);
+    }
+
+    return MiracIoResult();
+}
 
+
+bool MiracNetwork::Receive (std::string &message)
+{
+    MiracIoResult result = TryReceive(message);
+
+    result.check(__FUNCTION__);
     return true;
 }
 
+
+bool MiracNetwork::Receive (std::string &message, size_t length)
+{
+    MiracIoResult result = TryReceive(message, length);
+
+    result.check(__FUNCTION__);
+    return result.done();
+}
+
+
+bool MiracNetwork::Send (const std::string &message)
+{
+    MiracIoResult result = TrySend(message);
+
+    result.check(__FUNCTION__);
+    return result.done();
+}
+
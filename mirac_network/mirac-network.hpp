@@ -45,31 +45,138 @@ class MiracConnectionLostException : public MiracException
 
 
 
+/* TCP socket options for the RTSP control channel. Messages on it are
+ * tiny and latency critical (M5 triggers, M13 IDR requests), so Nagle
+ * and delayed ACKs only add delay. */
+struct MiracTcpProfile
+{
+    MiracTcpProfile ()
+        : no_delay(false), quick_ack(false), user_timeout(0),
+          keep_alive(false), keep_idle(0), keep_interval(0), keep_count(0),
+          tos(-1)
+        { }
+
+    /* profile matching the 60 second RTSP keep-alive of the session:
+     * a dead peer is noticed by TCP within the same time */
+    static MiracTcpProfile RtspControl (int tos = -1)
+        {
+            MiracTcpProfile profile;
+            profile.no_delay = true;
+            profile.quick_ack = true;
+            profile.user_timeout = 60 * 1000;
+            profile.keep_alive = true;
+            profile.keep_idle = 30;
+            profile.keep_interval = 10;
+            profile.keep_count = 3;
+            profile.tos = tos;
+            return profile;
+        }
+
+    bool no_delay;              /* TCP_NODELAY */
+    bool quick_ack;             /* TCP_QUICKACK, re-armed after every read */
+    unsigned user_timeout;      /* TCP_USER_TIMEOUT in ms, 0 for default */
+    bool keep_alive;            /* SO_KEEPALIVE */
+    int keep_idle;              /* TCP_KEEPIDLE in s, 0 for default */
+    int keep_interval;          /* TCP_KEEPINTVL in s, 0 for default */
+    int keep_count;             /* TCP_KEEPCNT, 0 for default */
+    int tos;                    /* IP_TOS / IPV6_TCLASS, -1 to leave as is,
+                                   e.g. 0xb8 for DSCP EF */
+};
+
+
+/* Outcome of the non-throwing I/O calls, used on the event loop hot path
+ * where a peer disconnect is an expected event and not an exception. */
+class MiracIoResult
+{
+    public:
+        enum Status {
+            Done,               /* the whole request was completed */
+            WouldBlock,         /* partial or nothing, wait for the socket */
+            ConnectionLost,     /* peer closed or reset the connection */
+            Error               /* other failure, see error() */
+        };
+
+        MiracIoResult (Status status = Done, int error = 0,
+                       const char *call = NULL)
+            : status_(status), error_(error), call_(call)
+            { }
+
+        Status status () const
+            { return status_; }
+        /* errno of the failed call for Error, 0 otherwise */
+        int error () const
+            { return error_; }
+        /* name of the failed system call for Error */
+        const char * call () const
+            { return call_; }
+        bool done () const
+            { return status_ == Done; }
+        bool failed () const
+            { return status_ == ConnectionLost || status_ == Error; }
+
+        /* throws the exception the throwing API uses for this result */
+        void check (const char *function) const;
+
+    private:
+        Status status_;
+        int error_;
+        const char *call_;
+};
+
+
 class MiracNetwork
 {
     public:
         MiracNetwork ();
         MiracNetwork (int conn_handle);
         virtual ~MiracNetwork ();
-        void Bind (const char *address, const char *service);
+        void Bind (const char *address, const char *service,
+            bool reuse_port = false);
         MiracNetwork * Accept ();
         bool Connect (const char *address, const char *service);
         int GetHandle () const
             { return handle; }
         std::string GetPeerAddress ();
+        /* local end of a connected socket, IPv4-mapped addresses are
+         * returned in dotted form */
+        std::string GetLocalAddress ();
         unsigned short GetHostPort ();
         bool Receive (std::string &message);
         bool Receive (std::string &message, size_t length);
         bool Send (const std::string &message = std::string());
+        /* non-throwing variants of the above, Receive() without length
+         * reports WouldBlock when nothing was read */
+        MiracIoResult TryReceive (std::string &message);
+        MiracIoResult TryReceive (std::string &message, size_t length);
+        MiracIoResult TrySend (const std::string &message = std::string());
+        /* bytes accepted by Send() but not yet written to the socket */
+        size_t GetSendBufferSize () const
+            { return send_buf.size(); }
+        /* applied to the current socket and to every socket created
+         * later by Bind(), Accept() or Connect() */
+        void SetTcpProfile (const MiracTcpProfile &profile);
+        const MiracTcpProfile & GetTcpProfile () const
+            { return tcp_profile; }
+        /* SO_BINDTODEVICE, applied to the current socket and to every
+         * socket created later, accepted ones inherit it */
+        void SetInterface (const std::string &name);
+        const std::string & GetInterface () const
+            { return interface_name; }
 
     protected:
         int handle;
         size_t page_size;
         std::string recv_buf;
         std::string send_buf;
+        MiracTcpProfile tcp_profile;
+        std::string interface_name;
 
         void Init ();
         void Close ();
+        void ApplyTcpProfile ();
+        void RearmQuickAck ();
+        void ApplyInterface ();
+        MiracIoResult Fill (std::string &buffer, size_t *received);
 
     private:
         void *conn_ares;
@@ -0,0 +1,142 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include "mirac-rate-controller.hpp"
+
+static const uint8_t rtcp_sr = 200;
+static const uint8_t rtcp_rr = 201;
+static const size_t report_block_size = 24;
+static const size_t sender_info_size = 20;
+
+// Loss above which the link is taken as congested, and below which it
+// is clean enough to probe for more bandwidth
+static const double congested_loss = 0.10;
+static const double clean_loss = 0.02;
+static const double increase = 1.08;
+// Queueing delay this much above the lowest jitter seen means the
+// bitrate is over the link capacity before packets start to drop
+static const double jitter_margin_ms = 20.0;
+static const double jitter_decrease = 0.85;
+
+// Encoded resolution steps, in percent of the negotiated resolution.
+// A step is left when the bitrate per pixel falls below low_bpp_share
+// of the negotiated one and retaken above high_bpp_share, so that the
+// resolution does not flip while the bitrate moves around a threshold.
+static const unsigned scale_steps[] = { 100, 75, 50 };
+static const size_t scale_step_count = sizeof(scale_steps) / sizeof(scale_steps[0]);
+static const double low_bpp_share = 0.35;
+static const double high_bpp_share = 0.7;
+
+static uint32_t read32 (const uint8_t *data)
+{
+    return (uint32_t) data[0] << 24 | data[1] << 16 | data[2] << 8 | data[3];
+}
+
+bool MiracParseRtcpReports (const uint8_t *data, size_t size,
+                            std::vector<MiracRtcpReportBlock> &blocks)
+{
+    while (size >= 4) {
+        unsigned version = data[0] >> 6;
+        unsigned count = data[0] & 0x1f;
+        uint8_t type = data[1];
+        size_t length = ((data[2] << 8 | data[3]) + 1) * 4;
+        if (version != 2 || length > size)
+            return false;
+
+        size_t offset = 8;
+        if (type == rtcp_sr)
+            offset += sender_info_size;
+        if (type == rtcp_sr || type == rtcp_rr) {
+            if (offset + count * report_block_size > length)
+                return false;
+            for (unsigned i = 0; i < count; i++, offset += report_block_size) {
+                const uint8_t *block = data + offset;
+                MiracRtcpReportBlock report;
+                report.ssrc = read32(block);
+                report.fraction_lost = block[4] / 256.0;
+                // 24 bit signed
+                report.cumulative_lost = (int32_t) (read32(block + 4) << 8) >> 8;
+                report.highest_sequence = read32(block + 8);
+                report.jitter = read32(block + 12);
+                blocks.push_back(report);
+            }
+        }
+
+        data += length;
+        size -= length;
+    }
+    return size == 0;
+}
+
+MiracRateController::MiracRateController (unsigned max_bitrate, unsigned min_bitrate)
+  : max_bitrate_(max_bitrate),
+    min_bitrate_(std::min(min_bitrate, max_bitrate)),
+    bitrate_(max_bitrate),
+    scale_step_(0),
+    min_jitter_(-1)
+{
+}
+
+unsigned MiracRateController::scale () const
+{
+    return scale_steps[scale_step_];
+}
+
+static double bpp_share (unsigned bitrate, unsigned max_bitrate, unsigned scale)
+{
+    double pixels = scale * scale / 10000.0;
+    return bitrate / (max_bitrate * pixels);
+}
+
+bool MiracRateController::OnReport (double fraction_lost, double jitter_ms)
+{
+    // The lowest jitter seen is the baseline of an empty queue; it
+    // creeps upwards so that a link that got slower for good is not
+    // taken as congested forever
+    if (min_jitter_ < 0 || jitter_ms < min_jitter_)
+        min_jitter_ = jitter_ms;
+    else
+        min_jitter_ += (jitter_ms - min_jitter_) / 32;
+
+    double bitrate = bitrate_;
+    if (fraction_lost > congested_loss)
+        bitrate *= 1.0 - fraction_lost / 2;
+    else if (jitter_ms > min_jitter_ + jitter_margin_ms)
+        bitrate *= jitter_decrease;
+    else if (fraction_lost < clean_loss)
+        bitrate *= increase;
+    bitrate = std::max<double>(min_bitrate_, std::min<double>(max_bitrate_, bitrate));
+
+    unsigned scale_step = scale_step_;
+    if (scale_step + 1 < scale_step_count &&
+        bpp_share(bitrate, max_bitrate_, scale_steps[scale_step]) < low_bpp_share)
+        scale_step++;
+    else if (scale_step > 0 &&
+             bpp_share(bitrate, max_bitrate_, scale_steps[scale_step - 1]) > high_bpp_share)
+        scale_step--;
+
+    bool changed = (unsigned) bitrate != bitrate_ || scale_step != scale_step_;
+    bitrate_ = bitrate;
+    scale_step_ = scale_step;
+    return changed;
+}
@@ -0,0 +1,74 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_RATE_CONTROLLER_HPP
+#define MIRAC_RATE_CONTROLLER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A report block of an RTCP sender or receiver report (RFC 3550, 6.4)
+struct MiracRtcpReportBlock {
+    uint32_t ssrc;
+    double fraction_lost;       // since the previous report, 0..1
+    int32_t cumulative_lost;
+    uint32_t highest_sequence;
+    uint32_t jitter;            // RTP timestamp units
+};
+
+// Appends the report blocks of all SR and RR packets in a compound RTCP
+// packet; returns false if the packet is malformed
+bool MiracParseRtcpReports (const uint8_t *data, size_t size,
+                            std::vector<MiracRtcpReportBlock> &blocks);
+
+/*
+ * Loss and delay based encoder rate control. Loss up to a few percent is
+ * taken as link noise (e.g. Wi-Fi retries running out) and is left to
+ * the IDR requests of the sink; the bitrate backs off when loss or
+ * growing jitter show that the link is congested, and probes upwards
+ * again while it is clean. When the bitrate gets too low for the
+ * negotiated resolution, the encoded resolution is scaled down in steps
+ * so that the frame rate can be kept.
+ */
+class MiracRateController
+{
+public:
+    // Bitrates in kbit/s; max_bitrate is what the negotiated format
+    // starts with
+    MiracRateController (unsigned max_bitrate, unsigned min_bitrate);
+
+    // Returns true if bitrate() or scale() changed
+    bool OnReport (double fraction_lost, double jitter_ms);
+
+    unsigned bitrate () const { return bitrate_; }
+    // Encoded resolution in percent of the negotiated one
+    unsigned scale () const;
+
+private:
+    unsigned max_bitrate_;
+    unsigned min_bitrate_;
+    unsigned bitrate_;
+    unsigned scale_step_;
+    double min_jitter_;
+};
+
+#endif
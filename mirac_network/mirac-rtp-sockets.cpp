@@ -0,0 +1,104 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <cerrno>
+#include <cstring>
+#include <sys/socket.h>
+
+#include "mirac-rtp-sockets.hpp"
+#include "libwds/public/logging.h"
+
+// Another process may take P + 1 between the two binds
+static const int max_attempts = 8;
+
+static GSocket *bind_socket (GSocketFamily family, const std::string &interface, guint16 port)
+{
+    GError *err = NULL;
+    GSocket *socket = g_socket_new(family, G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, &err);
+    if (!socket) {
+        WDS_ERROR("Cannot create RTP socket: %s", err->message);
+        g_error_free(err);
+        return NULL;
+    }
+
+    if (!interface.empty() &&
+        setsockopt(g_socket_get_fd(socket), SOL_SOCKET, SO_BINDTODEVICE,
+                   interface.c_str(), interface.size())) {
+        WDS_ERROR("Cannot bind RTP socket to %s: %s", interface.c_str(), strerror(errno));
+        g_object_unref(socket);
+        return NULL;
+    }
+
+    GInetAddress *any = g_inet_address_new_any(family);
+    GSocketAddress *address = g_inet_socket_address_new(any, port);
+    gboolean bound = g_socket_bind(socket, address, TRUE, &err);
+    g_object_unref(address);
+    g_object_unref(any);
+    if (!bound) {
+        // Expected when probing for P + 1
+        if (!port)
+            WDS_ERROR("Cannot bind RTP socket: %s", err->message);
+        g_error_free(err);
+        g_object_unref(socket);
+        return NULL;
+    }
+    return socket;
+}
+
+bool MiracBindRtpSockets (GSocketFamily family, const std::string &interface,
+                          GSocket **rtp, GSocket **rtcp)
+{
+    for (int attempt = 0; attempt < max_attempts; attempt++) {
+        *rtp = bind_socket(family, interface, 0);
+        if (!*rtp)
+            return false;
+
+        guint16 port = MiracSocketPort(*rtp);
+        *rtcp = port < G_MAXUINT16 ? bind_socket(family, interface, port + 1) : NULL;
+        if (*rtcp)
+            return true;
+        g_object_unref(*rtp);
+    }
+
+    *rtp = NULL;
+    WDS_ERROR("Cannot find a free RTP and RTCP port pair");
+    return false;
+}
+
+GSocketFamily MiracSocketFamilyOf (const std::string &hostname)
+{
+    GInetAddress *address = g_inet_address_new_from_string(hostname.c_str());
+    if (!address)
+        return G_SOCKET_FAMILY_IPV4;
+    GSocketFamily family = g_inet_address_get_family(address);
+    g_object_unref(address);
+    return family;
+}
+
+guint16 MiracSocketPort (GSocket *socket)
+{
+    GSocketAddress *address = g_socket_get_local_address(socket, NULL);
+    if (!address)
+        return 0;
+    guint16 port = g_inet_socket_address_get_port(G_INET_SOCKET_ADDRESS(address));
+    g_object_unref(address);
+    return port;
+}
@@ -0,0 +1,39 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_RTP_SOCKETS_HPP
+#define MIRAC_RTP_SOCKETS_HPP
+
+#include <gio/gio.h>
+#include <string>
+
+// Binds UDP sockets for RTP on a free port P and for RTCP on P + 1, as
+// the WFD transport header expects. A non-empty interface binds both to
+// it. The caller owns the sockets.
+bool MiracBindRtpSockets (GSocketFamily family, const std::string &interface,
+                          GSocket **rtp, GSocket **rtcp);
+
+// Family of the sockets to reach hostname, IPv4 if it is not an address
+GSocketFamily MiracSocketFamilyOf (const std::string &hostname);
+
+guint16 MiracSocketPort (GSocket *socket);
+
+#endif
@@ -0,0 +1,144 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+
+#include "mirac-video-caps.hpp"
+
+// Max video bit rate for Baseline and Main profiles, kbit/s (H.264 table A-1)
+static const unsigned level_max_bitrate[] = { 14000, 20000, 20000, 50000, 50000 };
+static const char *level_names[] = { "3.1", "3.2", "4", "4.1", "4.2" };
+
+// Screen content compresses well; 0.1 bit per pixel is plenty for x264
+// with tune=zerolatency and keeps 1080p60 at ~12 Mbit/s
+static const double bits_per_pixel = 0.1;
+
+// More slices let the sink decode a picture in parallel, but each costs
+// its own headers and prediction across slice boundaries
+static const unsigned max_slices = 4;
+
+// x264enc's own vbv-buf-capacity, for sinks not giving their latency
+static const unsigned default_vbv_buffer_ms = 600;
+
+MiracVideoEncoding MiracVideoEncodingFor (const wds::H264VideoFormat &format)
+{
+    const wds::VideoMode &mode = wds::GetVideoMode(format);
+
+    MiracVideoEncoding encoding;
+    encoding.width = mode.width;
+    encoding.height = mode.height;
+    encoding.frame_rate = mode.interlaced ? mode.frame_rate / 2 : mode.frame_rate;
+    encoding.interlaced = mode.interlaced;
+    // Constrained High is High without B-frames; x264enc has no separate
+    // profile for it, tune=zerolatency already disables B-frames
+    encoding.profile = format.profile == wds::CHP ? "high" : "constrained-baseline";
+    encoding.level = level_names[format.level];
+
+    unsigned max_bitrate = level_max_bitrate[format.level];
+    if (format.profile == wds::CHP)
+        max_bitrate = max_bitrate * 5 / 4;
+    unsigned bitrate = mode.pixel_rate * bits_per_pixel / 1000;
+    encoding.bitrate = std::min(bitrate, max_bitrate);
+
+    // One IDR per second so that a sink joining late or losing packets
+    // recovers without waiting for an explicit wfd_idr_request
+    encoding.key_int_max = encoding.frame_rate;
+
+    // Slices no smaller than the sink's min_slice_size (in macroblocks)
+    // and no more than its slice_enc_params allow
+    encoding.slices = 0;
+    if (format.min_slice_size) {
+        unsigned macroblocks = ((mode.width + 15) / 16) * ((mode.height + 15) / 16);
+        unsigned slices = std::min(max_slices, macroblocks / format.min_slice_size);
+        unsigned sink_max_slices = format.slice_enc_params & 0x3ff;
+        if (sink_max_slices)
+            slices = std::min(slices, sink_max_slices);
+        if (slices > 1)
+            encoding.slices = slices;
+    }
+
+    // The sink's decoder latency (in units of 5 ms) bounds how much the
+    // rate control may buffer
+    encoding.vbv_buffer_ms = format.latency ? format.latency * 5 : default_vbv_buffer_ms;
+    return encoding;
+}
+
+GstCaps *MiracRawVideoCaps (const MiracVideoEncoding &encoding)
+{
+    return gst_caps_new_simple("video/x-raw",
+                               "format", G_TYPE_STRING, "I420",
+                               "width", G_TYPE_INT, encoding.width,
+                               "height", G_TYPE_INT, encoding.height,
+                               "framerate", GST_TYPE_FRACTION, encoding.frame_rate, 1,
+                               NULL);
+}
+
+GstCaps *MiracH264Caps (const MiracVideoEncoding &encoding)
+{
+    return gst_caps_new_simple("video/x-h264",
+                               "stream-format", G_TYPE_STRING, "byte-stream",
+                               "profile", G_TYPE_STRING, encoding.profile,
+                               "level", G_TYPE_STRING, encoding.level,
+                               NULL);
+}
+
+static const unsigned profile_count = wds::CHP + 1;
+static const unsigned level_count = wds::k4_2 + 1;
+
+// The caps of every format, built once (thread-safely) on first use and
+// kept for the lifetime of the process, like static caps
+struct MiracCapsTable {
+    MiracCapsTable ()
+    {
+        for (unsigned i = 0; i < wds::kVideoModeCount; i++) {
+            const wds::VideoMode &mode = wds::kVideoModes[i];
+            wds::H264VideoFormat format(wds::CBP, wds::k3_1, mode.type, mode.bit);
+            raw[i] = MiracRawVideoCaps(MiracVideoEncodingFor(format));
+        }
+        for (unsigned profile = 0; profile < profile_count; profile++) {
+            for (unsigned level = 0; level < level_count; level++) {
+                wds::H264VideoFormat format(wds::H264Profile(profile), wds::H264Level(level),
+                                            wds::CEA640x480p60);
+                h264[profile][level] = MiracH264Caps(MiracVideoEncodingFor(format));
+            }
+        }
+    }
+
+    GstCaps *raw[wds::kVideoModeCount];
+    GstCaps *h264[profile_count][level_count];
+};
+
+static const MiracCapsTable &caps_table ()
+{
+    static const MiracCapsTable table;
+    return table;
+}
+
+GstCaps *MiracRawVideoCapsFor (const wds::H264VideoFormat &format)
+{
+    return gst_caps_ref(
+        caps_table().raw[wds::GetVideoModeIndex(format.type, format.rate_resolution)]);
+}
+
+GstCaps *MiracH264CapsFor (const wds::H264VideoFormat &format)
+{
+    return gst_caps_ref(caps_table().h264[format.profile][format.level]);
+}
@@ -0,0 +1,60 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef MIRAC_VIDEO_CAPS_HPP
+#define MIRAC_VIDEO_CAPS_HPP
+
+#include <gst/gst.h>
+
+#include "libwds/public/video_format.h"
+
+// Encoder settings derived from a negotiated wfd_video_formats entry
+struct MiracVideoEncoding {
+    unsigned width;
+    unsigned height;
+    // Frames per second fed to the encoder: half the field rate for
+    // interlaced modes, which x264enc then codes as field pairs
+    unsigned frame_rate;
+    bool interlaced;
+    const char *profile;    // video/x-h264 profile field
+    const char *level;      // video/x-h264 level field
+    unsigned bitrate;       // x264enc bitrate, kbit/s
+    unsigned key_int_max;   // frames between IDRs
+    unsigned slices;        // slices per picture, 0 for x264enc's default
+    unsigned vbv_buffer_ms; // x264enc vbv-buf-capacity
+};
+
+MiracVideoEncoding MiracVideoEncodingFor (const wds::H264VideoFormat &format);
+
+// video/x-raw caps forced in front of the encoder (scaled and rate
+// converted from whatever the capture source produces)
+GstCaps *MiracRawVideoCaps (const MiracVideoEncoding &encoding);
+
+// video/x-h264 caps forced behind the encoder (profile and level)
+GstCaps *MiracH264Caps (const MiracVideoEncoding &encoding);
+
+// The same caps for a negotiated format, looked up in a table built on
+// first use for every mode, profile and level. Returns a new reference
+// to caps shared by all pipelines.
+GstCaps *MiracRawVideoCapsFor (const wds::H264VideoFormat &format);
+GstCaps *MiracH264CapsFor (const wds::H264VideoFormat &format);
+
+#endif
@@ -0,0 +1,122 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Prints the local interface addresses and follows their changes, e.g.
+ * in a scratch network namespace:
+ *
+ *   ip netns add wds
+ *   ip netns exec wds netlink-test [interface] &
+ *   ip -n wds link add p2p-test type dummy
+ *   ip -n wds addr add 192.168.49.1/24 dev p2p-test
+ *   ip -n wds link set p2p-test up
+ *
+ * With an interface name, the address MiracBroker would report for it
+ * is printed after every change.
+ */
+
+
+#include <glib.h>
+#include <glib-unix.h>
+#include <sys/socket.h>
+
+#include <memory>
+
+#include "mirac-netlink.hpp"
+
+
+static const char *interface = NULL;
+
+
+static gboolean _sig_handler (gpointer data_ptr)
+{
+    GMainLoop *ml = (GMainLoop *) data_ptr;
+
+    g_main_loop_quit(ml);
+
+    return G_SOURCE_CONTINUE;
+}
+
+
+static void _print_addresses (const MiracNetlink &netlink)
+{
+    for (const MiracInterfaceAddress &entry : netlink.GetAddresses())
+        g_print("%-16s %s/%u\n", entry.name.c_str(), entry.address.c_str(),
+            entry.prefix_length);
+    if (interface)
+        g_print("address of %s: %s\n", interface,
+            netlink.GetAddress(interface).c_str());
+}
+
+
+static gboolean _netlink_cb (gint fd, GIOCondition condition,
+    gpointer data_ptr)
+{
+    MiracNetlink *netlink = reinterpret_cast<MiracNetlink *> (data_ptr);
+
+    try
+    {
+        if (netlink->ProcessEvents())
+        {
+            g_print("-- addresses changed\n");
+            _print_addresses(*netlink);
+        }
+    }
+    catch (std::exception &x)
+    {
+        g_warning("exception: %s", x.what());
+        return G_SOURCE_REMOVE;
+    }
+    return G_SOURCE_CONTINUE;
+}
+
+
+int main (int argc, char *argv[])
+{
+    GMainLoop *ml = NULL;
+
+    if (argc > 1)
+        interface = argv[1];
+
+    try
+    {
+        ml = g_main_loop_new(NULL, TRUE);
+        g_unix_signal_add(SIGINT, _sig_handler, ml);
+        g_unix_signal_add(SIGTERM, _sig_handler, ml);
+
+        std::unique_ptr<MiracNetlink> netlink(new MiracNetlink);
+        _print_addresses(*netlink);
+        g_unix_fd_add(netlink->GetHandle(), G_IO_IN, _netlink_cb,
+            netlink.get());
+
+        g_main_loop_run(ml);
+    }
+    catch (std::exception &x)
+    {
+        g_error("exception: %s", x.what());
+    }
+
+    if (ml)
+        g_main_loop_unref(ml);
+
+    return 0;
+}
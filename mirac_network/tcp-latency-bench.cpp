@@ -0,0 +1,152 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+
+/*
+ * Loopback M13 (IDR request) round trip time with and without the RTSP
+ * control channel TCP profile. The request is written the way an RTSP
+ * stack typically does it, header first and payload second, which is the
+ * write-write-read pattern where Nagle waits for a delayed ACK.
+ */
+
+#include <poll.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "mirac-network.hpp"
+
+static const std::string m13_header =
+    "SET_PARAMETER rtsp://localhost/wfd1.0 RTSP/1.0\r\n"
+    "CSeq: 10\r\n"
+    "Content-Type: text/parameters\r\n"
+    "Content-Length: 17\r\n\r\n";
+static const std::string m13_payload = "wfd_idr_request\r\n";
+static const std::string m13_reply = "RTSP/1.0 200 OK\r\nCSeq: 10\r\n\r\n";
+
+static void wait_for (int fd, short events)
+{
+    struct pollfd pfd = { fd, events, 0 };
+    while (poll(&pfd, 1, -1) < 0 && errno == EINTR)
+        ;
+}
+
+static void send_all (MiracNetwork &net, const std::string &data)
+{
+    if (net.Send(data))
+        return;
+    do {
+        wait_for(net.GetHandle(), POLLOUT);
+    } while (!net.Send());
+}
+
+static void receive_exact (MiracNetwork &net, std::string &data, size_t length)
+{
+    while (!net.Receive(data, length))
+        wait_for(net.GetHandle(), POLLIN);
+}
+
+static void serve (MiracNetwork *listener, unsigned iterations)
+{
+    wait_for(listener->GetHandle(), POLLIN);
+    std::unique_ptr<MiracNetwork> connection(listener->Accept());
+
+    std::string request;
+    for (unsigned i = 0; i < iterations; i++) {
+        receive_exact(*connection, request,
+                      m13_header.size() + m13_payload.size());
+        send_all(*connection, m13_reply);
+    }
+    // Hold the connection until the client hangs up, otherwise the last
+    // reply and the EOF can arrive in the same Receive() on the client
+    wait_for(connection->GetHandle(), POLLIN);
+}
+
+static std::vector<double> measure (const MiracTcpProfile &profile,
+                                    unsigned iterations)
+{
+    MiracNetwork listener;
+    listener.SetTcpProfile(profile);
+    listener.Bind("127.0.0.1", "0");
+    std::thread server(serve, &listener, iterations);
+
+    std::unique_ptr<MiracNetwork> connection(new MiracNetwork);
+    MiracNetwork &client = *connection;
+    client.SetTcpProfile(profile);
+    std::string port = std::to_string(listener.GetHostPort());
+    if (!client.Connect("127.0.0.1", port.c_str())) {
+        do {
+            wait_for(client.GetHandle(), POLLOUT);
+        } while (!client.Connect(NULL, NULL));
+    }
+
+    std::vector<double> samples;
+    std::string reply;
+    for (unsigned i = 0; i < iterations; i++) {
+        auto start = std::chrono::steady_clock::now();
+        send_all(client, m13_header);
+        send_all(client, m13_payload);
+        receive_exact(client, reply, m13_reply.size());
+        auto end = std::chrono::steady_clock::now();
+        samples.push_back(
+            std::chrono::duration<double, std::micro>(end - start).count());
+    }
+
+    connection.reset();
+    server.join();
+    std::sort(samples.begin(), samples.end());
+    return samples;
+}
+
+static void report (const char *name, const std::vector<double> &samples)
+{
+    double sum = 0;
+    for (double sample : samples)
+        sum += sample;
+    printf("%-12s %10.1f %10.1f %10.1f %10.1f\n", name,
+           samples.front(), samples[samples.size() / 2],
+           samples[samples.size() * 99 / 100], sum / samples.size());
+}
+
+int main (int argc, char *argv[])
+{
+    unsigned iterations = argc > 1 ? std::max(atoi(argv[1]), 1) : 200;
+
+    try {
+        printf("M13 round trip over loopback, %u iterations, microseconds\n",
+               iterations);
+        printf("%-12s %10s %10s %10s %10s\n", "profile", "min", "median",
+               "p99", "mean");
+        report("default", measure(MiracTcpProfile(), iterations));
+        report("rtsp", measure(MiracTcpProfile::RtspControl(), iterations));
+    } catch (std::exception &x) {
+        fprintf(stderr, "exception: %s\n", x.what());
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,75 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <iostream>
+#include <string>
+
+#include "mirac-audio-caps.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+static wds::AudioCodec codec (wds::AudioFormats format, unsigned mode_bits)
+{
+    return wds::AudioCodec(format, wds::AudioModes(mode_bits), 0);
+}
+
+int main (int argc, char **argv)
+{
+    gst_init(&argc, &argv);
+
+    // LPCM goes to the encoder as 16 bit big endian 48 kHz stereo
+    MiracAudioEncoding lpcm = MiracAudioEncodingFor(wds::AudioCodec());
+    CHECK(std::string(lpcm.encoder), "dvdlpcmenc");
+    CHECK(lpcm.rate, 48000u);
+    CHECK(lpcm.channels, 2u);
+    GstCaps *caps = MiracRawAudioCaps(lpcm);
+    GstStructure *structure = gst_caps_get_structure(caps, 0);
+    CHECK(std::string(gst_structure_get_string(structure, "format")), "S16BE");
+    int rate = 0, channels = 0;
+    gst_structure_get_int(structure, "rate", &rate);
+    gst_structure_get_int(structure, "channels", &channels);
+    CHECK(rate, 48000);
+    CHECK(channels, 2);
+    gst_caps_unref(caps);
+
+    // Compressed formats leave the sample format to the encoder
+    MiracAudioEncoding aac = MiracAudioEncodingFor(codec(wds::AAC, 1 << wds::AAC_48K_16B_6CH));
+    CHECK(std::string(aac.encoder), "avenc_aac");
+    CHECK(aac.channels, 6u);
+    caps = MiracRawAudioCaps(aac);
+    CHECK(gst_structure_has_field(gst_caps_get_structure(caps, 0), "format"), FALSE);
+    gst_caps_unref(caps);
+
+    // The mode with the fewest channels wins
+    aac = MiracAudioEncodingFor(codec(wds::AAC, 1 << wds::AAC_48K_16B_8CH | 1 << wds::AAC_48K_16B_4CH));
+    CHECK(aac.channels, 4u);
+    MiracAudioEncoding ac3 = MiracAudioEncodingFor(codec(wds::AC3, 7));
+    CHECK(std::string(ac3.encoder), "avenc_ac3");
+    CHECK(ac3.channels, 2u);
+    CHECK(ac3.rate, 48000u);
+
+    return 0;
+}
@@ -0,0 +1,118 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <iostream>
+#include <random>
+#include <vector>
+
+#include "mirac-color-convert.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+struct I420Buffer {
+    I420Buffer (int width, int height)
+      : width(width), height(height),
+        y(width * height), u((width + 1) / 2 * ((height + 1) / 2)), v(u.size())
+    {
+        frame.planes[0] = y.data();
+        frame.planes[1] = u.data();
+        frame.planes[2] = v.data();
+        frame.strides[0] = width;
+        frame.strides[1] = frame.strides[2] = (width + 1) / 2;
+    }
+
+    int width, height;
+    std::vector<uint8_t> y, u, v;
+    MiracI420Frame frame;
+};
+
+static int compare (int width, int height, std::mt19937 &random)
+{
+    int stride = width * 4 + 12;
+    std::vector<uint8_t> bgrx(stride * height);
+    for (auto &byte : bgrx)
+        byte = random();
+
+    I420Buffer simd(width, height), scalar(width, height);
+    MiracConvertBgrxToI420(bgrx.data(), stride, width, height, 0, height, simd.frame);
+    MiracConvertBgrxToI420Scalar(bgrx.data(), stride, width, height, 0, height, scalar.frame);
+
+    for (size_t i = 0; i < simd.y.size(); i++)
+        CHECK((int) simd.y[i], (int) scalar.y[i]);
+    for (size_t i = 0; i < simd.u.size(); i++) {
+        CHECK((int) simd.u[i], (int) scalar.u[i]);
+        CHECK((int) simd.v[i], (int) scalar.v[i]);
+    }
+    return 0;
+}
+
+int main()
+{
+    // Reference values of the BT.601 limited range
+    struct {
+        uint8_t b, g, r;
+        int y, u, v;
+    } colors[] = {
+        {   0,   0,   0,  16, 128, 128 },
+        { 255, 255, 255, 235, 128, 128 },
+        {   0,   0, 255,  82,  90, 240 },
+        {   0, 255,   0, 144,  54,  34 },
+        { 255,   0,   0,  41, 240, 110 },
+    };
+    for (const auto &color : colors) {
+        const int width = 16, height = 2;
+        std::vector<uint8_t> bgrx;
+        for (int i = 0; i < width * height; i++)
+            bgrx.insert(bgrx.end(), { color.b, color.g, color.r, 0xff });
+
+        I420Buffer out(width, height);
+        MiracConvertBgrxToI420(bgrx.data(), width * 4, width, height, 0, height, out.frame);
+        CHECK((int) out.y[0], color.y);
+        CHECK((int) out.y[width + 9], color.y);
+        CHECK((int) out.u[5], color.u);
+        CHECK((int) out.v[7], color.v);
+    }
+
+    // Noise, odd sizes and tails shorter than a SIMD block
+    std::mt19937 random(1);
+    const int sizes[][2] = { {1920, 1080}, {640, 480}, {17, 9}, {1, 1}, {7, 3}, {33, 2} };
+    for (const auto &size : sizes)
+        if (compare(size[0], size[1], random))
+            return 1;
+
+    // Converting a band leaves the rest alone
+    const int width = 64, height = 64;
+    std::vector<uint8_t> white(width * height * 4, 0xff);
+    I420Buffer out(width, height);
+    std::fill(out.y.begin(), out.y.end(), 0);
+    MiracConvertBgrxToI420(white.data(), width * 4, width, height, 16, 32, out.frame);
+    CHECK((int) out.y[15 * width], 0);
+    CHECK((int) out.y[16 * width], 235);
+    CHECK((int) out.y[31 * width + 63], 235);
+    CHECK((int) out.y[32 * width], 0);
+
+    return 0;
+}
@@ -0,0 +1,61 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <iostream>
+
+#include "mirac-gst-frame-timing.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+int main (int argc, char **argv)
+{
+    MiracLatencyHistogram histogram;
+    CHECK(histogram.Percentile(0.5), 0);
+
+    // 90 samples of 1 ms and 10 of 40 ms
+    for (int i = 0; i < 90; i++)
+        histogram.Add(1000);
+    for (int i = 0; i < 10; i++)
+        histogram.Add(40000);
+
+    CHECK(histogram.count, 100u);
+    CHECK(histogram.min, 1000);
+    CHECK(histogram.max, 40000);
+    CHECK(histogram.total, 490000);
+    // 1000 us is in [512, 1024), 40000 us in [32768, 65536)
+    CHECK(histogram.buckets[9], 90u);
+    CHECK(histogram.buckets[15], 10u);
+    CHECK(histogram.Percentile(0.5), 1024);
+    CHECK(histogram.Percentile(0.95), 40000);
+
+    // Out of range samples are clamped to the first and last bucket
+    histogram.Add(-5);
+    histogram.Add(G_GINT64_CONSTANT(1) << 40);
+    CHECK(histogram.buckets[0], 1u);
+    CHECK(histogram.buckets[MiracLatencyHistogram::bucket_count - 1], 1u);
+
+    return 0;
+}
@@ -0,0 +1,95 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <iostream>
+
+#include "mirac-idle-frames.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+static const int64_t frame_interval = 1000000 / 30;
+static const int64_t settle_time = 500000;
+static const int64_t refresh_interval = 1000000;
+
+// Feeds count frames at 30 fps from frame index first, returns how many
+// were let through
+static int run (MiracIdleFrameFilter &filter, int first, int count, bool changed)
+{
+    int sent = 0;
+    for (int i = first; i < first + count; i++)
+        sent += filter.OnFrame(changed, i * frame_interval);
+    return sent;
+}
+
+int main()
+{
+    MiracIdleFrameFilter filter(settle_time, refresh_interval);
+    int sent;
+
+    // A changing screen is sent at the full rate
+    sent = run(filter, 0, 60, true);
+    CHECK(sent, 60);
+    CHECK(filter.idle(), false);
+
+    // Static frames keep the full rate for the settle time (15 frames),
+    // then every 31st frame is sent (30 frames are 999990 us)
+    sent = run(filter, 60, 15, false);
+    CHECK(sent, 15);
+    CHECK(filter.idle(), false);
+    sent = run(filter, 75, 300, false);
+    CHECK(sent, 9);
+    CHECK(filter.idle(), true);
+
+    // The first change is sent right away and ends the idle period
+    sent = filter.OnFrame(true, 375 * frame_interval);
+    CHECK(sent, true);
+    CHECK(filter.idle(), false);
+    sent = run(filter, 376, 15, false);
+    CHECK(sent, 15);
+
+    // A static screen from the first frame on still sends that frame
+    MiracIdleFrameFilter fresh(settle_time, refresh_interval);
+    sent = fresh.OnFrame(false, 0);
+    CHECK(sent, true);
+    sent = run(fresh, 1, 15, false);
+    CHECK(sent, 15);
+    sent = run(fresh, 16, 30, false);
+    CHECK(sent, 0);
+    sent = fresh.OnFrame(false, 46 * frame_interval);
+    CHECK(sent, true);
+
+    // A forced frame (a pending IDR request) is sent while idle, stays
+    // idle and restarts the refresh interval
+    sent = fresh.OnFrame(false, 50 * frame_interval);
+    CHECK(sent, false);
+    sent = fresh.OnFrame(false, 51 * frame_interval, true);
+    CHECK(sent, true);
+    CHECK(fresh.idle(), true);
+    sent = run(fresh, 52, 31, false);
+    CHECK(sent, 1);
+
+    return 0;
+}
@@ -0,0 +1,109 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <functional>
+#include <iostream>
+
+#include <gst/gst.h>
+
+#include "mirac-gst-test-source.hpp"
+#include "mirac-listener-pool.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+static std::atomic<int> sessions_destroyed(0);
+
+// A session with a pipeline and its sources on the worker's context, as
+// the pooled WFD sources have
+class TestSession : public MiracBroker
+{
+public:
+    explicit TestSession (MiracNetwork* connection)
+      : MiracBroker(connection),
+        source(WFD_TEST_VIDEO, "127.0.0.1", 0)
+    {
+        source.FrameTiming().SetLogInterval(1);
+        // Its state change messages are still in flight on teardown
+        source.SetState(GST_STATE_PAUSED);
+    }
+    ~TestSession () { sessions_destroyed++; }
+
+    wds::Peer* Peer() const override { return nullptr; }
+
+private:
+    MiracGstTestSource source;
+};
+
+static bool wait_for (const std::function<bool ()>& condition)
+{
+    for (int i = 0; i < 500 && !condition(); i++)
+        g_usleep(10 * G_TIME_SPAN_MILLISECOND);
+    return condition();
+}
+
+static int connect_to (unsigned short port)
+{
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (fd >= 0 && connect(fd, (struct sockaddr*) &addr, sizeof(addr)) < 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+int main (int argc, char **argv)
+{
+    gst_init(&argc, &argv);
+    // Sources removed from the wrong main context are criticals
+    g_log_set_always_fatal((GLogLevelFlags) (G_LOG_LEVEL_CRITICAL | G_LOG_LEVEL_ERROR));
+
+    MiracListenerPool pool("0", 1, [] (MiracNetwork* connection) {
+        return new TestSession(connection);
+    });
+
+    int fd = connect_to(pool.get_host_port());
+    CHECK(fd >= 0, true);
+    CHECK(wait_for([&pool] () { return pool.session_count() == 1; }), true);
+
+    // The worker tears the session down on its own thread once the
+    // connection is lost, without waiting for the next client
+    close(fd);
+    CHECK(wait_for([&pool] () { return pool.session_count() == 0; }), true);
+    CHECK(sessions_destroyed.load(), 1);
+    CHECK(pool.accepted_count(), 1u);
+
+    return 0;
+}
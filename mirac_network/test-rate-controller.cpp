@@ -0,0 +1,155 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <algorithm>
+#include <iostream>
+#include <random>
+
+#include "mirac-rate-controller.hpp"
+
+#define CHECK(value, expected) \
+    if ((value) != (expected)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " \
+                  << (expected) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+#define CHECK_RANGE(value, low, high) \
+    if ((value) < (low) || (value) > (high)) { \
+        std::cout << __LINE__ << ": " << #value << ": expected " << (low) \
+                  << ".." << (high) << ", got " << (value) << std::endl; \
+        return 1; \
+    }
+
+// 7 TS packets per RTP packet
+static const double packet_kbit = 7 * 188 * 8 / 1000.0;
+
+/*
+ * A link with random packet loss and a bottleneck of the given capacity
+ * in front of a drop tail queue; every step is one receiver report
+ * interval of one second.
+ */
+class LossyLink
+{
+public:
+    LossyLink (double loss, unsigned capacity)
+      : loss_(loss), capacity_(capacity), queue_(0), random_(1) {}
+
+    void Send (unsigned bitrate, double *fraction_lost, double *jitter_ms)
+    {
+        unsigned packets = bitrate / packet_kbit;
+        unsigned lost = 0;
+        for (unsigned i = 0; i < packets; i++)
+            if (random_() < loss_ * random_.max())
+                lost++;
+
+        // Whatever does not fit the queue after the bottleneck drained it
+        // is dropped
+        const double queue_limit = capacity_ * 0.2;
+        queue_ = std::max(0.0, queue_ + bitrate - (double) capacity_);
+        if (queue_ > queue_limit) {
+            lost += (queue_ - queue_limit) / packet_kbit;
+            queue_ = queue_limit;
+        }
+
+        *fraction_lost = std::min(1.0, (double) lost / packets);
+        // Interarrival jitter follows the queueing delay
+        *jitter_ms = 2 + queue_ / capacity_ * 1000 / 4;
+    }
+
+private:
+    double loss_;
+    unsigned capacity_;
+    double queue_;
+    std::mt19937 random_;
+};
+
+int main (int argc, char **argv)
+{
+    // Receiver report with one block (RFC 3550 6.4.2) followed by an SDES
+    // packet, as sent by rtpbin
+    const uint8_t rr[] = {
+        0x81, 201, 0x00, 0x07,  0x11, 0x22, 0x33, 0x44,
+        0xaa, 0xbb, 0xcc, 0xdd,  64, 0xff, 0xff, 0xfe,
+        0x00, 0x01, 0x02, 0x03,  0x00, 0x00, 0x01, 0x68,
+        0x00, 0x00, 0x00, 0x00,  0x00, 0x00, 0x00, 0x00,
+        0x81, 202, 0x00, 0x01,  0x11, 0x22, 0x33, 0x44,
+    };
+    std::vector<MiracRtcpReportBlock> blocks;
+    CHECK(MiracParseRtcpReports(rr, sizeof(rr), blocks), true);
+    CHECK(blocks.size(), 1u);
+    CHECK(blocks[0].ssrc, 0xaabbccddu);
+    CHECK(blocks[0].fraction_lost, 0.25);
+    CHECK(blocks[0].cumulative_lost, -2);
+    CHECK(blocks[0].highest_sequence, 0x00010203u);
+    CHECK(blocks[0].jitter, 360u);
+    blocks.clear();
+    CHECK(MiracParseRtcpReports(rr, sizeof(rr) - 1, blocks), false);
+
+    // 5% random loss on a link that has the capacity for the negotiated
+    // bitrate: noise, the encoder is left alone
+    {
+        MiracRateController controller(8000, 500);
+        LossyLink link(0.05, 20000);
+        for (int report = 0; report < 120; report++) {
+            double fraction_lost, jitter_ms;
+            link.Send(controller.bitrate(), &fraction_lost, &jitter_ms);
+            CHECK(controller.OnReport(fraction_lost, jitter_ms), false);
+            CHECK(controller.bitrate(), 8000u);
+            CHECK(controller.scale(), 100u);
+        }
+    }
+
+    // The same on a bottleneck of 2 Mbit/s: the bitrate settles below
+    // the capacity and the resolution is scaled down once
+    {
+        MiracRateController controller(8000, 500);
+        LossyLink link(0.05, 2000);
+        unsigned settled_scale = 0;
+        for (int report = 0; report < 120; report++) {
+            double fraction_lost, jitter_ms;
+            link.Send(controller.bitrate(), &fraction_lost, &jitter_ms);
+            controller.OnReport(fraction_lost, jitter_ms);
+            if (report < 20)
+                continue;
+            CHECK_RANGE(controller.bitrate(), 1200u, 2200u);
+            if (!settled_scale)
+                settled_scale = controller.scale();
+            CHECK(controller.scale(), settled_scale);
+        }
+        CHECK(settled_scale, 75u);
+    }
+
+    // Once the bottleneck is gone, the negotiated bitrate and resolution
+    // are restored
+    {
+        MiracRateController controller(8000, 500);
+        for (int report = 0; report < 10; report++)
+            controller.OnReport(0.3, 2);
+        CHECK(controller.scale(), 50u);
+        for (int report = 0; report < 40; report++)
+            controller.OnReport(0, 2);
+        CHECK(controller.bitrate(), 8000u);
+        CHECK(controller.scale(), 100u);
+    }
+
+    return 0;
+}
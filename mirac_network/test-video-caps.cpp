@@ -0,0 +1,206 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include <cstdio>
+#include <iostream>
+#include <string>
+
+#include "mirac-video-caps.hpp"
+
+// Mode names from the Wi-Fi Display specification, in bitmap order
+static const char *cea_modes[] = {
+    "640x480p60", "720x480p60", "720x480i60", "720x576p50", "720x576i50",
+    "1280x720p30", "1280x720p60", "1920x1080p30", "1920x1080p60",
+    "1920x1080i60", "1280x720p25", "1280x720p50", "1920x1080p25",
+    "1920x1080p50", "1920x1080i50", "1280x720p24", "1920x1080p24"
+};
+
+static const char *vesa_modes[] = {
+    "800x600p30", "800x600p60", "1024x768p30", "1024x768p60", "1152x864p30",
+    "1152x864p60", "1280x768p30", "1280x768p60", "1280x800p30",
+    "1280x800p60", "1360x768p30", "1360x768p60", "1366x768p30",
+    "1366x768p60", "1280x1024p30", "1280x1024p60", "1400x1050p30",
+    "1400x1050p60", "1440x900p30", "1440x900p60", "1600x900p30",
+    "1600x900p60", "1600x1200p30", "1600x1200p60", "1680x1024p30",
+    "1680x1024p60", "1680x1050p30", "1680x1050p60", "1920x1200p30"
+};
+
+static const char *hh_modes[] = {
+    "800x480p30", "800x480p60", "854x480p30", "854x480p60", "864x480p30",
+    "864x480p60", "640x360p30", "640x360p60", "960x540p30", "960x540p60",
+    "848x480p30", "848x480p60"
+};
+
+static bool check_mode (const wds::H264VideoFormat &format, const char *mode)
+{
+    int width, height, rate;
+    char scan;
+    sscanf(mode, "%dx%d%c%d", &width, &height, &scan, &rate);
+    int frame_rate = scan == 'i' ? rate / 2 : rate;
+
+    MiracVideoEncoding encoding = MiracVideoEncodingFor(format);
+    GstCaps *raw = MiracRawVideoCaps(encoding);
+    GstCaps *h264 = MiracH264Caps(encoding);
+    GstStructure *raw_structure = gst_caps_get_structure(raw, 0);
+    GstStructure *h264_structure = gst_caps_get_structure(h264, 0);
+
+    int caps_width = 0, caps_height = 0, rate_num = 0, rate_den = 0;
+    gst_structure_get_int(raw_structure, "width", &caps_width);
+    gst_structure_get_int(raw_structure, "height", &caps_height);
+    gst_structure_get_fraction(raw_structure, "framerate", &rate_num, &rate_den);
+    std::string profile = gst_structure_get_string(h264_structure, "profile");
+    std::string level = gst_structure_get_string(h264_structure, "level");
+
+    bool ok = true;
+    if (caps_width != width || caps_height != height ||
+        rate_num != frame_rate || rate_den != 1) {
+        std::cout << mode << ": got raw caps " << caps_width << "x"
+                  << caps_height << "@" << rate_num << "/" << rate_den
+                  << std::endl;
+        ok = false;
+    }
+    if (encoding.interlaced != (scan == 'i')) {
+        std::cout << mode << ": wrong interlacing" << std::endl;
+        ok = false;
+    }
+    if (profile != (format.profile == wds::CHP ? "high" : "constrained-baseline") ||
+        level != "4.2") {
+        std::cout << mode << ": got h264 caps " << profile << " " << level
+                  << std::endl;
+        ok = false;
+    }
+    if (encoding.bitrate == 0 || encoding.key_int_max != (unsigned) frame_rate) {
+        std::cout << mode << ": got bitrate " << encoding.bitrate
+                  << " key-int-max " << encoding.key_int_max << std::endl;
+        ok = false;
+    }
+
+    gst_caps_unref(raw);
+    gst_caps_unref(h264);
+    return ok;
+}
+
+template <typename RREnum>
+static bool check_modes (const char **modes, unsigned count)
+{
+    bool ok = true;
+    for (wds::H264Profile profile : { wds::CBP, wds::CHP }) {
+        for (unsigned rr = 0; rr < count; rr++) {
+            wds::H264VideoFormat format(profile, wds::k4_2, static_cast<RREnum>(rr));
+            ok = check_mode(format, modes[rr]) && ok;
+        }
+    }
+    return ok;
+}
+
+static bool check_codec_parameters ()
+{
+    bool ok = true;
+    wds::H264VideoFormat format(wds::CHP, wds::k4_2, wds::CEA1280x720p60);
+    MiracVideoEncoding encoding = MiracVideoEncodingFor(format);
+    if (encoding.slices != 0 || encoding.vbv_buffer_ms != 600) {
+        std::cout << "no parameters: got " << encoding.slices << " slices, "
+                  << encoding.vbv_buffer_ms << " ms VBV buffer" << std::endl;
+        ok = false;
+    }
+
+    // 3600 macroblocks, a 100 ms decoder
+    format.min_slice_size = 1200;
+    format.latency = 20;
+    encoding = MiracVideoEncodingFor(format);
+    if (encoding.slices != 3 || encoding.vbv_buffer_ms != 100) {
+        std::cout << "min slice size: got " << encoding.slices << " slices, "
+                  << encoding.vbv_buffer_ms << " ms VBV buffer" << std::endl;
+        ok = false;
+    }
+
+    format.min_slice_size = 1;
+    format.slice_enc_params = 2;
+    encoding = MiracVideoEncodingFor(format);
+    if (encoding.slices != 2) {
+        std::cout << "max slices: got " << encoding.slices << " slices" << std::endl;
+        ok = false;
+    }
+    return ok;
+}
+
+static_assert(wds::kVideoModeCount == 58, "a mode is missing from the caps table test");
+
+// The table holds the caps MiracRawVideoCaps() and MiracH264Caps() build,
+// once: every lookup of a format returns the same caps
+static bool check_caps_table ()
+{
+    bool ok = true;
+    for (const wds::VideoMode &mode : wds::kVideoModes) {
+        for (unsigned profile = wds::CBP; profile <= wds::CHP; profile++) {
+            for (unsigned level = wds::k3_1; level <= wds::k4_2; level++) {
+                wds::H264VideoFormat format(wds::H264Profile(profile), wds::H264Level(level),
+                                            mode.type, mode.bit);
+                MiracVideoEncoding encoding = MiracVideoEncodingFor(format);
+                GstCaps *raw = MiracRawVideoCaps(encoding);
+                GstCaps *h264 = MiracH264Caps(encoding);
+                GstCaps *table_raw = MiracRawVideoCapsFor(format);
+                GstCaps *table_h264 = MiracH264CapsFor(format);
+                GstCaps *again_raw = MiracRawVideoCapsFor(format);
+                GstCaps *again_h264 = MiracH264CapsFor(format);
+
+                if (!gst_caps_is_equal(raw, table_raw) || !gst_caps_is_equal(h264, table_h264)) {
+                    gchar *raw_string = gst_caps_to_string(table_raw);
+                    gchar *h264_string = gst_caps_to_string(table_h264);
+                    std::cout << "caps table: got " << raw_string << " and " << h264_string
+                              << " for " << mode.width << "x" << mode.height << std::endl;
+                    g_free(raw_string);
+                    g_free(h264_string);
+                    ok = false;
+                }
+                if (again_raw != table_raw || again_h264 != table_h264) {
+                    std::cout << "caps table: caps built again for " << mode.width << "x"
+                              << mode.height << std::endl;
+                    ok = false;
+                }
+
+                gst_caps_unref(raw);
+                gst_caps_unref(h264);
+                gst_caps_unref(table_raw);
+                gst_caps_unref(table_h264);
+                gst_caps_unref(again_raw);
+                gst_caps_unref(again_h264);
+            }
+        }
+    }
+    return ok;
+}
+
+int main (int argc, char **argv)
+{
+    gst_init(&argc, &argv);
+
+    bool ok = check_modes<wds::CEARatesAndResolutions>(
+        cea_modes, G_N_ELEMENTS(cea_modes));
+    ok = check_modes<wds::VESARatesAndResolutions>(
+        vesa_modes, G_N_ELEMENTS(vesa_modes)) && ok;
+    ok = check_modes<wds::HHRatesAndResolutions>(
+        hh_modes, G_N_ELEMENTS(hh_modes)) && ok;
+    ok = check_codec_parameters() && ok;
+    ok = check_caps_table() && ok;
+
+    return ok ? 0 : 1;
+}
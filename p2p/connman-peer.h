@@ -53,6 +53,7 @@ class Peer {
         const std::string& name() const { return name_; }
         const std::string& remote_host() const {return remote_host_; }
         const int remote_port() const { return ie_->get_rtsp_port(); }
+        const int maximum_throughput() const { return ie_->get_maximum_throughput(); }
         const std::string& local_host() const {return local_host_; }
         bool is_available() const { return ready_ && !remote_host_.empty() && !local_host_.empty(); }
 
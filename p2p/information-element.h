@@ -150,6 +150,8 @@ class InformationElement {
     void add_subelement(P2P::Subelement* subelement);
     const DeviceType get_device_type() const;
     const int get_rtsp_port() const;
+    // In Mbit/s, -1 without device information
+    const int get_maximum_throughput() const;
 
     std::unique_ptr<InformationElementArray> serialize () const;
     std::string to_string() const;
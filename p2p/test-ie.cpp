@@ -62,6 +62,11 @@ int main (int argc, const char **argv)
         return 1;
     }
 
-    
+    if (ie2.get_maximum_throughput() != 50) {
+        std::cout << "Expected maximum throughput 50, got "
+                  << ie2.get_maximum_throughput() << std::endl;
+        return 1;
+    }
+
     return 0;
 }
@@ -0,0 +1,68 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#include "display_probe.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include <glib.h>
+
+std::vector<unsigned char> ReadEdidFile(const std::string& path) {
+  gchar* contents = nullptr;
+  gsize length = 0;
+  if (!g_file_get_contents(path.c_str(), &contents, &length, nullptr))
+    return std::vector<unsigned char>();
+  std::vector<unsigned char> edid(contents, contents + length);
+  g_free(contents);
+  return edid;
+}
+
+std::vector<unsigned char> ReadConnectedDisplayEdid(const std::string& drm_dir) {
+  GDir* dir = g_dir_open(drm_dir.c_str(), 0, nullptr);
+  if (!dir)
+    return std::vector<unsigned char>();
+
+  // Connectors are "card<N>-<type>-<index>", the cards themselves have no dash
+  std::vector<std::string> connectors;
+  while (const gchar* name = g_dir_read_name(dir)) {
+    if (g_str_has_prefix(name, "card") && strchr(name, '-'))
+      connectors.push_back(name);
+  }
+  g_dir_close(dir);
+  std::sort(connectors.begin(), connectors.end());
+
+  for (const std::string& connector : connectors) {
+    std::string path = drm_dir + "/" + connector + "/";
+    gchar* status = nullptr;
+    if (!g_file_get_contents((path + "status").c_str(), &status, nullptr, nullptr))
+      continue;
+    bool connected = g_str_has_prefix(status, "connected");
+    g_free(status);
+    if (!connected)
+      continue;
+    // Empty for connectors whose display has no EDID
+    std::vector<unsigned char> edid = ReadEdidFile(path + "edid");
+    if (!edid.empty())
+      return edid;
+  }
+  return std::vector<unsigned char>();
+}
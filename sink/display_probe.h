@@ -0,0 +1,36 @@
+/*
+ * This file is part of Wireless Display Software for Linux OS
+ *
+ * Copyright (C) 2015 Intel Corporation.
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA
+ * 02110-1301 USA
+ */
+
+#ifndef DISPLAY_PROBE_H_
+#define DISPLAY_PROBE_H_
+
+#include <string>
+#include <vector>
+
+// Empty if the file can not be read
+std::vector<unsigned char> ReadEdidFile(const std::string& path);
+
+// The EDID of the first connected connector the kernel DRM drivers export
+// in sysfs, empty if there is none
+std::vector<unsigned char> ReadConnectedDisplayEdid(
+    const std::string& drm_dir = "/sys/class/drm");
+
+#endif // DISPLAY_PROBE_H_
@@ -21,8 +21,22 @@
 
 #include "gst_sink_media_manager.h"
 
-GstSinkMediaManager::GstSinkMediaManager(const std::string& hostname)
-  : gst_pipeline_(new MiracGstSink(hostname, 0)) {
+#include "libwds/public/logging.h"
+
+GstSinkMediaManager::GstSinkMediaManager(const std::string& hostname, guint latency,
+                                         const std::string& source_host,
+                                         const std::vector<unsigned char>& display_edid)
+  : source_host_(source_host),
+    display_edid_(display_edid),
+    has_display_info_(false),
+    gst_pipeline_(new MiracGstSink(hostname, 0, latency)) {
+  if (!display_edid_.empty()) {
+    has_display_info_ = wds::ParseEdid(display_edid_, &display_info_);
+    if (!has_display_info_) {
+      WDS_WARNING("Ignoring the display EDID, it is not valid");
+      display_edid_.clear();
+    }
+  }
 }
 
 void GstSinkMediaManager::Play() {
@@ -63,6 +77,20 @@ std::string GstSinkMediaManager::GetSessionId() const {
 
 std::vector<wds::H264VideoCodec>
 GstSinkMediaManager::GetSupportedH264VideoCodecs() const {
+  if (has_display_info_) {
+    // Sending larger frames than the display shows only costs bandwidth
+    wds::H264VideoCodec chp(wds::CHP, wds::k4_2, display_info_.cea_rr,
+                            display_info_.vesa_rr, display_info_.hh_rr);
+    if (display_info_.has_preferred_timing) {
+      const wds::DisplayTiming& timing = display_info_.preferred_timing;
+      chp.max_hres = timing.h_active;
+      chp.max_vres = timing.interlaced ? timing.v_active * 2 : timing.v_active;
+    }
+    wds::H264VideoCodec cbp(chp);
+    cbp.profile = wds::CBP;
+    return {chp, cbp};
+  }
+
   wds::RateAndResolutionsBitmap cea_rr;
   wds::RateAndResolutionsBitmap vesa_rr;
   wds::RateAndResolutionsBitmap hh_rr;
@@ -80,8 +108,9 @@ GstSinkMediaManager::GetSupportedH264VideoCodecs() const {
 }
 
 wds::NativeVideoFormat GstSinkMediaManager::GetNativeVideoFormat() const {
+  if (has_display_info_)
+    return display_info_.native_format;
   // pick the maximum possible resolution, let gstreamer deal with it
-  // TODO: get the actual screen size of the system
   return wds::NativeVideoFormat(wds::CEA1920x1080p60);
 }
 
@@ -89,6 +118,34 @@ bool GstSinkMediaManager::SetOptimalVideoFormat(const wds::H264VideoFormat& opti
   return true;
 }
 
+std::vector<unsigned char> GstSinkMediaManager::GetDisplayEdid() const {
+  return display_edid_;
+}
+
+bool GstSinkMediaManager::GetPreferredDisplayMode(wds::DisplayTiming* timing) const {
+  if (!has_display_info_ || !display_info_.has_preferred_timing)
+    return false;
+  *timing = display_info_.preferred_timing;
+  return true;
+}
+
+bool GstSinkMediaManager::SetPreferredDisplayMode(const wds::DisplayTiming& timing) {
+  // The decoder takes whatever frame size the stream has
+  return true;
+}
+
+std::string GstSinkMediaManager::GetFrameTimingStats() const {
+  return gst_pipeline_->FrameTiming().Format();
+}
+
 wds::ConnectorType GstSinkMediaManager::GetConnectorType() const {
   return wds::ConnectorTypeNone;
 }
+
+bool GstSinkMediaManager::IsRtcpSupported() const {
+  return gst_pipeline_->IsRtcpSupported();
+}
+
+void GstSinkMediaManager::SetSourceRtcpPort(int port) {
+  gst_pipeline_->SetSourceRtcpAddress(source_host_, port);
+}
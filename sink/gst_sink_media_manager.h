@@ -24,12 +24,19 @@
 
 #include <memory>
 
+#include "libwds/public/edid.h"
 #include "libwds/public/media_manager.h"
 #include "mirac-gst-sink.hpp"
 
 class GstSinkMediaManager : public wds::SinkMediaManager {
  public:
-  explicit GstSinkMediaManager(const std::string& hostname);
+  // RTCP receiver reports are sent to source_host. The modes of
+  // display_edid are the ones offered to the source, all of them if it is
+  // empty or not valid.
+  GstSinkMediaManager(const std::string& hostname, guint latency,
+                      const std::string& source_host,
+                      const std::vector<unsigned char>& display_edid =
+                          std::vector<unsigned char>());
 
   void Play() override;
   void Pause() override;
@@ -44,12 +51,23 @@ class GstSinkMediaManager : public wds::SinkMediaManager {
   std::vector<wds::H264VideoCodec> GetSupportedH264VideoCodecs() const override;
   wds::NativeVideoFormat GetNativeVideoFormat() const override;
   bool SetOptimalVideoFormat(const wds::H264VideoFormat& optimal_format) override;
+  std::vector<unsigned char> GetDisplayEdid() const override;
+  bool GetPreferredDisplayMode(wds::DisplayTiming* timing) const override;
+  bool SetPreferredDisplayMode(const wds::DisplayTiming& timing) override;
   wds::ConnectorType GetConnectorType() const override;
+  bool IsRtcpSupported() const override;
+  void SetSourceRtcpPort(int port) override;
+
+  std::string GetFrameTimingStats() const;
 
  private:
   std::string hostname_;
+  std::string source_host_;
   std::string presentation_url_;
   std::string session_;
+  std::vector<unsigned char> display_edid_;
+  bool has_display_info_;
+  wds::EdidDisplayInfo display_info_;
   std::unique_ptr<MiracGstSink> gst_pipeline_;
 };
 
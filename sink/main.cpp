@@ -27,6 +27,7 @@
 
 #include "mirac-glib-logging.hpp"
 
+#include "display_probe.h"
 #include "sink-app.h"
 #include "sink.h"
 
@@ -40,6 +41,17 @@ static gboolean _sig_handler (gpointer data_ptr)
     return G_SOURCE_CONTINUE;
 }
 
+static void print_send_queue_stats(const MiracBroker::SendQueueStats& stats) {
+    std::cout << "RTSP send queue: " << stats.depth << " bytes queued (max "
+              << stats.max_depth << "), " << stats.messages << " messages sent, "
+              << stats.congestion_events << " times congested, "
+              << stats.overflows << " overflows" << std::endl;
+    if (stats.messages > 0)
+        std::cout << "send latency: last " << stats.last_latency << " us, max "
+                  << stats.max_latency << " us, mean "
+                  << stats.total_latency / (gint64) stats.messages << " us" << std::endl;
+}
+
 static void parse_input_and_call_sink(
     const std::string& command, Sink *sink) {
     if (command == "teardown\n") {
@@ -54,6 +66,15 @@ static void parse_input_and_call_sink(
         sink->Play();
         return;
     }
+    if (command == "idr\n") {
+        sink->RequestIDR();
+        return;
+    }
+    if (command == "stats\n") {
+        print_send_queue_stats(sink->get_send_queue_stats());
+        std::cout << "Frame timing: " << sink->get_frame_timing_stats() << std::endl;
+        return;
+    }
     std::cout << "Received unknown command: " << command << std::endl;
 }
 
@@ -88,11 +109,15 @@ int main (int argc, char *argv[])
     InitGlibLogging();
     char* hostname = NULL;
     int port = 7236;
+    int latency = MiracGstSink::default_latency;
+    char* edid_file = NULL;
     std::unique_ptr<SinkApp> app;
 
     GOptionEntry main_entries[] = {
         { "hostname", 0, 0, G_OPTION_ARG_STRING, &hostname, "Specify remote hostname (for debugging purposes)", "host"},
         { "rtsp_port", 0, 0, G_OPTION_ARG_INT, &port, "Specify remote RTSP port number (for debugging purposes), 7236 by default", "rtsp_port"},
+        { "latency", 0, 0, G_OPTION_ARG_INT, &latency, "Specify jitterbuffer latency budget in milliseconds, 40 by default", "ms"},
+        { "edid", 0, 0, G_OPTION_ARG_FILENAME, &edid_file, "Specify the EDID of the display, read from DRM sysfs by default", "file"},
         { NULL }
     };
 
@@ -108,11 +133,23 @@ int main (int argc, char *argv[])
     }
     g_option_context_free(context);
 
+    std::vector<unsigned char> edid;
+    if (edid_file) {
+        edid = ReadEdidFile(edid_file);
+        if (edid.empty())
+            WDS_WARNING ("Cannot read EDID from %s", edid_file);
+        g_free (edid_file);
+    } else {
+        edid = ReadConnectedDisplayEdid();
+    }
+    if (edid.empty())
+        std::cout << "* No display EDID, offering all resolutions" << std::endl;
+
     if (hostname) {
-        app.reset(new SinkApp(std::string(hostname), port));
+        app.reset(new SinkApp(std::string(hostname), port, latency, edid));
         g_free (hostname);
     } else {
-        app.reset(new SinkApp());
+        app.reset(new SinkApp(latency, edid));
     }
 
     GMainLoop *main_loop =  g_main_loop_new(NULL, TRUE);
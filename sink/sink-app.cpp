@@ -46,7 +46,7 @@ void SinkApp::on_availability_changed(P2P::Peer *peer)
     if (!sink_ && peer->is_available() && peer->device_type() == P2P::SOURCE) {
         std::cout << "* Connecting to source at " << peer->remote_host() << ":" << ntohs(peer->remote_port()) << std::endl;
 
-        sink_.reset(new Sink (peer->remote_host(), ntohs(peer->remote_port()), peer->local_host()));
+        sink_.reset(new Sink (peer->remote_host(), ntohs(peer->remote_port()), peer->local_host(), latency_, display_edid_));
         peer_ = peer;
     } else if (sink_ && !peer->is_available() && peer == peer_) {
         std::cout << "* Source unavailable" << std::endl;
@@ -56,7 +56,10 @@ void SinkApp::on_availability_changed(P2P::Peer *peer)
     }
 }
 
-SinkApp::SinkApp(){
+SinkApp::SinkApp(guint latency, const std::vector<unsigned char>& display_edid)
+    : peer_(NULL),
+      latency_(latency),
+      display_edid_(display_edid) {
     // Create a information element for a simple WFD Sink
     P2P::InformationElement ie;
     auto sub_element = P2P::new_subelement(P2P::DEVICE_INFORMATION);
@@ -79,11 +82,15 @@ SinkApp::SinkApp(){
     p2p_client_.reset(new P2P::Client(array, this));
 }
 
-SinkApp::SinkApp(const std::string& hostname, int port)
+SinkApp::SinkApp(const std::string& hostname, int port, guint latency,
+                 const std::vector<unsigned char>& display_edid)
+    : peer_(NULL),
+      latency_(latency),
+      display_edid_(display_edid)
 {
     std::cout << "* Connecting to peer at " << hostname << ":" << port << std::endl;
 
-    sink_.reset(new Sink (hostname, port, ""));
+    sink_.reset(new Sink (hostname, port, "", latency_, display_edid_));
 }
 
 SinkApp::~SinkApp() {
@@ -29,8 +29,13 @@
 
 class SinkApp: public P2P::Client::Observer, public P2P::Peer::Observer {
  public:
-  SinkApp();
-  SinkApp(const std::string& hostname, int port);
+  explicit SinkApp(guint latency = MiracGstSink::default_latency,
+                   const std::vector<unsigned char>& display_edid =
+                       std::vector<unsigned char>());
+  SinkApp(const std::string& hostname, int port,
+          guint latency = MiracGstSink::default_latency,
+          const std::vector<unsigned char>& display_edid =
+              std::vector<unsigned char>());
   ~SinkApp();
 
   Sink& sink() { return *sink_; }
@@ -46,6 +51,8 @@ class SinkApp: public P2P::Client::Observer, public P2P::Peer::Observer {
   std::unique_ptr<P2P::Client> p2p_client_;
   std::unique_ptr<Sink> sink_;
   P2P::Peer *peer_;
+  guint latency_;
+  std::vector<unsigned char> display_edid_;
 };
 
 #endif // SINK_APP_H
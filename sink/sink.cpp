@@ -24,9 +24,29 @@
 #include "sink.h"
 #include "gst_sink_media_manager.h"
 
-Sink::Sink(const std::string& remote_host, int remote_rtsp_port, const std::string& local_host)
-  : MiracBroker(remote_host, std::to_string(remote_rtsp_port)),
-    local_host_(local_host) {
+namespace {
+
+// The P2P group the local address belongs to, so that the RTSP connection
+// does not leave through another interface.
+std::string InterfaceOf(const std::string& local_host) {
+  if (local_host.empty())
+    return std::string();
+  try {
+    return MiracNetlink().GetInterface(local_host);
+  } catch (const std::exception& x) {
+    std::cout << "* Cannot look up local interface: " << x.what() << std::endl;
+  }
+  return std::string();
+}
+
+}
+
+Sink::Sink(const std::string& remote_host, int remote_rtsp_port, const std::string& local_host,
+           guint latency, const std::vector<unsigned char>& display_edid)
+  : MiracBroker(remote_host, std::to_string(remote_rtsp_port), 3000, InterfaceOf(local_host)),
+    local_host_(local_host),
+    latency_(latency),
+    display_edid_(display_edid) {
 }
 
 Sink::~Sink() {}
@@ -36,7 +56,8 @@ void Sink::got_message(const std::string& message) {
 }
 
 void Sink::on_connected() {
-  media_manager_.reset(new GstSinkMediaManager(local_host_));
+  media_manager_.reset(new GstSinkMediaManager(local_host_, latency_, get_peer_address(),
+                                              display_edid_));
   wfd_sink_.reset(wds::Sink::Create(this, media_manager_.get()));
   wfd_sink_->Start();
 }
@@ -62,6 +83,16 @@ void Sink::Teardown() {
   wfd_sink_->Teardown();
 }
 
+void Sink::RequestIDR() {
+  wfd_sink_->RequestIDR();
+}
+
+std::string Sink::get_frame_timing_stats() const {
+  if (!media_manager_)
+    return std::string();
+  return static_cast<GstSinkMediaManager*>(media_manager_.get())->GetFrameTimingStats();
+}
+
 wds::Peer* Sink::Peer() const {
   return wfd_sink_.get();
 }
@@ -23,20 +23,26 @@
 #define SINK_H
 
 #include <memory>
+#include <vector>
 
 #include "libwds/public/media_manager.h"
 #include "libwds/public/sink.h"
 
 #include "mirac-broker.hpp"
+#include "mirac-gst-sink.hpp"
 
 class Sink : public MiracBroker {
  public:
-  explicit Sink(const std::string& remote_host, int remote_rtsp_port, const std::string& local_host);
+  Sink(const std::string& remote_host, int remote_rtsp_port, const std::string& local_host,
+       guint latency = MiracGstSink::default_latency,
+       const std::vector<unsigned char>& display_edid = std::vector<unsigned char>());
   ~Sink();
 
   void Play();
   void Pause();
   void Teardown();
+  void RequestIDR();
+  std::string get_frame_timing_stats() const;
 
  protected:
   virtual wds::Peer* Peer() const override;
@@ -49,6 +55,8 @@ class Sink : public MiracBroker {
   std::unique_ptr<wds::SinkMediaManager> media_manager_;
   std::unique_ptr<wds::Sink> wfd_sink_;
   std::string local_host_;
+  guint latency_;
+  std::vector<unsigned char> display_edid_;
 };
 
 #endif // SINK_H